@@ -0,0 +1,455 @@
+///////////////////////////////////////////////////////////////////////////////
+// animationsystem.cpp
+// ============
+// sample keyframed clips for many objects at once on the worker threads
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AnimationSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// SSE2 is part of every x64 target, so it only needs to be
+// detected for 32-bit builds
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define ANIMATION_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// instances sampled by each task of the parallel update
+	const int g_InstancesPerBatch = 512;
+	// CPU time an update may take before it is reported
+	const double g_BudgetMilliseconds = 2.0;
+	// spacing error, relative to the first interval, up to
+	// which the keys of a track count as evenly spaced
+	const float g_EvenSpacingTolerance = 1e-4f;
+
+	/***********************************************************
+	 *  ElapsedMilliseconds()
+	 *
+	 *  Milliseconds since the passed in time point.
+	 ***********************************************************/
+	double ElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	/***********************************************************
+	 *  Blend()
+	 *
+	 *  Blend between two keys by the given amount, all four
+	 *  values at once.
+	 ***********************************************************/
+	inline glm::vec4 Blend(const glm::vec4& from, const glm::vec4& to, float amount)
+	{
+#ifdef ANIMATION_USE_SSE
+		__m128 a = _mm_loadu_ps(&from.x);
+		__m128 b = _mm_loadu_ps(&to.x);
+		glm::vec4 result;
+		_mm_storeu_ps(&result.x, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(amount))));
+		return(result);
+#else
+		return(from + (to - from) * amount);
+#endif
+	}
+
+	/***********************************************************
+	 *  NormalizeRotation()
+	 *
+	 *  Scale a blended quaternion back to unit length.  The
+	 *  keys of a track are on the same side of the sphere, so
+	 *  a blend of two of them is never near zero.
+	 ***********************************************************/
+	inline glm::vec4 NormalizeRotation(const glm::vec4& rotation)
+	{
+#ifdef ANIMATION_USE_SSE
+		__m128 q = _mm_loadu_ps(&rotation.x);
+		__m128 squares = _mm_mul_ps(q, q);
+		// add neighboring lanes, then the two halves, leaving
+		// the length squared in every lane
+		__m128 sum = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		glm::vec4 result;
+		_mm_storeu_ps(&result.x, _mm_div_ps(q, _mm_sqrt_ps(sum)));
+		return(result);
+#else
+		return(rotation / std::sqrt(glm::dot(rotation, rotation)));
+#endif
+	}
+
+	/***********************************************************
+	 *  ComposeTransform()
+	 *
+	 *  Build the transform of a pose, turned and scaled about
+	 *  the pivot and then moved, and place it by the parent.
+	 *  Each column of the pose is multiplied into the parent as
+	 *  it is made, and its last row is known, so the pose is
+	 *  never stored as a matrix of its own.
+	 ***********************************************************/
+	inline void ComposeTransform(
+		const glm::mat4& parent,
+		const glm::vec4& rotation,
+		const glm::vec4& scale,
+		const glm::vec4& position,
+		const glm::vec3& pivot,
+		glm::mat4& result)
+	{
+		float x = rotation.x;
+		float y = rotation.y;
+		float z = rotation.z;
+		float w = rotation.w;
+
+		// the turned and scaled axes
+		const float axes[3][3] =
+		{
+			{ (1.0f - 2.0f * (y * y + z * z)) * scale.x, 2.0f * (x * y + w * z) * scale.x, 2.0f * (x * z - w * y) * scale.x },
+			{ 2.0f * (x * y - w * z) * scale.y, (1.0f - 2.0f * (x * x + z * z)) * scale.y, 2.0f * (y * z + w * x) * scale.y },
+			{ 2.0f * (x * z + w * y) * scale.z, 2.0f * (y * z - w * x) * scale.z, (1.0f - 2.0f * (x * x + y * y)) * scale.z }
+		};
+		// where the origin goes so the pivot stays in place
+		float origin[3];
+		for (int k = 0; k < 3; k++)
+		{
+			origin[k] = position[k] + pivot[k] - axes[0][k] * pivot.x - axes[1][k] * pivot.y - axes[2][k] * pivot.z;
+		}
+
+#ifdef ANIMATION_USE_SSE
+		__m128 column0 = _mm_loadu_ps(&parent[0].x);
+		__m128 column1 = _mm_loadu_ps(&parent[1].x);
+		__m128 column2 = _mm_loadu_ps(&parent[2].x);
+		for (int i = 0; i < 3; i++)
+		{
+			__m128 column = _mm_mul_ps(column0, _mm_set1_ps(axes[i][0]));
+			column = _mm_add_ps(column, _mm_mul_ps(column1, _mm_set1_ps(axes[i][1])));
+			column = _mm_add_ps(column, _mm_mul_ps(column2, _mm_set1_ps(axes[i][2])));
+			_mm_storeu_ps(&result[i].x, column);
+		}
+		__m128 column = _mm_loadu_ps(&parent[3].x);
+		column = _mm_add_ps(column, _mm_mul_ps(column0, _mm_set1_ps(origin[0])));
+		column = _mm_add_ps(column, _mm_mul_ps(column1, _mm_set1_ps(origin[1])));
+		column = _mm_add_ps(column, _mm_mul_ps(column2, _mm_set1_ps(origin[2])));
+		_mm_storeu_ps(&result[3].x, column);
+#else
+		for (int i = 0; i < 3; i++)
+		{
+			result[i] = parent[0] * axes[i][0] + parent[1] * axes[i][1] + parent[2] * axes[i][2];
+		}
+		result[3] = parent[3] + parent[0] * origin[0] + parent[1] * origin[1] + parent[2] * origin[2];
+#endif
+	}
+}
+
+/***********************************************************
+ *  AnimationSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AnimationSystem::AnimationSystem(ThreadPool* pThreadPool)
+{
+	m_pThreadPool = pThreadPool;
+	m_stats = ANIMATION_STATS();
+	m_bBudgetReported = false;
+}
+
+/***********************************************************
+ *  AddClip()
+ *
+ *  This method is used to add a clip.  Its keys are copied
+ *  into the shared key arrays, and the rotation keys are
+ *  normalized and flipped where needed, so neighboring keys
+ *  are on the same side of the sphere and blend the short
+ *  way around.
+ ***********************************************************/
+int AnimationSystem::AddClip(const ANIMATION_CLIP& clip)
+{
+	CLIP_DATA data;
+
+	data.name = clip.name;
+	data.duration = clip.duration;
+	data.bLoop = clip.bLoop;
+	for (int target = 0; target < TRACK_TARGET_COUNT; target++)
+	{
+		data.firstKey[target] = 0;
+		data.keyCount[target] = 0;
+		data.keyRate[target] = 0.0f;
+	}
+
+	if (clip.duration <= 0.0f)
+	{
+		std::cout << "ERROR: animation clip " << clip.name << " has no duration" << std::endl;
+		return(-1);
+	}
+
+	// every track is checked before any key is added
+	bool bDriven[TRACK_TARGET_COUNT] = {};
+	for (int i = 0; i < (int)clip.tracks.size(); i++)
+	{
+		const ANIMATION_TRACK& track = clip.tracks[i];
+		bool bValid = (track.target >= 0) && (track.target < TRACK_TARGET_COUNT) &&
+			(track.times.empty() == false) && (track.times.size() == track.values.size());
+		bValid = bValid && (bDriven[track.target] == false);
+		for (int k = 1; bValid && (k < (int)track.times.size()); k++)
+		{
+			bValid = track.times[k] > track.times[k - 1];
+		}
+		for (int k = 0; bValid && (track.target == TRACK_ROTATION) && (k < (int)track.values.size()); k++)
+		{
+			bValid = glm::dot(track.values[k], track.values[k]) > 0.0f;
+		}
+		if (bValid == false)
+		{
+			std::cout << "ERROR: animation clip " << clip.name << " has an invalid track " << i << std::endl;
+			return(-1);
+		}
+		bDriven[track.target] = true;
+	}
+
+	for (int i = 0; i < (int)clip.tracks.size(); i++)
+	{
+		const ANIMATION_TRACK& track = clip.tracks[i];
+		data.firstKey[track.target] = (int)m_keyTimes.size();
+		data.keyCount[track.target] = (int)track.times.size();
+		// baked clips are keyed at a fixed rate, so the keys
+		// around a time can be computed
+		if (track.times.size() > 1)
+		{
+			float interval = track.times[1] - track.times[0];
+			bool bEven = true;
+			for (int k = 2; bEven && (k < (int)track.times.size()); k++)
+			{
+				float expected = track.times[0] + interval * k;
+				bEven = std::fabs(track.times[k] - expected) <= interval * g_EvenSpacingTolerance;
+			}
+			if (bEven)
+			{
+				data.keyRate[track.target] = 1.0f / interval;
+			}
+		}
+		for (int k = 0; k < (int)track.times.size(); k++)
+		{
+			glm::vec4 value = track.values[k];
+			if (track.target == TRACK_ROTATION)
+			{
+				value = glm::normalize(value);
+				if ((k > 0) && (glm::dot(value, m_keyValues.back()) < 0.0f))
+				{
+					value = -value;
+				}
+			}
+			m_keyTimes.push_back(track.times[k]);
+			m_keyValues.push_back(value);
+		}
+	}
+
+	m_clips.push_back(data);
+
+	return((int)m_clips.size() - 1);
+}
+
+/***********************************************************
+ *  AddInstance()
+ *
+ *  This method is used to add an instance playing a clip.
+ *  It is sampled for the first time by the next update.
+ ***********************************************************/
+int AnimationSystem::AddInstance(int clip, const glm::mat4& parent, const glm::vec3& pivot, float startTime, float speed)
+{
+	if ((clip < 0) || (clip >= (int)m_clips.size()))
+	{
+		std::cout << "ERROR: animation clip " << clip << " does not exist" << std::endl;
+		return(-1);
+	}
+
+	m_instanceClips.push_back(clip);
+	m_parents.push_back(parent);
+	m_pivots.push_back(pivot);
+	m_startTimes.push_back(startTime);
+	m_speeds.push_back(speed);
+	m_clipTimes.push_back(-1.0f);
+	m_transforms.push_back(parent);
+	m_colors.push_back(glm::vec4(1.0f));
+	m_uvScales.push_back(glm::vec4(1.0f));
+	m_dirty.push_back(0);
+
+	return((int)m_instanceClips.size() - 1);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used to remove every clip and instance.
+ ***********************************************************/
+void AnimationSystem::Clear()
+{
+	m_clips.clear();
+	m_keyTimes.clear();
+	m_keyValues.clear();
+	m_instanceClips.clear();
+	m_parents.clear();
+	m_pivots.clear();
+	m_startTimes.clear();
+	m_speeds.clear();
+	m_clipTimes.clear();
+	m_transforms.clear();
+	m_colors.clear();
+	m_uvScales.clear();
+	m_dirty.clear();
+	m_stats.instanceCount = 0;
+	m_stats.dirtyCount = 0;
+	m_stats.batchCount = 0;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used to sample the instances at the given
+ *  time.  Fixed size batches are handed to the thread pool,
+ *  and each batch counts the instances it moved, so nothing
+ *  is shared between the tasks.
+ ***********************************************************/
+void AnimationSystem::Update(float seconds)
+{
+	int instanceCount = (int)m_instanceClips.size();
+	int batchCount = (instanceCount + g_InstancesPerBatch - 1) / g_InstancesPerBatch;
+
+	m_stats.instanceCount = instanceCount;
+	m_stats.dirtyCount = 0;
+	m_stats.batchCount = batchCount;
+	m_stats.sampleMilliseconds = 0.0;
+	if (instanceCount == 0)
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	m_batchDirtyCounts.assign(batchCount, 0);
+	m_pThreadPool->ParallelFor(batchCount,
+		[this, seconds, instanceCount](int index, int)
+		{
+			int first = index * g_InstancesPerBatch;
+			int end = std::min(instanceCount, first + g_InstancesPerBatch);
+			m_batchDirtyCounts[index] = SampleBatch(first, end, seconds);
+		});
+
+	for (int i = 0; i < batchCount; i++)
+	{
+		m_stats.dirtyCount += m_batchDirtyCounts[i];
+	}
+
+	m_stats.sampleMilliseconds = ElapsedMilliseconds(start);
+	m_stats.peakMilliseconds = std::max(m_stats.peakMilliseconds, m_stats.sampleMilliseconds);
+	m_stats.updateCount++;
+	if (m_stats.dirtyCount > 0)
+	{
+		m_stats.changeCount++;
+	}
+	if (m_stats.sampleMilliseconds > g_BudgetMilliseconds)
+	{
+		m_stats.overBudgetCount++;
+		if (m_bBudgetReported == false)
+		{
+			std::cout << "WARNING: sampling " << instanceCount << " animations took "
+				<< m_stats.sampleMilliseconds << " ms, over the " << g_BudgetMilliseconds
+				<< " ms budget" << std::endl;
+			m_bBudgetReported = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  SampleBatch()
+ *
+ *  This method is used to sample a range of instances.  An
+ *  instance whose clip time is the one of its current pose
+ *  keeps the pose and is left clean.  The others are placed
+ *  straight into the instance's transform.
+ ***********************************************************/
+int AnimationSystem::SampleBatch(int first, int end, float seconds)
+{
+	int dirtyCount = 0;
+
+	for (int i = first; i < end; i++)
+	{
+		const CLIP_DATA& clip = m_clips[m_instanceClips[i]];
+		float clipTime = (seconds - m_startTimes[i]) * m_speeds[i];
+		if (clip.bLoop)
+		{
+			clipTime -= std::floor(clipTime / clip.duration) * clip.duration;
+		}
+		else
+		{
+			clipTime = std::min(std::max(clipTime, 0.0f), clip.duration);
+		}
+
+		if (clipTime == m_clipTimes[i])
+		{
+			m_dirty[i] = 0;
+			continue;
+		}
+		m_clipTimes[i] = clipTime;
+
+		glm::vec4 position = SampleTrack(clip, TRACK_POSITION, clipTime, glm::vec4(0.0f));
+		glm::vec4 rotation = SampleTrack(clip, TRACK_ROTATION, clipTime, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		glm::vec4 scale = SampleTrack(clip, TRACK_SCALE, clipTime, glm::vec4(1.0f));
+		m_colors[i] = SampleTrack(clip, TRACK_COLOR, clipTime, glm::vec4(1.0f));
+		m_uvScales[i] = SampleTrack(clip, TRACK_UV_SCALE, clipTime, glm::vec4(1.0f));
+
+		ComposeTransform(m_parents[i], rotation, scale, position, m_pivots[i], m_transforms[i]);
+		m_dirty[i] = 1;
+		dirtyCount++;
+	}
+
+	return(dirtyCount);
+}
+
+/***********************************************************
+ *  SampleTrack()
+ *
+ *  This method is used to sample one target of a clip.  The
+ *  keys around the clip time are computed for evenly spaced
+ *  keys and found by binary search otherwise, then blended.
+ *  Times outside the keys hold the first or the last key.
+ ***********************************************************/
+glm::vec4 AnimationSystem::SampleTrack(const CLIP_DATA& clip, TRACK_TARGET target, float clipTime, const glm::vec4& defaultValue) const
+{
+	int keyCount = clip.keyCount[target];
+	if (keyCount == 0)
+	{
+		return(defaultValue);
+	}
+
+	const float* pTimes = &m_keyTimes[clip.firstKey[target]];
+	const glm::vec4* pValues = &m_keyValues[clip.firstKey[target]];
+	if (clipTime <= pTimes[0])
+	{
+		return(pValues[0]);
+	}
+	if (clipTime >= pTimes[keyCount - 1])
+	{
+		return(pValues[keyCount - 1]);
+	}
+
+	int next = 0;
+	if (clip.keyRate[target] > 0.0f)
+	{
+		next = std::min(keyCount - 1, (int)((clipTime - pTimes[0]) * clip.keyRate[target]) + 1);
+	}
+	else
+	{
+		next = (int)(std::upper_bound(pTimes, pTimes + keyCount, clipTime) - pTimes);
+	}
+	float amount = (clipTime - pTimes[next - 1]) / (pTimes[next] - pTimes[next - 1]);
+	glm::vec4 value = Blend(pValues[next - 1], pValues[next], amount);
+	if (target == TRACK_ROTATION)
+	{
+		value = NormalizeRotation(value);
+	}
+
+	return(value);
+}
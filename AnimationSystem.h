@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// animationsystem.h
+// ============
+// sample keyframed clips for many objects at once on the worker threads
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  AnimationSystem
+ *
+ *  This class plays clips of keyframed tracks on a large
+ *  number of instances.  Each update samples the instances
+ *  in batches spread across the worker threads, one instance
+ *  at a time, blending the four floats of a key together with
+ *  SSE when it is available, and
+ *  writes each pose straight into the transform, color and
+ *  UV scale the instance hands to its draws.  Only instances
+ *  whose clip time moved are sampled again and marked dirty,
+ *  so paused and finished instances cost nothing.  The clips
+ *  are copied in and can't change afterwards.
+ ***********************************************************/
+class AnimationSystem
+{
+public:
+	// what a track drives
+	enum TRACK_TARGET
+	{
+		// translation in x, y, z
+		TRACK_POSITION,
+		// quaternion in x, y, z, w
+		TRACK_ROTATION,
+		// scale in x, y, z
+		TRACK_SCALE,
+		// multiplies the object color
+		TRACK_COLOR,
+		// multiplies the texture UV scale in x, y
+		TRACK_UV_SCALE,
+		TRACK_TARGET_COUNT
+	};
+
+	// keys of one target, times in seconds from the start of
+	// the clip and in increasing order
+	struct ANIMATION_TRACK
+	{
+		TRACK_TARGET target;
+		std::vector<float> times;
+		std::vector<glm::vec4> values;
+	};
+
+	// tracks played together, at most one per target
+	struct ANIMATION_CLIP
+	{
+		std::string name;
+		float duration;
+		// loop instead of holding the last pose
+		bool bLoop;
+		std::vector<ANIMATION_TRACK> tracks;
+	};
+
+	// counters for the most recent update and since startup
+	struct ANIMATION_STATS
+	{
+		int instanceCount;
+		int dirtyCount;
+		int batchCount;
+		double sampleMilliseconds;
+		double peakMilliseconds;
+		// updates that took longer than the budget
+		uint64_t overBudgetCount;
+		uint64_t updateCount;
+		// updates that moved at least one instance
+		uint64_t changeCount;
+	};
+
+	// constructor
+	AnimationSystem(ThreadPool* pThreadPool);
+
+	// add a clip, returns its index or -1 if its tracks are
+	// not valid
+	int AddClip(const ANIMATION_CLIP& clip);
+	// add an instance playing a clip from the given start time
+	// and at the given speed; its transform is the parent
+	// times the clip's pose about the pivot
+	int AddInstance(int clip, const glm::mat4& parent, const glm::vec3& pivot, float startTime, float speed);
+	// remove every clip and instance
+	void Clear();
+
+	// sample every instance whose clip time changed
+	void Update(float seconds);
+
+	// results of the most recent update
+	const glm::mat4& GetTransform(int instance) const { return(m_transforms[instance]); }
+	const glm::vec4& GetColor(int instance) const { return(m_colors[instance]); }
+	const glm::vec4& GetUVScale(int instance) const { return(m_uvScales[instance]); }
+	bool IsDirty(int instance) const { return(m_dirty[instance] != 0); }
+
+	int GetInstanceCount() const { return((int)m_instanceClips.size()); }
+	const ANIMATION_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// a clip, with its keys in the shared key arrays
+	struct CLIP_DATA
+	{
+		std::string name;
+		float duration;
+		bool bLoop;
+		// first key and key count of each target, 0 keys for
+		// a target the clip doesn't drive
+		int firstKey[TRACK_TARGET_COUNT];
+		int keyCount[TRACK_TARGET_COUNT];
+		// keys per second of a track with evenly spaced keys,
+		// found without a search, 0 for other tracks
+		float keyRate[TRACK_TARGET_COUNT];
+	};
+
+	ThreadPool* m_pThreadPool;
+	std::vector<CLIP_DATA> m_clips;
+	std::vector<float> m_keyTimes;
+	std::vector<glm::vec4> m_keyValues;
+
+	// instances, one entry per instance in each array
+	std::vector<int> m_instanceClips;
+	std::vector<glm::mat4> m_parents;
+	std::vector<glm::vec3> m_pivots;
+	std::vector<float> m_startTimes;
+	std::vector<float> m_speeds;
+	// clip time of the current pose, negative until sampled
+	std::vector<float> m_clipTimes;
+	// sampled poses
+	std::vector<glm::mat4> m_transforms;
+	std::vector<glm::vec4> m_colors;
+	std::vector<glm::vec4> m_uvScales;
+	std::vector<uint8_t> m_dirty;
+	// instances marked dirty by each batch
+	std::vector<int> m_batchDirtyCounts;
+
+	ANIMATION_STATS m_stats;
+	bool m_bBudgetReported;
+
+	// sample the instances of one batch
+	int SampleBatch(int first, int end, float seconds);
+	// sample one target of a clip at a clip time
+	glm::vec4 SampleTrack(const CLIP_DATA& clip, TRACK_TARGET target, float clipTime, const glm::vec4& defaultValue) const;
+};
@@ -0,0 +1,310 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetpack.cpp
+// ============
+// single file holding GPU-ready meshes, textures, materials and lights
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char g_PackMagic[4] = { 'S', 'P', 'A', 'K' };
+
+	/***********************************************************
+	 *  AlignOffset()
+	 *
+	 *  Round an offset up to the pack alignment.
+	 ***********************************************************/
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		uint64_t alignment = AssetPack::ASSET_ALIGNMENT;
+
+		return((offset + alignment - 1) & ~(alignment - 1));
+	}
+}
+
+/***********************************************************
+ *  AssetPack()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AssetPack::AssetPack()
+{
+	m_pEntries = NULL;
+	m_entryCount = 0;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used to map a pack and check that its
+ *  header and every entry lie inside the file.
+ ***********************************************************/
+bool AssetPack::Open(const char* filename)
+{
+	Close();
+
+	if (m_file.Open(filename) == false)
+	{
+		std::cout << "Could not open asset pack:" << filename << std::endl;
+		return false;
+	}
+
+	const PACK_HEADER* pHeader = (const PACK_HEADER*)m_file.GetData();
+	if ((m_file.GetSize() < sizeof(PACK_HEADER)) ||
+		(std::memcmp(pHeader->magic, g_PackMagic, sizeof(g_PackMagic)) != 0))
+	{
+		std::cout << "ERROR: " << filename << " is not an asset pack" << std::endl;
+		Close();
+		return false;
+	}
+	if (pHeader->version != ASSET_PACK_VERSION)
+	{
+		std::cout << "ERROR: asset pack " << filename << " is version " << pHeader->version
+			<< ", expected " << ASSET_PACK_VERSION << ", rebuild it with --build-asset-pack" << std::endl;
+		Close();
+		return false;
+	}
+
+	uint64_t tocSize = (uint64_t)pHeader->entryCount * sizeof(PACK_ENTRY);
+	if ((pHeader->fileSize != m_file.GetSize()) || (pHeader->tocOffset + tocSize > m_file.GetSize()))
+	{
+		std::cout << "ERROR: asset pack " << filename << " is truncated" << std::endl;
+		Close();
+		return false;
+	}
+
+	m_pEntries = (const PACK_ENTRY*)(m_file.GetData() + pHeader->tocOffset);
+	m_entryCount = (int)pHeader->entryCount;
+
+	for (int i = 0; i < m_entryCount; i++)
+	{
+		if (m_pEntries[i].offset + m_pEntries[i].size > pHeader->tocOffset)
+		{
+			std::cout << "ERROR: asset pack " << filename << " has a damaged table of contents" << std::endl;
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used to release the pack.
+ ***********************************************************/
+void AssetPack::Close()
+{
+	m_file.Close();
+	m_pEntries = NULL;
+	m_entryCount = 0;
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method is used to look up an entry by type and name.
+ ***********************************************************/
+const AssetPack::PACK_ENTRY* AssetPack::FindEntry(ENTRY_TYPE type, const char* name) const
+{
+	for (int i = 0; i < m_entryCount; i++)
+	{
+		if ((m_pEntries[i].type == (uint32_t)type) &&
+			(std::strncmp(m_pEntries[i].name, name, sizeof(m_pEntries[i].name)) == 0))
+		{
+			return(&m_pEntries[i]);
+		}
+	}
+
+	return(NULL);
+}
+
+/***********************************************************
+ *  BuildMipChain()
+ *
+ *  This method is used to build the full chain of mip levels
+ *  down to 1x1, each the average of 2x2 texels of the level
+ *  above.  Odd sizes repeat their last row or column.  The
+ *  number of levels, including the original, is returned.
+ ***********************************************************/
+int AssetPack::BuildMipChain(
+	const unsigned char* pImage,
+	int width,
+	int height,
+	int channels,
+	std::vector<unsigned char>& mipChain)
+{
+	size_t levelStart = mipChain.size();
+	int levelCount = 1;
+
+	mipChain.insert(mipChain.end(), pImage, pImage + (size_t)width * height * channels);
+
+	while ((width > 1) || (height > 1))
+	{
+		int nextWidth = std::max(1, width / 2);
+		int nextHeight = std::max(1, height / 2);
+		size_t nextStart = mipChain.size();
+
+		mipChain.resize(nextStart + (size_t)nextWidth * nextHeight * channels);
+
+		// pointers are taken after the resize, which may move
+		// the storage
+		const unsigned char* pSource = &mipChain[levelStart];
+		unsigned char* pDestination = &mipChain[nextStart];
+
+		for (int y = 0; y < nextHeight; y++)
+		{
+			int y0 = std::min(y * 2, height - 1);
+			int y1 = std::min(y * 2 + 1, height - 1);
+			for (int x = 0; x < nextWidth; x++)
+			{
+				int x0 = std::min(x * 2, width - 1);
+				int x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < channels; c++)
+				{
+					int sum = pSource[((size_t)y0 * width + x0) * channels + c] +
+						pSource[((size_t)y0 * width + x1) * channels + c] +
+						pSource[((size_t)y1 * width + x0) * channels + c] +
+						pSource[((size_t)y1 * width + x1) * channels + c];
+					pDestination[((size_t)y * nextWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+
+		levelStart = nextStart;
+		width = nextWidth;
+		height = nextHeight;
+		levelCount++;
+	}
+
+	return(levelCount);
+}
+
+/***********************************************************
+ *  GetMipChainSize()
+ *
+ *  This method is used to get the size of the first levels
+ *  of a chain laid out by BuildMipChain(), so a texture entry
+ *  can be checked before its levels are uploaded.
+ ***********************************************************/
+uint64_t AssetPack::GetMipChainSize(
+	int width,
+	int height,
+	int channels,
+	int mipCount)
+{
+	uint64_t size = 0;
+
+	if ((width <= 0) || (height <= 0) || (channels <= 0) || (mipCount <= 0))
+	{
+		return(0);
+	}
+
+	for (int level = 0; level < mipCount; level++)
+	{
+		// the chain ends at 1x1
+		if ((level > 0) && (width == 1) && (height == 1))
+		{
+			return(0);
+		}
+		if (level > 0)
+		{
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+		}
+		size += (uint64_t)width * height * channels;
+	}
+
+	return(size);
+}
+
+/***********************************************************
+ *  AddEntry()
+ *
+ *  This method is used to add an entry to the pack being
+ *  written.  Names longer than the table allows are cut.
+ ***********************************************************/
+void AssetPackWriter::AddEntry(
+	AssetPack::ENTRY_TYPE type,
+	const std::string& name,
+	const uint32_t* pParams,
+	const void* pData,
+	size_t size)
+{
+	AssetPack::PACK_ENTRY entry;
+
+	std::memset(&entry, 0, sizeof(entry));
+	std::strncpy(entry.name, name.c_str(), sizeof(entry.name) - 1);
+	entry.type = (uint32_t)type;
+	if (pParams != NULL)
+	{
+		std::memcpy(entry.params, pParams, sizeof(entry.params));
+	}
+	entry.size = size;
+
+	m_entries.push_back(entry);
+	m_data.push_back(std::vector<unsigned char>((const unsigned char*)pData, (const unsigned char*)pData + size));
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used to write the pack.  The header is
+ *  written last, once every offset is known.
+ ***********************************************************/
+bool AssetPackWriter::Write(const char* filename)
+{
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR: could not create asset pack " << filename << std::endl;
+		return false;
+	}
+
+	AssetPack::PACK_HEADER header;
+	std::memset(&header, 0, sizeof(header));
+	file.write((const char*)&header, sizeof(header));
+
+	const char padding[AssetPack::ASSET_ALIGNMENT] = { 0 };
+	uint64_t offset = sizeof(header);
+
+	for (int i = 0; i < (int)m_entries.size(); i++)
+	{
+		uint64_t aligned = AlignOffset(offset);
+		file.write(padding, (std::streamsize)(aligned - offset));
+		m_entries[i].offset = aligned;
+		file.write((const char*)m_data[i].data(), (std::streamsize)m_data[i].size());
+		offset = aligned + m_data[i].size();
+	}
+
+	uint64_t tocOffset = AlignOffset(offset);
+	file.write(padding, (std::streamsize)(tocOffset - offset));
+	file.write((const char*)m_entries.data(), (std::streamsize)(m_entries.size() * sizeof(AssetPack::PACK_ENTRY)));
+
+	std::memcpy(header.magic, g_PackMagic, sizeof(g_PackMagic));
+	header.version = AssetPack::ASSET_PACK_VERSION;
+	header.entryCount = (uint32_t)m_entries.size();
+	header.tocOffset = tocOffset;
+	header.fileSize = tocOffset + m_entries.size() * sizeof(AssetPack::PACK_ENTRY);
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+
+	if (!file)
+	{
+		std::cout << "ERROR: failed writing asset pack " << filename << std::endl;
+		return false;
+	}
+
+	std::cout << "Asset pack written to " << filename << ": " << m_entries.size()
+		<< " entries, " << header.fileSize << " bytes" << std::endl;
+
+	return true;
+}
@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetpack.h
+// ============
+// single file holding GPU-ready meshes, textures, materials and lights
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  AssetPack
+ *
+ *  This class reads an asset pack.  The file starts with a
+ *  header, followed by the data of every entry aligned to
+ *  ASSET_ALIGNMENT bytes, and ends with the table of contents.
+ *  Entries are stored in the exact layout they are uploaded
+ *  in, so loading is a lookup in the table and a pointer into
+ *  the mapped file.  Packs are little-endian and a pack with
+ *  a different version is rejected rather than converted.
+ ***********************************************************/
+class AssetPack
+{
+public:
+	// bump whenever the layout of any entry changes
+	static const uint32_t ASSET_PACK_VERSION = 1;
+	// alignment of every entry in the file
+	static const uint32_t ASSET_ALIGNMENT = 256;
+
+	// kinds of data an entry can hold
+	enum ENTRY_TYPE
+	{
+		ENTRY_MESH_VERTICES,	// MeshOptimizer::QUANTIZED_VERTEX array
+		ENTRY_MESH_INDICES,		// uint16_t array
+		ENTRY_MESH_RANGES,		// MESH_RECORD array
+		ENTRY_TEXTURE,			// mip levels, largest first, tightly packed
+		ENTRY_MATERIALS,		// MATERIAL_RECORD array
+		ENTRY_LIGHTS			// LIGHT_RECORD array
+	};
+
+	// start of the file
+	struct PACK_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+		uint64_t tocOffset;
+		uint64_t fileSize;
+	};
+
+	// one row of the table of contents
+	struct PACK_ENTRY
+	{
+		char name[32];
+		uint32_t type;
+		// meaning depends on the type, for textures the width,
+		// height, channel count and mip level count
+		uint32_t params[7];
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// location of one shape in the shared mesh buffers
+	struct MESH_RECORD
+	{
+		int32_t baseVertex;
+		int32_t partCount;
+		// flags, first index and index count of each part
+		int32_t parts[3][3];
+		float dequantize[16];
+	};
+
+	// one object material
+	struct MATERIAL_RECORD
+	{
+		char tag[32];
+		float ambientColor[3];
+		float ambientStrength;
+		float diffuseColor[3];
+		float opacity;
+		float specularColor[3];
+		float shininess;
+		uint32_t blendMode;
+	};
+
+	// one scene light
+	struct LIGHT_RECORD
+	{
+		// 0 for the directional light, 1 for a point light
+		uint32_t type;
+		int32_t index;
+		// direction of a directional light, position of a point
+		float vector[3];
+		float ambient[3];
+		float diffuse[3];
+		float specular[3];
+		float constant;
+		float linear;
+		float quadratic;
+		uint32_t bActive;
+	};
+
+	// constructor
+	AssetPack();
+
+	// map and validate a pack
+	bool Open(const char* filename);
+	// release the mapping, pointers into the pack become invalid
+	void Close();
+
+	int GetEntryCount() const { return(m_entryCount); }
+	const PACK_ENTRY& GetEntry(int index) const { return(m_pEntries[index]); }
+	// find an entry by type and name, NULL if it is missing
+	const PACK_ENTRY* FindEntry(ENTRY_TYPE type, const char* name) const;
+	// data of an entry inside the mapped file
+	const void* GetEntryData(const PACK_ENTRY& entry) const { return(m_file.GetData() + entry.offset); }
+
+	// reduce an image to every smaller mip level with a box
+	// filter, appending all levels to mipChain
+	static int BuildMipChain(
+		const unsigned char* pImage,
+		int width,
+		int height,
+		int channels,
+		std::vector<unsigned char>& mipChain);
+	// bytes of the first mipCount levels of such a chain, 0 if
+	// the chain cannot have that many levels
+	static uint64_t GetMipChainSize(
+		int width,
+		int height,
+		int channels,
+		int mipCount);
+
+private:
+	MappedFile m_file;
+	const PACK_ENTRY* m_pEntries;
+	int m_entryCount;
+};
+
+/***********************************************************
+ *  AssetPackWriter
+ *
+ *  This class collects entries in memory and writes them out
+ *  as an asset pack.
+ ***********************************************************/
+class AssetPackWriter
+{
+public:
+	// add an entry, the data is copied
+	void AddEntry(
+		AssetPack::ENTRY_TYPE type,
+		const std::string& name,
+		const uint32_t* pParams,
+		const void* pData,
+		size_t size);
+	// write the header, the aligned entries and the table
+	bool Write(const char* filename);
+
+private:
+	std::vector<AssetPack::PACK_ENTRY> m_entries;
+	std::vector<std::vector<unsigned char> > m_data;
+};
@@ -0,0 +1,377 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarksuite.cpp
+// ============
+// time the hot paths, save the results and compare them against a baseline
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BenchmarkSuite.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// declaration of global variables
+namespace
+{
+	// a single timed run must take at least this long
+	const double g_MinRunMilliseconds = 20.0;
+	// timed runs per benchmark after calibration
+	const int g_RepetitionCount = 7;
+	// calibration stops here even if the body is still too fast
+	const int g_MaxIterations = 1 << 26;
+
+	/***********************************************************
+	 *  TimeRun()
+	 *
+	 *  Time one run of a benchmark body in nanoseconds.
+	 ***********************************************************/
+	double TimeRun(const BenchmarkSuite::BENCHMARK_FUNCTION& function, int iterations)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		function(iterations);
+		return(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	/***********************************************************
+	 *  EscapeJSON()
+	 *
+	 *  Escape the characters JSON strings can't hold as is.
+	 ***********************************************************/
+	std::string EscapeJSON(const std::string& text)
+	{
+		std::string escaped;
+
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			char c = text[i];
+			if ((c == '"') || (c == '\\'))
+			{
+				escaped += '\\';
+				escaped += c;
+			}
+			else if ((unsigned char)c < 0x20)
+			{
+				char code[8];
+				snprintf(code, sizeof(code), "\\u%04x", (unsigned int)(unsigned char)c);
+				escaped += code;
+			}
+			else
+			{
+				escaped += c;
+			}
+		}
+
+		return(escaped);
+	}
+
+	/***********************************************************
+	 *  FindValue()
+	 *
+	 *  Find the start of the value of a key at or after a
+	 *  position, npos if the key doesn't follow.
+	 ***********************************************************/
+	size_t FindValue(const std::string& text, const char* key, size_t position)
+	{
+		std::string quotedKey = std::string("\"") + key + "\"";
+		size_t found = text.find(quotedKey, position);
+		if (found == std::string::npos)
+		{
+			return(std::string::npos);
+		}
+
+		found = text.find(':', found + quotedKey.size());
+		if (found == std::string::npos)
+		{
+			return(std::string::npos);
+		}
+
+		return(text.find_first_not_of(" \t\r\n", found + 1));
+	}
+}
+
+const void* volatile BenchmarkSuite::s_pSink = NULL;
+
+/***********************************************************
+ *  BenchmarkSuite()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+BenchmarkSuite::BenchmarkSuite()
+{
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used to register a benchmark.
+ ***********************************************************/
+void BenchmarkSuite::Add(const std::string& name, BENCHMARK_FUNCTION function)
+{
+	BENCHMARK benchmark;
+
+	benchmark.name = name;
+	benchmark.function = function;
+	m_benchmarks.push_back(benchmark);
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used to time every registered benchmark.
+ *  The first runs double the iteration count until a run is
+ *  long enough, which also warms up the caches.
+ ***********************************************************/
+void BenchmarkSuite::Run()
+{
+	for (int i = 0; i < (int)m_benchmarks.size(); i++)
+	{
+		const BENCHMARK& benchmark = m_benchmarks[i];
+		int iterations = 1;
+
+		while ((TimeRun(benchmark.function, iterations) < g_MinRunMilliseconds * 1000000.0) &&
+			(iterations < g_MaxIterations))
+		{
+			iterations *= 2;
+		}
+
+		std::vector<double> times;
+		for (int repetition = 0; repetition < g_RepetitionCount; repetition++)
+		{
+			times.push_back(TimeRun(benchmark.function, iterations) / iterations);
+		}
+		std::sort(times.begin(), times.end());
+
+		AddResult(benchmark.name, (uint64_t)iterations * g_RepetitionCount, times[times.size() / 2], times[0]);
+	}
+}
+
+/***********************************************************
+ *  AddResult()
+ *
+ *  This method is used to add a result measured outside the
+ *  suite and print it like the others.
+ ***********************************************************/
+void BenchmarkSuite::AddResult(
+	const std::string& name,
+	uint64_t iterations,
+	double medianNanoseconds,
+	double minNanoseconds)
+{
+	BENCHMARK_RESULT result;
+
+	result.name = name;
+	result.iterations = iterations;
+	result.medianNanoseconds = medianNanoseconds;
+	result.minNanoseconds = minNanoseconds;
+	m_results.push_back(result);
+
+	char line[256];
+	snprintf(line, sizeof(line), "%-40s %14.1f ns %14.1f ns min %12llu iterations",
+		name.c_str(), medianNanoseconds, minNanoseconds, (unsigned long long)iterations);
+	std::cout << line << std::endl;
+}
+
+/***********************************************************
+ *  SetContext()
+ *
+ *  This method is used to record a condition of the run.
+ ***********************************************************/
+void BenchmarkSuite::SetContext(const std::string& key, const std::string& value)
+{
+	m_context[key] = value;
+}
+
+/***********************************************************
+ *  WriteResults()
+ *
+ *  This method is used to write the results as JSON, with
+ *  one benchmark per line so result files diff cleanly.
+ ***********************************************************/
+bool BenchmarkSuite::WriteResults(const char* filename) const
+{
+	std::ofstream file(filename, std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR: could not create benchmark results " << filename << std::endl;
+		return false;
+	}
+
+	file << "{\n  \"context\": {";
+	std::map<std::string, std::string>::const_iterator it;
+	for (it = m_context.begin(); it != m_context.end(); ++it)
+	{
+		file << ((it == m_context.begin()) ? "\n" : ",\n") << "    \"" << EscapeJSON(it->first) << "\": \""
+			<< EscapeJSON(it->second) << "\"";
+	}
+	file << "\n  },\n  \"benchmarks\": [";
+
+	for (int i = 0; i < (int)m_results.size(); i++)
+	{
+		char values[160];
+		snprintf(values, sizeof(values), "\"iterations\": %llu, \"median_ns\": %.3f, \"min_ns\": %.3f",
+			(unsigned long long)m_results[i].iterations, m_results[i].medianNanoseconds, m_results[i].minNanoseconds);
+		file << ((i == 0) ? "\n" : ",\n") << "    { \"name\": \"" << EscapeJSON(m_results[i].name) << "\", "
+			<< values << " }";
+	}
+	file << "\n  ]\n}\n";
+
+	if (!file)
+	{
+		std::cout << "ERROR: failed writing benchmark results " << filename << std::endl;
+		return false;
+	}
+
+	std::cout << "Benchmark results written to " << filename << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  ReadResults()
+ *
+ *  This method is used to read back the benchmarks of a
+ *  result file.  Only the layout WriteResults() produces is
+ *  understood, which is all the comparison needs.  A file
+ *  without any benchmark is rejected, so a broken result
+ *  can't pass the comparison.
+ ***********************************************************/
+bool BenchmarkSuite::ReadResults(const char* filename, std::vector<BENCHMARK_RESULT>& results)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cout << "ERROR: could not open benchmark results " << filename << std::endl;
+		return false;
+	}
+
+	std::stringstream stream;
+	stream << file.rdbuf();
+	std::string text = stream.str();
+
+	results.clear();
+	size_t position = text.find("\"benchmarks\"");
+	if (position == std::string::npos)
+	{
+		std::cout << "ERROR: " << filename << " is not a benchmark result file" << std::endl;
+		return false;
+	}
+	while (position != std::string::npos)
+	{
+		size_t nameStart = FindValue(text, "name", position);
+		if ((nameStart == std::string::npos) || (text[nameStart] != '"'))
+		{
+			break;
+		}
+		size_t nameEnd = text.find('"', nameStart + 1);
+		size_t iterationsStart = FindValue(text, "iterations", nameEnd);
+		size_t medianStart = FindValue(text, "median_ns", nameEnd);
+		size_t minStart = FindValue(text, "min_ns", nameEnd);
+		if ((nameEnd == std::string::npos) || (iterationsStart == std::string::npos) ||
+			(medianStart == std::string::npos) || (minStart == std::string::npos))
+		{
+			std::cout << "ERROR: " << filename << " is not a benchmark result file" << std::endl;
+			return false;
+		}
+
+		BENCHMARK_RESULT result;
+		result.name = text.substr(nameStart + 1, nameEnd - nameStart - 1);
+		result.iterations = strtoull(text.c_str() + iterationsStart, NULL, 10);
+		result.medianNanoseconds = strtod(text.c_str() + medianStart, NULL);
+		result.minNanoseconds = strtod(text.c_str() + minStart, NULL);
+		results.push_back(result);
+
+		position = minStart;
+	}
+
+	if (results.empty())
+	{
+		std::cout << "ERROR: " << filename << " holds no benchmark results" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  Compare()
+ *
+ *  This method is used to check results against a baseline.
+ *  Medians are compared, and a benchmark regresses when it
+ *  got slower by more than the threshold.  A baseline
+ *  benchmark missing from the results fails the check as
+ *  well, while new benchmarks are only listed.
+ ***********************************************************/
+int BenchmarkSuite::Compare(const char* baselineFilename, const char* resultsFilename, double thresholdPercent)
+{
+	std::vector<BENCHMARK_RESULT> baseline;
+	std::vector<BENCHMARK_RESULT> results;
+
+	if ((ReadResults(baselineFilename, baseline) == false) || (ReadResults(resultsFilename, results) == false))
+	{
+		return(-1);
+	}
+
+	int regressionCount = 0;
+	int missingCount = 0;
+	char line[256];
+
+	snprintf(line, sizeof(line), "%-40s %14s %14s %9s", "benchmark", "baseline ns", "current ns", "change");
+	std::cout << line << std::endl;
+
+	for (int i = 0; i < (int)results.size(); i++)
+	{
+		const BENCHMARK_RESULT* pBaseline = NULL;
+		for (int j = 0; j < (int)baseline.size(); j++)
+		{
+			if (baseline[j].name == results[i].name)
+			{
+				pBaseline = &baseline[j];
+				break;
+			}
+		}
+
+		if ((pBaseline == NULL) || (pBaseline->medianNanoseconds <= 0.0))
+		{
+			snprintf(line, sizeof(line), "%-40s %14s %14.1f %9s", results[i].name.c_str(), "-",
+				results[i].medianNanoseconds, "new");
+			std::cout << line << std::endl;
+			continue;
+		}
+
+		double change = (results[i].medianNanoseconds / pBaseline->medianNanoseconds - 1.0) * 100.0;
+		bool bRegressed = (change > thresholdPercent);
+		if (bRegressed)
+		{
+			regressionCount++;
+		}
+
+		snprintf(line, sizeof(line), "%-40s %14.1f %14.1f %+8.1f%%%s", results[i].name.c_str(),
+			pBaseline->medianNanoseconds, results[i].medianNanoseconds, change, bRegressed ? "  REGRESSED" : "");
+		std::cout << line << std::endl;
+	}
+
+	for (int j = 0; j < (int)baseline.size(); j++)
+	{
+		bool bFound = false;
+		for (int i = 0; (i < (int)results.size()) && (bFound == false); i++)
+		{
+			bFound = (results[i].name == baseline[j].name);
+		}
+		if (bFound == false)
+		{
+			snprintf(line, sizeof(line), "%-40s %14.1f %14s %9s  MISSING", baseline[j].name.c_str(),
+				baseline[j].medianNanoseconds, "-", "-");
+			std::cout << line << std::endl;
+			missingCount++;
+		}
+	}
+
+	std::cout << regressionCount << " of " << results.size() << " benchmarks regressed by more than "
+		<< thresholdPercent << "%, " << missingCount << " missing from the results" << std::endl;
+
+	return(regressionCount + missingCount);
+}
@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarksuite.h
+// ============
+// time the hot paths, save the results and compare them against a baseline
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  BenchmarkSuite
+ *
+ *  This class runs a set of microbenchmarks and collects
+ *  their results together with any measured elsewhere, such
+ *  as whole frames.  Each benchmark body is handed an
+ *  iteration count, which is doubled until one run takes long
+ *  enough to time reliably.  The run is then repeated, and
+ *  the median and the fastest time per iteration are kept.
+ *  Results are written as JSON, and Compare() checks a result
+ *  file against a stored baseline.
+ ***********************************************************/
+class BenchmarkSuite
+{
+public:
+	// body of a benchmark, runs the measured code the given
+	// number of times
+	typedef std::function<void(int iterations)> BENCHMARK_FUNCTION;
+
+	// outcome of one benchmark
+	struct BENCHMARK_RESULT
+	{
+		std::string name;
+		uint64_t iterations;
+		double medianNanoseconds;
+		double minNanoseconds;
+	};
+
+	// constructor
+	BenchmarkSuite();
+
+	// register a benchmark to be timed by Run()
+	void Add(const std::string& name, BENCHMARK_FUNCTION function);
+	// time every registered benchmark, printing each result
+	void Run();
+	// add a result that was timed by the caller
+	void AddResult(const std::string& name, uint64_t iterations, double medianNanoseconds, double minNanoseconds);
+	// describe the conditions of the run, such as the renderer
+	void SetContext(const std::string& key, const std::string& value);
+
+	const std::vector<BENCHMARK_RESULT>& GetResults() const { return(m_results); }
+
+	// write the context and results as JSON
+	bool WriteResults(const char* filename) const;
+	// read the results of a file written by WriteResults()
+	static bool ReadResults(const char* filename, std::vector<BENCHMARK_RESULT>& results);
+	// print how each result differs from the baseline, returns
+	// the number slower by more than the threshold percentage
+	// plus the number missing from the results, or -1 if a
+	// file can't be read
+	static int Compare(const char* baselineFilename, const char* resultsFilename, double thresholdPercent);
+
+	// keep the compiler from removing code whose result is
+	// otherwise unused
+	template <class T>
+	static void DoNotOptimize(const T& value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r"(&value) : "memory");
+#else
+		s_pSink = &value;
+#endif
+	}
+
+private:
+	// a registered benchmark
+	struct BENCHMARK
+	{
+		std::string name;
+		BENCHMARK_FUNCTION function;
+	};
+
+	std::vector<BENCHMARK> m_benchmarks;
+	std::vector<BENCHMARK_RESULT> m_results;
+	std::map<std::string, std::string> m_context;
+
+	static const void* volatile s_pSink;
+};
@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerarecorder.cpp
+// ============
+// record the camera path of a session and play it back at a fixed rate
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char g_TrackMagic[4] = { 'C', 'T', 'R', 'K' };
+	const uint32_t g_TrackVersion = 1;
+
+	// start of every track file
+	struct TRACK_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t sampleSize;
+		uint32_t sampleCount;
+	};
+
+	/***********************************************************
+	 *  CompareSampleTime()
+	 *
+	 *  Order a time before the samples that come after it.
+	 ***********************************************************/
+	bool CompareSampleTime(float time, const CameraRecorder::CAMERA_SAMPLE& sample)
+	{
+		return(time < sample.time);
+	}
+}
+
+/***********************************************************
+ *  CameraRecorder()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraRecorder::CameraRecorder()
+{
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used to remove every sample of the track.
+ ***********************************************************/
+void CameraRecorder::Clear()
+{
+	m_samples.clear();
+}
+
+/***********************************************************
+ *  AddSample()
+ *
+ *  This method is used to append the camera state of a frame.
+ ***********************************************************/
+void CameraRecorder::AddSample(const CAMERA_SAMPLE& sample)
+{
+	m_samples.push_back(sample);
+	if ((m_samples.size() > 1) && (sample.time < m_samples[m_samples.size() - 2].time))
+	{
+		m_samples.back().time = m_samples[m_samples.size() - 2].time;
+	}
+}
+
+/***********************************************************
+ *  Save()
+ *
+ *  This method is used to write the track to a file.
+ ***********************************************************/
+bool CameraRecorder::Save(const char* filename) const
+{
+	TRACK_HEADER header;
+	std::memcpy(header.magic, g_TrackMagic, sizeof(g_TrackMagic));
+	header.version = g_TrackVersion;
+	header.sampleSize = (uint32_t)sizeof(CAMERA_SAMPLE);
+	header.sampleCount = (uint32_t)m_samples.size();
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	if (m_samples.empty() == false)
+	{
+		file.write((const char*)m_samples.data(), (std::streamsize)(m_samples.size() * sizeof(CAMERA_SAMPLE)));
+	}
+	if (!file)
+	{
+		std::cout << "ERROR: could not write camera track " << filename << std::endl;
+		return false;
+	}
+
+	std::cout << "INFO: camera track of " << m_samples.size() << " frames, " << GetDuration()
+		<< " seconds, written to " << filename << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used to read a track written by Save().
+ ***********************************************************/
+bool CameraRecorder::Load(const char* filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "ERROR: could not open camera track " << filename << std::endl;
+		return false;
+	}
+
+	TRACK_HEADER header;
+	file.read((char*)&header, sizeof(header));
+	if (!file || (std::memcmp(header.magic, g_TrackMagic, sizeof(g_TrackMagic)) != 0) ||
+		(header.version != g_TrackVersion) || (header.sampleSize != sizeof(CAMERA_SAMPLE)))
+	{
+		std::cout << "ERROR: " << filename << " is not a camera track of this version" << std::endl;
+		return false;
+	}
+
+	// the count is checked against the rest of the file before
+	// anything is allocated for it
+	std::streamoff samplesStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	file.seekg(samplesStart);
+	if (!file || ((uint64_t)header.sampleCount * sizeof(CAMERA_SAMPLE) > (uint64_t)(fileSize - samplesStart)))
+	{
+		std::cout << "ERROR: camera track " << filename << " is truncated" << std::endl;
+		return false;
+	}
+
+	std::vector<CAMERA_SAMPLE> samples(header.sampleCount);
+	if (samples.empty() == false)
+	{
+		file.read((char*)samples.data(), (std::streamsize)(samples.size() * sizeof(CAMERA_SAMPLE)));
+	}
+	if (!file)
+	{
+		std::cout << "ERROR: camera track " << filename << " is truncated" << std::endl;
+		return false;
+	}
+
+	m_samples.swap(samples);
+
+	return true;
+}
+
+/***********************************************************
+ *  GetSample()
+ *
+ *  This method is used to get the camera state at a time of
+ *  the track.  Positions and zoom are blended linearly and
+ *  the directions are blended and normalized again, while
+ *  the flags come from the sample at or before the time.
+ ***********************************************************/
+bool CameraRecorder::GetSample(float time, CAMERA_SAMPLE& sample) const
+{
+	if (m_samples.empty())
+	{
+		return false;
+	}
+
+	// first sample later than the time
+	std::vector<CAMERA_SAMPLE>::const_iterator next =
+		std::upper_bound(m_samples.begin(), m_samples.end(), time, CompareSampleTime);
+
+	if (next == m_samples.begin())
+	{
+		sample = m_samples.front();
+		sample.time = time;
+		return true;
+	}
+	if (next == m_samples.end())
+	{
+		sample = m_samples.back();
+		sample.time = time;
+		return(time <= m_samples.back().time);
+	}
+
+	const CAMERA_SAMPLE& previous = *(next - 1);
+	float span = next->time - previous.time;
+	float blend = (span > 0.0f) ? (time - previous.time) / span : 0.0f;
+
+	sample = previous;
+	sample.time = time;
+	sample.position = glm::mix(previous.position, next->position, blend);
+	sample.front = glm::normalize(glm::mix(previous.front, next->front, blend));
+	sample.up = glm::normalize(glm::mix(previous.up, next->up, blend));
+	sample.zoom = previous.zoom + (next->zoom - previous.zoom) * blend;
+
+	return true;
+}
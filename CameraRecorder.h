@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerarecorder.h
+// ============
+// record the camera path of a session and play it back at a fixed rate
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  CameraRecorder
+ *
+ *  This class holds a camera track: one sample per recorded
+ *  frame with the camera pose, the projection mode and the
+ *  movement keys that were held.  Samples are stamped with
+ *  the time since the recording started, so playback can ask
+ *  for the pose at any time and get the same path whatever
+ *  the frame rate of either run.  Tracks are stored as a
+ *  small header followed by the raw samples.
+ ***********************************************************/
+class CameraRecorder
+{
+public:
+	// keys held and modes set during a sample
+	enum INPUT_FLAGS
+	{
+		INPUT_FORWARD = 1,
+		INPUT_BACKWARD = 2,
+		INPUT_LEFT = 4,
+		INPUT_RIGHT = 8,
+		INPUT_UP = 16,
+		INPUT_DOWN = 32,
+		INPUT_ORTHOGRAPHIC = 64
+	};
+
+	// camera state of one frame
+	struct CAMERA_SAMPLE
+	{
+		float time;
+		glm::vec3 position;
+		glm::vec3 front;
+		glm::vec3 up;
+		float zoom;
+		uint32_t inputFlags;
+	};
+
+	// constructor
+	CameraRecorder();
+
+	// remove every sample
+	void Clear();
+	// append a sample, times must not decrease
+	void AddSample(const CAMERA_SAMPLE& sample);
+
+	// write the track to a file
+	bool Save(const char* filename) const;
+	// replace the track with the one in a file
+	bool Load(const char* filename);
+
+	// camera state at a time, blended between the samples
+	// around it.  Returns false past the end of the track,
+	// where the last sample is given.
+	bool GetSample(float time, CAMERA_SAMPLE& sample) const;
+
+	int GetSampleCount() const { return((int)m_samples.size()); }
+	float GetDuration() const { return(m_samples.empty() ? 0.0f : m_samples.back().time); }
+
+private:
+	std::vector<CAMERA_SAMPLE> m_samples;
+};
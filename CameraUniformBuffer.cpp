@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerauniformbuffer.cpp
+// ============
+// share the per-frame camera data with every shader program through a
+// single std140 uniform block
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraUniformBuffer.h"
+#include "RenderStats.h"
+
+// declaration of global variables
+namespace
+{
+	// name of the uniform block declared in the shaders
+	const char* g_CameraBlockName = "CameraBlock";
+}
+
+/***********************************************************
+ *  CameraUniformBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraUniformBuffer::CameraUniformBuffer()
+{
+	m_frameIndex = 0;
+	m_block = CAMERA_BLOCK();
+	m_lastProjection = glm::mat4(1.0f);
+	m_bInverseProjectionValid = false;
+}
+
+/***********************************************************
+ *  ~CameraUniformBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+CameraUniformBuffer::~CameraUniformBuffer()
+{
+	// the buffer is deleted by its handle
+}
+
+/***********************************************************
+ *  RegisterProgram()
+ *
+ *  This method is used to connect the camera block of the
+ *  passed in program to the shared binding point.  It must
+ *  be called once for every program that is linked.
+ ***********************************************************/
+bool CameraUniformBuffer::RegisterProgram(GLuint programID)
+{
+	if (programID == 0)
+	{
+		return false;
+	}
+
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_CameraBlockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		return false;
+	}
+
+	glUniformBlockBinding(programID, blockIndex, CAMERA_BLOCK_BINDING);
+
+	return true;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used to fill in the camera block for the
+ *  current frame and upload it with a single buffer update.
+ ***********************************************************/
+void CameraUniformBuffer::Update(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& cameraPosition,
+	float deltaTime,
+	float elapsedTime)
+{
+	m_block.frameTime = glm::vec4(deltaTime, elapsedTime, (float)m_frameIndex, 0.0f);
+	m_frameIndex++;
+
+	SetView(view, projection, cameraPosition);
+}
+
+/***********************************************************
+ *  SetView()
+ *
+ *  This method is used to fill in the camera of the block
+ *  and upload it.  Frames drawing several views call it for
+ *  each view after the first, so the frame index only
+ *  advances once per frame.
+ ***********************************************************/
+void CameraUniformBuffer::SetView(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& cameraPosition)
+{
+	// the buffer can only be created once a context exists
+	if (m_buffer.Get() == 0)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer.Create("camera block"));
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(CAMERA_BLOCK), NULL, GL_DYNAMIC_DRAW);
+		m_buffer.SetBytes(sizeof(CAMERA_BLOCK));
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, m_buffer.Get());
+	}
+
+	// the projection rarely changes, so skip the 4x4 inverse
+	// unless it is different from the previous upload
+	if ((m_bInverseProjectionValid == false) || (projection != m_lastProjection))
+	{
+		m_block.inverseProjection = glm::inverse(projection);
+		m_lastProjection = projection;
+		m_bInverseProjectionValid = true;
+	}
+
+	m_block.view = view;
+	m_block.projection = projection;
+	m_block.viewProjection = projection * view;
+	m_block.inverseView = glm::inverse(view);
+	m_block.inverseViewProjection = m_block.inverseView * m_block.inverseProjection;
+	m_block.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer.Get());
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CAMERA_BLOCK), &m_block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	RenderStats::Count(RenderStats::COUNTER_UPLOAD_BYTES, sizeof(CAMERA_BLOCK));
+}
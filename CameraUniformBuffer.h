@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerauniformbuffer.h
+// ============
+// share the per-frame camera data with every shader program through a
+// single std140 uniform block
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GpuResources.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  CameraUniformBuffer
+ *
+ *  This class owns the uniform buffer holding the camera
+ *  matrices for the current frame.  Shader programs opt in
+ *  by declaring the block below, and are attached to the
+ *  shared binding point through RegisterProgram().
+ *
+ *  layout (std140) uniform CameraBlock
+ *  {
+ *      mat4 view;
+ *      mat4 projection;
+ *      mat4 viewProjection;
+ *      mat4 inverseView;
+ *      mat4 inverseProjection;
+ *      mat4 inverseViewProjection;
+ *      vec4 cameraPosition;   // xyz = world position
+ *      vec4 frameTime;        // x = delta seconds, y = elapsed seconds, z = frame index
+ *  };
+ ***********************************************************/
+class CameraUniformBuffer
+{
+public:
+	// binding point shared by all programs for the camera block
+	static const GLuint CAMERA_BLOCK_BINDING = 0;
+
+	// CPU side mirror of the std140 block layout
+	struct CAMERA_BLOCK
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::mat4 viewProjection;
+		glm::mat4 inverseView;
+		glm::mat4 inverseProjection;
+		glm::mat4 inverseViewProjection;
+		glm::vec4 cameraPosition;
+		glm::vec4 frameTime;
+	};
+
+	// constructor
+	CameraUniformBuffer();
+	// destructor
+	~CameraUniformBuffer();
+
+	// attach a program's camera block to the shared binding
+	// point, returns false if the program does not declare it
+	bool RegisterProgram(GLuint programID);
+
+	// upload the camera data for the current frame
+	void Update(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& cameraPosition,
+		float deltaTime,
+		float elapsedTime);
+	// upload another camera for a further view of the same
+	// frame, keeping the frame timing
+	void SetView(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& cameraPosition);
+
+	// most recently uploaded block contents
+	const CAMERA_BLOCK& GetBlock() const { return(m_block); }
+
+private:
+	// uniform buffer object holding the block
+	GLBuffer m_buffer;
+	// CPU copy of the block contents
+	CAMERA_BLOCK m_block;
+	// number of frames uploaded so far
+	unsigned int m_frameIndex;
+	// inverse projection is only recomputed when it changes
+	glm::mat4 m_lastProjection;
+	bool m_bInverseProjectionValid;
+};
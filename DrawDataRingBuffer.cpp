@@ -0,0 +1,314 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawdataringbuffer.cpp
+// ============
+// persistently mapped ring buffer holding the per-draw shader data
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DrawDataRingBuffer.h"
+
+#include <iostream>
+#include <chrono>
+
+// declaration of global variables
+namespace
+{
+	// name of the shader storage block declared in the shaders
+	const char* g_DrawDataBlockName = "DrawDataBlock";
+	const char* g_MaterialBlockName = "MaterialBlock";
+	// how long a single fence wait may block before retrying
+	const GLuint64 g_FenceTimeoutNanoseconds = 1000000000;
+}
+
+/***********************************************************
+ *  DrawDataRingBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DrawDataRingBuffer::DrawDataRingBuffer()
+{
+	m_pMappedData = NULL;
+	m_drawsPerRegion = 0;
+	m_bBlockDeclared = false;
+	m_regionIndex = 0;
+	m_writeCursor = 0;
+	for (int i = 0; i < FRAME_REGION_COUNT; i++)
+	{
+		m_regionFences[i] = NULL;
+	}
+	m_stats = FENCE_WAIT_STATS();
+}
+
+/***********************************************************
+ *  ~DrawDataRingBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DrawDataRingBuffer::~DrawDataRingBuffer()
+{
+	for (int i = 0; i < FRAME_REGION_COUNT; i++)
+	{
+		if (m_regionFences[i] != NULL)
+		{
+			glDeleteSync(m_regionFences[i]);
+			m_regionFences[i] = NULL;
+		}
+	}
+
+	m_materialBuffer.Reset();
+
+	if (m_buffer.Get() != 0)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer.Get());
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_buffer.Reset();
+		m_pMappedData = NULL;
+	}
+
+	if (m_stats.frameCount > 0)
+	{
+		std::cout << "INFO: draw data ring buffer waited on " << m_stats.waitCount
+			<< " of " << m_stats.frameCount << " frames, "
+			<< m_stats.totalWaitMilliseconds << " ms total, "
+			<< m_stats.maxWaitMilliseconds << " ms longest" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used to create the ring buffer with
+ *  immutable storage and map it once for the lifetime of
+ *  the application.
+ ***********************************************************/
+bool DrawDataRingBuffer::Initialize(GLuint programID, int maxDrawsPerFrame)
+{
+	// the program must read its per-draw data from the buffer
+	m_bBlockDeclared = BindProgram(programID);
+	if (m_bBlockDeclared == false)
+	{
+		std::cout << "INFO: shader has no " << g_DrawDataBlockName << ", using per-draw uniforms" << std::endl;
+		return false;
+	}
+
+	// persistent mapping needs OpenGL 4.4 or ARB_buffer_storage
+	if (!GLEW_ARB_buffer_storage)
+	{
+		std::cout << "INFO: persistent buffer mapping unavailable, using per-draw uniforms" << std::endl;
+		return false;
+	}
+
+	return(CreateStorage(maxDrawsPerFrame));
+}
+
+/***********************************************************
+ *  BindProgram()
+ *
+ *  This method is used to point the storage blocks of a
+ *  program at the binding points of the buffers.
+ ***********************************************************/
+bool DrawDataRingBuffer::BindProgram(GLuint programID)
+{
+	GLuint blockIndex = glGetProgramResourceIndex(programID, GL_SHADER_STORAGE_BLOCK, g_DrawDataBlockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		return false;
+	}
+	glShaderStorageBlockBinding(programID, blockIndex, DRAW_DATA_BINDING);
+
+	// the material table is optional, draws still get their
+	// material index when the shader has no table to read
+	blockIndex = glGetProgramResourceIndex(programID, GL_SHADER_STORAGE_BLOCK, g_MaterialBlockName);
+	if (blockIndex != GL_INVALID_INDEX)
+	{
+		glShaderStorageBlockBinding(programID, blockIndex, MATERIAL_BINDING);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  CreateStorage()
+ *
+ *  This method is used to allocate the immutable buffer
+ *  storage for the given number of draws per frame and bind
+ *  it to the draw data binding point.
+ ***********************************************************/
+bool DrawDataRingBuffer::CreateStorage(int drawsPerRegion)
+{
+	GLsizeiptr bufferSize = (GLsizeiptr)sizeof(DRAW_DATA) * drawsPerRegion * FRAME_REGION_COUNT;
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer.Create("draw data ring"));
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, bufferSize, NULL, flags);
+	m_buffer.SetBytes((size_t)bufferSize);
+	m_pMappedData = (DRAW_DATA*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, bufferSize, flags);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	if (m_pMappedData == NULL)
+	{
+		std::cout << "ERROR: could not map the draw data ring buffer" << std::endl;
+		m_buffer.Reset();
+		return false;
+	}
+
+	m_drawsPerRegion = drawsPerRegion;
+
+	// the whole buffer stays bound, frames are selected by the
+	// region offset folded into each draw index
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_buffer.Get());
+
+	return true;
+}
+
+/***********************************************************
+ *  GrowStorage()
+ *
+ *  This method is used to replace a ring buffer too small for
+ *  the draws of the next frame, doubling its size until they
+ *  fit.  It runs before the frame writes any record, and the
+ *  draws of earlier frames keep reading the old storage,
+ *  which the driver releases once they have completed.
+ ***********************************************************/
+bool DrawDataRingBuffer::GrowStorage(int drawCount)
+{
+	int drawsPerRegion = m_drawsPerRegion;
+	while (drawsPerRegion < drawCount)
+	{
+		drawsPerRegion *= 2;
+	}
+
+	// the fences only guard regions of the old storage
+	for (int i = 0; i < FRAME_REGION_COUNT; i++)
+	{
+		if (m_regionFences[i] != NULL)
+		{
+			glDeleteSync(m_regionFences[i]);
+			m_regionFences[i] = NULL;
+		}
+	}
+
+	m_buffer.Reset();
+	m_pMappedData = NULL;
+	m_stats.resizeCount++;
+
+	std::cout << "INFO: draw data ring buffer grown to " << drawsPerRegion << " draws per frame" << std::endl;
+
+	return(CreateStorage(drawsPerRegion));
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used to advance to the next frame region,
+ *  waiting on its fence if the GPU is still reading it.  A
+ *  frame with more draws than a region holds grows the
+ *  buffer first, so records are never moved once written.
+ ***********************************************************/
+bool DrawDataRingBuffer::BeginFrame(int drawCount)
+{
+	if ((m_pMappedData != NULL) && (drawCount > m_drawsPerRegion) && (GrowStorage(drawCount) == false))
+	{
+		return false;
+	}
+
+	m_regionIndex = (m_regionIndex + 1) % FRAME_REGION_COUNT;
+	m_writeCursor = 0;
+	m_stats.frameCount++;
+	m_stats.lastWaitMilliseconds = 0.0;
+
+	GLsync fence = m_regionFences[m_regionIndex];
+	if (fence == NULL)
+	{
+		return true;
+	}
+
+	// a signaled fence costs nothing, anything else means the
+	// CPU has run FRAME_REGION_COUNT frames ahead of the GPU
+	GLenum waitResult = glClientWaitSync(fence, 0, 0);
+	if (waitResult == GL_TIMEOUT_EXPIRED)
+	{
+		auto waitStart = std::chrono::steady_clock::now();
+		do
+		{
+			waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, g_FenceTimeoutNanoseconds);
+		} while (waitResult == GL_TIMEOUT_EXPIRED);
+		auto waitEnd = std::chrono::steady_clock::now();
+
+		double waitMilliseconds = std::chrono::duration<double, std::milli>(waitEnd - waitStart).count();
+		m_stats.waitCount++;
+		m_stats.lastWaitMilliseconds = waitMilliseconds;
+		m_stats.totalWaitMilliseconds += waitMilliseconds;
+		if (waitMilliseconds > m_stats.maxWaitMilliseconds)
+		{
+			m_stats.maxWaitMilliseconds = waitMilliseconds;
+		}
+	}
+
+	glDeleteSync(fence);
+	m_regionFences[m_regionIndex] = NULL;
+
+	return true;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used to place a fence after the last draw
+ *  that reads from the current frame region.
+ ***********************************************************/
+void DrawDataRingBuffer::EndFrame()
+{
+	if (m_pMappedData == NULL)
+	{
+		return;
+	}
+
+	m_regionFences[m_regionIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used to reserve the next per-draw record.
+ *  Records are handed out linearly through the region so the
+ *  writes stream through memory in order.
+ ***********************************************************/
+DrawDataRingBuffer::DRAW_DATA* DrawDataRingBuffer::Allocate(int& drawIndex)
+{
+	if (m_pMappedData == NULL)
+	{
+		return NULL;
+	}
+	if (m_writeCursor >= m_drawsPerRegion)
+	{
+		return NULL;
+	}
+
+	drawIndex = (m_regionIndex * m_drawsPerRegion) + m_writeCursor;
+	m_writeCursor++;
+
+	return(&m_pMappedData[drawIndex]);
+}
+
+/***********************************************************
+ *  UploadMaterials()
+ *
+ *  This method is used to upload the table of materials that
+ *  the per-draw records index into.  Materials are defined
+ *  once, so the table is written a single time.
+ ***********************************************************/
+void DrawDataRingBuffer::UploadMaterials(const MATERIAL_DATA* pMaterials, int materialCount)
+{
+	if ((m_pMappedData == NULL) || (materialCount <= 0))
+	{
+		return;
+	}
+
+	// creating the handle again deletes the previous table
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialBuffer.Create("material table"));
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(MATERIAL_DATA) * materialCount, pMaterials, 0);
+	m_materialBuffer.SetBytes(sizeof(MATERIAL_DATA) * materialCount);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, m_materialBuffer.Get());
+}
@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawdataringbuffer.h
+// ============
+// persistently mapped ring buffer holding the per-draw shader data
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GpuResources.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  DrawDataRingBuffer
+ *
+ *  This class owns a shader storage buffer that stays mapped
+ *  for the lifetime of the application.  It is split into
+ *  one region per frame in flight, and each region is
+ *  guarded by a fence so the CPU never overwrites data the
+ *  GPU has not finished reading.  Shaders read the record of
+ *  the current draw through the drawIndex uniform, and take
+ *  the per-draw uniforms instead while it is negative, which
+ *  is how every draw is made when the buffer can't be used:
+ *
+ *  struct DrawData
+ *  {
+ *      mat4 model;
+ *      mat4 normalMatrix;
+ *      vec4 objectColor;
+ *      vec4 uvScale;         // xy = texture UV scale
+ *      ivec4 params;         // x = material index, y = texture slot, z = use texture,
+ *                            // w = texture atlas entry, 0 if not packed
+ *  };
+ *  layout (std430, binding = 1) readonly buffer DrawDataBlock
+ *  {
+ *      DrawData draws[];
+ *  };
+ *  uniform int drawIndex;
+ *  uniform sampler2D objectTextures[16];
+ *
+ *  The buffer is sized for the draws of a frame before any
+ *  of them is written, and grows only between frames.
+ *
+ *  The material index selects an entry of the material table:
+ *
+ *  struct MaterialData
+ *  {
+ *      vec4 ambient;         // rgb = color, a = strength
+ *      vec4 diffuse;
+ *      vec4 specular;        // rgb = color, a = shininess
+ *  };
+ *  layout (std430, binding = 2) readonly buffer MaterialBlock
+ *  {
+ *      MaterialData materials[];
+ *  };
+ ***********************************************************/
+class DrawDataRingBuffer
+{
+public:
+	// binding point of the DrawDataBlock shader storage block
+	static const GLuint DRAW_DATA_BINDING = 1;
+	// binding point of the MaterialBlock shader storage block
+	static const GLuint MATERIAL_BINDING = 2;
+	// number of frames the CPU may run ahead of the GPU
+	static const int FRAME_REGION_COUNT = 3;
+
+	// per-draw record, laid out to match std430
+	struct DRAW_DATA
+	{
+		glm::mat4 model;
+		glm::mat4 normalMatrix;
+		glm::vec4 objectColor;
+		glm::vec4 uvScale;
+		glm::ivec4 params;
+	};
+
+	// material table entry, laid out to match std430
+	struct MATERIAL_DATA
+	{
+		glm::vec4 ambient;
+		glm::vec4 diffuse;
+		glm::vec4 specular;
+	};
+
+	// time the CPU spent blocked on the GPU before reusing a region
+	struct FENCE_WAIT_STATS
+	{
+		// frames that had to wait for a fence
+		unsigned int waitCount;
+		// frames that were started
+		unsigned int frameCount;
+		// wait time of the most recent frame
+		double lastWaitMilliseconds;
+		// longest single wait
+		double maxWaitMilliseconds;
+		// accumulated wait time
+		double totalWaitMilliseconds;
+		// frames the buffer had to grow for
+		unsigned int resizeCount;
+	};
+
+	// constructor
+	DrawDataRingBuffer();
+	// destructor
+	~DrawDataRingBuffer();
+
+	// create and map the buffer, returns false if the driver
+	// lacks persistent mapping or the program lacks the block
+	bool Initialize(GLuint programID, int maxDrawsPerFrame);
+	// connect the storage blocks of a program, returns false if
+	// it has no draw data block
+	bool BindProgram(GLuint programID);
+
+	// wait for the GPU to release the next frame region and
+	// make room for the given number of draws, returns false
+	// if the buffer couldn't grow and is no longer in use
+	bool BeginFrame(int drawCount);
+	// fence the region written during this frame
+	void EndFrame();
+
+	// reserve the next record in the current frame region,
+	// NULL if the region is full
+	DRAW_DATA* Allocate(int& drawIndex);
+
+	// upload the table of materials referenced by the draws
+	void UploadMaterials(const MATERIAL_DATA* pMaterials, int materialCount);
+
+	// fence wait metrics since startup
+	const FENCE_WAIT_STATS& GetFenceWaitStats() const { return(m_stats); }
+
+	// true once the buffer has been created and mapped
+	bool IsActive() const { return(m_pMappedData != NULL); }
+	// true if the program passed to Initialize() reads the
+	// draw data block, and so needs a negative drawIndex when
+	// it is drawn with uniforms
+	bool IsBlockDeclared() const { return(m_bBlockDeclared); }
+
+private:
+	// shader storage buffer and its persistent mapping
+	GLBuffer m_buffer;
+	DRAW_DATA* m_pMappedData;
+	// static buffer holding the material table
+	GLBuffer m_materialBuffer;
+	// records available in each frame region
+	int m_drawsPerRegion;
+	bool m_bBlockDeclared;
+
+	// region being written during the current frame
+	int m_regionIndex;
+	// next free record in the current region
+	int m_writeCursor;
+	// fences guarding each region
+	GLsync m_regionFences[FRAME_REGION_COUNT];
+
+	// collected wait metrics
+	FENCE_WAIT_STATS m_stats;
+
+	// allocate and map the buffer storage
+	bool CreateStorage(int drawsPerRegion);
+	// replace the storage with one that fits the given draws
+	bool GrowStorage(int drawCount);
+};
@@ -0,0 +1,171 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.cpp
+// ============
+// linear allocator for the render data that only lives for one frame
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	/***********************************************************
+	 *  AlignOffset()
+	 *
+	 *  Round an offset into a block up so that the address it
+	 *  gives is a multiple of the alignment.
+	 ***********************************************************/
+	size_t AlignOffset(const unsigned char* pBlock, size_t offset, size_t alignment)
+	{
+		uintptr_t address = (uintptr_t)pBlock + offset;
+		uintptr_t aligned = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+		return(offset + (size_t)(aligned - address));
+	}
+
+	/***********************************************************
+	 *  AllocateBlock()
+	 *
+	 *  Allocate the block of a sub-arena.  Larger alignments are
+	 *  made up by the offsets, so malloc's own is enough.
+	 ***********************************************************/
+	unsigned char* AllocateBlock(size_t capacity)
+	{
+		return((unsigned char*)std::malloc(std::max(capacity, (size_t)1)));
+	}
+}
+
+/***********************************************************
+ *  FrameArena()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameArena::FrameArena(size_t capacity, size_t workerCapacity, int threadCount)
+{
+	m_stats = ARENA_STATS();
+	m_subArenas.resize(std::max(threadCount, 1));
+
+	for (int i = 0; i < (int)m_subArenas.size(); i++)
+	{
+		SUB_ARENA& subArena = m_subArenas[i];
+		subArena.capacity = (i == 0) ? capacity : workerCapacity;
+		subArena.pBlock = AllocateBlock(subArena.capacity);
+		subArena.offset = 0;
+		subArena.fallbackBytes = 0;
+		// room for a few fallbacks before the list itself grows
+		subArena.fallbacks.reserve(16);
+		m_stats.capacityBytes += subArena.capacity;
+	}
+}
+
+/***********************************************************
+ *  ~FrameArena()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameArena::~FrameArena()
+{
+	for (int i = 0; i < (int)m_subArenas.size(); i++)
+	{
+		SUB_ARENA& subArena = m_subArenas[i];
+		for (int j = 0; j < (int)subArena.fallbacks.size(); j++)
+		{
+			std::free(subArena.fallbacks[j]);
+		}
+		std::free(subArena.pBlock);
+	}
+	m_subArenas.clear();
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used to start a new frame.  The usage of
+ *  the frame that ended is recorded, its heap fallbacks are
+ *  freed, and a sub-arena that overflowed is grown with room
+ *  to spare, so the same load fits next time.  Must not be
+ *  called while a worker task is allocating.
+ ***********************************************************/
+void FrameArena::BeginFrame()
+{
+	size_t frameBytes = 0;
+	int frameFallbackCount = 0;
+
+	for (int i = 0; i < (int)m_subArenas.size(); i++)
+	{
+		SUB_ARENA& subArena = m_subArenas[i];
+		size_t needed = subArena.offset + subArena.fallbackBytes;
+
+		frameBytes += needed;
+		frameFallbackCount += (int)subArena.fallbacks.size();
+		// totals are only kept here, so workers never share them
+		m_stats.fallbackCount += subArena.fallbacks.size();
+		m_stats.fallbackBytes += subArena.fallbackBytes;
+
+		for (int j = 0; j < (int)subArena.fallbacks.size(); j++)
+		{
+			std::free(subArena.fallbacks[j]);
+		}
+		if (subArena.fallbacks.empty() == false)
+		{
+			size_t capacity = std::max(subArena.capacity * 2, needed + needed / 2);
+
+			std::free(subArena.pBlock);
+			subArena.pBlock = AllocateBlock(capacity);
+			m_stats.capacityBytes += capacity - subArena.capacity;
+			subArena.capacity = capacity;
+			m_stats.growCount++;
+		}
+
+		subArena.fallbacks.clear();
+		subArena.fallbackBytes = 0;
+		subArena.offset = 0;
+	}
+
+	if (frameFallbackCount > 0)
+	{
+		std::cout << "INFO: frame arena grown to " << (m_stats.capacityBytes / 1024) << " KB after "
+			<< frameFallbackCount << " allocations fell back to the heap" << std::endl;
+	}
+
+	if (m_stats.frameCount > 0)
+	{
+		m_stats.frameBytes = frameBytes;
+		m_stats.peakBytes = std::max(m_stats.peakBytes, frameBytes);
+		m_stats.frameFallbackCount = frameFallbackCount;
+	}
+	m_stats.frameCount++;
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used to take memory from the sub-arena of
+ *  a thread.  The memory stays valid until the next
+ *  BeginFrame().  When the block is full the memory comes
+ *  from the heap instead, and is counted so the block can
+ *  grow.
+ ***********************************************************/
+void* FrameArena::Allocate(size_t size, size_t alignment, int threadIndex)
+{
+	SUB_ARENA& subArena = m_subArenas[threadIndex];
+	size_t offset = AlignOffset(subArena.pBlock, subArena.offset, alignment);
+
+	if (offset + size <= subArena.capacity)
+	{
+		subArena.offset = offset + size;
+		return(subArena.pBlock + offset);
+	}
+
+	// malloc aligns for any standard type, which is all the
+	// frame data asks for
+	void* pMemory = std::malloc(std::max(size, (size_t)1));
+	subArena.fallbacks.push_back(pMemory);
+	subArena.fallbackBytes += size;
+
+	return(pMemory);
+}
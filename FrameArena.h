@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.h
+// ============
+// linear allocator for the render data that only lives for one frame
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/***********************************************************
+ *  FrameArena
+ *
+ *  This class hands out memory for data that is thrown away
+ *  at the end of a frame, such as the draw lists, culling
+ *  results and sort orders.  Allocating only moves an offset
+ *  forward, nothing is freed on its own, and BeginFrame()
+ *  makes the whole block available again.  Each thread of
+ *  the pool has its own sub-arena, picked by the thread index
+ *  ParallelFor() passes to its tasks, so workers allocate
+ *  without locking.
+ *
+ *  A request that doesn't fit falls back to the heap and is
+ *  freed at the next BeginFrame(), which also grows the block
+ *  to what the frame needed.  After the first frames the
+ *  arena has settled, and a frame makes no heap calls at all.
+ ***********************************************************/
+class FrameArena
+{
+public:
+	// usage of the arena, summed over the sub-arenas
+	struct ARENA_STATS
+	{
+		// bytes reserved for the arena
+		size_t capacityBytes;
+		// bytes used by the most recent complete frame,
+		// including those that fell back to the heap
+		size_t frameBytes;
+		// largest frameBytes seen
+		size_t peakBytes;
+		// allocations of the most recent frame that didn't fit
+		int frameFallbackCount;
+		// totals since startup
+		uint64_t fallbackCount;
+		uint64_t fallbackBytes;
+		int growCount;
+		uint64_t frameCount;
+	};
+
+	// constructor, with the starting size of the sub-arena of
+	// the calling thread and of each worker thread
+	FrameArena(size_t capacity, size_t workerCapacity, int threadCount);
+	// destructor
+	~FrameArena();
+
+	// release everything allocated during the previous frame
+	void BeginFrame();
+
+	// memory for one frame, aligned to a power of two
+	void* Allocate(size_t size, size_t alignment, int threadIndex = 0);
+
+	// uninitialized array for one frame.  Nothing is destroyed,
+	// so only types without a destructor can be used.
+	template <class T>
+	T* AllocateArray(size_t count, int threadIndex = 0)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "frame arrays are never destroyed");
+		return((T*)Allocate(count * sizeof(T), alignof(T), threadIndex));
+	}
+
+	int GetThreadCount() const { return((int)m_subArenas.size()); }
+	const ARENA_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// block used by one thread
+	struct SUB_ARENA
+	{
+		unsigned char* pBlock;
+		size_t capacity;
+		size_t offset;
+		// heap allocations of this frame, freed at its end
+		std::vector<void*> fallbacks;
+		size_t fallbackBytes;
+		// keeps the offsets of neighbouring threads apart
+		char padding[64];
+	};
+
+	std::vector<SUB_ARENA> m_subArenas;
+	ARENA_STATS m_stats;
+};
+
+/***********************************************************
+ *  FrameAllocator
+ *
+ *  This template lets standard containers keep their storage
+ *  in a frame arena.  A container using it must be emptied
+ *  before the next BeginFrame(), and one that is kept across
+ *  frames has to swap in a new, empty container instead of
+ *  calling clear(), which would keep the released storage.
+ ***********************************************************/
+template <class T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+	// the arena goes along with the contents
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	// only for containers that are given an arena before they
+	// first allocate
+	FrameAllocator() : m_pArena(NULL), m_threadIndex(0) {}
+	FrameAllocator(FrameArena* pArena, int threadIndex = 0) : m_pArena(pArena), m_threadIndex(threadIndex) {}
+	template <class U>
+	FrameAllocator(const FrameAllocator<U>& other) : m_pArena(other.GetArena()), m_threadIndex(other.GetThreadIndex()) {}
+
+	T* allocate(size_t count)
+	{
+		return((T*)m_pArena->Allocate(count * sizeof(T), alignof(T), m_threadIndex));
+	}
+	// the memory is released with the rest of the frame
+	void deallocate(T*, size_t) {}
+
+	FrameArena* GetArena() const { return(m_pArena); }
+	int GetThreadIndex() const { return(m_threadIndex); }
+
+private:
+	FrameArena* m_pArena;
+	int m_threadIndex;
+};
+
+template <class T, class U>
+bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b)
+{
+	return((a.GetArena() == b.GetArena()) && (a.GetThreadIndex() == b.GetThreadIndex()));
+}
+
+template <class T, class U>
+bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b)
+{
+	return(!(a == b));
+}
+
+// vector with its storage in a frame arena
+template <class T>
+using FrameVector = std::vector<T, FrameAllocator<T> >;
@@ -0,0 +1,383 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.cpp
+// ============
+// frustum culling and draw generation for static scenes on the GPU
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuCuller.h"
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <iostream>
+#include <regex>
+
+// declaration of global variables
+namespace
+{
+	// threads per work group of the culling pass
+	const int g_GroupSize = 64;
+
+	// indirect command of glMultiDrawElementsIndirectCount()
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	const char* g_CullSource = R"(
+		#version 430 core
+		layout (local_size_x = 64) in;
+
+		struct CullObject
+		{
+			vec4 sphere;
+			ivec4 command;
+		};
+		struct DrawCommand
+		{
+			uint count;
+			uint instanceCount;
+			uint firstIndex;
+			int baseVertex;
+			uint baseInstance;
+		};
+		layout (std430, binding = 3) readonly buffer ObjectBlock
+		{
+			CullObject objects[];
+		};
+		layout (std430, binding = 4) writeonly buffer CommandBlock
+		{
+			DrawCommand commands[];
+		};
+		layout (std430, binding = 5) buffer CountBlock
+		{
+			uint drawCount;
+		};
+
+		uniform vec4 frustumPlanes[6];
+		uniform uint objectCount;
+
+		void main()
+		{
+			uint index = gl_GlobalInvocationID.x;
+			if (index >= objectCount)
+			{
+				return;
+			}
+
+			vec4 sphere = objects[index].sphere;
+			for (int i = 0; i < 6; i++)
+			{
+				if (dot(frustumPlanes[i].xyz, sphere.xyz) + frustumPlanes[i].w < -sphere.w)
+				{
+					return;
+				}
+			}
+
+			ivec4 command = objects[index].command;
+			uint slot = atomicAdd(drawCount, 1u);
+			commands[slot] = DrawCommand(uint(command.x), 1u, uint(command.y), command.z, uint(command.w));
+		}
+	)";
+
+	// base instance of the command in the vertex stage, a
+	// built-in from GLSL 4.60 and an extension before
+	const char* g_BaseInstanceHeader =
+		"#if __VERSION__ >= 460\n"
+		"#define GPU_BASE_INSTANCE gl_BaseInstance\n"
+		"#else\n"
+		"#extension GL_ARB_shader_draw_parameters : require\n"
+		"#define GPU_BASE_INSTANCE gl_BaseInstanceARB\n"
+		"#endif\n";
+
+	/***********************************************************
+	 *  InsertAfterVersion()
+	 *
+	 *  Insert lines after the #version line, followed by a
+	 *  #line directive so compile errors still point at the
+	 *  lines of the file.
+	 ***********************************************************/
+	std::string InsertAfterVersion(const std::string& source, const std::string& lines)
+	{
+		size_t insertAt = 0;
+		int nextLine = 1;
+		size_t versionStart = source.find("#version");
+		if (versionStart != std::string::npos)
+		{
+			insertAt = source.find('\n', versionStart);
+			insertAt = (insertAt == std::string::npos) ? source.size() : insertAt + 1;
+			nextLine = (int)std::count(source.begin(), source.begin() + insertAt, '\n') + 1;
+		}
+
+		std::string result = source;
+		result.insert(insertAt, lines + "#line " + std::to_string(nextLine) + "\n");
+
+		return(result);
+	}
+
+	/***********************************************************
+	 *  ExtractFrustumPlanes()
+	 *
+	 *  Get the six planes of the frustum from the combined
+	 *  matrix, normalized so the distance to a point can be
+	 *  compared with a radius.  Normals point inward.
+	 ***********************************************************/
+	void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+	{
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+		{
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		planes[4] = rows[3] + rows[2];
+		planes[5] = rows[3] - rows[2];
+		for (int i = 0; i < 6; i++)
+		{
+			planes[i] /= glm::length(glm::vec3(planes[i]));
+		}
+	}
+}
+
+/***********************************************************
+ *  GpuCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuCuller::GpuCuller()
+{
+	m_planesLocation = -1;
+	m_objectCountLocation = -1;
+	m_objectCount = 0;
+}
+
+/***********************************************************
+ *  ~GpuCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GpuCuller::~GpuCuller()
+{
+	// the program and buffers are deleted by their handles
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used to check for compute shaders, draws
+ *  with their count in a buffer, and the base instance in
+ *  the vertex shader.  All are core in GL 4.6, which Mesa's
+ *  software renderer provides as well.
+ ***********************************************************/
+bool GpuCuller::IsSupported()
+{
+	if (!GLEW_VERSION_4_3)
+	{
+		return false;
+	}
+
+	return(GLEW_VERSION_4_6 || (GLEW_ARB_indirect_parameters && GLEW_ARB_shader_draw_parameters));
+}
+
+/***********************************************************
+ *  AdaptSceneSources()
+ *
+ *  This method is used to make the scene program take its
+ *  draw index from the command.  In the vertex stage the
+ *  drawIndex uniform becomes the base instance, and the
+ *  original main() is wrapped to pass it to the fragment
+ *  stage as a flat input, which replaces the uniform there.
+ ***********************************************************/
+bool GpuCuller::AdaptSceneSources(std::string& vertexSource, std::string& fragmentSource)
+{
+	std::regex declaration("uniform\\s+int\\s+drawIndex\\s*;");
+	std::regex mainFunction("void\\s+main\\s*\\(\\s*(void)?\\s*\\)");
+
+	if ((std::regex_search(vertexSource, declaration) == false) ||
+		(std::regex_search(vertexSource, mainFunction) == false))
+	{
+		return false;
+	}
+
+	std::string vertex = std::regex_replace(vertexSource, declaration,
+		"flat out int gpuDrawIndex;\n#define drawIndex GPU_BASE_INSTANCE\n",
+		std::regex_constants::format_first_only);
+	vertex = std::regex_replace(vertex, mainFunction, "void sceneMain()", std::regex_constants::format_first_only);
+	vertex += "\nvoid main()\n{\n\tgpuDrawIndex = GPU_BASE_INSTANCE;\n\tsceneMain();\n}\n";
+	vertexSource = InsertAfterVersion(vertex, g_BaseInstanceHeader);
+
+	fragmentSource = std::regex_replace(fragmentSource, declaration,
+		"flat in int gpuDrawIndex;\n#define drawIndex gpuDrawIndex\n",
+		std::regex_constants::format_first_only);
+
+	return true;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used to build the culling program and the
+ *  buffers that don't depend on the scene.
+ ***********************************************************/
+bool GpuCuller::Initialize()
+{
+	if (IsSupported() == false)
+	{
+		std::cout << "INFO: GPU culling needs compute shaders and indirect draw counts" << std::endl;
+		return false;
+	}
+
+	GLint success = 0;
+	GLuint shaderID = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shaderID, 1, &g_CullSource, NULL);
+	glCompileShader(shaderID);
+
+	GLuint programID = m_program.Create("GPU culling");
+	glAttachShader(programID, shaderID);
+	glLinkProgram(programID);
+	glDeleteShader(shaderID);
+
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR: GPU culling program link failed\n" << infoLog << std::endl;
+		m_program.Reset();
+		return false;
+	}
+	m_program.SetBytes(GpuResourceRegistry::EstimateProgramBytes(programID));
+
+	m_planesLocation = glGetUniformLocation(programID, "frustumPlanes");
+	m_objectCountLocation = glGetUniformLocation(programID, "objectCount");
+
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_countBuffer.Create("GPU culling count"));
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_DRAW);
+	m_countBuffer.SetBytes(sizeof(GLuint));
+	m_objectBuffer.Create("GPU culling objects");
+	m_drawDataBuffer.Create("GPU culling draw data");
+	m_commandBuffer.Create("GPU culling commands");
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	return true;
+}
+
+/***********************************************************
+ *  SetObjects()
+ *
+ *  This method is used to upload the static draws, replacing
+ *  any uploaded before.  The command buffer gets room for
+ *  every draw being visible.
+ ***********************************************************/
+void GpuCuller::SetObjects(
+	const std::vector<GPU_OBJECT>& objects,
+	const std::vector<DrawDataRingBuffer::DRAW_DATA>& drawData)
+{
+	m_objectCount = (int)objects.size();
+
+	size_t objectBytes = std::max(objects.size(), (size_t)1) * sizeof(GPU_OBJECT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer.Get());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, objectBytes, objects.empty() ? NULL : objects.data(), GL_STATIC_DRAW);
+	m_objectBuffer.SetBytes(objectBytes);
+
+	size_t drawDataBytes = std::max(drawData.size(), (size_t)1) * sizeof(DrawDataRingBuffer::DRAW_DATA);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer.Get());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, drawDataBytes, drawData.empty() ? NULL : drawData.data(), GL_STATIC_DRAW);
+	m_drawDataBuffer.SetBytes(drawDataBytes);
+
+	size_t commandBytes = std::max(objects.size(), (size_t)1) * sizeof(DRAW_COMMAND);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer.Get());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, commandBytes, NULL, GL_DYNAMIC_COPY);
+	m_commandBuffer.SetBytes(commandBytes);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used to run the culling pass for a camera.
+ *  The count is reset first, and the barrier makes the
+ *  written commands visible to the indirect draw.
+ ***********************************************************/
+void GpuCuller::Cull(const glm::mat4& viewProjection)
+{
+	if (m_objectCount == 0)
+	{
+		return;
+	}
+
+	glm::vec4 planes[6];
+	ExtractFrustumPlanes(viewProjection, planes);
+
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_countBuffer.Get());
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	GLint previousProgramID = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgramID);
+
+	glUseProgram(m_program.Get());
+	glUniform4fv(m_planesLocation, 6, &planes[0][0]);
+	glUniform1ui(m_objectCountLocation, (GLuint)m_objectCount);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, m_objectBuffer.Get());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_commandBuffer.Get());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, m_countBuffer.Get());
+	glDispatchCompute((GLuint)((m_objectCount + g_GroupSize - 1) / g_GroupSize), 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+	glUseProgram((GLuint)previousProgramID);
+
+	RenderStats::Count(RenderStats::COUNTER_UPLOAD_BYTES, sizeof(GLuint));
+	RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS, 2);
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES, 2);
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used to draw the visible commands.  The
+ *  static draw data is bound in place of the ring buffer for
+ *  the draw, and the ring buffer is bound again after it.
+ ***********************************************************/
+void GpuCuller::Draw(GLuint vertexArrayID)
+{
+	if (m_objectCount == 0)
+	{
+		return;
+	}
+
+	GLint previousBufferID = 0;
+	glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, DrawDataRingBuffer::DRAW_DATA_BINDING, &previousBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataRingBuffer::DRAW_DATA_BINDING, m_drawDataBuffer.Get());
+
+	glBindVertexArray(vertexArrayID);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer.Get());
+	glBindBuffer(GL_PARAMETER_BUFFER, m_countBuffer.Get());
+	if (GLEW_VERSION_4_6)
+	{
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_SHORT, NULL, 0, m_objectCount, 0);
+	}
+	else
+	{
+		glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_SHORT, NULL, 0, m_objectCount, 0);
+	}
+	glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+
+	// the GPU decides how many objects are drawn, so the
+	// triangles of this call aren't known here
+	RenderStats::CountDraw(0);
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataRingBuffer::DRAW_DATA_BINDING, (GLuint)previousBufferID);
+}
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.h
+// ============
+// frustum culling and draw generation for static scenes on the GPU
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "DrawDataRingBuffer.h"
+#include "GpuResources.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  GpuCuller
+ *
+ *  This class keeps the bounds, draw commands and draw data
+ *  of every static draw on the GPU.  They are uploaded once,
+ *  and each frame a compute pass tests the bounding spheres
+ *  against the frustum and appends the command of each
+ *  visible draw to a compacted indirect buffer, counting
+ *  them.  The frame is then drawn with a single
+ *  glMultiDrawElementsIndirectCount() over the shared buffers
+ *  of the MeshLibrary, so the CPU never touches the objects.
+ *
+ *  Each command carries the index of its draw data record as
+ *  its base instance.  The scene program reads the record
+ *  through its drawIndex uniform, so a copy of the program is
+ *  built with that uniform taken from gl_BaseInstance, see
+ *  AdaptSceneSources().
+ ***********************************************************/
+class GpuCuller
+{
+public:
+	// shader storage bindings used by the culling pass
+	static const GLuint OBJECT_BINDING = 3;
+	static const GLuint COMMAND_BINDING = 4;
+	static const GLuint COUNT_BINDING = 5;
+
+	// one draw to cull, laid out to match std430
+	struct GPU_OBJECT
+	{
+		// xyz = world space center, w = radius
+		glm::vec4 sphere;
+		// x = index count, y = first index, z = base vertex,
+		// w = draw data index
+		glm::ivec4 command;
+	};
+
+	// constructor
+	GpuCuller();
+	// destructor
+	~GpuCuller();
+
+	// true if the driver has compute shaders and draws with a
+	// count taken from a buffer
+	static bool IsSupported();
+	// rewrite the scene program so the draw index comes from
+	// the base instance of the command, false if the sources
+	// don't read it from a drawIndex uniform
+	static bool AdaptSceneSources(std::string& vertexSource, std::string& fragmentSource);
+
+	// build the culling program and buffers
+	bool Initialize();
+	// upload the draws and the draw data records they index
+	void SetObjects(
+		const std::vector<GPU_OBJECT>& objects,
+		const std::vector<DrawDataRingBuffer::DRAW_DATA>& drawData);
+
+	// write the commands of the draws inside the frustum
+	void Cull(const glm::mat4& viewProjection);
+	// draw the commands written by Cull() with the program in
+	// use, from the given vertex array of 16-bit indices
+	void Draw(GLuint vertexArrayID);
+
+	int GetObjectCount() const { return(m_objectCount); }
+	bool IsActive() const { return(m_program.Get() != 0); }
+
+private:
+	// culling compute program and its uniforms
+	GLProgram m_program;
+	GLint m_planesLocation;
+	GLint m_objectCountLocation;
+
+	// static draws and their draw data
+	GLBuffer m_objectBuffer;
+	GLBuffer m_drawDataBuffer;
+	int m_objectCount;
+	// written by the culling pass every frame
+	GLBuffer m_commandBuffer;
+	GLBuffer m_countBuffer;
+};
@@ -0,0 +1,260 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuresources.cpp
+// ============
+// own OpenGL objects and keep count of the GPU memory they hold
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuResources.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+
+// declaration of global variables
+namespace
+{
+	// a recorded resource
+	struct RESOURCE_RECORD
+	{
+		GpuResourceRegistry::CATEGORY category;
+		std::string label;
+		size_t bytes;
+	};
+
+	const char* g_CategoryNames[GpuResourceRegistry::CATEGORY_COUNT] =
+	{
+		"texture",
+		"buffer",
+		"vertex array",
+		"program",
+		"renderbuffer"
+	};
+
+	// records by number, ordered so leaks are reported in the
+	// order they were created
+	std::map<int, RESOURCE_RECORD> g_Records;
+	int g_NextRecord = 0;
+	size_t g_CurrentBytes[GpuResourceRegistry::CATEGORY_COUNT] = {};
+	size_t g_PeakBytes[GpuResourceRegistry::CATEGORY_COUNT] = {};
+	size_t g_TotalCurrentBytes = 0;
+	size_t g_TotalPeakBytes = 0;
+
+	/***********************************************************
+	 *  AddBytes()
+	 *
+	 *  Add to and take away from the totals of a category, and
+	 *  raise the peaks.
+	 ***********************************************************/
+	void AddBytes(GpuResourceRegistry::CATEGORY category, size_t added, size_t removed)
+	{
+		g_CurrentBytes[category] = g_CurrentBytes[category] + added - removed;
+		g_TotalCurrentBytes = g_TotalCurrentBytes + added - removed;
+		g_PeakBytes[category] = std::max(g_PeakBytes[category], g_CurrentBytes[category]);
+		g_TotalPeakBytes = std::max(g_TotalPeakBytes, g_TotalCurrentBytes);
+	}
+
+	/***********************************************************
+	 *  FormatMegabytes()
+	 *
+	 *  Format a byte count in megabytes for a report.
+	 ***********************************************************/
+	std::string FormatMegabytes(size_t bytes)
+	{
+		char text[32];
+		snprintf(text, sizeof(text), "%.2f MB", (double)bytes / (1024.0 * 1024.0));
+		return(text);
+	}
+}
+
+/***********************************************************
+ *  Track()
+ *
+ *  This method is used to start recording a resource.  The
+ *  returned record is passed back to change or end it.
+ ***********************************************************/
+int GpuResourceRegistry::Track(CATEGORY category, const std::string& label, size_t bytes)
+{
+	RESOURCE_RECORD record;
+
+	record.category = category;
+	record.label = label;
+	record.bytes = bytes;
+
+	int recordNumber = g_NextRecord++;
+	g_Records[recordNumber] = record;
+	AddBytes(category, bytes, 0);
+
+	return(recordNumber);
+}
+
+/***********************************************************
+ *  SetBytes()
+ *
+ *  This method is used to change the bytes a resource holds,
+ *  after its storage was allocated or reallocated.
+ ***********************************************************/
+void GpuResourceRegistry::SetBytes(int record, size_t bytes)
+{
+	std::map<int, RESOURCE_RECORD>::iterator it = g_Records.find(record);
+	if (it == g_Records.end())
+	{
+		return;
+	}
+
+	AddBytes(it->second.category, bytes, it->second.bytes);
+	it->second.bytes = bytes;
+}
+
+/***********************************************************
+ *  Untrack()
+ *
+ *  This method is used to stop recording a resource once it
+ *  was freed.
+ ***********************************************************/
+void GpuResourceRegistry::Untrack(int record)
+{
+	std::map<int, RESOURCE_RECORD>::iterator it = g_Records.find(record);
+	if (it == g_Records.end())
+	{
+		return;
+	}
+
+	AddBytes(it->second.category, 0, it->second.bytes);
+	g_Records.erase(it);
+}
+
+/***********************************************************
+ *  GetCurrentBytes()
+ *
+ *  This method is used to get the bytes held by every
+ *  recorded resource.
+ ***********************************************************/
+size_t GpuResourceRegistry::GetCurrentBytes()
+{
+	return(g_TotalCurrentBytes);
+}
+
+/***********************************************************
+ *  GetPeakBytes()
+ *
+ *  This method is used to get the most bytes the recorded
+ *  resources held at any one time.
+ ***********************************************************/
+size_t GpuResourceRegistry::GetPeakBytes()
+{
+	return(g_TotalPeakBytes);
+}
+
+/***********************************************************
+ *  GetCurrentBytes()
+ *
+ *  This method is used to get the bytes held by the
+ *  recorded resources of a category.
+ ***********************************************************/
+size_t GpuResourceRegistry::GetCurrentBytes(CATEGORY category)
+{
+	return(g_CurrentBytes[category]);
+}
+
+/***********************************************************
+ *  GetPeakBytes()
+ *
+ *  This method is used to get the most bytes the recorded
+ *  resources of a category held at any one time.
+ ***********************************************************/
+size_t GpuResourceRegistry::GetPeakBytes(CATEGORY category)
+{
+	return(g_PeakBytes[category]);
+}
+
+/***********************************************************
+ *  GetResourceCount()
+ *
+ *  This method is used to get the number of resources
+ *  recorded now.
+ ***********************************************************/
+int GpuResourceRegistry::GetResourceCount()
+{
+	return((int)g_Records.size());
+}
+
+/***********************************************************
+ *  GetCategoryName()
+ *
+ *  This method is used to get the name of a category.
+ ***********************************************************/
+const char* GpuResourceRegistry::GetCategoryName(CATEGORY category)
+{
+	return(g_CategoryNames[category]);
+}
+
+/***********************************************************
+ *  EstimateTextureBytes()
+ *
+ *  This method is used to estimate the memory of a texture
+ *  from its size, with each level a quarter of the one
+ *  before, down to the given level count or to 1x1.
+ ***********************************************************/
+size_t GpuResourceRegistry::EstimateTextureBytes(int width, int height, int bytesPerTexel, int levelCount)
+{
+	size_t bytes = 0;
+
+	for (int level = 0; (levelCount <= 0) || (level < levelCount); level++)
+	{
+		bytes += (size_t)width * height * bytesPerTexel;
+		if ((width <= 1) && (height <= 1))
+		{
+			break;
+		}
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+
+	return(bytes);
+}
+
+/***********************************************************
+ *  EstimateProgramBytes()
+ *
+ *  This method is used to estimate the memory of a linked
+ *  program by the size of its binary, which is as close as
+ *  OpenGL lets us look.
+ ***********************************************************/
+size_t GpuResourceRegistry::EstimateProgramBytes(GLuint programID)
+{
+	GLint binaryLength = 0;
+
+	if ((programID != 0) && GLEW_ARB_get_program_binary)
+	{
+		glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	}
+
+	return((size_t)std::max(binaryLength, 0));
+}
+
+/***********************************************************
+ *  ReportLeaks()
+ *
+ *  This method is used at shutdown, after every owner was
+ *  deleted, to warn about the resources never freed and to
+ *  print the peak memory per category.
+ ***********************************************************/
+int GpuResourceRegistry::ReportLeaks()
+{
+	std::map<int, RESOURCE_RECORD>::const_iterator it;
+	for (it = g_Records.begin(); it != g_Records.end(); ++it)
+	{
+		std::cout << "WARNING: GPU " << g_CategoryNames[it->second.category] << " \"" << it->second.label
+			<< "\" (" << FormatMegabytes(it->second.bytes) << ") was never freed" << std::endl;
+	}
+
+	std::cout << "INFO: GPU memory peaked at " << FormatMegabytes(g_TotalPeakBytes) << " (";
+	for (int i = 0; i < CATEGORY_COUNT; i++)
+	{
+		std::cout << ((i == 0) ? "" : ", ") << g_CategoryNames[i] << "s " << FormatMegabytes(g_PeakBytes[i]);
+	}
+	std::cout << "), " << g_Records.size() << " resources leaked" << std::endl;
+
+	return((int)g_Records.size());
+}
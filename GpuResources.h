@@ -0,0 +1,227 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuresources.h
+// ============
+// own OpenGL objects and keep count of the GPU memory they hold
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <string>
+
+/***********************************************************
+ *  GpuResourceRegistry
+ *
+ *  This class keeps a record of every tracked GPU resource,
+ *  with a label and an estimate of the bytes it holds, and
+ *  totals them per category with the peak reached.  The
+ *  handles below register and unregister their objects, so
+ *  the totals follow the objects' lifetimes, and anything
+ *  still recorded when the application quits is reported as
+ *  a leak.  Objects created by code outside this project are
+ *  recorded with a GpuMemoryRecord.  Every call runs on the
+ *  thread owning the GL context.
+ ***********************************************************/
+class GpuResourceRegistry
+{
+public:
+	// kinds of resources, totaled separately
+	enum CATEGORY
+	{
+		CATEGORY_TEXTURE,
+		CATEGORY_BUFFER,
+		CATEGORY_VERTEX_ARRAY,
+		CATEGORY_PROGRAM,
+		CATEGORY_RENDERBUFFER,
+		CATEGORY_COUNT
+	};
+
+	// start recording a resource, returns its record
+	static int Track(CATEGORY category, const std::string& label, size_t bytes);
+	// change the bytes a resource holds
+	static void SetBytes(int record, size_t bytes);
+	// stop recording a freed resource
+	static void Untrack(int record);
+
+	// bytes held now and at most, in total or per category
+	static size_t GetCurrentBytes();
+	static size_t GetPeakBytes();
+	static size_t GetCurrentBytes(CATEGORY category);
+	static size_t GetPeakBytes(CATEGORY category);
+	// number of resources recorded now
+	static int GetResourceCount();
+	// name of a category in reports
+	static const char* GetCategoryName(CATEGORY category);
+
+	// bytes of a texture and its mip levels, a level count of
+	// 0 meaning the full chain down to 1x1; drivers store RGB
+	// textures with four bytes per texel, so pass 4 for them
+	static size_t EstimateTextureBytes(int width, int height, int bytesPerTexel, int levelCount);
+	// bytes of the linked binary of a program, 0 if unknown
+	static size_t EstimateProgramBytes(GLuint programID);
+
+	// print every resource still recorded and the peak usage,
+	// returns the number of leaked resources
+	static int ReportLeaks();
+};
+
+// how each kind of GL object is created, deleted and counted
+struct GL_TEXTURE_TRAITS
+{
+	static const GpuResourceRegistry::CATEGORY RESOURCE_CATEGORY = GpuResourceRegistry::CATEGORY_TEXTURE;
+	static GLuint Create() { GLuint name = 0; glGenTextures(1, &name); return(name); }
+	static void Destroy(GLuint name) { glDeleteTextures(1, &name); }
+};
+struct GL_BUFFER_TRAITS
+{
+	static const GpuResourceRegistry::CATEGORY RESOURCE_CATEGORY = GpuResourceRegistry::CATEGORY_BUFFER;
+	static GLuint Create() { GLuint name = 0; glGenBuffers(1, &name); return(name); }
+	static void Destroy(GLuint name) { glDeleteBuffers(1, &name); }
+};
+struct GL_VERTEX_ARRAY_TRAITS
+{
+	static const GpuResourceRegistry::CATEGORY RESOURCE_CATEGORY = GpuResourceRegistry::CATEGORY_VERTEX_ARRAY;
+	static GLuint Create() { GLuint name = 0; glGenVertexArrays(1, &name); return(name); }
+	static void Destroy(GLuint name) { glDeleteVertexArrays(1, &name); }
+};
+struct GL_PROGRAM_TRAITS
+{
+	static const GpuResourceRegistry::CATEGORY RESOURCE_CATEGORY = GpuResourceRegistry::CATEGORY_PROGRAM;
+	static GLuint Create() { return(glCreateProgram()); }
+	static void Destroy(GLuint name) { glDeleteProgram(name); }
+};
+struct GL_RENDERBUFFER_TRAITS
+{
+	static const GpuResourceRegistry::CATEGORY RESOURCE_CATEGORY = GpuResourceRegistry::CATEGORY_RENDERBUFFER;
+	static GLuint Create() { GLuint name = 0; glGenRenderbuffers(1, &name); return(name); }
+	static void Destroy(GLuint name) { glDeleteRenderbuffers(1, &name); }
+};
+
+/***********************************************************
+ *  GpuHandle
+ *
+ *  This class owns one GL object and deletes it when it goes
+ *  out of scope or is reset, keeping its registry record in
+ *  step.  Handles can be moved but not copied, so an object
+ *  always has exactly one owner.  Get() returns the plain
+ *  object name for the GL calls.
+ ***********************************************************/
+template <class TRAITS>
+class GpuHandle
+{
+public:
+	// constructor
+	GpuHandle() : m_name(0), m_record(-1) {}
+	// destructor
+	~GpuHandle() { Reset(); }
+
+	GpuHandle(GpuHandle&& other) : m_name(other.m_name), m_record(other.m_record)
+	{
+		other.m_name = 0;
+		other.m_record = -1;
+	}
+	GpuHandle& operator=(GpuHandle&& other)
+	{
+		if (this != &other)
+		{
+			Reset();
+			m_name = other.m_name;
+			m_record = other.m_record;
+			other.m_name = 0;
+			other.m_record = -1;
+		}
+		return(*this);
+	}
+
+	// create a new object, deleting the one held before
+	GLuint Create(const std::string& label)
+	{
+		Adopt(TRAITS::Create(), label, 0);
+		return(m_name);
+	}
+	// take over an object created elsewhere, deleting the one
+	// held before
+	void Adopt(GLuint name, const std::string& label, size_t bytes = 0)
+	{
+		Reset();
+		if (name != 0)
+		{
+			m_name = name;
+			m_record = GpuResourceRegistry::Track(TRAITS::RESOURCE_CATEGORY, label, bytes);
+		}
+	}
+	// record the memory the object holds after allocating it
+	void SetBytes(size_t bytes)
+	{
+		if (m_record >= 0)
+		{
+			GpuResourceRegistry::SetBytes(m_record, bytes);
+		}
+	}
+	// delete the object
+	void Reset()
+	{
+		if (m_name != 0)
+		{
+			TRAITS::Destroy(m_name);
+			GpuResourceRegistry::Untrack(m_record);
+			m_name = 0;
+			m_record = -1;
+		}
+	}
+
+	GLuint Get() const { return(m_name); }
+
+private:
+	GLuint m_name;
+	int m_record;
+
+	GpuHandle(const GpuHandle&) = delete;
+	GpuHandle& operator=(const GpuHandle&) = delete;
+};
+
+typedef GpuHandle<GL_TEXTURE_TRAITS> GLTexture;
+typedef GpuHandle<GL_BUFFER_TRAITS> GLBuffer;
+typedef GpuHandle<GL_VERTEX_ARRAY_TRAITS> GLVertexArray;
+typedef GpuHandle<GL_PROGRAM_TRAITS> GLProgram;
+typedef GpuHandle<GL_RENDERBUFFER_TRAITS> GLRenderbuffer;
+
+/***********************************************************
+ *  GpuMemoryRecord
+ *
+ *  This class records memory held by GL objects this project
+ *  doesn't own, such as the meshes of ShapeMeshes, for as
+ *  long as the record lives.  Nothing is deleted with it.
+ ***********************************************************/
+class GpuMemoryRecord
+{
+public:
+	// constructor
+	GpuMemoryRecord() : m_record(-1) {}
+	// destructor
+	~GpuMemoryRecord() { Reset(); }
+
+	// start recording, replacing what was recorded before
+	void Track(GpuResourceRegistry::CATEGORY category, const std::string& label, size_t bytes)
+	{
+		Reset();
+		m_record = GpuResourceRegistry::Track(category, label, bytes);
+	}
+	// stop recording
+	void Reset()
+	{
+		if (m_record >= 0)
+		{
+			GpuResourceRegistry::Untrack(m_record);
+			m_record = -1;
+		}
+	}
+
+private:
+	int m_record;
+
+	GpuMemoryRecord(const GpuMemoryRecord&) = delete;
+	GpuMemoryRecord& operator=(const GpuMemoryRecord&) = delete;
+};
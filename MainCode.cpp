@@ -1,5 +1,9 @@
 #include <iostream>         // error handling and output
-#include <cstdlib>          // EXIT_FAILURE
+#include <cstdlib>          // EXIT_FAILURE, setenv
+#include <cstring>          // strcmp
+#include <chrono>           // startup timing
+#include <algorithm>        // sort of the frame times
+#include <vector>           // frame times
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -13,6 +17,11 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "ShaderProgramCache.h"
+#include "BenchmarkSuite.h"
+#include "RenderStats.h"
+#include "StatsOverlay.h"
+#include "GpuResources.h"
 
 // Namespace for declaring global variables
 namespace
@@ -29,12 +38,36 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// compiled shader programs kept between runs
+	ShaderProgramCache* g_ShaderCache = nullptr;
+	// per-frame counts of the work handed to OpenGL
+	RenderStats* g_RenderStats = nullptr;
+	// panel drawing the render stats over the frame
+	StatsOverlay* g_StatsOverlay = nullptr;
+
+	// scene shader sources, watched for edits while running
+	const char* const VERTEX_SHADER_FILE = "../../Utilities/shaders/vertexShader.glsl";
+	const char* const FRAGMENT_SHADER_FILE = "../../Utilities/shaders/fragmentShader.glsl";
+	// directory the compiled programs are stored in
+	const char* const SHADER_CACHE_DIRECTORY = "shadercache";
+
+	// frames rendered before and while timing the benchmark
+	const int BENCHMARK_WARMUP_FRAMES = 30;
+	const int BENCHMARK_TIMED_FRAMES = 300;
+	// simulated time advanced per benchmark or camera playback
+	// frame, so every run animates through the same poses
+	const float FIXED_FRAME_STEP = 1.0f / 60.0f;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+double RenderFrame(float sceneTime);
+void RunBenchmarks(const char* resultsFilename);
+double TimeFrames(const char* frameName, BenchmarkSuite& suite);
+void RenderReference(const char* imageFilename, int samplesPerPixel);
+void DeleteManagers();
 
 
 /***********************************************************
@@ -45,6 +78,74 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// startup is timed from here until the first frame is shown
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	bool bFirstFrame = true;
+	const char* benchmarkFilename = NULL;
+	const char* compareBaseline = NULL;
+	const char* compareResults = NULL;
+	double regressionThreshold = 10.0;
+	const char* referenceFilename = NULL;
+	int referenceSamples = 64;
+	bool bTextureAtlas = false;
+
+	// options deciding what the run does have to be applied
+	// before any window is created
+	for (int i = 1; i < argc; i++)
+	{
+		// time the hot paths and whole frames, then write the
+		// results and quit
+		if ((strcmp(argv[i], "--benchmark") == 0) && (i + 1 < argc))
+		{
+			benchmarkFilename = argv[++i];
+		}
+		// check stored results against a baseline and quit,
+		// failing when a benchmark got slower than allowed
+		else if ((strcmp(argv[i], "--compare-benchmarks") == 0) && (i + 2 < argc))
+		{
+			compareBaseline = argv[++i];
+			compareResults = argv[++i];
+		}
+		// percentage a benchmark may slow down before it fails
+		else if ((strcmp(argv[i], "--regression-threshold") == 0) && (i + 1 < argc))
+		{
+			regressionThreshold = atof(argv[++i]);
+		}
+		// path trace a reference image of the first frame on the
+		// CPU, then quit
+		else if ((strcmp(argv[i], "--path-trace") == 0) && (i + 1 < argc))
+		{
+			referenceFilename = argv[++i];
+		}
+		// samples per pixel of the reference image
+		else if ((strcmp(argv[i], "--trace-samples") == 0) && (i + 1 < argc))
+		{
+			referenceSamples = atoi(argv[++i]);
+		}
+		// pack the small scene textures into shared pages, which
+		// needs the scene shaders rewritten as they are loaded
+		else if (strcmp(argv[i], "--texture-atlas") == 0)
+		{
+			bTextureAtlas = true;
+		}
+		// ask Mesa for its software renderer, so benchmark runs
+		// on machines without a GPU are comparable
+		else if (strcmp(argv[i], "--software-gl") == 0)
+		{
+#ifdef _WIN32
+			_putenv_s("LIBGL_ALWAYS_SOFTWARE", "1");
+#else
+			setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+#endif
+		}
+	}
+
+	if (compareBaseline != NULL)
+	{
+		int regressionCount = BenchmarkSuite::Compare(compareBaseline, compareResults, regressionThreshold);
+		exit((regressionCount == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -66,42 +167,309 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"../../Utilities/shaders/vertexShader.glsl",
-		"../../Utilities/shaders/fragmentShader.glsl");
+	// load the shader code from the external GLSL files, using
+	// the program compiled by an earlier run when the sources
+	// and the driver are unchanged
+	g_ShaderCache = new ShaderProgramCache(SHADER_CACHE_DIRECTORY);
+	// the scene textures are read through the texture atlas
+	if (bTextureAtlas)
+	{
+		g_ShaderCache->SetSourceFilter(TextureAtlas::AdaptSceneSources);
+	}
+	GLuint programID = g_ShaderCache->LoadProgram(VERTEX_SHADER_FILE, FRAGMENT_SHADER_FILE);
+	if (programID != 0)
+	{
+		g_ShaderManager->m_programID = programID;
+	}
+	else
+	{
+		g_ShaderManager->LoadShaders(VERTEX_SHADER_FILE, FRAGMENT_SHADER_FILE);
+	}
 	g_ShaderManager->use();
 
 	// try to create a new scene manager object and prepare the 3D scene
 	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager->SetTextureAtlas(bTextureAtlas);
+	g_RenderStats = new RenderStats();
+	g_StatsOverlay = new StatsOverlay();
+
+	// options deciding where the scene is loaded from have to
+	// be applied before it is prepared
+	for (int i = 1; i < argc; i++)
+	{
+		// load the prebuilt scene data instead of the sources
+		if ((strcmp(argv[i], "--asset-pack") == 0) && (i + 1 < argc))
+		{
+			g_SceneManager->SetAssetPackFile(argv[++i]);
+		}
+		// read the scene files from disk instead of the cache
+		else if (strcmp(argv[i], "--cold-start") == 0)
+		{
+			g_SceneManager->SetColdStart(true);
+		}
+		// show the scene at once and load texture detail over
+		// the first frames
+		else if (strcmp(argv[i], "--stream-textures") == 0)
+		{
+			g_SceneManager->SetTextureStreaming(true);
+		}
+		// build each basic shape in the background the first
+		// time it is drawn instead of loading them all up front
+		else if (strcmp(argv[i], "--lazy-meshes") == 0)
+		{
+			g_SceneManager->SetLazyMeshes(true);
+		}
+		// write the asset pack and quit without rendering
+		else if ((strcmp(argv[i], "--build-asset-pack") == 0) && (i + 1 < argc))
+		{
+			exit(g_SceneManager->BuildAssetPack(argv[i + 1]) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
 	g_SceneManager->PrepareScene();
 
+	// apply the optional rendering settings from the command line
+	bool bShaderPermutations = true;
+	bool bGpuCulling = false;
+	bool bDepthPrePass = false;
+	bool bGenerateScene = false;
+	SceneGenerator::GENERATOR_SETTINGS generatorSettings = SceneGenerator::GetDefaultSettings();
+	for (int i = 1; i < argc; i++)
+	{
+		// lay down depth first so heavy fragment shading runs
+		// once per visible pixel
+		if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			bDepthPrePass = true;
+		}
+		// draw everything, even objects hidden behind others
+		else if (strcmp(argv[i], "--no-occlusion") == 0)
+		{
+			g_SceneManager->SetOcclusionCulling(false);
+		}
+		// save the CPU occlusion depth buffer of the first frame
+		else if ((strcmp(argv[i], "--occlusion-dump") == 0) && (i + 1 < argc))
+		{
+			g_SceneManager->SetOcclusionDumpFile(argv[++i]);
+		}
+		// draw the cache optimized, quantized basic shapes
+		else if (strcmp(argv[i], "--quantized-meshes") == 0)
+		{
+			g_SceneManager->SetQuantizedMeshes(true);
+		}
+		// stop watching the shader files for edits
+		else if (strcmp(argv[i], "--no-shader-reload") == 0)
+		{
+			g_ShaderCache->SetHotReload(false);
+		}
+		// draw everything with the general scene program
+		else if (strcmp(argv[i], "--no-shader-permutations") == 0)
+		{
+			bShaderPermutations = false;
+		}
+		// cull and draw the static objects on the GPU
+		else if (strcmp(argv[i], "--gpu-culling") == 0)
+		{
+			bGpuCulling = true;
+		}
+		// fill a grid of desks to measure how rendering scales
+		else if ((strcmp(argv[i], "--generate-scene") == 0) && (i + 1 < argc))
+		{
+			generatorSettings.deskCount = atoi(argv[++i]);
+			bGenerateScene = true;
+		}
+		// seed of the generated layout
+		else if ((strcmp(argv[i], "--scene-seed") == 0) && (i + 1 < argc))
+		{
+			generatorSettings.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+		}
+		// number of materials and textures each generated draw
+		// picks from
+		else if ((strcmp(argv[i], "--scene-variety") == 0) && (i + 1 < argc))
+		{
+			generatorSettings.materialVariety = atoi(argv[++i]);
+			generatorSettings.textureVariety = generatorSettings.materialVariety;
+		}
+		// share of the generated objects that move
+		else if ((strcmp(argv[i], "--scene-animated") == 0) && (i + 1 < argc))
+		{
+			generatorSettings.animatedFraction = (float)atof(argv[++i]);
+		}
+		// import an OBJ or glTF model and stand it on the desk,
+		// may be given more than once
+		else if ((strcmp(argv[i], "--model") == 0) && (i + 1 < argc))
+		{
+			const char* modelFile = argv[++i];
+			g_SceneManager->LoadModel(modelFile, modelFile);
+		}
+		// write the render stats of every frame to a CSV file,
+		// or a JSON file if its name ends in .json
+		else if ((strcmp(argv[i], "--stats-log") == 0) && (i + 1 < argc))
+		{
+			g_RenderStats->OpenLog(argv[++i]);
+		}
+		// start with the render stats shown, F3 toggles them
+		else if (strcmp(argv[i], "--stats-overlay") == 0)
+		{
+			g_ViewManager->SetStatsOverlayVisible(true);
+		}
+		// split the window between the camera and 1 or 3
+		// orthographic views, F4 cycles the layouts
+		else if ((strcmp(argv[i], "--views") == 0) && (i + 1 < argc))
+		{
+			int viewCount = atoi(argv[++i]);
+			if (viewCount == 1)
+			{
+				g_ViewManager->SetViewLayout(ViewManager::VIEW_LAYOUT_SINGLE);
+			}
+			else if (viewCount == 2)
+			{
+				g_ViewManager->SetViewLayout(ViewManager::VIEW_LAYOUT_DUAL);
+			}
+			else if (viewCount == 4)
+			{
+				g_ViewManager->SetViewLayout(ViewManager::VIEW_LAYOUT_QUAD);
+			}
+			else
+			{
+				std::cout << "ERROR: --views takes 1, 2 or 4, not " << argv[i] << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		// save the camera path of this session to a track
+		else if ((strcmp(argv[i], "--record-camera") == 0) && (i + 1 < argc))
+		{
+			g_ViewManager->StartCameraRecording(argv[++i]);
+		}
+		// fly the camera along a recorded track at a fixed step
+		// and quit at its end
+		else if ((strcmp(argv[i], "--play-camera") == 0) && (i + 1 < argc))
+		{
+			if (g_ViewManager->StartCameraPlayback(argv[++i], FIXED_FRAME_STEP) == false)
+			{
+				return(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (bGenerateScene)
+	{
+		g_SceneManager->GenerateScene(generatorSettings);
+	}
+
+	// build a program for each combination of features the
+	// draws use, replacing the branches of the general shader
+	if (bShaderPermutations && (programID != 0))
+	{
+		g_SceneManager->SetShaderPermutations(g_ShaderCache);
+	}
+	// the pre-pass only matches the depth of programs built by
+	// the cache, which declares gl_Position invariant
+	if (bDepthPrePass && (programID != 0))
+	{
+		g_SceneManager->SetDepthPrePass(true);
+	}
+	else if (bDepthPrePass)
+	{
+		std::cout << "INFO: the depth pre-pass needs the scene program from the shader cache, drawing without it" << std::endl;
+	}
+	if (bGpuCulling && (programID != 0))
+	{
+		g_SceneManager->SetGpuCulling(g_ShaderCache);
+	}
+
+	if (benchmarkFilename != NULL)
+	{
+		RunBenchmarks(benchmarkFilename);
+	}
+	if (referenceFilename != NULL)
+	{
+		RenderReference(referenceFilename, referenceSamples);
+	}
+
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
-
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// switch to edited shaders once they have compiled, the
+		// old program keeps drawing until then
+		GLuint reloadedProgramID = g_ShaderCache->PollReload();
+		if (reloadedProgramID != 0)
+		{
+			glDeleteProgram(g_ShaderManager->m_programID);
+			g_ShaderManager->m_programID = reloadedProgramID;
+			g_SceneManager->RestoreShaderState();
+		}
 
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
+		// draw the scene and show it, at the simulated time of
+		// the track while one is played back
+		RenderFrame(g_ViewManager->GetFrameTime());
 
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+		// name the object under the cursor when clicked
+		glm::vec3 rayOrigin;
+		glm::vec3 rayDirection;
+		if (g_ViewManager->GetPickRay(rayOrigin, rayDirection))
+		{
+			float distance = 0.0f;
+			std::chrono::steady_clock::time_point pickStart = std::chrono::steady_clock::now();
+			int objectIndex = g_SceneManager->PickObject(rayOrigin, rayDirection, distance);
+			double microseconds = std::chrono::duration<double, std::micro>(
+				std::chrono::steady_clock::now() - pickStart).count();
+			if (objectIndex >= 0)
+			{
+				std::cout << "Picked draw " << objectIndex << ", " << g_SceneManager->DescribeObject(objectIndex)
+					<< ", at distance " << distance << " in " << microseconds << " us" << std::endl;
+			}
+			else
+			{
+				std::cout << "Picked nothing in " << microseconds << " us" << std::endl;
+			}
+		}
 
-
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+		if (bFirstFrame)
+		{
+			// wait for the frame to actually finish so the time
+			// includes the GPU work of the uploads
+			glFinish();
+			double milliseconds = std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - startTime).count();
+			std::cout << "Time to first frame: " << milliseconds << " ms ("
+				<< (g_SceneManager->IsUsingAssetPack() ? "asset pack" : "source assets") << ", "
+				<< (g_SceneManager->IsColdStart() ? "cold" : "warm") << " page cache, "
+				<< (g_SceneManager->IsUsingLazyMeshes() ? "lazy" : "eager") << " meshes)" << std::endl;
+			bFirstFrame = false;
+		}
 
 		// query the latest GLFW events
 		glfwPollEvents();
 	}
 
 	// clear the allocated manager objects from memory
+	DeleteManagers();
+
+	// Terminates the program successfully
+	exit(EXIT_SUCCESS); 
+}
+
+/***********************************************************
+ *  DeleteManagers()
+ *
+ *  This function is used to free the render stats and the
+ *  manager objects before the application quits, and to
+ *  report any GPU resources they left behind.
+ ***********************************************************/
+void DeleteManagers()
+{
+	if (NULL != g_StatsOverlay)
+	{
+		delete g_StatsOverlay;
+		g_StatsOverlay = NULL;
+	}
+	if (NULL != g_RenderStats)
+	{
+		delete g_RenderStats;
+		g_RenderStats = NULL;
+	}
 	if (NULL != g_SceneManager)
 	{
 		delete g_SceneManager;
@@ -112,14 +480,219 @@ int main(int argc, char* argv[])
 		delete g_ViewManager;
 		g_ViewManager = NULL;
 	}
+	if (NULL != g_ShaderCache)
+	{
+		delete g_ShaderCache;
+		g_ShaderCache = NULL;
+	}
 	if (NULL != g_ShaderManager)
 	{
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
 
-	// Terminates the program successfully
-	exit(EXIT_SUCCESS); 
+	// every owner of GPU resources is gone, so whatever is
+	// still recorded was leaked
+	GpuResourceRegistry::ReportLeaks();
+}
+
+/***********************************************************
+ *  RenderFrame()
+ *
+ *  This function is used to render one frame of the scene
+ *  at the given scene time and show it in the window.  The
+ *  scene is walked and its draws recorded once, and only the
+ *  culling and drawing are repeated for each view of the
+ *  layout, each timed so the cost of another view shows.
+ *  The CPU time spent submitting the frame is returned in
+ *  milliseconds.  It ends before the buffer swap, which may
+ *  wait for the display, and before the stats overlay, so
+ *  turning it on doesn't change the numbers it shows.
+ ***********************************************************/
+double RenderFrame(float sceneTime)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// convert from 3D object space to 2D view, this also
+	// binds the offscreen target the scene is rendered into
+	g_ViewManager->PrepareSceneView();
+
+	// Enable z-depth
+	glEnable(GL_DEPTH_TEST);
+
+	// Clear the frame and z buffers
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// refresh the 3D scene once, then sort and draw it against
+	// the camera of every view
+	g_SceneManager->SetSceneTime(sceneTime);
+	g_SceneManager->BeginSceneFrame();
+
+	int viewCount = g_ViewManager->GetViewCount();
+	double viewMilliseconds[2] = { 0.0, 0.0 };
+	for (int i = 0; i < viewCount; i++)
+	{
+		std::chrono::steady_clock::time_point viewStart = std::chrono::steady_clock::now();
+
+		const ViewManager::SCENE_VIEW& view = g_ViewManager->GetView(i);
+		g_ViewManager->ApplyView(i);
+		g_SceneManager->SetViewParameters(view.view, view.projection, view.position);
+		g_SceneManager->RenderSceneView();
+
+		// the first view against the ones it adds to
+		viewMilliseconds[(i == 0) ? 0 : 1] += std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - viewStart).count();
+	}
+	g_SceneManager->EndSceneFrame();
+
+	// between frames, the scene queries and the reference
+	// image look through the camera
+	if (viewCount > 1)
+	{
+		const ViewManager::SCENE_VIEW& camera = g_ViewManager->GetView(0);
+		g_SceneManager->SetViewParameters(camera.view, camera.projection, camera.position);
+	}
+
+	// upscale the rendered scene into the display window
+	g_ViewManager->PresentSceneView();
+
+	double submitMilliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+
+	g_RenderStats->SetViewTimes(viewCount,
+		submitMilliseconds - viewMilliseconds[0] - viewMilliseconds[1], viewMilliseconds[0],
+		(viewCount > 1) ? (viewMilliseconds[1] / (viewCount - 1)) : 0.0);
+	g_RenderStats->EndFrame(submitMilliseconds);
+	if (g_ViewManager->IsStatsOverlayVisible())
+	{
+		int width = 0;
+		int height = 0;
+		glfwGetFramebufferSize(g_Window, &width, &height);
+		g_StatsOverlay->Draw(*g_RenderStats, width, height);
+	}
+
+	// Flips the the back buffer with the front buffer every frame.
+	glfwSwapBuffers(g_Window);
+
+	return(submitMilliseconds);
+}
+
+/***********************************************************
+ *  RunBenchmarks()
+ *
+ *  This function is used to time the hot paths of the
+ *  managers and then whole frames, write the results to the
+ *  given file and quit.  Frames run without vsync at a fixed
+ *  render scale and scene time step, and each one is waited
+ *  for, so its time includes the GPU work.  The frames are
+ *  timed again with the stats overlay drawn, and with four
+ *  views to price each view added.
+ ***********************************************************/
+void RunBenchmarks(const char* resultsFilename)
+{
+	BenchmarkSuite suite;
+
+	glfwSwapInterval(0);
+	g_ViewManager->SetFixedRenderScale(1.0f);
+	g_ViewManager->SetStatsOverlayVisible(false);
+
+	// the first frame loads everything the later ones use
+	RenderFrame(0.0f);
+	glFinish();
+	g_SceneManager->FinishMeshLoading();
+
+	g_SceneManager->AddBenchmarks(suite);
+	g_ViewManager->AddBenchmarks(suite);
+	suite.Run();
+	g_SceneManager->TimeAnimation(suite);
+
+	TimeFrames("Frame", suite);
+	// the overlay is drawn after the submit time is taken, so
+	// only the whole frames show what it costs
+	g_ViewManager->SetStatsOverlayVisible(true);
+	TimeFrames("Frame::StatsOverlay", suite);
+	g_ViewManager->SetStatsOverlayVisible(false);
+	// the scene is walked once for all views, so each added
+	// view costs only its culling and draws
+	ViewManager::VIEW_LAYOUT viewLayout = g_ViewManager->GetViewLayout();
+	g_ViewManager->SetViewLayout(ViewManager::VIEW_LAYOUT_SINGLE);
+	double singleViewNanoseconds = TimeFrames("Frame::SingleView", suite);
+	g_ViewManager->SetViewLayout(ViewManager::VIEW_LAYOUT_QUAD);
+	double quadViewNanoseconds = TimeFrames("Frame::QuadView", suite);
+	g_ViewManager->SetViewLayout(viewLayout);
+	std::cout << "INFO: median CPU submit time " << singleViewNanoseconds / 1000000.0 << " ms with one view, "
+		<< quadViewNanoseconds / 1000000.0 << " ms with four, "
+		<< (quadViewNanoseconds - singleViewNanoseconds) / 3000000.0 << " ms per extra view" << std::endl;
+
+	suite.SetContext("renderer", (const char*)glGetString(GL_RENDERER));
+	suite.SetContext("version", (const char*)glGetString(GL_VERSION));
+	bool bWritten = suite.WriteResults(resultsFilename);
+
+	DeleteManagers();
+
+	exit(bWritten ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/***********************************************************
+ *  TimeFrames()
+ *
+ *  This function is used to time whole frames, waiting for
+ *  each, and add them to the suite under the given name.
+ *  The median CPU time it took to submit them is returned
+ *  in nanoseconds.
+ ***********************************************************/
+double TimeFrames(const char* frameName, BenchmarkSuite& suite)
+{
+	std::vector<double> frameTimes;
+	std::vector<double> submitTimes;
+	frameTimes.reserve(BENCHMARK_TIMED_FRAMES);
+	submitTimes.reserve(BENCHMARK_TIMED_FRAMES);
+	for (int frame = 0; frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_TIMED_FRAMES; frame++)
+	{
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		double submitMilliseconds = RenderFrame((float)frame * FIXED_FRAME_STEP);
+		glFinish();
+		glfwPollEvents();
+
+		if (frame >= BENCHMARK_WARMUP_FRAMES)
+		{
+			frameTimes.push_back(std::chrono::duration<double, std::nano>(
+				std::chrono::steady_clock::now() - frameStart).count());
+			submitTimes.push_back(submitMilliseconds * 1000000.0);
+		}
+	}
+	std::sort(frameTimes.begin(), frameTimes.end());
+	std::sort(submitTimes.begin(), submitTimes.end());
+	suite.AddResult(frameName, frameTimes.size(), frameTimes[frameTimes.size() / 2], frameTimes[0]);
+
+	return(submitTimes[submitTimes.size() / 2]);
+}
+
+/***********************************************************
+ *  RenderReference()
+ *
+ *  This function is used to path trace the view of the
+ *  first frame at the size of the window, write it to the
+ *  given image file and quit.  The image refines in the
+ *  file as the passes go on.
+ ***********************************************************/
+void RenderReference(const char* imageFilename, int samplesPerPixel)
+{
+	int width = 0;
+	int height = 0;
+
+	// the first frame places the camera and loads the scene
+	RenderFrame(0.0f);
+	glfwGetFramebufferSize(g_Window, &width, &height);
+
+	PathTracer::TRACE_SETTINGS settings = PathTracer::GetDefaultSettings(width, height);
+	settings.samplesPerPixel = samplesPerPixel;
+	bool bWritten = g_SceneManager->RenderReferenceImage(imageFilename, settings);
+
+	DeleteManagers();
+
+	exit(bWritten ? EXIT_SUCCESS : EXIT_FAILURE);
 }
 
 /***********************************************************
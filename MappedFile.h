@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.h
+// ============
+// read-only memory mapping of a whole file
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps a file into memory for reading, so its
+ *  contents can be handed to the driver without first being
+ *  copied into a buffer.  Pages are only read from disk when
+ *  they are first touched.  The mapping is released when the
+ *  object is closed or destroyed.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map the whole file, returns false if it can't be opened
+	bool Open(const char* filename);
+	// release the mapping
+	void Close();
+
+	bool IsOpen() const { return(m_pData != NULL); }
+	const unsigned char* GetData() const { return(m_pData); }
+	size_t GetSize() const { return(m_size); }
+
+	// ask the operating system to evict the file from the page
+	// cache, so the next read comes from disk
+	static bool DropFromPageCache(const char* filename);
+
+private:
+	const unsigned char* m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#endif
+
+	// not copyable, the mapping has a single owner
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
@@ -0,0 +1,388 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshbuilder.cpp
+// ============
+// generate the basic shapes as CPU side vertex and index data
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshBuilder.h"
+
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	const float g_Pi = 3.14159265358979f;
+	// segments around the round shapes
+	const int g_RadialSegments = 36;
+	// segments around the tube of the torus
+	const int g_TubeSegments = 18;
+	// radius of the torus ring, measured to the tube center
+	const float g_TorusRadius = 1.0f;
+	const float g_TorusTubeRadius = 0.2f;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used to build the passed in basic shape.
+ ***********************************************************/
+void MeshBuilder::Build(RenderQueue::MESH_TYPE meshType, MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.parts.clear();
+
+	switch (meshType)
+	{
+	case RenderQueue::MESH_PLANE:
+		BuildPlane(mesh);
+		break;
+	case RenderQueue::MESH_BOX:
+		BuildBox(mesh);
+		break;
+	case RenderQueue::MESH_CYLINDER:
+		BuildCylinder(mesh, 1.0f, 1.0f, true);
+		break;
+	case RenderQueue::MESH_TAPERED_CYLINDER:
+		BuildCylinder(mesh, 1.0f, 0.5f, true);
+		break;
+	case RenderQueue::MESH_CONE:
+		BuildCylinder(mesh, 1.0f, 0.0f, false);
+		break;
+	case RenderQueue::MESH_TORUS:
+		BuildTorus(mesh, g_TorusTubeRadius);
+		break;
+	case RenderQueue::MESH_PRISM:
+		BuildPrism(mesh);
+		break;
+	default:
+		break;
+	}
+}
+
+/***********************************************************
+ *  AddVertex()
+ *
+ *  This method is used to append one vertex to the mesh.
+ ***********************************************************/
+uint32_t MeshBuilder::AddVertex(
+	MESH_DATA& mesh,
+	float x, float y, float z,
+	float nx, float ny, float nz,
+	float u, float v)
+{
+	uint32_t index = (uint32_t)mesh.GetVertexCount();
+	float vertex[FLOATS_PER_VERTEX] = { x, y, z, nx, ny, nz, u, v };
+
+	mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + FLOATS_PER_VERTEX);
+
+	return(index);
+}
+
+/***********************************************************
+ *  BeginPart()
+ *
+ *  This method is used to open a new index range for a part.
+ ***********************************************************/
+void MeshBuilder::BeginPart(MESH_DATA& mesh, unsigned int flags)
+{
+	MESH_PART part;
+
+	part.flags = flags;
+	part.firstIndex = (int)mesh.indices.size();
+	part.indexCount = 0;
+	mesh.parts.push_back(part);
+}
+
+/***********************************************************
+ *  EndPart()
+ *
+ *  This method is used to close the index range of the part
+ *  opened last.
+ ***********************************************************/
+void MeshBuilder::EndPart(MESH_DATA& mesh)
+{
+	MESH_PART& part = mesh.parts.back();
+
+	part.indexCount = (int)mesh.indices.size() - part.firstIndex;
+}
+
+/***********************************************************
+ *  BuildPlane()
+ *
+ *  This method is used to build a flat square on the XZ plane
+ *  from -1 to 1, facing up.
+ ***********************************************************/
+void MeshBuilder::BuildPlane(MESH_DATA& mesh)
+{
+	BeginPart(mesh, RenderQueue::MESH_PART_ALL);
+
+	uint32_t v0 = AddVertex(mesh, -1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f);
+	uint32_t v1 = AddVertex(mesh, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
+	uint32_t v2 = AddVertex(mesh, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f);
+	uint32_t v3 = AddVertex(mesh, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f);
+
+	uint32_t indices[6] = { v0, v1, v2, v0, v2, v3 };
+	mesh.indices.insert(mesh.indices.end(), indices, indices + 6);
+
+	EndPart(mesh);
+}
+
+/***********************************************************
+ *  BuildBox()
+ *
+ *  This method is used to build a unit cube centered on the
+ *  origin, with each face mapping the whole texture.
+ ***********************************************************/
+void MeshBuilder::BuildBox(MESH_DATA& mesh)
+{
+	// outward normal, and the two axes spanning each face
+	const float faces[6][9] =
+	{
+		{ 0.0f, 0.0f, 1.0f,		1.0f, 0.0f, 0.0f,	0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, -1.0f,	-1.0f, 0.0f, 0.0f,	0.0f, 1.0f, 0.0f },
+		{ 1.0f, 0.0f, 0.0f,		0.0f, 0.0f, -1.0f,	0.0f, 1.0f, 0.0f },
+		{ -1.0f, 0.0f, 0.0f,	0.0f, 0.0f, 1.0f,	0.0f, 1.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f,		1.0f, 0.0f, 0.0f,	0.0f, 0.0f, -1.0f },
+		{ 0.0f, -1.0f, 0.0f,	1.0f, 0.0f, 0.0f,	0.0f, 0.0f, 1.0f }
+	};
+	const float corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+
+	BeginPart(mesh, RenderQueue::MESH_PART_ALL);
+
+	for (int face = 0; face < 6; face++)
+	{
+		const float* n = faces[face];
+		const float* s = faces[face] + 3;
+		const float* t = faces[face] + 6;
+		uint32_t first = 0;
+
+		for (int c = 0; c < 4; c++)
+		{
+			float a = corners[c][0] - 0.5f;
+			float b = corners[c][1] - 0.5f;
+			uint32_t index = AddVertex(mesh,
+				n[0] * 0.5f + s[0] * a + t[0] * b,
+				n[1] * 0.5f + s[1] * a + t[1] * b,
+				n[2] * 0.5f + s[2] * a + t[2] * b,
+				n[0], n[1], n[2],
+				corners[c][0], corners[c][1]);
+			if (c == 0)
+			{
+				first = index;
+			}
+		}
+
+		uint32_t indices[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+		mesh.indices.insert(mesh.indices.end(), indices, indices + 6);
+	}
+
+	EndPart(mesh);
+}
+
+/***********************************************************
+ *  AddCap()
+ *
+ *  This method is used to add a flat disc as a triangle fan
+ *  around a center vertex.
+ ***********************************************************/
+void MeshBuilder::AddCap(MESH_DATA& mesh, float y, float radius, bool bFacingUp)
+{
+	float normalY = bFacingUp ? 1.0f : -1.0f;
+	uint32_t center = AddVertex(mesh, 0.0f, y, 0.0f, 0.0f, normalY, 0.0f, 0.5f, 0.5f);
+	uint32_t first = center + 1;
+
+	for (int i = 0; i <= g_RadialSegments; i++)
+	{
+		float angle = 2.0f * g_Pi * (float)i / (float)g_RadialSegments;
+		float x = std::cos(angle);
+		float z = std::sin(angle);
+		AddVertex(mesh, x * radius, y, z * radius, 0.0f, normalY, 0.0f, 0.5f + 0.5f * x, 0.5f + 0.5f * z);
+	}
+
+	for (int i = 0; i < g_RadialSegments; i++)
+	{
+		// keep the winding counter-clockwise seen from outside
+		if (bFacingUp)
+		{
+			mesh.indices.push_back(center);
+			mesh.indices.push_back(first + i + 1);
+			mesh.indices.push_back(first + i);
+		}
+		else
+		{
+			mesh.indices.push_back(center);
+			mesh.indices.push_back(first + i);
+			mesh.indices.push_back(first + i + 1);
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildCylinder()
+ *
+ *  This method is used to build an upright cylinder from
+ *  y = 0 to y = 1.  Different radii give a tapered cylinder,
+ *  and a top radius of zero gives a cone.
+ ***********************************************************/
+void MeshBuilder::BuildCylinder(MESH_DATA& mesh, float bottomRadius, float topRadius, bool bTopCap)
+{
+	if (bTopCap)
+	{
+		BeginPart(mesh, RenderQueue::MESH_PART_TOP);
+		AddCap(mesh, 1.0f, topRadius, true);
+		EndPart(mesh);
+	}
+
+	BeginPart(mesh, RenderQueue::MESH_PART_BOTTOM);
+	AddCap(mesh, 0.0f, bottomRadius, false);
+	EndPart(mesh);
+
+	// the side normal leans up by the slope of the taper
+	float slope = bottomRadius - topRadius;
+	float normalScale = 1.0f / std::sqrt(1.0f + slope * slope);
+
+	BeginPart(mesh, RenderQueue::MESH_PART_SIDES);
+	uint32_t first = (uint32_t)mesh.GetVertexCount();
+	for (int i = 0; i <= g_RadialSegments; i++)
+	{
+		float u = (float)i / (float)g_RadialSegments;
+		float angle = 2.0f * g_Pi * u;
+		float x = std::cos(angle);
+		float z = std::sin(angle);
+
+		AddVertex(mesh, x * bottomRadius, 0.0f, z * bottomRadius,
+			x * normalScale, slope * normalScale, z * normalScale, u, 0.0f);
+		AddVertex(mesh, x * topRadius, 1.0f, z * topRadius,
+			x * normalScale, slope * normalScale, z * normalScale, u, 1.0f);
+	}
+	for (int i = 0; i < g_RadialSegments; i++)
+	{
+		uint32_t bottom0 = first + i * 2;
+		uint32_t top0 = bottom0 + 1;
+		uint32_t bottom1 = bottom0 + 2;
+		uint32_t top1 = bottom0 + 3;
+
+		mesh.indices.push_back(bottom0);
+		mesh.indices.push_back(top0);
+		mesh.indices.push_back(bottom1);
+		mesh.indices.push_back(bottom1);
+		mesh.indices.push_back(top0);
+		mesh.indices.push_back(top1);
+	}
+	EndPart(mesh);
+}
+
+/***********************************************************
+ *  BuildTorus()
+ *
+ *  This method is used to build a ring lying in the XY plane
+ *  around the Z axis.
+ ***********************************************************/
+void MeshBuilder::BuildTorus(MESH_DATA& mesh, float tubeRadius)
+{
+	BeginPart(mesh, RenderQueue::MESH_PART_ALL);
+
+	for (int i = 0; i <= g_RadialSegments; i++)
+	{
+		float u = (float)i / (float)g_RadialSegments;
+		float ringAngle = 2.0f * g_Pi * u;
+		float ringX = std::cos(ringAngle);
+		float ringY = std::sin(ringAngle);
+
+		for (int j = 0; j <= g_TubeSegments; j++)
+		{
+			float v = (float)j / (float)g_TubeSegments;
+			float tubeAngle = 2.0f * g_Pi * v;
+			float nx = std::cos(tubeAngle) * ringX;
+			float ny = std::cos(tubeAngle) * ringY;
+			float nz = std::sin(tubeAngle);
+
+			AddVertex(mesh,
+				ringX * g_TorusRadius + nx * tubeRadius,
+				ringY * g_TorusRadius + ny * tubeRadius,
+				nz * tubeRadius,
+				nx, ny, nz, u, v);
+		}
+	}
+
+	int rowLength = g_TubeSegments + 1;
+	for (int i = 0; i < g_RadialSegments; i++)
+	{
+		for (int j = 0; j < g_TubeSegments; j++)
+		{
+			uint32_t a = i * rowLength + j;
+			uint32_t b = (i + 1) * rowLength + j;
+
+			mesh.indices.push_back(a);
+			mesh.indices.push_back(b);
+			mesh.indices.push_back(a + 1);
+			mesh.indices.push_back(a + 1);
+			mesh.indices.push_back(b);
+			mesh.indices.push_back(b + 1);
+		}
+	}
+
+	EndPart(mesh);
+}
+
+/***********************************************************
+ *  BuildPrism()
+ *
+ *  This method is used to build a triangular prism with its
+ *  triangle in the XY plane, extruded along Z.
+ ***********************************************************/
+void MeshBuilder::BuildPrism(MESH_DATA& mesh)
+{
+	const float triangle[3][2] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.0f, 0.5f } };
+
+	BeginPart(mesh, RenderQueue::MESH_PART_ALL);
+
+	// front and back triangles
+	for (int side = 0; side < 2; side++)
+	{
+		float z = (side == 0) ? 0.5f : -0.5f;
+		float nz = (side == 0) ? 1.0f : -1.0f;
+		uint32_t first = (uint32_t)mesh.GetVertexCount();
+
+		for (int c = 0; c < 3; c++)
+		{
+			AddVertex(mesh, triangle[c][0], triangle[c][1], z, 0.0f, 0.0f, nz,
+				triangle[c][0] + 0.5f, triangle[c][1] + 0.5f);
+		}
+		if (side == 0)
+		{
+			mesh.indices.push_back(first);
+			mesh.indices.push_back(first + 1);
+			mesh.indices.push_back(first + 2);
+		}
+		else
+		{
+			mesh.indices.push_back(first);
+			mesh.indices.push_back(first + 2);
+			mesh.indices.push_back(first + 1);
+		}
+	}
+
+	// three rectangular sides
+	for (int edge = 0; edge < 3; edge++)
+	{
+		const float* a = triangle[edge];
+		const float* b = triangle[(edge + 1) % 3];
+		float nx = b[1] - a[1];
+		float ny = a[0] - b[0];
+		float length = std::sqrt(nx * nx + ny * ny);
+		nx /= length;
+		ny /= length;
+
+		uint32_t first = AddVertex(mesh, a[0], a[1], 0.5f, nx, ny, 0.0f, 0.0f, 0.0f);
+		AddVertex(mesh, b[0], b[1], 0.5f, nx, ny, 0.0f, 1.0f, 0.0f);
+		AddVertex(mesh, b[0], b[1], -0.5f, nx, ny, 0.0f, 1.0f, 1.0f);
+		AddVertex(mesh, a[0], a[1], -0.5f, nx, ny, 0.0f, 0.0f, 1.0f);
+
+		uint32_t indices[6] = { first, first + 3, first + 2, first, first + 2, first + 1 };
+		mesh.indices.insert(mesh.indices.end(), indices, indices + 6);
+	}
+
+	EndPart(mesh);
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshbuilder.h
+// ============
+// generate the basic shapes as CPU side vertex and index data
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderQueue.h"
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  MeshBuilder
+ *
+ *  This class builds the same basic shapes that ShapeMeshes
+ *  loads, but keeps the vertices and indices in memory so
+ *  they can be processed before they are uploaded.  Vertices
+ *  use the ShapeMeshes layout of position, normal and
+ *  texture coordinate, eight floats each.  Capped shapes keep
+ *  their top, bottom and sides in separate index ranges so
+ *  each part can still be drawn on its own.
+ ***********************************************************/
+class MeshBuilder
+{
+public:
+	// floats in each vertex
+	static const int FLOATS_PER_VERTEX = 8;
+
+	// index range of one drawable part of a mesh
+	struct MESH_PART
+	{
+		// RenderQueue::MESH_PART_FLAGS covered by this range
+		unsigned int flags;
+		int firstIndex;
+		int indexCount;
+	};
+
+	// vertices, indices and parts of one mesh
+	struct MESH_DATA
+	{
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<MESH_PART> parts;
+
+		int GetVertexCount() const { return((int)vertices.size() / FLOATS_PER_VERTEX); }
+	};
+
+	// build the given shape, replacing the contents of mesh
+	static void Build(RenderQueue::MESH_TYPE meshType, MESH_DATA& mesh);
+
+private:
+	static void BuildPlane(MESH_DATA& mesh);
+	static void BuildBox(MESH_DATA& mesh);
+	// cylinder from y = 0 to 1, topRadius of 0 makes a cone
+	static void BuildCylinder(MESH_DATA& mesh, float bottomRadius, float topRadius, bool bTopCap);
+	static void BuildTorus(MESH_DATA& mesh, float tubeRadius);
+	static void BuildPrism(MESH_DATA& mesh);
+
+	// append a vertex and return its index
+	static uint32_t AddVertex(
+		MESH_DATA& mesh,
+		float x, float y, float z,
+		float nx, float ny, float nz,
+		float u, float v);
+	// append the indices of a disc at height y facing up or down
+	static void AddCap(MESH_DATA& mesh, float y, float radius, bool bFacingUp);
+	// start a new part at the current end of the index list
+	static void BeginPart(MESH_DATA& mesh, unsigned int flags);
+	// close the part started by BeginPart()
+	static void EndPart(MESH_DATA& mesh);
+};
@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshlibrary.cpp
+// ============
+// optimized, quantized basic shapes sharing one vertex and index buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshLibrary.h"
+#include "RenderStats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// names used in reports
+	const char* g_MeshNames[RenderQueue::MESH_TYPE_COUNT] =
+	{
+		"plane", "box", "cylinder", "tapered cylinder", "cone", "torus", "prism"
+	};
+	// bytes of a ShapeMeshes style vertex and index
+	const int g_FloatVertexBytes = MeshBuilder::FLOATS_PER_VERTEX * sizeof(float);
+	const int g_FloatIndexBytes = sizeof(uint32_t);
+}
+
+/***********************************************************
+ *  MeshLibrary()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshLibrary::MeshLibrary()
+{
+	for (int i = 0; i < RenderQueue::MESH_TYPE_COUNT; i++)
+	{
+		m_meshes[i].baseVertex = 0;
+		m_meshes[i].dequantize = glm::mat4(1.0f);
+	}
+}
+
+/***********************************************************
+ *  ~MeshLibrary()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MeshLibrary::~MeshLibrary()
+{
+	// the shared buffers are deleted by their handles
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used to build every basic shape and upload
+ *  the result.
+ ***********************************************************/
+bool MeshLibrary::Initialize()
+{
+	std::vector<MeshOptimizer::QUANTIZED_VERTEX> vertices;
+	std::vector<uint16_t> indices;
+
+	if (BuildGeometry(vertices, indices) == false)
+	{
+		return false;
+	}
+
+	Upload(vertices.data(), vertices.size() * sizeof(MeshOptimizer::QUANTIZED_VERTEX),
+		indices.data(), indices.size() * sizeof(uint16_t));
+
+	return true;
+}
+
+/***********************************************************
+ *  BuildGeometry()
+ *
+ *  This method is used to build every basic shape, reorder
+ *  its triangles and vertices, pack its vertices and append
+ *  it to the shared buffers.  The report compares the cache
+ *  miss ratio and the vertex size against the shapes as they
+ *  were generated.
+ ***********************************************************/
+bool MeshLibrary::BuildGeometry(
+	std::vector<MeshOptimizer::QUANTIZED_VERTEX>& allVertices,
+	std::vector<uint16_t>& allIndices)
+{
+	std::vector<MeshOptimizer::QUANTIZED_VERTEX> packedVertices;
+	MeshBuilder::MESH_DATA mesh;
+	int totalVertices = 0;
+	int totalTriangles = 0;
+	float totalMissesBefore = 0.0f;
+	float totalMissesAfter = 0.0f;
+
+	std::cout << "Mesh optimization (ACMR with a 16 entry FIFO cache):" << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+
+	for (int type = 0; type < RenderQueue::MESH_TYPE_COUNT; type++)
+	{
+		MeshBuilder::Build((RenderQueue::MESH_TYPE)type, mesh);
+
+		int vertexCount = mesh.GetVertexCount();
+		int triangleCount = (int)mesh.indices.size() / 3;
+		if (vertexCount > 65535)
+		{
+			std::cout << "ERROR: " << g_MeshNames[type] << " mesh has too many vertices for 16-bit indices" << std::endl;
+			return false;
+		}
+
+		float acmrBefore = MeshOptimizer::ComputeACMR(mesh.indices.data(), (int)mesh.indices.size(), vertexCount);
+
+		// each part is reordered on its own so the parts can
+		// still be drawn separately
+		for (int p = 0; p < (int)mesh.parts.size(); p++)
+		{
+			const MeshBuilder::MESH_PART& part = mesh.parts[p];
+			MeshOptimizer::OptimizeVertexCache(&mesh.indices[part.firstIndex], part.indexCount, vertexCount);
+		}
+		MeshOptimizer::OptimizeVertexFetch(mesh);
+		vertexCount = mesh.GetVertexCount();
+
+		float acmrAfter = MeshOptimizer::ComputeACMR(mesh.indices.data(), (int)mesh.indices.size(), vertexCount);
+
+		MESH_RANGE& range = m_meshes[type];
+		range.dequantize = MeshOptimizer::Quantize(mesh, packedVertices);
+		range.baseVertex = (GLint)allVertices.size();
+		range.parts = mesh.parts;
+		for (int p = 0; p < (int)range.parts.size(); p++)
+		{
+			range.parts[p].firstIndex += (int)allIndices.size();
+		}
+
+		allVertices.insert(allVertices.end(), packedVertices.begin(), packedVertices.end());
+		for (int i = 0; i < (int)mesh.indices.size(); i++)
+		{
+			allIndices.push_back((uint16_t)mesh.indices[i]);
+		}
+
+		std::cout << "  " << std::left << std::setw(18) << g_MeshNames[type] << std::right
+			<< std::setw(5) << vertexCount << " vertices " << std::setw(5) << triangleCount << " triangles  ACMR "
+			<< acmrBefore << " -> " << acmrAfter << std::endl;
+
+		totalVertices += vertexCount;
+		totalTriangles += triangleCount;
+		totalMissesBefore += acmrBefore * triangleCount;
+		totalMissesAfter += acmrAfter * triangleCount;
+	}
+
+	if (totalTriangles > 0)
+	{
+		std::cout << "  overall ACMR " << totalMissesBefore / totalTriangles << " -> "
+			<< totalMissesAfter / totalTriangles << ", vertex size " << g_FloatVertexBytes << " -> "
+			<< sizeof(MeshOptimizer::QUANTIZED_VERTEX) << " bytes, index size " << g_FloatIndexBytes
+			<< " -> " << sizeof(uint16_t) << " bytes" << std::endl;
+		std::cout << "  geometry " << totalVertices * g_FloatVertexBytes + totalTriangles * 3 * g_FloatIndexBytes
+			<< " -> " << allVertices.size() * sizeof(MeshOptimizer::QUANTIZED_VERTEX) + allIndices.size() * sizeof(uint16_t)
+			<< " bytes" << std::endl;
+	}
+	std::cout << std::defaultfloat;
+
+	return true;
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used to create the shared buffers from
+ *  packed vertices and 16-bit indices, and to describe the
+ *  packed vertex layout to the vertex fetch.
+ ***********************************************************/
+void MeshLibrary::Upload(
+	const void* pVertices,
+	size_t vertexBytes,
+	const void* pIndices,
+	size_t indexBytes)
+{
+	glBindVertexArray(m_vertexArray.Create("mesh library"));
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer.Create("mesh library vertices"));
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, pVertices, GL_STATIC_DRAW);
+	m_vertexBuffer.SetBytes(vertexBytes);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer.Create("mesh library indices"));
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, pIndices, GL_STATIC_DRAW);
+	m_indexBuffer.SetBytes(indexBytes);
+
+	// normalized integer formats are turned into floats by the
+	// vertex fetch, so the shaders need no decoding code.  GL
+	// 4.2 and later map snorm exactly, earlier versions are off
+	// by half a step, well below what can be seen.
+	const GLsizei stride = sizeof(MeshOptimizer::QUANTIZED_VERTEX);
+	glVertexAttribPointer(0, 4, GL_SHORT, GL_TRUE, stride,
+		(void*)offsetof(MeshOptimizer::QUANTIZED_VERTEX, position));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride,
+		(void*)offsetof(MeshOptimizer::QUANTIZED_VERTEX, normal));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+		(void*)offsetof(MeshOptimizer::QUANTIZED_VERTEX, texCoord));
+	glEnableVertexAttribArray(2);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used to draw the selected parts of a shape
+ *  out of the shared buffers.
+ ***********************************************************/
+void MeshLibrary::Draw(RenderQueue::MESH_TYPE meshType, unsigned int meshParts)
+{
+	const MESH_RANGE& range = m_meshes[meshType];
+
+	glBindVertexArray(m_vertexArray.Get());
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+	for (int p = 0; p < (int)range.parts.size(); p++)
+	{
+		const MeshBuilder::MESH_PART& part = range.parts[p];
+		if ((part.flags & meshParts) != 0)
+		{
+			glDrawElementsBaseVertex(GL_TRIANGLES, part.indexCount, GL_UNSIGNED_SHORT,
+				(void*)(part.firstIndex * sizeof(uint16_t)), range.baseVertex);
+			RenderStats::CountDraw(part.indexCount / 3);
+		}
+	}
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  GetMeshName()
+ *
+ *  This method is used to get the name of a shape for
+ *  messages.
+ ***********************************************************/
+const char* MeshLibrary::GetMeshName(RenderQueue::MESH_TYPE meshType)
+{
+	return(g_MeshNames[meshType]);
+}
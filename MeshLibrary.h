@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshlibrary.h
+// ============
+// optimized, quantized basic shapes sharing one vertex and index buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GpuResources.h"
+#include "MeshBuilder.h"
+#include "MeshOptimizer.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  MeshLibrary
+ *
+ *  This class is a drop-in replacement for drawing the basic
+ *  shapes of ShapeMeshes.  Every shape is built on the CPU,
+ *  run through MeshOptimizer and uploaded into one shared
+ *  vertex buffer of 16 byte vertices and one 16-bit index
+ *  buffer.  The vertex fetch decodes the packed attributes,
+ *  so the scene shaders read them unchanged from locations 0
+ *  (position), 1 (normal) and 2 (texture coordinate).  The
+ *  only thing a draw has to add is the dequantize matrix of
+ *  its shape on the right of the model matrix.
+ ***********************************************************/
+class MeshLibrary
+{
+public:
+	// location of one shape in the shared buffers
+	struct MESH_RANGE
+	{
+		GLint baseVertex;
+		std::vector<MeshBuilder::MESH_PART> parts;
+		glm::mat4 dequantize;
+	};
+
+	// constructor
+	MeshLibrary();
+	// destructor
+	~MeshLibrary();
+
+	// build, optimize and upload every basic shape, and print
+	// the before and after report
+	bool Initialize();
+	// build and optimize every basic shape without uploading,
+	// filling in the shape ranges
+	bool BuildGeometry(
+		std::vector<MeshOptimizer::QUANTIZED_VERTEX>& vertices,
+		std::vector<uint16_t>& indices);
+	// upload already built shapes, the shape ranges must have
+	// been set before drawing
+	void Upload(
+		const void* pVertices,
+		size_t vertexBytes,
+		const void* pIndices,
+		size_t indexBytes);
+	// true once the shapes have been uploaded
+	bool IsActive() const { return(m_vertexArray.Get() != 0); }
+
+	// draw the selected parts of a shape
+	void Draw(RenderQueue::MESH_TYPE meshType, unsigned int meshParts);
+	// matrix turning the packed positions of a shape back
+	// into its object space
+	const glm::mat4& GetDequantizeMatrix(RenderQueue::MESH_TYPE meshType) const
+	{
+		return(m_meshes[meshType].dequantize);
+	}
+	// where a shape lives in the shared buffers
+	const MESH_RANGE& GetMeshRange(RenderQueue::MESH_TYPE meshType) const { return(m_meshes[meshType]); }
+	void SetMeshRange(RenderQueue::MESH_TYPE meshType, const MESH_RANGE& range) { m_meshes[meshType] = range; }
+	// name of a shape for messages
+	static const char* GetMeshName(RenderQueue::MESH_TYPE meshType);
+	// vertex array of the shared buffers, for drawing ranges
+	// of several shapes in one call
+	GLuint GetVertexArray() const { return(m_vertexArray.Get()); }
+
+private:
+	GLVertexArray m_vertexArray;
+	GLBuffer m_vertexBuffer;
+	GLBuffer m_indexBuffer;
+	MESH_RANGE m_meshes[RenderQueue::MESH_TYPE_COUNT];
+};
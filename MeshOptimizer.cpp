@@ -0,0 +1,360 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.cpp
+// ============
+// reorder and quantize mesh data for faster vertex processing
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// cache modelled by the triangle reordering, larger than
+	// any real hardware so the order suits all of them
+	const int g_CacheSize = 32;
+	// scoring constants from the original article
+	const float g_CacheDecayPower = 1.5f;
+	const float g_LastTriangleScore = 0.75f;
+	const float g_ValenceBoostScale = 2.0f;
+	const float g_ValenceBoostPower = 0.5f;
+
+	/***********************************************************
+	 *  VertexScore()
+	 *
+	 *  Score a vertex by how recently it was used and by how
+	 *  few triangles still need it.  Vertices in the triangle
+	 *  just emitted get a fixed score so the next triangle does
+	 *  not simply repeat the same edge.
+	 ***********************************************************/
+	float VertexScore(int cachePosition, int remainingValence)
+	{
+		if (remainingValence == 0)
+		{
+			return(-1.0f);
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				score = g_LastTriangleScore;
+			}
+			else
+			{
+				float scale = 1.0f / (float)(g_CacheSize - 3);
+				score = std::pow(1.0f - (float)(cachePosition - 3) * scale, g_CacheDecayPower);
+			}
+		}
+
+		// finish off vertices with few triangles left first
+		score += g_ValenceBoostScale * std::pow((float)remainingValence, -g_ValenceBoostPower);
+
+		return(score);
+	}
+
+	/***********************************************************
+	 *  PackSnorm()
+	 *
+	 *  Convert a value in [-1, 1] to a signed normalized integer
+	 *  with the given largest magnitude.
+	 ***********************************************************/
+	int PackSnorm(float value, float maxValue)
+	{
+		value = std::min(1.0f, std::max(-1.0f, value));
+
+		return((int)std::floor(value * maxValue + 0.5f));
+	}
+}
+
+/***********************************************************
+ *  OptimizeVertexCache()
+ *
+ *  This method is used to reorder the triangles of an index
+ *  range so that each triangle reuses as many of the vertices
+ *  transformed for the previous triangles as possible.  Each
+ *  step emits the highest scoring triangle around the
+ *  vertices currently in the modelled cache, and only those
+ *  triangles are rescored, which keeps the cost linear.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexCache(uint32_t* pIndices, int indexCount, int vertexCount)
+{
+	int triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// triangles using each vertex, the first remaining[v]
+	// entries of a vertex are the ones not yet emitted
+	std::vector<int> remaining(vertexCount, 0);
+	for (int i = 0; i < triangleCount * 3; i++)
+	{
+		remaining[pIndices[i]]++;
+	}
+	std::vector<int> adjacencyOffset(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+	}
+	std::vector<int> adjacency(triangleCount * 3);
+	std::vector<int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			adjacency[fill[pIndices[t * 3 + k]]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = VertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> bEmitted(triangleCount, false);
+	int bestTriangle = 0;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = vertexScore[pIndices[t * 3]] +
+			vertexScore[pIndices[t * 3 + 1]] + vertexScore[pIndices[t * 3 + 2]];
+		if (triangleScore[t] > triangleScore[bestTriangle])
+		{
+			bestTriangle = t;
+		}
+	}
+
+	std::vector<uint32_t> output;
+	std::vector<int> cache;
+	std::vector<int> newCache;
+	int scanCursor = 0;
+
+	output.reserve(triangleCount * 3);
+	cache.reserve(g_CacheSize + 3);
+	newCache.reserve(g_CacheSize + 3);
+
+	while (bestTriangle >= 0)
+	{
+		const uint32_t* pTriangle = pIndices + bestTriangle * 3;
+
+		bEmitted[bestTriangle] = true;
+		output.insert(output.end(), pTriangle, pTriangle + 3);
+
+		// take the triangle out of the lists of its vertices
+		for (int k = 0; k < 3; k++)
+		{
+			int v = pTriangle[k];
+			int* pList = &adjacency[adjacencyOffset[v]];
+			for (int i = 0; i < remaining[v]; i++)
+			{
+				if (pList[i] == bestTriangle)
+				{
+					pList[i] = pList[remaining[v] - 1];
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// the triangle moves to the front of the cache
+		newCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			if (std::find(newCache.begin(), newCache.end(), (int)pTriangle[k]) == newCache.end())
+			{
+				newCache.push_back(pTriangle[k]);
+			}
+		}
+		for (int i = 0; i < (int)cache.size(); i++)
+		{
+			if (std::find(newCache.begin(), newCache.end(), cache[i]) == newCache.end())
+			{
+				newCache.push_back(cache[i]);
+			}
+		}
+
+		// rescore the cached vertices, including the ones that
+		// just fell out of it
+		for (int i = 0; i < (int)newCache.size(); i++)
+		{
+			int v = newCache[i];
+			cachePosition[v] = (i < g_CacheSize) ? i : -1;
+			vertexScore[v] = VertexScore(cachePosition[v], remaining[v]);
+		}
+
+		// rescore the triangles around them and pick the best
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < (int)newCache.size(); i++)
+		{
+			int v = newCache[i];
+			const int* pList = &adjacency[adjacencyOffset[v]];
+			for (int a = 0; a < remaining[v]; a++)
+			{
+				int t = pList[a];
+				float score = vertexScore[pIndices[t * 3]] +
+					vertexScore[pIndices[t * 3 + 1]] + vertexScore[pIndices[t * 3 + 2]];
+				triangleScore[t] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cache.assign(newCache.begin(), newCache.begin() + std::min((int)newCache.size(), g_CacheSize));
+
+		// nothing left around the cache, continue elsewhere
+		if (bestTriangle < 0)
+		{
+			while ((scanCursor < triangleCount) && bEmitted[scanCursor])
+			{
+				scanCursor++;
+			}
+			bestTriangle = (scanCursor < triangleCount) ? scanCursor : -1;
+		}
+	}
+
+	std::copy(output.begin(), output.end(), pIndices);
+}
+
+/***********************************************************
+ *  OptimizeVertexFetch()
+ *
+ *  This method is used to renumber the vertices in the order
+ *  the index list first uses them, so the vertex fetch reads
+ *  the vertex buffer mostly sequentially.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexFetch(MeshBuilder::MESH_DATA& mesh)
+{
+	const int stride = MeshBuilder::FLOATS_PER_VERTEX;
+	std::vector<int> remap(mesh.GetVertexCount(), -1);
+	std::vector<float> vertices;
+	int nextVertex = 0;
+
+	vertices.reserve(mesh.vertices.size());
+	for (int i = 0; i < (int)mesh.indices.size(); i++)
+	{
+		uint32_t index = mesh.indices[i];
+		if (remap[index] < 0)
+		{
+			remap[index] = nextVertex++;
+			vertices.insert(vertices.end(),
+				mesh.vertices.begin() + index * stride,
+				mesh.vertices.begin() + (index + 1) * stride);
+		}
+		mesh.indices[i] = (uint32_t)remap[index];
+	}
+
+	mesh.vertices.swap(vertices);
+}
+
+/***********************************************************
+ *  ComputeACMR()
+ *
+ *  This method is used to count the vertices a FIFO post-
+ *  transform cache would have to transform, per triangle.
+ *  1.0 or a little lower is typical for meshes in generation
+ *  order, and 0.5 is the ideal for a regular grid.
+ ***********************************************************/
+float MeshOptimizer::ComputeACMR(const uint32_t* pIndices, int indexCount, int vertexCount, int cacheSize)
+{
+	int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return(0.0f);
+	}
+
+	// a vertex is cached while fewer than cacheSize misses
+	// have happened since it was loaded
+	std::vector<int> loadedAt(vertexCount, -1);
+	int misses = 0;
+
+	for (int i = 0; i < triangleCount * 3; i++)
+	{
+		uint32_t index = pIndices[i];
+		if ((loadedAt[index] < 0) || (misses - loadedAt[index] >= cacheSize))
+		{
+			loadedAt[index] = misses;
+			misses++;
+		}
+	}
+
+	return((float)misses / (float)triangleCount);
+}
+
+/***********************************************************
+ *  Quantize()
+ *
+ *  This method is used to pack the vertices of a mesh.
+ *  Positions are stored relative to the center of the mesh
+ *  bounds and divided by the largest half extent, so one
+ *  uniform scale folded into the model matrix decodes them
+ *  and normals are not distorted.  Normals use 10 bits per
+ *  axis and texture coordinates 16 bits, clamped to [0, 1].
+ ***********************************************************/
+glm::mat4 MeshOptimizer::Quantize(
+	const MeshBuilder::MESH_DATA& mesh,
+	std::vector<QUANTIZED_VERTEX>& vertices)
+{
+	const int stride = MeshBuilder::FLOATS_PER_VERTEX;
+	int vertexCount = mesh.GetVertexCount();
+	glm::vec3 boundsMin(1e30f);
+	glm::vec3 boundsMax(-1e30f);
+
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const float* pVertex = &mesh.vertices[i * stride];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			boundsMin[axis] = std::min(boundsMin[axis], pVertex[axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], pVertex[axis]);
+		}
+	}
+
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float extent = 1e-6f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		extent = std::max(extent, (boundsMax[axis] - boundsMin[axis]) * 0.5f);
+	}
+	float inverseExtent = 1.0f / extent;
+
+	vertices.resize(vertexCount);
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const float* pVertex = &mesh.vertices[i * stride];
+		QUANTIZED_VERTEX& packed = vertices[i];
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			packed.position[axis] = (int16_t)PackSnorm((pVertex[axis] - center[axis]) * inverseExtent, 32767.0f);
+		}
+		packed.position[3] = 32767;
+
+		// x in the low bits, the two bit w is left at zero
+		uint32_t normal = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			normal |= ((uint32_t)PackSnorm(pVertex[3 + axis], 511.0f) & 0x3FFu) << (axis * 10);
+		}
+		packed.normal = normal;
+
+		for (int c = 0; c < 2; c++)
+		{
+			float value = std::min(1.0f, std::max(0.0f, pVertex[6 + c]));
+			packed.texCoord[c] = (uint16_t)std::floor(value * 65535.0f + 0.5f);
+		}
+	}
+
+	return(glm::translate(center) * glm::scale(glm::vec3(extent)));
+}
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.h
+// ============
+// reorder and quantize mesh data for faster vertex processing
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshBuilder.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  MeshOptimizer
+ *
+ *  This class holds the processing steps run on a mesh before
+ *  it is uploaded.  Triangles are reordered so recently
+ *  transformed vertices are reused from the post-transform
+ *  cache, vertices are then reordered into the order they are
+ *  first used so fetches walk memory forward, and finally the
+ *  attributes are packed from 32 to 16 bytes per vertex.
+ ***********************************************************/
+class MeshOptimizer
+{
+public:
+	// packed vertex, read by the vertex fetch as normalized
+	// integers so the shader still sees plain vec3/vec2 inputs
+	struct QUANTIZED_VERTEX
+	{
+		// snorm16 position in the mesh bounds, w is unused
+		int16_t position[4];
+		// snorm 2_10_10_10 normal
+		uint32_t normal;
+		// unorm16 texture coordinate
+		uint16_t texCoord[2];
+	};
+
+	// reorder the triangles of one index range for the vertex
+	// cache, using Tom Forsyth's linear-speed scoring
+	static void OptimizeVertexCache(uint32_t* pIndices, int indexCount, int vertexCount);
+	// reorder the vertices into first-use order and drop any
+	// that no index refers to
+	static void OptimizeVertexFetch(MeshBuilder::MESH_DATA& mesh);
+
+	// average cache miss ratio, transformed vertices per
+	// triangle for a FIFO cache of the given size
+	static float ComputeACMR(const uint32_t* pIndices, int indexCount, int vertexCount, int cacheSize = 16);
+
+	// pack the vertices of a mesh, the returned matrix maps the
+	// decoded positions back into object space
+	static glm::mat4 Quantize(
+		const MeshBuilder::MESH_DATA& mesh,
+		std::vector<QUANTIZED_VERTEX>& vertices);
+};
@@ -0,0 +1,356 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshstreamer.cpp
+// ============
+// build meshes in the background the first time they are drawn
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshStreamer.h"
+#include "RenderStats.h"
+
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// indices of the 12 edges of a box outline, two per line
+	const int g_PlaceholderIndexCount = 24;
+
+	/***********************************************************
+	 *  SetVertexLayout()
+	 *
+	 *  Describe the MeshBuilder vertex layout of position,
+	 *  normal and texture coordinate to the bound vertex array.
+	 ***********************************************************/
+	void SetVertexLayout()
+	{
+		const GLsizei stride = MeshBuilder::FLOATS_PER_VERTEX * sizeof(float);
+
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+	}
+}
+
+/***********************************************************
+ *  MeshStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshStreamer::MeshStreamer()
+{
+	m_stats.meshCount = 0;
+	m_stats.readyCount = 0;
+	m_stats.failedCount = 0;
+	m_stats.bytesUploaded = 0;
+	m_stats.placeholderDraws = 0;
+	m_stats.framesStreamed = 0;
+	m_bReported = false;
+	m_nextBuild = 0;
+	m_builtCount = 0;
+	m_bShutdown = false;
+
+	m_worker = std::thread(&MeshStreamer::BuildLoop, this);
+}
+
+/***********************************************************
+ *  ~MeshStreamer()
+ *
+ *  The destructor for the class.  A mesh being built is
+ *  finished before the worker stops.
+ ***********************************************************/
+MeshStreamer::~MeshStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bShutdown = true;
+	}
+	m_workCondition.notify_all();
+	m_worker.join();
+
+	for (int i = 0; i < (int)m_meshes.size(); i++)
+	{
+		delete m_meshes[i];
+	}
+	m_meshes.clear();
+}
+
+/***********************************************************
+ *  Request()
+ *
+ *  This method is used to get the handle of a mesh by name.
+ *  A name seen for the first time gets its placeholder and
+ *  is queued for the worker.
+ ***********************************************************/
+int MeshStreamer::Request(
+	const std::string& name,
+	const BUILD_FUNCTION& build,
+	const glm::vec3& boundsMin,
+	const glm::vec3& boundsMax)
+{
+	for (int i = 0; i < (int)m_meshes.size(); i++)
+	{
+		if (m_meshes[i]->name == name)
+		{
+			return(i);
+		}
+	}
+
+	STREAMED_MESH* pMesh = new STREAMED_MESH();
+	pMesh->name = name;
+	pMesh->build = build;
+	pMesh->bFailed = false;
+	pMesh->bReady = false;
+	CreatePlaceholder(*pMesh, boundsMin, boundsMax);
+
+	int handle = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		handle = (int)m_meshes.size();
+		m_meshes.push_back(pMesh);
+	}
+	m_workCondition.notify_one();
+
+	m_stats.meshCount++;
+	if (m_stats.meshCount == 1)
+	{
+		m_startTime = std::chrono::steady_clock::now();
+	}
+
+	return(handle);
+}
+
+/***********************************************************
+ *  CreatePlaceholder()
+ *
+ *  This method is used to create the outline of the bounds
+ *  of a mesh.  The corners are numbered by which of x, y and
+ *  z are at the maximum, and the index buffer joining them
+ *  is shared by every placeholder.
+ ***********************************************************/
+void MeshStreamer::CreatePlaceholder(STREAMED_MESH& mesh, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	if (m_placeholderIndexBuffer.Get() == 0)
+	{
+		GLuint indices[g_PlaceholderIndexCount];
+		int count = 0;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			for (int axis = 1; axis < 8; axis <<= 1)
+			{
+				if ((corner & axis) == 0)
+				{
+					indices[count++] = corner;
+					indices[count++] = corner | axis;
+				}
+			}
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_placeholderIndexBuffer.Create("mesh placeholder indices"));
+		glBufferData(GL_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+		m_placeholderIndexBuffer.SetBytes(sizeof(indices));
+	}
+
+	float vertices[8 * MeshBuilder::FLOATS_PER_VERTEX] = {};
+	for (int corner = 0; corner < 8; corner++)
+	{
+		float* pVertex = &vertices[corner * MeshBuilder::FLOATS_PER_VERTEX];
+		pVertex[0] = (corner & 1) ? boundsMax.x : boundsMin.x;
+		pVertex[1] = (corner & 2) ? boundsMax.y : boundsMin.y;
+		pVertex[2] = (corner & 4) ? boundsMax.z : boundsMin.z;
+		// lit as if facing up
+		pVertex[4] = 1.0f;
+	}
+
+	glBindVertexArray(mesh.placeholderArray.Create(mesh.name + " placeholder"));
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.placeholderBuffer.Create(mesh.name + " placeholder"));
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	mesh.placeholderBuffer.SetBytes(sizeof(vertices));
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_placeholderIndexBuffer.Get());
+	SetVertexLayout();
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used to upload the meshes the worker has
+ *  built since the previous frame.  Meshes are small next
+ *  to textures, so all of them are uploaded at once.
+ ***********************************************************/
+void MeshStreamer::Update()
+{
+	std::vector<STREAMED_MESH*> built;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		built.swap(m_builtMeshes);
+	}
+
+	for (int i = 0; i < (int)built.size(); i++)
+	{
+		STREAMED_MESH& mesh = *built[i];
+		if (mesh.bFailed)
+		{
+			// the placeholder stays to show what is missing
+			std::cout << "ERROR: could not build mesh " << mesh.name << std::endl;
+			m_stats.failedCount++;
+		}
+		else
+		{
+			UploadMesh(mesh);
+			m_stats.readyCount++;
+		}
+	}
+
+	// frames that uploaded a mesh or still drew a placeholder
+	if ((built.empty() == false) || (IsComplete() == false))
+	{
+		m_stats.framesStreamed++;
+	}
+
+	if ((m_stats.meshCount > 0) && IsComplete() && (m_bReported == false))
+	{
+		double milliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - m_startTime).count();
+		std::cout << "Mesh streaming complete: " << m_stats.readyCount << " meshes, "
+			<< m_stats.bytesUploaded / 1024.0 << " KB in " << m_stats.framesStreamed << " frames, "
+			<< milliseconds << " ms after the first request, " << m_stats.placeholderDraws
+			<< " placeholder draws" << std::endl;
+		m_bReported = true;
+	}
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used to wait for the worker to build every
+ *  requested mesh and upload the results, for runs that
+ *  must not see any placeholders.
+ ***********************************************************/
+void MeshStreamer::Finish()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_builtCondition.wait(lock, [this]() { return(m_builtCount == (int)m_meshes.size()); });
+	}
+
+	Update();
+}
+
+/***********************************************************
+ *  UploadMesh()
+ *
+ *  This method is used to copy a built mesh into buffers of
+ *  its own and free the CPU copy and the placeholder.
+ ***********************************************************/
+void MeshStreamer::UploadMesh(STREAMED_MESH& mesh)
+{
+	size_t vertexBytes = mesh.data.vertices.size() * sizeof(float);
+	size_t indexBytes = mesh.data.indices.size() * sizeof(uint32_t);
+
+	glBindVertexArray(mesh.vertexArray.Create(mesh.name));
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer.Create(mesh.name + " vertices"));
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, mesh.data.vertices.data(), GL_STATIC_DRAW);
+	mesh.vertexBuffer.SetBytes(vertexBytes);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer.Create(mesh.name + " indices"));
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, mesh.data.indices.data(), GL_STATIC_DRAW);
+	mesh.indexBuffer.SetBytes(indexBytes);
+
+	SetVertexLayout();
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	RenderStats::Count(RenderStats::COUNTER_UPLOAD_BYTES, vertexBytes + indexBytes);
+	m_stats.bytesUploaded += vertexBytes + indexBytes;
+
+	mesh.parts = mesh.data.parts;
+	mesh.data = MeshBuilder::MESH_DATA();
+	mesh.placeholderArray.Reset();
+	mesh.placeholderBuffer.Reset();
+	mesh.bReady = true;
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used to draw the selected parts of a mesh
+ *  out of its buffers, or the outline of its bounds while it
+ *  isn't ready.
+ ***********************************************************/
+void MeshStreamer::Draw(int handle, unsigned int meshParts)
+{
+	STREAMED_MESH& mesh = *m_meshes[handle];
+
+	if (mesh.bReady == false)
+	{
+		glBindVertexArray(mesh.placeholderArray.Get());
+		glDrawElements(GL_LINES, g_PlaceholderIndexCount, GL_UNSIGNED_INT, (void*)0);
+		glBindVertexArray(0);
+		RenderStats::CountDraw(0);
+		RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+		m_stats.placeholderDraws++;
+		return;
+	}
+
+	glBindVertexArray(mesh.vertexArray.Get());
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+	for (int p = 0; p < (int)mesh.parts.size(); p++)
+	{
+		const MeshBuilder::MESH_PART& part = mesh.parts[p];
+		if ((part.flags & meshParts) != 0)
+		{
+			glDrawElements(GL_TRIANGLES, part.indexCount, GL_UNSIGNED_INT,
+				(void*)(part.firstIndex * sizeof(uint32_t)));
+			RenderStats::CountDraw(part.indexCount / 3);
+		}
+	}
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  BuildLoop()
+ *
+ *  This method is the body of the building thread.  It takes
+ *  the meshes in the order they were requested and builds
+ *  each without holding the lock.
+ ***********************************************************/
+void MeshStreamer::BuildLoop()
+{
+	while (true)
+	{
+		STREAMED_MESH* pNext = NULL;
+		BUILD_FUNCTION build;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_workCondition.wait(lock, [this]()
+				{
+					return(m_bShutdown || (m_nextBuild < (int)m_meshes.size()));
+				});
+			if (m_bShutdown)
+			{
+				return;
+			}
+			pNext = m_meshes[m_nextBuild++];
+			build = pNext->build;
+		}
+
+		MeshBuilder::MESH_DATA data;
+		bool bBuilt = build(data) && (data.indices.empty() == false);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			pNext->data = std::move(data);
+			pNext->bFailed = (bBuilt == false);
+			m_builtMeshes.push_back(pNext);
+			m_builtCount++;
+		}
+		m_builtCondition.notify_all();
+	}
+}
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshstreamer.h
+// ============
+// build meshes in the background the first time they are drawn
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GpuResources.h"
+#include "MeshBuilder.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  MeshStreamer
+ *
+ *  This class hands out a handle for each mesh as it is
+ *  requested, and generates or loads the mesh on a worker
+ *  thread instead of at startup.  Each frame, the meshes the
+ *  worker finished are uploaded into buffers of their own.
+ *  Until then, drawing a handle draws the outline of the
+ *  mesh's bounding box, so the scene shows up at once and
+ *  fills in as the meshes arrive.  Vertices use the layout
+ *  of MeshBuilder, so the scene shaders draw them unchanged.
+ *  Everything but the building runs on the GL thread.
+ ***********************************************************/
+class MeshStreamer
+{
+public:
+	// fills in a mesh on the worker thread, false on failure
+	typedef std::function<bool(MeshBuilder::MESH_DATA& mesh)> BUILD_FUNCTION;
+
+	// progress counters
+	struct STREAM_STATS
+	{
+		int meshCount;
+		int readyCount;
+		int failedCount;
+		size_t bytesUploaded;
+		int placeholderDraws;
+		int framesStreamed;
+	};
+
+	// constructor
+	MeshStreamer();
+	// destructor
+	~MeshStreamer();
+
+	// get the handle of a mesh, queueing it to be built the
+	// first time its name is requested; the bounds size the
+	// placeholder drawn until it is ready
+	int Request(
+		const std::string& name,
+		const BUILD_FUNCTION& build,
+		const glm::vec3& boundsMin,
+		const glm::vec3& boundsMax);
+	// upload the meshes the worker has finished, called once
+	// per frame
+	void Update();
+	// block until every requested mesh is built and uploaded
+	void Finish();
+
+	// draw the selected parts of a mesh, or its placeholder
+	void Draw(int handle, unsigned int meshParts);
+	bool IsReady(int handle) const { return(m_meshes[handle]->bReady); }
+
+	// true once every requested mesh was built or failed
+	bool IsComplete() const { return(m_stats.readyCount + m_stats.failedCount == m_stats.meshCount); }
+	const STREAM_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// one requested mesh
+	struct STREAMED_MESH
+	{
+		std::string name;
+		BUILD_FUNCTION build;
+		// written by the worker, read once the mesh is queued
+		// in m_builtMeshes
+		MeshBuilder::MESH_DATA data;
+		bool bFailed;
+		// set once the buffers hold the mesh
+		bool bReady;
+		std::vector<MeshBuilder::MESH_PART> parts;
+		GLVertexArray vertexArray;
+		GLBuffer vertexBuffer;
+		GLBuffer indexBuffer;
+		// bounding box outline drawn until the mesh is ready
+		GLVertexArray placeholderArray;
+		GLBuffer placeholderBuffer;
+	};
+
+	std::vector<STREAMED_MESH*> m_meshes;
+	STREAM_STATS m_stats;
+	std::chrono::steady_clock::time_point m_startTime;
+	bool m_bReported;
+	// line indices of a box outline, shared by the placeholders
+	GLBuffer m_placeholderIndexBuffer;
+
+	// background building
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_workCondition;
+	std::condition_variable m_builtCondition;
+	// next mesh for the worker, in request order
+	int m_nextBuild;
+	// meshes built so far, and those not yet uploaded
+	int m_builtCount;
+	std::vector<STREAMED_MESH*> m_builtMeshes;
+	bool m_bShutdown;
+
+	// create the outline of the bounds of a mesh
+	void CreatePlaceholder(STREAMED_MESH& mesh, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// upload a built mesh into its buffers
+	void UploadMesh(STREAMED_MESH& mesh);
+	// body of the building thread
+	void BuildLoop();
+};
@@ -0,0 +1,1877 @@
+///////////////////////////////////////////////////////////////////////////////
+// modelimporter.cpp
+// ============
+// read OBJ and glTF models into the vertex layout of the basic shapes
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ModelImporter.h"
+#include "MappedFile.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// declaration of global variables
+namespace
+{
+	// bytes of OBJ text parsed by each task, ended at the next
+	// line break
+	const size_t g_ObjChunkBytes = 1024 * 1024;
+	// deepest nesting of JSON values and of glTF nodes read
+	const int g_MaxNesting = 64;
+	// GLB header and chunk identifiers
+	const uint32_t g_GlbMagic = 0x46546C67;
+	const uint32_t g_GlbJsonChunk = 0x4E4F534A;
+	const uint32_t g_GlbBinaryChunk = 0x004E4942;
+	// glTF accessor component types and the triangle list mode
+	const int g_GltfByte = 5120;
+	const int g_GltfUnsignedByte = 5121;
+	const int g_GltfShort = 5122;
+	const int g_GltfUnsignedShort = 5123;
+	const int g_GltfUnsignedInt = 5125;
+	const int g_GltfFloat = 5126;
+	const int g_GltfTriangles = 4;
+
+	// powers of ten a parsed decimal is scaled by exactly
+	const double g_PowersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const int g_MaxExactPower = 22;
+
+	// vertices and indices converted by one task, copied into
+	// the mesh once every task is done
+	struct MESH_PIECE
+	{
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		// vertices whose normal is computed from the triangles
+		std::vector<uint8_t> missingNormals;
+		size_t firstVertex;
+		size_t firstIndex;
+		int mergedCount;
+		int skippedCount;
+		bool bValid;
+	};
+
+	/***********************************************************
+	 *  VertexTable
+	 *
+	 *  Open addressing hash table from a key of a fixed number
+	 *  of 32-bit words to the index of the vertex made from it.
+	 *  It doubles when half full, so a lookup touches only a
+	 *  few neighboring slots.
+	 ***********************************************************/
+	template <int WORD_COUNT>
+	class VertexTable
+	{
+	public:
+		VertexTable(size_t expectedCount)
+		{
+			size_t capacity = 64;
+			while (capacity < expectedCount * 2)
+			{
+				capacity *= 2;
+			}
+			m_keys.resize(capacity * WORD_COUNT);
+			m_values.assign(capacity, -1);
+			m_count = 0;
+		}
+
+		// index stored for the key, or newIndex after storing it
+		int Insert(const uint32_t* pKey, int newIndex)
+		{
+			if ((m_count + 1) * 2 > m_values.size())
+			{
+				Grow();
+			}
+
+			size_t mask = m_values.size() - 1;
+			size_t slot = Hash(pKey) & mask;
+			while (m_values[slot] >= 0)
+			{
+				if (memcmp(&m_keys[slot * WORD_COUNT], pKey, WORD_COUNT * sizeof(uint32_t)) == 0)
+				{
+					return(m_values[slot]);
+				}
+				slot = (slot + 1) & mask;
+			}
+
+			memcpy(&m_keys[slot * WORD_COUNT], pKey, WORD_COUNT * sizeof(uint32_t));
+			m_values[slot] = newIndex;
+			m_count++;
+
+			return(newIndex);
+		}
+
+	private:
+		std::vector<uint32_t> m_keys;
+		// -1 for an empty slot
+		std::vector<int> m_values;
+		size_t m_count;
+
+		static size_t Hash(const uint32_t* pKey)
+		{
+			uint64_t hash = 0x9E3779B97F4A7C15ull;
+			for (int i = 0; i < WORD_COUNT; i++)
+			{
+				hash = (hash ^ pKey[i]) * 0xFF51AFD7ED558CCDull;
+				hash ^= hash >> 32;
+			}
+			return((size_t)hash);
+		}
+
+		void Grow()
+		{
+			std::vector<uint32_t> keys;
+			std::vector<int> values;
+			keys.swap(m_keys);
+			values.swap(m_values);
+
+			m_keys.resize(keys.size() * 2);
+			m_values.assign(values.size() * 2, -1);
+			m_count = 0;
+			for (size_t slot = 0; slot < values.size(); slot++)
+			{
+				if (values[slot] >= 0)
+				{
+					Insert(&keys[slot * WORD_COUNT], values[slot]);
+				}
+			}
+		}
+	};
+
+	/***********************************************************
+	 *  RunParallel()
+	 *
+	 *  Run a task for every index on the thread pool, or on the
+	 *  calling thread when there is none.
+	 ***********************************************************/
+	void RunParallel(ThreadPool* pThreadPool, int count, const ThreadPool::PARALLEL_TASK& task)
+	{
+		if (pThreadPool != NULL)
+		{
+			pThreadPool->ParallelFor(count, task);
+			return;
+		}
+		for (int i = 0; i < count; i++)
+		{
+			task(i, 0);
+		}
+	}
+
+	/***********************************************************
+	 *  AddVertex()
+	 *
+	 *  Append a vertex of a piece in the MeshBuilder layout.
+	 ***********************************************************/
+	void AddVertex(MESH_PIECE& piece, const glm::vec3& position, const glm::vec3& normal, float u, float v, bool bMissingNormal)
+	{
+		const float vertex[MeshBuilder::FLOATS_PER_VERTEX] =
+		{
+			position.x, position.y, position.z, normal.x, normal.y, normal.z, u, v
+		};
+		piece.vertices.insert(piece.vertices.end(), vertex, vertex + MeshBuilder::FLOATS_PER_VERTEX);
+		piece.missingNormals.push_back(bMissingNormal ? 1 : 0);
+	}
+
+	/***********************************************************
+	 *  GenerateNormals()
+	 *
+	 *  Give the vertices of a piece without a normal the
+	 *  average of the normals of their triangles, weighted by
+	 *  area.  Welded vertices come out smooth.
+	 ***********************************************************/
+	void GenerateNormals(MESH_PIECE& piece)
+	{
+		if (std::find(piece.missingNormals.begin(), piece.missingNormals.end(), 1) == piece.missingNormals.end())
+		{
+			return;
+		}
+
+		float* pVertices = piece.vertices.data();
+		for (size_t i = 0; i + 2 < piece.indices.size(); i += 3)
+		{
+			float* pCorners[3];
+			for (int c = 0; c < 3; c++)
+			{
+				pCorners[c] = pVertices + piece.indices[i + c] * MeshBuilder::FLOATS_PER_VERTEX;
+			}
+			glm::vec3 a(pCorners[0][0], pCorners[0][1], pCorners[0][2]);
+			glm::vec3 b(pCorners[1][0], pCorners[1][1], pCorners[1][2]);
+			glm::vec3 c(pCorners[2][0], pCorners[2][1], pCorners[2][2]);
+			glm::vec3 faceNormal = glm::cross(b - a, c - a);
+			for (int corner = 0; corner < 3; corner++)
+			{
+				if (piece.missingNormals[piece.indices[i + corner]] != 0)
+				{
+					pCorners[corner][3] += faceNormal.x;
+					pCorners[corner][4] += faceNormal.y;
+					pCorners[corner][5] += faceNormal.z;
+				}
+			}
+		}
+
+		for (size_t v = 0; v < piece.missingNormals.size(); v++)
+		{
+			if (piece.missingNormals[v] != 0)
+			{
+				float* pNormal = pVertices + v * MeshBuilder::FLOATS_PER_VERTEX + 3;
+				float length = std::sqrt(pNormal[0] * pNormal[0] + pNormal[1] * pNormal[1] + pNormal[2] * pNormal[2]);
+				if (length > 0.0f)
+				{
+					pNormal[0] /= length;
+					pNormal[1] /= length;
+					pNormal[2] /= length;
+				}
+				else
+				{
+					// a vertex of degenerate triangles only
+					pNormal[1] = 1.0f;
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  JoinPieces()
+	 *
+	 *  Copy the vertices and indices of every piece into the
+	 *  mesh as a single part, each piece writing its own range
+	 *  in parallel.
+	 ***********************************************************/
+	void JoinPieces(std::vector<MESH_PIECE>& pieces, ThreadPool* pThreadPool, MeshBuilder::MESH_DATA& mesh)
+	{
+		size_t vertexFloats = 0;
+		size_t indexCount = 0;
+		for (int i = 0; i < (int)pieces.size(); i++)
+		{
+			pieces[i].firstVertex = vertexFloats / MeshBuilder::FLOATS_PER_VERTEX;
+			pieces[i].firstIndex = indexCount;
+			vertexFloats += pieces[i].vertices.size();
+			indexCount += pieces[i].indices.size();
+		}
+
+		mesh = MeshBuilder::MESH_DATA();
+		mesh.vertices.resize(vertexFloats);
+		mesh.indices.resize(indexCount);
+		RunParallel(pThreadPool, (int)pieces.size(),
+			[&pieces, &mesh](int index, int)
+			{
+				MESH_PIECE& piece = pieces[index];
+				if (piece.vertices.empty() == false)
+				{
+					memcpy(&mesh.vertices[piece.firstVertex * MeshBuilder::FLOATS_PER_VERTEX],
+						piece.vertices.data(), piece.vertices.size() * sizeof(float));
+				}
+				for (size_t i = 0; i < piece.indices.size(); i++)
+				{
+					mesh.indices[piece.firstIndex + i] = piece.indices[i] + (uint32_t)piece.firstVertex;
+				}
+				// the piece is done with, free it while the others
+				// are still copied
+				std::vector<float>().swap(piece.vertices);
+				std::vector<uint32_t>().swap(piece.indices);
+			});
+
+		MeshBuilder::MESH_PART part;
+		part.flags = RenderQueue::MESH_PART_ALL;
+		part.firstIndex = 0;
+		part.indexCount = (int)indexCount;
+		mesh.parts.push_back(part);
+	}
+
+	/***********************************************************
+	 *  IsSpace()
+	 *
+	 *  True for the blanks separating the values of a line.
+	 ***********************************************************/
+	inline bool IsSpace(char c)
+	{
+		return((c == ' ') || (c == '\t') || (c == '\r'));
+	}
+
+	/***********************************************************
+	 *  SkipSpaces()
+	 *
+	 *  Step over blanks, stopping at the end of the text.
+	 ***********************************************************/
+	inline const char* SkipSpaces(const char* p, const char* pEnd)
+	{
+		while ((p < pEnd) && IsSpace(*p))
+		{
+			p++;
+		}
+		return(p);
+	}
+
+	/***********************************************************
+	 *  IsKeyword()
+	 *
+	 *  True if a line starts with the keyword followed by a
+	 *  blank.
+	 ***********************************************************/
+	inline bool IsKeyword(const char* p, const char* pEnd, const char* keyword)
+	{
+		while (*keyword != '\0')
+		{
+			if ((p >= pEnd) || (*p != *keyword))
+			{
+				return(false);
+			}
+			p++;
+			keyword++;
+		}
+		return((p < pEnd) && IsSpace(*p));
+	}
+
+	/***********************************************************
+	 *  ParseFloat()
+	 *
+	 *  Read a decimal number, stepping past it.  Up to 19
+	 *  significant digits are gathered as an integer and scaled
+	 *  once by a power of ten, which is exact for the numbers
+	 *  model files hold, without the locale handling and
+	 *  rounding of strtod().  False if there are no digits.
+	 ***********************************************************/
+	bool ParseFloat(const char*& p, const char* pEnd, float& value)
+	{
+		const char* pStart = p;
+		bool bNegative = false;
+		uint64_t mantissa = 0;
+		int significantDigits = 0;
+		int exponent = 0;
+		bool bDigits = false;
+
+		if ((p < pEnd) && ((*p == '-') || (*p == '+')))
+		{
+			bNegative = (*p == '-');
+			p++;
+		}
+		for (; (p < pEnd) && (*p >= '0') && (*p <= '9'); p++)
+		{
+			bDigits = true;
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				significantDigits += (mantissa != 0) ? 1 : 0;
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+		if ((p < pEnd) && (*p == '.'))
+		{
+			for (p++; (p < pEnd) && (*p >= '0') && (*p <= '9'); p++)
+			{
+				bDigits = true;
+				if (significantDigits < 19)
+				{
+					mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+					significantDigits += (mantissa != 0) ? 1 : 0;
+					exponent--;
+				}
+			}
+		}
+		if (bDigits == false)
+		{
+			p = pStart;
+			return(false);
+		}
+		if ((p < pEnd) && ((*p == 'e') || (*p == 'E')))
+		{
+			const char* pExponent = p + 1;
+			bool bNegativeExponent = false;
+			if ((pExponent < pEnd) && ((*pExponent == '-') || (*pExponent == '+')))
+			{
+				bNegativeExponent = (*pExponent == '-');
+				pExponent++;
+			}
+			if ((pExponent < pEnd) && (*pExponent >= '0') && (*pExponent <= '9'))
+			{
+				int written = 0;
+				for (; (pExponent < pEnd) && (*pExponent >= '0') && (*pExponent <= '9'); pExponent++)
+				{
+					written = std::min(written * 10 + (*pExponent - '0'), 10000);
+				}
+				exponent += bNegativeExponent ? -written : written;
+				p = pExponent;
+			}
+		}
+
+		double result = (double)mantissa;
+		if (mantissa != 0)
+		{
+			if ((exponent >= -g_MaxExactPower) && (exponent < 0))
+			{
+				result /= g_PowersOfTen[-exponent];
+			}
+			else if ((exponent > 0) && (exponent <= g_MaxExactPower))
+			{
+				result *= g_PowersOfTen[exponent];
+			}
+			else if (exponent != 0)
+			{
+				result *= std::pow(10.0, (double)exponent);
+			}
+		}
+		value = (float)(bNegative ? -result : result);
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ParseInt()
+	 *
+	 *  Read a whole number, stepping past it.  False if there
+	 *  are no digits.
+	 ***********************************************************/
+	bool ParseInt(const char*& p, const char* pEnd, int& value)
+	{
+		const char* pStart = p;
+		bool bNegative = false;
+		int64_t result = 0;
+
+		if ((p < pEnd) && ((*p == '-') || (*p == '+')))
+		{
+			bNegative = (*p == '-');
+			p++;
+		}
+		const char* pDigits = p;
+		for (; (p < pEnd) && (*p >= '0') && (*p <= '9'); p++)
+		{
+			result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX);
+		}
+		if (p == pDigits)
+		{
+			p = pStart;
+			return(false);
+		}
+		value = (int)(bNegative ? -result : result);
+
+		return(true);
+	}
+
+	// one chunk of OBJ text and what it holds
+	struct OBJ_CHUNK
+	{
+		const char* pBegin;
+		const char* pEnd;
+		std::vector<float> positions;
+		std::vector<float> texCoords;
+		std::vector<float> normals;
+		// three corners per triangle, each the 0-based position,
+		// texture coordinate and normal, -1 for none
+		std::vector<int> corners;
+		// entries of corners counted from the end of the lists
+		// so far, made absolute once the chunks before are known
+		std::vector<size_t> relativeCorners;
+		// first position, texture coordinate and normal of the
+		// chunk in the whole file
+		int firstPosition;
+		int firstTexCoord;
+		int firstNormal;
+		MESH_PIECE piece;
+	};
+
+	/***********************************************************
+	 *  ParseObjFace()
+	 *
+	 *  Read the corners of a face line and add it as a fan of
+	 *  triangles.  Corners are written p, p/t, p/t/n or p//n,
+	 *  with negative indices counting back from the last one.
+	 ***********************************************************/
+	bool ParseObjFace(OBJ_CHUNK& chunk, const char* p, const char* pEnd)
+	{
+		const int counts[3] =
+		{
+			(int)chunk.positions.size() / 3,
+			(int)chunk.texCoords.size() / 2,
+			(int)chunk.normals.size() / 3
+		};
+		int first[3] = { -1, -1, -1 };
+		int firstRelative = 0;
+		int previous[3] = { -1, -1, -1 };
+		int previousRelative = 0;
+		int cornerCount = 0;
+
+		while (true)
+		{
+			p = SkipSpaces(p, pEnd);
+			if ((p >= pEnd) || (*p == '\n') || (*p == '#'))
+			{
+				break;
+			}
+
+			int corner[3] = { -1, -1, -1 };
+			int relative = 0;
+			for (int component = 0; component < 3; component++)
+			{
+				if (component > 0)
+				{
+					if ((p >= pEnd) || (*p != '/'))
+					{
+						break;
+					}
+					p++;
+					// p//n leaves out the texture coordinate
+					if ((component == 1) && (p < pEnd) && (*p == '/'))
+					{
+						continue;
+					}
+				}
+
+				int index = 0;
+				if ((ParseInt(p, pEnd, index) == false) || (index == 0))
+				{
+					return(false);
+				}
+				if (index > 0)
+				{
+					corner[component] = index - 1;
+				}
+				else
+				{
+					corner[component] = counts[component] + index;
+					relative |= 1 << component;
+				}
+			}
+			if ((p < pEnd) && (IsSpace(*p) == false) && (*p != '\n'))
+			{
+				return(false);
+			}
+
+			cornerCount++;
+			if (cornerCount == 1)
+			{
+				std::copy(corner, corner + 3, first);
+				firstRelative = relative;
+			}
+			else if (cornerCount >= 3)
+			{
+				const int* pCorners[3] = { first, previous, corner };
+				const int relatives[3] = { firstRelative, previousRelative, relative };
+				for (int c = 0; c < 3; c++)
+				{
+					for (int component = 0; component < 3; component++)
+					{
+						if ((relatives[c] & (1 << component)) != 0)
+						{
+							chunk.relativeCorners.push_back(chunk.corners.size());
+						}
+						chunk.corners.push_back(pCorners[c][component]);
+					}
+				}
+			}
+			std::copy(corner, corner + 3, previous);
+			previousRelative = relative;
+		}
+
+		return(cornerCount >= 3);
+	}
+
+	/***********************************************************
+	 *  ParseObjChunk()
+	 *
+	 *  Read the vertex data and faces of a chunk of OBJ text.
+	 *  Lines of other kinds, such as groups and materials, are
+	 *  passed over.
+	 ***********************************************************/
+	void ParseObjChunk(OBJ_CHUNK& chunk)
+	{
+		const char* p = chunk.pBegin;
+
+		while (p < chunk.pEnd)
+		{
+			const char* pLineEnd = (const char*)memchr(p, '\n', chunk.pEnd - p);
+			pLineEnd = (pLineEnd != NULL) ? pLineEnd + 1 : chunk.pEnd;
+			p = SkipSpaces(p, pLineEnd);
+
+			bool bValid = true;
+			float values[3];
+			if (IsKeyword(p, pLineEnd, "v"))
+			{
+				p++;
+				for (int i = 0; bValid && (i < 3); i++)
+				{
+					p = SkipSpaces(p, pLineEnd);
+					bValid = ParseFloat(p, pLineEnd, values[i]);
+				}
+				if (bValid)
+				{
+					chunk.positions.insert(chunk.positions.end(), values, values + 3);
+				}
+			}
+			else if (IsKeyword(p, pLineEnd, "vt"))
+			{
+				p += 2;
+				for (int i = 0; bValid && (i < 2); i++)
+				{
+					p = SkipSpaces(p, pLineEnd);
+					bValid = ParseFloat(p, pLineEnd, values[i]);
+				}
+				if (bValid)
+				{
+					chunk.texCoords.insert(chunk.texCoords.end(), values, values + 2);
+				}
+			}
+			else if (IsKeyword(p, pLineEnd, "vn"))
+			{
+				p += 2;
+				for (int i = 0; bValid && (i < 3); i++)
+				{
+					p = SkipSpaces(p, pLineEnd);
+					bValid = ParseFloat(p, pLineEnd, values[i]);
+				}
+				if (bValid)
+				{
+					chunk.normals.insert(chunk.normals.end(), values, values + 3);
+				}
+			}
+			else if (IsKeyword(p, pLineEnd, "f"))
+			{
+				size_t cornerCount = chunk.corners.size();
+				size_t relativeCount = chunk.relativeCorners.size();
+				bValid = ParseObjFace(chunk, p + 1, pLineEnd);
+				if (bValid == false)
+				{
+					chunk.corners.resize(cornerCount);
+					chunk.relativeCorners.resize(relativeCount);
+				}
+			}
+
+			if (bValid == false)
+			{
+				chunk.piece.skippedCount++;
+			}
+			p = pLineEnd;
+		}
+	}
+
+	/***********************************************************
+	 *  BuildObjChunk()
+	 *
+	 *  Make the vertices of the corners of a chunk, merging the
+	 *  corners with the same position, texture coordinate and
+	 *  normal.  The indices must already be absolute.
+	 ***********************************************************/
+	void BuildObjChunk(
+		OBJ_CHUNK& chunk,
+		const std::vector<float>& positions,
+		const std::vector<float>& texCoords,
+		const std::vector<float>& normals)
+	{
+		MESH_PIECE& piece = chunk.piece;
+		const int limits[3] =
+		{
+			(int)positions.size() / 3,
+			(int)texCoords.size() / 2,
+			(int)normals.size() / 3
+		};
+
+		VertexTable<3> table(chunk.corners.size() / 6);
+		piece.indices.reserve(chunk.corners.size() / 3);
+		for (size_t c = 0; c < chunk.corners.size(); c += 3)
+		{
+			const int* pCorner = &chunk.corners[c];
+			for (int component = 0; component < 3; component++)
+			{
+				if ((pCorner[component] >= limits[component]) ||
+					((pCorner[component] < 0) && ((component == 0) || (pCorner[component] != -1))))
+				{
+					piece.bValid = false;
+					return;
+				}
+			}
+
+			int vertexCount = (int)piece.missingNormals.size();
+			int vertex = table.Insert((const uint32_t*)pCorner, vertexCount);
+			if (vertex == vertexCount)
+			{
+				const float* pPosition = &positions[pCorner[0] * 3];
+				glm::vec3 normal(0.0f);
+				float u = 0.0f;
+				float v = 0.0f;
+				if (pCorner[1] >= 0)
+				{
+					u = texCoords[pCorner[1] * 2];
+					v = texCoords[pCorner[1] * 2 + 1];
+				}
+				if (pCorner[2] >= 0)
+				{
+					normal = glm::vec3(normals[pCorner[2] * 3], normals[pCorner[2] * 3 + 1], normals[pCorner[2] * 3 + 2]);
+				}
+				AddVertex(piece, glm::vec3(pPosition[0], pPosition[1], pPosition[2]), normal, u, v, pCorner[2] < 0);
+			}
+			else
+			{
+				piece.mergedCount++;
+			}
+			piece.indices.push_back((uint32_t)vertex);
+		}
+		std::vector<int>().swap(chunk.corners);
+
+		GenerateNormals(piece);
+	}
+
+	// a parsed JSON value
+	struct JSON_VALUE
+	{
+		enum TYPE
+		{
+			JSON_NULL,
+			JSON_BOOL,
+			JSON_NUMBER,
+			JSON_STRING,
+			JSON_ARRAY,
+			JSON_OBJECT
+		};
+
+		TYPE type;
+		double number;
+		std::string text;
+		// elements of an array or member values of an object
+		std::vector<JSON_VALUE> items;
+		// member names of an object, in step with items
+		std::vector<std::string> keys;
+
+		JSON_VALUE() : type(JSON_NULL), number(0.0) {}
+
+		// member of an object, NULL if there is none
+		const JSON_VALUE* Find(const char* key) const
+		{
+			for (int i = 0; i < (int)keys.size(); i++)
+			{
+				if (keys[i] == key)
+				{
+					return(&items[i]);
+				}
+			}
+			return(NULL);
+		}
+		// element of an array, NULL if out of range
+		const JSON_VALUE* At(int index) const
+		{
+			if ((type != JSON_ARRAY) || (index < 0) || (index >= (int)items.size()))
+			{
+				return(NULL);
+			}
+			return(&items[index]);
+		}
+		// number member of an object, or the default
+		double GetNumber(const char* key, double defaultValue) const
+		{
+			const JSON_VALUE* pValue = Find(key);
+			return(((pValue != NULL) && (pValue->type == JSON_NUMBER)) ? pValue->number : defaultValue);
+		}
+		int GetInt(const char* key, int defaultValue) const
+		{
+			return((int)GetNumber(key, defaultValue));
+		}
+	};
+
+	/***********************************************************
+	 *  JsonParser
+	 *
+	 *  Recursive descent parser for the JSON of a glTF file.
+	 ***********************************************************/
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* pText, size_t size) : m_p(pText), m_pEnd(pText + size) {}
+
+		// parse the whole text as one value
+		bool Parse(JSON_VALUE& value)
+		{
+			if (ParseValue(value, 0) == false)
+			{
+				return(false);
+			}
+			SkipWhitespace();
+			// GLB pads its JSON chunk with spaces, and may end
+			// it with zeros
+			while ((m_p < m_pEnd) && (*m_p == '\0'))
+			{
+				m_p++;
+			}
+			return(m_p == m_pEnd);
+		}
+
+	private:
+		const char* m_p;
+		const char* m_pEnd;
+
+		void SkipWhitespace()
+		{
+			while ((m_p < m_pEnd) && ((*m_p == ' ') || (*m_p == '\t') || (*m_p == '\n') || (*m_p == '\r')))
+			{
+				m_p++;
+			}
+		}
+
+		bool Match(const char* literal)
+		{
+			size_t length = strlen(literal);
+			if (((size_t)(m_pEnd - m_p) < length) || (memcmp(m_p, literal, length) != 0))
+			{
+				return(false);
+			}
+			m_p += length;
+			return(true);
+		}
+
+		bool ParseValue(JSON_VALUE& value, int depth)
+		{
+			SkipWhitespace();
+			if ((m_p >= m_pEnd) || (depth > g_MaxNesting))
+			{
+				return(false);
+			}
+
+			switch (*m_p)
+			{
+			case '{':
+				return(ParseObject(value, depth));
+			case '[':
+				return(ParseArray(value, depth));
+			case '"':
+				value.type = JSON_VALUE::JSON_STRING;
+				return(ParseString(value.text));
+			case 't':
+				value.type = JSON_VALUE::JSON_BOOL;
+				value.number = 1.0;
+				return(Match("true"));
+			case 'f':
+				value.type = JSON_VALUE::JSON_BOOL;
+				return(Match("false"));
+			case 'n':
+				return(Match("null"));
+			default:
+				return(ParseNumber(value));
+			}
+		}
+
+		bool ParseObject(JSON_VALUE& value, int depth)
+		{
+			value.type = JSON_VALUE::JSON_OBJECT;
+			m_p++;
+			SkipWhitespace();
+			if ((m_p < m_pEnd) && (*m_p == '}'))
+			{
+				m_p++;
+				return(true);
+			}
+
+			while (true)
+			{
+				std::string key;
+				SkipWhitespace();
+				if ((m_p >= m_pEnd) || (*m_p != '"') || (ParseString(key) == false))
+				{
+					return(false);
+				}
+				SkipWhitespace();
+				if ((m_p >= m_pEnd) || (*m_p != ':'))
+				{
+					return(false);
+				}
+				m_p++;
+
+				value.keys.push_back(key);
+				value.items.push_back(JSON_VALUE());
+				if (ParseValue(value.items.back(), depth + 1) == false)
+				{
+					return(false);
+				}
+
+				SkipWhitespace();
+				if ((m_p < m_pEnd) && (*m_p == ','))
+				{
+					m_p++;
+				}
+				else if ((m_p < m_pEnd) && (*m_p == '}'))
+				{
+					m_p++;
+					return(true);
+				}
+				else
+				{
+					return(false);
+				}
+			}
+		}
+
+		bool ParseArray(JSON_VALUE& value, int depth)
+		{
+			value.type = JSON_VALUE::JSON_ARRAY;
+			m_p++;
+			SkipWhitespace();
+			if ((m_p < m_pEnd) && (*m_p == ']'))
+			{
+				m_p++;
+				return(true);
+			}
+
+			while (true)
+			{
+				value.items.push_back(JSON_VALUE());
+				if (ParseValue(value.items.back(), depth + 1) == false)
+				{
+					return(false);
+				}
+
+				SkipWhitespace();
+				if ((m_p < m_pEnd) && (*m_p == ','))
+				{
+					m_p++;
+				}
+				else if ((m_p < m_pEnd) && (*m_p == ']'))
+				{
+					m_p++;
+					return(true);
+				}
+				else
+				{
+					return(false);
+				}
+			}
+		}
+
+		bool ParseString(std::string& text)
+		{
+			m_p++;
+			while ((m_p < m_pEnd) && (*m_p != '"'))
+			{
+				if (*m_p != '\\')
+				{
+					text += *m_p++;
+					continue;
+				}
+
+				m_p++;
+				if (m_p >= m_pEnd)
+				{
+					return(false);
+				}
+				char escaped = *m_p++;
+				switch (escaped)
+				{
+				case 'b':
+					text += '\b';
+					break;
+				case 'f':
+					text += '\f';
+					break;
+				case 'n':
+					text += '\n';
+					break;
+				case 'r':
+					text += '\r';
+					break;
+				case 't':
+					text += '\t';
+					break;
+				case 'u':
+				{
+					if (m_pEnd - m_p < 4)
+					{
+						return(false);
+					}
+					unsigned int code = (unsigned int)strtoul(std::string(m_p, 4).c_str(), NULL, 16);
+					m_p += 4;
+					// written as UTF-8, surrogate pairs are not
+					// joined since names and paths rarely need them
+					if (code < 0x80)
+					{
+						text += (char)code;
+					}
+					else if (code < 0x800)
+					{
+						text += (char)(0xC0 | (code >> 6));
+						text += (char)(0x80 | (code & 0x3F));
+					}
+					else
+					{
+						text += (char)(0xE0 | (code >> 12));
+						text += (char)(0x80 | ((code >> 6) & 0x3F));
+						text += (char)(0x80 | (code & 0x3F));
+					}
+					break;
+				}
+				default:
+					text += escaped;
+					break;
+				}
+			}
+			if (m_p >= m_pEnd)
+			{
+				return(false);
+			}
+			m_p++;
+			return(true);
+		}
+
+		bool ParseNumber(JSON_VALUE& value)
+		{
+			const char* pStart = m_p;
+			while ((m_p < m_pEnd) && (strchr("+-0123456789.eE", *m_p) != NULL))
+			{
+				m_p++;
+			}
+			if ((m_p == pStart) || (m_p - pStart > 64))
+			{
+				return(false);
+			}
+
+			// copied, since the text of a GLB isn't terminated
+			std::string number(pStart, m_p);
+			char* pNumberEnd = NULL;
+			value.type = JSON_VALUE::JSON_NUMBER;
+			value.number = strtod(number.c_str(), &pNumberEnd);
+			return(*pNumberEnd == '\0');
+		}
+	};
+
+	// the data of a glTF buffer
+	struct GLTF_BUFFER
+	{
+		const unsigned char* pData;
+		size_t size;
+	};
+
+	// elements of an accessor, where they are and how they are
+	// stored
+	struct GLTF_ACCESSOR
+	{
+		const unsigned char* pData;
+		int count;
+		int componentType;
+		int componentCount;
+		size_t stride;
+		bool bNormalized;
+	};
+
+	/***********************************************************
+	 *  DecodeUri()
+	 *
+	 *  Turn the escaped characters of a relative URI back into
+	 *  the characters of a file name.
+	 ***********************************************************/
+	std::string DecodeUri(const std::string& uri)
+	{
+		std::string decoded;
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			if ((uri[i] == '%') && (i + 2 < uri.size()))
+			{
+				decoded += (char)strtoul(uri.substr(i + 1, 2).c_str(), NULL, 16);
+				i += 2;
+			}
+			else
+			{
+				decoded += uri[i];
+			}
+		}
+		return(decoded);
+	}
+
+	/***********************************************************
+	 *  DecodeBase64()
+	 *
+	 *  Decode the base64 payload of a data URI.
+	 ***********************************************************/
+	bool DecodeBase64(const std::string& text, size_t start, std::vector<unsigned char>& bytes)
+	{
+		uint32_t bits = 0;
+		int bitCount = 0;
+
+		bytes.clear();
+		bytes.reserve((text.size() - start) * 3 / 4);
+		for (size_t i = start; i < text.size(); i++)
+		{
+			char c = text[i];
+			int value = -1;
+			if ((c >= 'A') && (c <= 'Z'))
+			{
+				value = c - 'A';
+			}
+			else if ((c >= 'a') && (c <= 'z'))
+			{
+				value = c - 'a' + 26;
+			}
+			else if ((c >= '0') && (c <= '9'))
+			{
+				value = c - '0' + 52;
+			}
+			else if (c == '+')
+			{
+				value = 62;
+			}
+			else if (c == '/')
+			{
+				value = 63;
+			}
+			else if (c == '=')
+			{
+				break;
+			}
+			else
+			{
+				return(false);
+			}
+
+			bits = (bits << 6) | (uint32_t)value;
+			bitCount += 6;
+			if (bitCount >= 8)
+			{
+				bitCount -= 8;
+				bytes.push_back((unsigned char)(bits >> bitCount));
+			}
+		}
+		return(true);
+	}
+
+	/***********************************************************
+	 *  FindAccessor()
+	 *
+	 *  Look up an accessor of the document and check that its
+	 *  elements lie inside its buffer.  Sparse accessors and
+	 *  accessors without a buffer view are not supported.
+	 ***********************************************************/
+	bool FindAccessor(
+		const JSON_VALUE& document,
+		const std::vector<GLTF_BUFFER>& buffers,
+		int accessorIndex,
+		GLTF_ACCESSOR& accessor)
+	{
+		const JSON_VALUE* pAccessors = document.Find("accessors");
+		const JSON_VALUE* pViews = document.Find("bufferViews");
+		const JSON_VALUE* pAccessor = (pAccessors != NULL) ? pAccessors->At(accessorIndex) : NULL;
+		if ((pAccessor == NULL) || (pViews == NULL) || (pAccessor->Find("sparse") != NULL))
+		{
+			return(false);
+		}
+		const JSON_VALUE* pView = pViews->At(pAccessor->GetInt("bufferView", -1));
+		if (pView == NULL)
+		{
+			return(false);
+		}
+		int bufferIndex = pView->GetInt("buffer", -1);
+		if ((bufferIndex < 0) || (bufferIndex >= (int)buffers.size()))
+		{
+			return(false);
+		}
+
+		const JSON_VALUE* pType = pAccessor->Find("type");
+		std::string type = (pType != NULL) ? pType->text : std::string();
+		const char* typeNames[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+		accessor.componentCount = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (type == typeNames[i])
+			{
+				accessor.componentCount = i + 1;
+			}
+		}
+
+		accessor.componentType = pAccessor->GetInt("componentType", 0);
+		accessor.count = pAccessor->GetInt("count", 0);
+		const JSON_VALUE* pNormalized = pAccessor->Find("normalized");
+		accessor.bNormalized = (pNormalized != NULL) && (pNormalized->number != 0.0);
+		size_t componentBytes = 0;
+		if ((accessor.componentType == g_GltfByte) || (accessor.componentType == g_GltfUnsignedByte))
+		{
+			componentBytes = 1;
+		}
+		else if ((accessor.componentType == g_GltfShort) || (accessor.componentType == g_GltfUnsignedShort))
+		{
+			componentBytes = 2;
+		}
+		else if ((accessor.componentType == g_GltfUnsignedInt) || (accessor.componentType == g_GltfFloat))
+		{
+			componentBytes = 4;
+		}
+		if ((componentBytes == 0) || (accessor.componentCount == 0) || (accessor.count <= 0))
+		{
+			return(false);
+		}
+
+		size_t elementBytes = componentBytes * accessor.componentCount;
+		size_t viewOffset = (size_t)pView->GetNumber("byteOffset", 0.0);
+		size_t viewLength = (size_t)pView->GetNumber("byteLength", 0.0);
+		size_t accessorOffset = (size_t)pAccessor->GetNumber("byteOffset", 0.0);
+		accessor.stride = (size_t)pView->GetNumber("byteStride", 0.0);
+		if (accessor.stride == 0)
+		{
+			accessor.stride = elementBytes;
+		}
+
+		const GLTF_BUFFER& buffer = buffers[bufferIndex];
+		size_t lastByte = accessorOffset + accessor.stride * (accessor.count - 1) + elementBytes;
+		if ((viewOffset + viewLength > buffer.size) || (lastByte > viewLength))
+		{
+			return(false);
+		}
+		accessor.pData = buffer.pData + viewOffset + accessorOffset;
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ReadFloats()
+	 *
+	 *  Read up to four components of an accessor element as
+	 *  floats, scaling normalized integers into 0 - 1 or -1 - 1.
+	 ***********************************************************/
+	void ReadFloats(const GLTF_ACCESSOR& accessor, int element, float* pValues, int count)
+	{
+		const unsigned char* pElement = accessor.pData + accessor.stride * element;
+
+		for (int i = 0; i < count; i++)
+		{
+			float value = 0.0f;
+			if (i < accessor.componentCount)
+			{
+				switch (accessor.componentType)
+				{
+				case g_GltfFloat:
+					memcpy(&value, pElement + i * 4, sizeof(float));
+					break;
+				case g_GltfUnsignedByte:
+					value = pElement[i];
+					value = accessor.bNormalized ? value / 255.0f : value;
+					break;
+				case g_GltfByte:
+					value = (float)(int8_t)pElement[i];
+					value = accessor.bNormalized ? std::max(value / 127.0f, -1.0f) : value;
+					break;
+				case g_GltfUnsignedShort:
+				{
+					uint16_t component;
+					memcpy(&component, pElement + i * 2, sizeof(component));
+					value = accessor.bNormalized ? component / 65535.0f : (float)component;
+					break;
+				}
+				case g_GltfShort:
+				{
+					int16_t component;
+					memcpy(&component, pElement + i * 2, sizeof(component));
+					value = accessor.bNormalized ? std::max(component / 32767.0f, -1.0f) : (float)component;
+					break;
+				}
+				default:
+					break;
+				}
+			}
+			pValues[i] = value;
+		}
+	}
+
+	/***********************************************************
+	 *  ReadIndex()
+	 *
+	 *  Read an element of an index accessor.
+	 ***********************************************************/
+	uint32_t ReadIndex(const GLTF_ACCESSOR& accessor, int element)
+	{
+		const unsigned char* pElement = accessor.pData + accessor.stride * element;
+
+		if (accessor.componentType == g_GltfUnsignedByte)
+		{
+			return(*pElement);
+		}
+		if (accessor.componentType == g_GltfUnsignedShort)
+		{
+			uint16_t index;
+			memcpy(&index, pElement, sizeof(index));
+			return(index);
+		}
+		uint32_t index;
+		memcpy(&index, pElement, sizeof(index));
+		return(index);
+	}
+
+	/***********************************************************
+	 *  GetNodeTransform()
+	 *
+	 *  Read the transform of a glTF node, from its matrix or
+	 *  from its translation, rotation and scale.
+	 ***********************************************************/
+	glm::mat4 GetNodeTransform(const JSON_VALUE& node)
+	{
+		glm::mat4 transform(1.0f);
+
+		const JSON_VALUE* pMatrix = node.Find("matrix");
+		if ((pMatrix != NULL) && (pMatrix->items.size() == 16))
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				transform[i / 4][i % 4] = (float)pMatrix->items[i].number;
+			}
+			return(transform);
+		}
+
+		float values[3][4] = { { 0.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 0.0f } };
+		const char* names[3] = { "translation", "rotation", "scale" };
+		for (int i = 0; i < 3; i++)
+		{
+			const JSON_VALUE* pValues = node.Find(names[i]);
+			for (int c = 0; (pValues != NULL) && (c < (int)pValues->items.size()) && (c < 4); c++)
+			{
+				values[i][c] = (float)pValues->items[c].number;
+			}
+		}
+
+		float x = values[1][0];
+		float y = values[1][1];
+		float z = values[1][2];
+		float w = values[1][3];
+		transform[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * values[2][0];
+		transform[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * values[2][1];
+		transform[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * values[2][2];
+		transform[3] = glm::vec4(values[0][0], values[0][1], values[0][2], 1.0f);
+
+		return(transform);
+	}
+
+	// a primitive placed by a node
+	struct GLTF_PRIMITIVE
+	{
+		const JSON_VALUE* pPrimitive;
+		glm::mat4 transform;
+	};
+
+	/***********************************************************
+	 *  GatherPrimitives()
+	 *
+	 *  Walk a node and its children, adding the primitives of
+	 *  their meshes with the transform placing them.
+	 ***********************************************************/
+	void GatherPrimitives(
+		const JSON_VALUE& document,
+		int nodeIndex,
+		const glm::mat4& parent,
+		int depth,
+		std::vector<GLTF_PRIMITIVE>& primitives)
+	{
+		const JSON_VALUE* pNodes = document.Find("nodes");
+		const JSON_VALUE* pNode = (pNodes != NULL) ? pNodes->At(nodeIndex) : NULL;
+		if ((pNode == NULL) || (depth > g_MaxNesting))
+		{
+			return;
+		}
+
+		glm::mat4 transform = parent * GetNodeTransform(*pNode);
+		const JSON_VALUE* pMeshes = document.Find("meshes");
+		const JSON_VALUE* pMesh = (pMeshes != NULL) ? pMeshes->At(pNode->GetInt("mesh", -1)) : NULL;
+		const JSON_VALUE* pPrimitives = (pMesh != NULL) ? pMesh->Find("primitives") : NULL;
+		for (int i = 0; (pPrimitives != NULL) && (i < (int)pPrimitives->items.size()); i++)
+		{
+			GLTF_PRIMITIVE primitive;
+			primitive.pPrimitive = &pPrimitives->items[i];
+			primitive.transform = transform;
+			primitives.push_back(primitive);
+		}
+
+		const JSON_VALUE* pChildren = pNode->Find("children");
+		for (int i = 0; (pChildren != NULL) && (i < (int)pChildren->items.size()); i++)
+		{
+			GatherPrimitives(document, (int)pChildren->items[i].number, transform, depth + 1, primitives);
+		}
+	}
+
+	/***********************************************************
+	 *  BuildGltfPrimitive()
+	 *
+	 *  Convert a triangle list primitive into the vertices of a
+	 *  piece, placed by its transform, with texture coordinates
+	 *  flipped to the OpenGL origin and identical vertices
+	 *  welded.  A mirroring transform has its winding reversed.
+	 ***********************************************************/
+	void BuildGltfPrimitive(
+		const JSON_VALUE& document,
+		const std::vector<GLTF_BUFFER>& buffers,
+		const GLTF_PRIMITIVE& primitive,
+		MESH_PIECE& piece)
+	{
+		const JSON_VALUE& source = *primitive.pPrimitive;
+		const JSON_VALUE* pAttributes = source.Find("attributes");
+		if ((source.GetInt("mode", g_GltfTriangles) != g_GltfTriangles) || (pAttributes == NULL))
+		{
+			piece.skippedCount++;
+			return;
+		}
+
+		GLTF_ACCESSOR positions;
+		GLTF_ACCESSOR normals;
+		GLTF_ACCESSOR texCoords;
+		GLTF_ACCESSOR indices;
+		bool bNormals = FindAccessor(document, buffers, pAttributes->GetInt("NORMAL", -1), normals);
+		bool bTexCoords = FindAccessor(document, buffers, pAttributes->GetInt("TEXCOORD_0", -1), texCoords);
+		bool bIndices = FindAccessor(document, buffers, source.GetInt("indices", -1), indices);
+		if ((FindAccessor(document, buffers, pAttributes->GetInt("POSITION", -1), positions) == false) ||
+			(bNormals && (normals.count != positions.count)) ||
+			(bTexCoords && (texCoords.count != positions.count)) ||
+			((source.Find("indices") != NULL) && (bIndices == false)))
+		{
+			piece.skippedCount++;
+			return;
+		}
+
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(primitive.transform)));
+		bool bMirrored = glm::determinant(glm::mat3(primitive.transform)) < 0.0f;
+		int cornerCount = bIndices ? indices.count : positions.count;
+		cornerCount -= cornerCount % 3;
+
+		VertexTable<MeshBuilder::FLOATS_PER_VERTEX> table(positions.count);
+		piece.indices.reserve(cornerCount);
+		for (int c = 0; c < cornerCount; c++)
+		{
+			// the last two corners of a mirrored triangle swap
+			int corner = c;
+			if (bMirrored && ((c % 3) != 0))
+			{
+				corner = ((c % 3) == 1) ? c + 1 : c - 1;
+			}
+			uint32_t element = bIndices ? ReadIndex(indices, corner) : (uint32_t)corner;
+			if (element >= (uint32_t)positions.count)
+			{
+				piece.bValid = false;
+				return;
+			}
+
+			float values[MeshBuilder::FLOATS_PER_VERTEX];
+			ReadFloats(positions, element, values, 3);
+			glm::vec3 position = glm::vec3(primitive.transform * glm::vec4(values[0], values[1], values[2], 1.0f));
+			glm::vec3 normal(0.0f);
+			if (bNormals)
+			{
+				ReadFloats(normals, element, values + 3, 3);
+				normal = normalMatrix * glm::vec3(values[3], values[4], values[5]);
+				float length = glm::length(normal);
+				normal = (length > 0.0f) ? normal / length : normal;
+			}
+			values[6] = 0.0f;
+			values[7] = 0.0f;
+			if (bTexCoords)
+			{
+				ReadFloats(texCoords, element, values + 6, 2);
+			}
+			const float vertex[MeshBuilder::FLOATS_PER_VERTEX] =
+			{
+				position.x, position.y, position.z, normal.x, normal.y, normal.z, values[6], 1.0f - values[7]
+			};
+
+			uint32_t key[MeshBuilder::FLOATS_PER_VERTEX];
+			memcpy(key, vertex, sizeof(key));
+			int vertexCount = (int)piece.missingNormals.size();
+			int vertexIndex = table.Insert(key, vertexCount);
+			if (vertexIndex == vertexCount)
+			{
+				AddVertex(piece, position, normal, vertex[6], vertex[7], bNormals == false);
+			}
+			else
+			{
+				piece.mergedCount++;
+			}
+			piece.indices.push_back((uint32_t)vertexIndex);
+		}
+
+		GenerateNormals(piece);
+	}
+
+	/***********************************************************
+	 *  EndsWith()
+	 *
+	 *  True if a file name ends with the extension, ignoring
+	 *  case.
+	 ***********************************************************/
+	bool EndsWith(const std::string& filename, const char* extension)
+	{
+		size_t length = strlen(extension);
+		if (filename.size() < length)
+		{
+			return(false);
+		}
+		for (size_t i = 0; i < length; i++)
+		{
+			char c = filename[filename.size() - length + i];
+			if (tolower((unsigned char)c) != extension[i])
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  Import()
+ *
+ *  This method is used to read a model file.  The file is
+ *  mapped, read by the importer of its format, and the time
+ *  and throughput of the whole import are reported.
+ ***********************************************************/
+bool ModelImporter::Import(
+	const char* filename,
+	ThreadPool* pThreadPool,
+	MeshBuilder::MESH_DATA& mesh,
+	IMPORT_STATS& stats)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	MappedFile file;
+	bool bImported = false;
+
+	stats = IMPORT_STATS();
+	if (file.Open(filename) == false)
+	{
+		std::cout << "ERROR: could not open model " << filename << std::endl;
+		return(false);
+	}
+	stats.fileBytes = file.GetSize();
+
+	uint32_t magic = 0;
+	if (file.GetSize() >= sizeof(magic))
+	{
+		memcpy(&magic, file.GetData(), sizeof(magic));
+	}
+	if ((magic == g_GlbMagic) || EndsWith(filename, ".gltf") || EndsWith(filename, ".glb"))
+	{
+		bImported = ImportGltf(filename, file.GetData(), file.GetSize(), pThreadPool, mesh, stats);
+	}
+	else if (EndsWith(filename, ".obj"))
+	{
+		bImported = ImportObj((const char*)file.GetData(), file.GetSize(), pThreadPool, mesh, stats);
+	}
+	else
+	{
+		std::cout << "ERROR: model " << filename << " is not an OBJ or glTF file" << std::endl;
+		return(false);
+	}
+
+	if (bImported && mesh.indices.empty())
+	{
+		std::cout << "ERROR: model " << filename << " has no triangles" << std::endl;
+		bImported = false;
+	}
+	if (bImported == false)
+	{
+		mesh = MeshBuilder::MESH_DATA();
+		return(false);
+	}
+
+	stats.vertexCount = mesh.GetVertexCount();
+	stats.triangleCount = (int)mesh.indices.size() / 3;
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	double megabytes = stats.fileBytes / (1024.0 * 1024.0);
+	std::cout << "INFO: imported " << filename << ": " << megabytes << " MB in " << stats.milliseconds
+		<< " ms (" << megabytes / std::max(stats.milliseconds / 1000.0, 1e-6) << " MB/s) in "
+		<< stats.pieceCount << " pieces using " << ((pThreadPool != NULL) ? pThreadPool->GetThreadCount() : 1)
+		<< " threads, " << stats.vertexCount << " vertices, " << stats.triangleCount << " triangles, "
+		<< stats.mergedCount << " corners merged" << std::endl;
+	if (stats.skippedCount > 0)
+	{
+		std::cout << "WARNING: skipped " << stats.skippedCount << " unreadable lines or primitives of "
+			<< filename << std::endl;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  ImportObj()
+ *
+ *  This method is used to read OBJ text.  The chunks are
+ *  parsed in parallel, then counted up so indices relative
+ *  to the end of a list can be made absolute, and the lists
+ *  are joined for the chunks to build their vertices from,
+ *  again in parallel.
+ ***********************************************************/
+bool ModelImporter::ImportObj(
+	const char* pText,
+	size_t size,
+	ThreadPool* pThreadPool,
+	MeshBuilder::MESH_DATA& mesh,
+	IMPORT_STATS& stats)
+{
+	// chunks end after the first line break past their size
+	std::vector<OBJ_CHUNK> chunks;
+	const char* pEnd = pText + size;
+	const char* pBegin = pText;
+	while (pBegin < pEnd)
+	{
+		const char* pChunkEnd = pBegin + std::min(g_ObjChunkBytes, (size_t)(pEnd - pBegin));
+		const char* pLineBreak = (const char*)memchr(pChunkEnd - 1, '\n', pEnd - pChunkEnd + 1);
+		pChunkEnd = (pLineBreak != NULL) ? pLineBreak + 1 : pEnd;
+
+		chunks.push_back(OBJ_CHUNK());
+		chunks.back().pBegin = pBegin;
+		chunks.back().pEnd = pChunkEnd;
+		pBegin = pChunkEnd;
+	}
+
+	RunParallel(pThreadPool, (int)chunks.size(),
+		[&chunks](int index, int)
+		{
+			OBJ_CHUNK& chunk = chunks[index];
+			chunk.piece.mergedCount = 0;
+			chunk.piece.skippedCount = 0;
+			chunk.piece.bValid = true;
+			ParseObjChunk(chunk);
+		});
+
+	size_t positionCount = 0;
+	size_t texCoordCount = 0;
+	size_t normalCount = 0;
+	for (int i = 0; i < (int)chunks.size(); i++)
+	{
+		chunks[i].firstPosition = (int)(positionCount / 3);
+		chunks[i].firstTexCoord = (int)(texCoordCount / 2);
+		chunks[i].firstNormal = (int)(normalCount / 3);
+		positionCount += chunks[i].positions.size();
+		texCoordCount += chunks[i].texCoords.size();
+		normalCount += chunks[i].normals.size();
+	}
+
+	std::vector<float> positions(positionCount);
+	std::vector<float> texCoords(texCoordCount);
+	std::vector<float> normals(normalCount);
+	RunParallel(pThreadPool, (int)chunks.size(),
+		[&chunks, &positions, &texCoords, &normals](int index, int)
+		{
+			OBJ_CHUNK& chunk = chunks[index];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.firstPosition * 3);
+			std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + chunk.firstTexCoord * 2);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.firstNormal * 3);
+			std::vector<float>().swap(chunk.positions);
+			std::vector<float>().swap(chunk.texCoords);
+			std::vector<float>().swap(chunk.normals);
+
+			const int firsts[3] = { chunk.firstPosition, chunk.firstTexCoord, chunk.firstNormal };
+			for (int i = 0; i < (int)chunk.relativeCorners.size(); i++)
+			{
+				size_t entry = chunk.relativeCorners[i];
+				chunk.corners[entry] += firsts[entry % 3];
+			}
+			BuildObjChunk(chunk, positions, texCoords, normals);
+		});
+
+	std::vector<MESH_PIECE> pieces(chunks.size());
+	for (int i = 0; i < (int)chunks.size(); i++)
+	{
+		if (chunks[i].piece.bValid == false)
+		{
+			std::cout << "ERROR: OBJ face refers to a missing vertex" << std::endl;
+			return(false);
+		}
+		stats.mergedCount += chunks[i].piece.mergedCount;
+		stats.skippedCount += chunks[i].piece.skippedCount;
+		std::swap(pieces[i], chunks[i].piece);
+	}
+	stats.pieceCount = (int)pieces.size();
+
+	JoinPieces(pieces, pThreadPool, mesh);
+
+	return(true);
+}
+
+/***********************************************************
+ *  ImportGltf()
+ *
+ *  This method is used to read a glTF document, from a GLB
+ *  container or from JSON text.  Buffers come from the GLB
+ *  binary chunk, from data URIs or from mapped files next to
+ *  the document.  The primitives of the meshes placed by the
+ *  nodes of the default scene are converted in parallel.
+ ***********************************************************/
+bool ModelImporter::ImportGltf(
+	const char* filename,
+	const unsigned char* pData,
+	size_t size,
+	ThreadPool* pThreadPool,
+	MeshBuilder::MESH_DATA& mesh,
+	IMPORT_STATS& stats)
+{
+	const char* pJson = (const char*)pData;
+	size_t jsonSize = size;
+	GLTF_BUFFER binaryChunk = { NULL, 0 };
+
+	uint32_t header[3] = {};
+	if (size >= sizeof(header))
+	{
+		memcpy(header, pData, sizeof(header));
+	}
+	if (header[0] == g_GlbMagic)
+	{
+		// chunks follow the header, the JSON first and then an
+		// optional binary buffer
+		size_t offset = sizeof(header);
+		pJson = NULL;
+		while (offset + 8 <= std::min((size_t)header[2], size))
+		{
+			uint32_t chunkHeader[2];
+			memcpy(chunkHeader, pData + offset, sizeof(chunkHeader));
+			offset += sizeof(chunkHeader);
+			if (offset + chunkHeader[0] > size)
+			{
+				break;
+			}
+			if ((chunkHeader[1] == g_GlbJsonChunk) && (pJson == NULL))
+			{
+				pJson = (const char*)pData + offset;
+				jsonSize = chunkHeader[0];
+			}
+			else if ((chunkHeader[1] == g_GlbBinaryChunk) && (binaryChunk.pData == NULL))
+			{
+				binaryChunk.pData = pData + offset;
+				binaryChunk.size = chunkHeader[0];
+			}
+			offset += (chunkHeader[0] + 3) & ~3u;
+		}
+		if (pJson == NULL)
+		{
+			std::cout << "ERROR: GLB file " << filename << " has no JSON chunk" << std::endl;
+			return(false);
+		}
+	}
+
+	JSON_VALUE document;
+	JsonParser parser(pJson, jsonSize);
+	if ((parser.Parse(document) == false) || (document.type != JSON_VALUE::JSON_OBJECT))
+	{
+		std::cout << "ERROR: could not parse the glTF JSON of " << filename << std::endl;
+		return(false);
+	}
+
+	// external buffers are found relative to the document
+	std::string directory(filename);
+	size_t slash = directory.find_last_of("/\\");
+	directory = (slash != std::string::npos) ? directory.substr(0, slash + 1) : std::string();
+
+	std::vector<GLTF_BUFFER> buffers;
+	std::vector<MappedFile*> files;
+	std::vector<std::vector<unsigned char> > decoded;
+	const JSON_VALUE* pBuffers = document.Find("buffers");
+	int bufferCount = (pBuffers != NULL) ? (int)pBuffers->items.size() : 0;
+	bool bValid = true;
+	decoded.reserve(bufferCount);
+	for (int i = 0; bValid && (i < bufferCount); i++)
+	{
+		const JSON_VALUE& source = pBuffers->items[i];
+		const JSON_VALUE* pUri = source.Find("uri");
+		GLTF_BUFFER buffer = { NULL, 0 };
+
+		if (pUri == NULL)
+		{
+			buffer = binaryChunk;
+		}
+		else if (pUri->text.compare(0, 5, "data:") == 0)
+		{
+			size_t payload = pUri->text.find(";base64,");
+			decoded.push_back(std::vector<unsigned char>());
+			if ((payload != std::string::npos) && DecodeBase64(pUri->text, payload + 8, decoded.back()))
+			{
+				buffer.pData = decoded.back().data();
+				buffer.size = decoded.back().size();
+			}
+		}
+		else
+		{
+			std::string bufferFilename = directory + DecodeUri(pUri->text);
+			files.push_back(new MappedFile());
+			if (files.back()->Open(bufferFilename.c_str()))
+			{
+				buffer.pData = files.back()->GetData();
+				buffer.size = files.back()->GetSize();
+			}
+		}
+
+		if (buffer.pData == NULL)
+		{
+			std::cout << "ERROR: could not read buffer " << i << " of " << filename << std::endl;
+			bValid = false;
+		}
+		buffer.size = std::min(buffer.size, (size_t)source.GetNumber("byteLength", (double)buffer.size));
+		buffers.push_back(buffer);
+	}
+
+	// the default scene, or every mesh as it is when there is
+	// no scene
+	std::vector<GLTF_PRIMITIVE> primitives;
+	const JSON_VALUE* pScenes = document.Find("scenes");
+	const JSON_VALUE* pScene = (pScenes != NULL) ? pScenes->At(document.GetInt("scene", 0)) : NULL;
+	const JSON_VALUE* pRoots = (pScene != NULL) ? pScene->Find("nodes") : NULL;
+	if (bValid == false)
+	{
+		// nothing to convert
+	}
+	else if (pRoots != NULL)
+	{
+		for (int i = 0; i < (int)pRoots->items.size(); i++)
+		{
+			GatherPrimitives(document, (int)pRoots->items[i].number, glm::mat4(1.0f), 0, primitives);
+		}
+	}
+	else
+	{
+		const JSON_VALUE* pMeshes = document.Find("meshes");
+		for (int m = 0; (pMeshes != NULL) && (m < (int)pMeshes->items.size()); m++)
+		{
+			const JSON_VALUE* pPrimitives = pMeshes->items[m].Find("primitives");
+			for (int i = 0; (pPrimitives != NULL) && (i < (int)pPrimitives->items.size()); i++)
+			{
+				GLTF_PRIMITIVE primitive;
+				primitive.pPrimitive = &pPrimitives->items[i];
+				primitive.transform = glm::mat4(1.0f);
+				primitives.push_back(primitive);
+			}
+		}
+	}
+
+	std::vector<MESH_PIECE> pieces(primitives.size());
+	RunParallel(pThreadPool, (int)primitives.size(),
+		[&document, &buffers, &primitives, &pieces](int index, int)
+		{
+			MESH_PIECE& piece = pieces[index];
+			piece.mergedCount = 0;
+			piece.skippedCount = 0;
+			piece.bValid = true;
+			BuildGltfPrimitive(document, buffers, primitives[index], piece);
+		});
+
+	for (int i = 0; bValid && (i < (int)pieces.size()); i++)
+	{
+		if (pieces[i].bValid == false)
+		{
+			std::cout << "ERROR: glTF primitive " << i << " of " << filename << " indexes a missing vertex" << std::endl;
+			bValid = false;
+		}
+		stats.mergedCount += pieces[i].mergedCount;
+		stats.skippedCount += pieces[i].skippedCount;
+	}
+	stats.pieceCount = (int)pieces.size();
+
+	if (bValid)
+	{
+		JoinPieces(pieces, pThreadPool, mesh);
+	}
+
+	for (int i = 0; i < (int)files.size(); i++)
+	{
+		delete files[i];
+	}
+
+	return(bValid);
+}
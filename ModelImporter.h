@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+// modelimporter.h
+// ============
+// read OBJ and glTF models into the vertex layout of the basic shapes
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshBuilder.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+
+/***********************************************************
+ *  ModelImporter
+ *
+ *  This class reads Wavefront OBJ files and glTF 2.0 files,
+ *  as JSON with external or embedded buffers or as binary
+ *  GLB, into one mesh with the MeshBuilder layout, so the
+ *  scene draws models with the shaders of the basic shapes.
+ *  Files are memory mapped and read in place.  OBJ text is
+ *  split at line breaks into chunks parsed on the worker
+ *  threads, and each chunk merges its repeated corners with
+ *  a hash table; a corner shared across two chunks is kept
+ *  once in each.  glTF primitives are converted in parallel,
+ *  placed by the nodes of the scene, and identical vertices
+ *  are welded the same way.  Materials and textures of the
+ *  files are not read, the model is a single part drawn with
+ *  the scene's own materials.
+ ***********************************************************/
+class ModelImporter
+{
+public:
+	// what an import read and how long it took
+	struct IMPORT_STATS
+	{
+		size_t fileBytes;
+		// OBJ chunks or glTF primitives converted in parallel
+		int pieceCount;
+		int vertexCount;
+		int triangleCount;
+		// corners folded into a vertex that was already added
+		int mergedCount;
+		// lines or primitives that couldn't be read
+		int skippedCount;
+		double milliseconds;
+	};
+
+	// read a model by its extension, .obj, .gltf or .glb,
+	// replacing the contents of mesh; the thread pool may be
+	// NULL to read on the calling thread only
+	static bool Import(
+		const char* filename,
+		ThreadPool* pThreadPool,
+		MeshBuilder::MESH_DATA& mesh,
+		IMPORT_STATS& stats);
+
+private:
+	// read the text of an OBJ file
+	static bool ImportObj(
+		const char* pText,
+		size_t size,
+		ThreadPool* pThreadPool,
+		MeshBuilder::MESH_DATA& mesh,
+		IMPORT_STATS& stats);
+	// read a glTF or GLB file, whose external buffers are found
+	// next to it
+	static bool ImportGltf(
+		const char* filename,
+		const unsigned char* pData,
+		size_t size,
+		ThreadPool* pThreadPool,
+		MeshBuilder::MESH_DATA& mesh,
+		IMPORT_STATS& stats);
+};
@@ -0,0 +1,563 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.cpp
+// ============
+// software occlusion culling against a low resolution CPU depth buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+// SSE2 is part of every x64 target, so it only needs to be
+// detected for 32-bit builds
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OCCLUSION_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// corners closer than this to the eye plane cannot be
+	// projected safely
+	const float g_NearW = 1e-4f;
+	// depth slack so an occluder never hides its own surface
+	const float g_DepthBias = 1e-6f;
+	// boxes tested by each task of the parallel visibility loop
+	const int g_TestChunkSize = 64;
+
+	// the twelve triangles of a box, indexing corners where bit
+	// 0 selects max x, bit 1 max y and bit 2 max z
+	const int g_BoxTriangles[12][3] =
+	{
+		{ 0, 2, 6 }, { 0, 6, 4 },	// -X
+		{ 1, 5, 7 }, { 1, 7, 3 },	// +X
+		{ 0, 4, 5 }, { 0, 5, 1 },	// -Y
+		{ 2, 3, 7 }, { 2, 7, 6 },	// +Y
+		{ 0, 1, 3 }, { 0, 3, 2 },	// -Z
+		{ 4, 6, 7 }, { 4, 7, 5 }	// +Z
+	};
+
+	/***********************************************************
+	 *  BoxCorner()
+	 *
+	 *  Return one of the eight corners of a box.
+	 ***********************************************************/
+	glm::vec4 BoxCorner(const glm::vec3& boundsMin, const glm::vec3& boundsMax, int corner)
+	{
+		return(glm::vec4(
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z,
+			1.0f));
+	}
+
+	/***********************************************************
+	 *  ElapsedMilliseconds()
+	 *
+	 *  Milliseconds since the passed in time point.
+	 ***********************************************************/
+	double ElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+}
+
+/***********************************************************
+ *  OcclusionCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionCuller::OcclusionCuller(ThreadPool* pThreadPool, FrameArena* pFrameArena)
+	: m_occluders(FrameAllocator<OCCLUSION_BOX>(pFrameArena))
+{
+	m_pThreadPool = pThreadPool;
+	m_pFrameArena = pFrameArena;
+	m_pTriangles = NULL;
+	m_triangleCount = 0;
+	m_width = 0;
+	m_height = 0;
+	m_viewProjection = glm::mat4(1.0f);
+	m_stats = OCCLUSION_STATS();
+
+	// a quarter of a typical window is plenty for occlusion
+	SetResolution(256, 160);
+}
+
+/***********************************************************
+ *  SetResolution()
+ *
+ *  This method is used to size the depth buffer.  The width
+ *  is kept a multiple of four for the SIMD loops.
+ ***********************************************************/
+void OcclusionCuller::SetResolution(int width, int height)
+{
+	m_width = std::max(4, (width + 3) & ~3);
+	m_height = std::max(1, height);
+	m_depthBuffer.assign(m_width * m_height, 1.0f);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used to clear the depth buffer and the
+ *  occluder list for the camera of a new frame.
+ ***********************************************************/
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection)
+{
+	m_viewProjection = viewProjection;
+	// the arena has started over, so the storage of the last
+	// frame's lists is gone
+	FrameVector<OCCLUSION_BOX>(FrameAllocator<OCCLUSION_BOX>(m_pFrameArena)).swap(m_occluders);
+	m_pTriangles = NULL;
+	m_triangleCount = 0;
+	std::fill(m_depthBuffer.begin(), m_depthBuffer.end(), 1.0f);
+
+	m_stats.occluderCount = 0;
+	m_stats.trianglesRasterized = 0;
+	m_stats.testedCount = 0;
+	m_stats.occludedCount = 0;
+	m_stats.visibleCount = 0;
+	m_stats.rasterizeMilliseconds = 0.0;
+	m_stats.testMilliseconds = 0.0;
+	m_stats.frameCount++;
+}
+
+/***********************************************************
+ *  AddOccluder()
+ *
+ *  This method is used to add a box that is completely solid,
+ *  so that anything behind it can be hidden.  The box must
+ *  not be larger than the object it stands in for.
+ ***********************************************************/
+void OcclusionCuller::AddOccluder(const OCCLUSION_BOX& occluder)
+{
+	m_occluders.push_back(occluder);
+}
+
+/***********************************************************
+ *  RasterizeOccluders()
+ *
+ *  This method is used to draw all of the occluders into the
+ *  depth buffer.  The triangles are first projected in
+ *  parallel, one occluder per task, and then rasterized in
+ *  parallel with each task owning a band of rows, so no two
+ *  threads ever write the same pixel.
+ ***********************************************************/
+void OcclusionCuller::RasterizeOccluders()
+{
+	auto start = std::chrono::steady_clock::now();
+	int occluderCount = (int)m_occluders.size();
+
+	m_triangleCount = occluderCount * 12;
+	m_pTriangles = m_pFrameArena->AllocateArray<SCREEN_TRIANGLE>(m_triangleCount);
+	m_pThreadPool->ParallelFor(occluderCount,
+		[this](int index, int) { SetupOccluderTriangles(index); });
+
+	int triangleCount = 0;
+	for (int i = 0; i < m_triangleCount; i++)
+	{
+		if (m_pTriangles[i].bValid)
+		{
+			triangleCount++;
+		}
+	}
+
+	// a few bands per thread keeps the load balanced when the
+	// occluders cover only part of the screen
+	int bandCount = std::min(m_height, m_pThreadPool->GetThreadCount() * 4);
+	int rowsPerBand = (m_height + bandCount - 1) / bandCount;
+	if (triangleCount > 0)
+	{
+		m_pThreadPool->ParallelFor(bandCount,
+			[this, rowsPerBand](int index, int)
+			{
+				int rowStart = index * rowsPerBand;
+				int rowEnd = std::min(m_height, rowStart + rowsPerBand);
+				RasterizeBand(rowStart, rowEnd);
+			});
+	}
+
+	m_stats.occluderCount = occluderCount;
+	m_stats.trianglesRasterized = triangleCount;
+	m_stats.rasterizeMilliseconds = ElapsedMilliseconds(start);
+}
+
+/***********************************************************
+ *  SetupOccluderTriangles()
+ *
+ *  This method is used to project the twelve triangles of an
+ *  occluder box into depth buffer coordinates.  Triangles
+ *  that reach behind the eye are dropped, which only ever
+ *  makes the culling less aggressive.
+ ***********************************************************/
+void OcclusionCuller::SetupOccluderTriangles(int occluderIndex)
+{
+	const OCCLUSION_BOX& occluder = m_occluders[occluderIndex];
+	glm::mat4 modelViewProjection = m_viewProjection * occluder.model;
+	glm::vec4 clip[8];
+
+	for (int corner = 0; corner < 8; corner++)
+	{
+		clip[corner] = modelViewProjection * BoxCorner(occluder.boundsMin, occluder.boundsMax, corner);
+	}
+
+	for (int t = 0; t < 12; t++)
+	{
+		SCREEN_TRIANGLE& triangle = m_pTriangles[occluderIndex * 12 + t];
+		triangle.bValid = false;
+
+		bool bBehindEye = false;
+		for (int v = 0; v < 3; v++)
+		{
+			const glm::vec4& position = clip[g_BoxTriangles[t][v]];
+			if (position.w <= g_NearW)
+			{
+				bBehindEye = true;
+				break;
+			}
+			float inverseW = 1.0f / position.w;
+			triangle.x[v] = (position.x * inverseW * 0.5f + 0.5f) * m_width;
+			triangle.y[v] = (position.y * inverseW * 0.5f + 0.5f) * m_height;
+			triangle.z[v] = std::max(0.0f, position.z * inverseW * 0.5f + 0.5f);
+		}
+		if (bBehindEye)
+		{
+			continue;
+		}
+
+		// orient every triangle counter-clockwise so the inside
+		// of all three edges is positive
+		float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+			(triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+		if (std::fabs(area) < 1e-8f)
+		{
+			continue;
+		}
+		if (area < 0.0f)
+		{
+			std::swap(triangle.x[1], triangle.x[2]);
+			std::swap(triangle.y[1], triangle.y[2]);
+			std::swap(triangle.z[1], triangle.z[2]);
+		}
+
+		float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		float minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+		float maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+
+		triangle.minX = std::max(0, (int)std::floor(minX));
+		triangle.maxX = std::min(m_width - 1, (int)std::ceil(maxX));
+		triangle.minY = std::max(0, (int)std::floor(minY));
+		triangle.maxY = std::min(m_height - 1, (int)std::ceil(maxY));
+
+		triangle.bValid = (triangle.minX <= triangle.maxX) && (triangle.minY <= triangle.maxY);
+	}
+}
+
+/***********************************************************
+ *  RasterizeBand()
+ *
+ *  This method is used to rasterize every occluder triangle
+ *  into one band of rows, keeping the nearest depth.  Pixel
+ *  centers are tested with edge functions, and depth is
+ *  interpolated from the plane of the triangle.
+ ***********************************************************/
+void OcclusionCuller::RasterizeBand(int rowStart, int rowEnd)
+{
+	for (int t = 0; t < m_triangleCount; t++)
+	{
+		const SCREEN_TRIANGLE& triangle = m_pTriangles[t];
+		if ((triangle.bValid == false) || (triangle.maxY < rowStart) || (triangle.minY >= rowEnd))
+		{
+			continue;
+		}
+
+		// edge i is opposite vertex i: E(x, y) = A * x + B * y + C
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		for (int e = 0; e < 3; e++)
+		{
+			int a = (e + 1) % 3;
+			int b = (e + 2) % 3;
+			edgeA[e] = triangle.y[a] - triangle.y[b];
+			edgeB[e] = triangle.x[b] - triangle.x[a];
+			edgeC[e] = triangle.x[a] * triangle.y[b] - triangle.y[a] * triangle.x[b];
+		}
+
+		// the edge functions are the barycentric weights scaled
+		// by twice the area, which gives the depth plane
+		float area = edgeC[0] + edgeC[1] + edgeC[2];
+		float inverseArea = 1.0f / area;
+		float depthA = (edgeA[0] * triangle.z[0] + edgeA[1] * triangle.z[1] + edgeA[2] * triangle.z[2]) * inverseArea;
+		float depthB = (edgeB[0] * triangle.z[0] + edgeB[1] * triangle.z[1] + edgeB[2] * triangle.z[2]) * inverseArea;
+		float depthC = (edgeC[0] * triangle.z[0] + edgeC[1] * triangle.z[1] + edgeC[2] * triangle.z[2]) * inverseArea;
+
+		int firstRow = std::max(triangle.minY, rowStart);
+		int lastRow = std::min(triangle.maxY, rowEnd - 1);
+		int firstColumn = triangle.minX & ~3;
+
+		for (int y = firstRow; y <= lastRow; y++)
+		{
+			float pixelY = (float)y + 0.5f;
+			float* pRow = &m_depthBuffer[y * m_width];
+
+#ifdef OCCLUSION_USE_SSE
+			__m128 stepX = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			__m128 zero = _mm_setzero_ps();
+			__m128 rowEdge0 = _mm_set1_ps(edgeB[0] * pixelY + edgeC[0]);
+			__m128 rowEdge1 = _mm_set1_ps(edgeB[1] * pixelY + edgeC[1]);
+			__m128 rowEdge2 = _mm_set1_ps(edgeB[2] * pixelY + edgeC[2]);
+			__m128 rowDepth = _mm_set1_ps(depthB * pixelY + depthC);
+			__m128 a0 = _mm_set1_ps(edgeA[0]);
+			__m128 a1 = _mm_set1_ps(edgeA[1]);
+			__m128 a2 = _mm_set1_ps(edgeA[2]);
+			__m128 aDepth = _mm_set1_ps(depthA);
+
+			for (int x = firstColumn; x <= triangle.maxX; x += 4)
+			{
+				__m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), stepX);
+				__m128 w0 = _mm_add_ps(_mm_mul_ps(a0, pixelX), rowEdge0);
+				__m128 w1 = _mm_add_ps(_mm_mul_ps(a1, pixelX), rowEdge1);
+				__m128 w2 = _mm_add_ps(_mm_mul_ps(a2, pixelX), rowEdge2);
+				__m128 inside = _mm_and_ps(_mm_cmpge_ps(w0, zero),
+					_mm_and_ps(_mm_cmpge_ps(w1, zero), _mm_cmpge_ps(w2, zero)));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				__m128 depth = _mm_add_ps(_mm_mul_ps(aDepth, pixelX), rowDepth);
+				__m128 previous = _mm_loadu_ps(pRow + x);
+				__m128 nearest = _mm_min_ps(previous, depth);
+				_mm_storeu_ps(pRow + x,
+					_mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+			}
+#else
+			for (int x = firstColumn; x <= triangle.maxX; x++)
+			{
+				float pixelX = (float)x + 0.5f;
+				float w0 = edgeA[0] * pixelX + edgeB[0] * pixelY + edgeC[0];
+				float w1 = edgeA[1] * pixelX + edgeB[1] * pixelY + edgeC[1];
+				float w2 = edgeA[2] * pixelX + edgeB[2] * pixelY + edgeC[2];
+				if ((w0 >= 0.0f) && (w1 >= 0.0f) && (w2 >= 0.0f))
+				{
+					float depth = depthA * pixelX + depthB * pixelY + depthC;
+					pRow[x] = std::min(pRow[x], depth);
+				}
+			}
+#endif
+		}
+	}
+}
+
+/***********************************************************
+ *  TestVisibility()
+ *
+ *  This method is used to test a list of boxes against the
+ *  depth buffer in parallel, in chunks of boxes per task.
+ ***********************************************************/
+void OcclusionCuller::TestVisibility(const OCCLUSION_BOX* pBoxes, int boxCount, uint8_t* pVisible)
+{
+	auto start = std::chrono::steady_clock::now();
+	int chunkCount = (boxCount + g_TestChunkSize - 1) / g_TestChunkSize;
+	int* pChunkVisible = m_pFrameArena->AllocateArray<int>(chunkCount);
+
+	// the task only captures two pointers, which std::function
+	// stores without a heap allocation
+	struct VISIBILITY_TEST
+	{
+		const OCCLUSION_BOX* pBoxes;
+		int boxCount;
+		uint8_t* pVisible;
+		int* pChunkVisible;
+	} test = { pBoxes, boxCount, pVisible, pChunkVisible };
+
+	m_pThreadPool->ParallelFor(chunkCount,
+		[this, &test](int index, int)
+		{
+			int first = index * g_TestChunkSize;
+			int last = std::min(test.boxCount, first + g_TestChunkSize);
+			int visible = 0;
+			for (int i = first; i < last; i++)
+			{
+				test.pVisible[i] = IsBoxVisible(test.pBoxes[i]) ? 1 : 0;
+				visible += test.pVisible[i];
+			}
+			test.pChunkVisible[index] = visible;
+		});
+
+	int visibleCount = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		visibleCount += pChunkVisible[i];
+	}
+
+	m_stats.testedCount += boxCount;
+	m_stats.visibleCount += visibleCount;
+	m_stats.occludedCount += boxCount - visibleCount;
+	m_stats.totalTested += boxCount;
+	m_stats.totalOccluded += boxCount - visibleCount;
+	m_stats.testMilliseconds += ElapsedMilliseconds(start);
+}
+
+/***********************************************************
+ *  IsBoxVisible()
+ *
+ *  This method is used to test one box.  The box is reduced
+ *  to its screen rectangle and its nearest depth, and it is
+ *  hidden only if every pixel in the rectangle, grown by one
+ *  pixel on each side, holds an occluder that is nearer
+ *  still.
+ ***********************************************************/
+bool OcclusionCuller::IsBoxVisible(const OCCLUSION_BOX& box) const
+{
+	glm::mat4 modelViewProjection = m_viewProjection * box.model;
+	float minX = 1e30f;
+	float maxX = -1e30f;
+	float minY = 1e30f;
+	float maxY = -1e30f;
+	float minDepth = 1.0f;
+
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec4 position = modelViewProjection * BoxCorner(box.boundsMin, box.boundsMax, corner);
+
+		// anything reaching behind the eye can't be bounded on
+		// screen, so it is always drawn
+		if (position.w <= g_NearW)
+		{
+			return true;
+		}
+
+		float inverseW = 1.0f / position.w;
+		float x = (position.x * inverseW * 0.5f + 0.5f) * m_width;
+		float y = (position.y * inverseW * 0.5f + 0.5f) * m_height;
+		float depth = position.z * inverseW * 0.5f + 0.5f;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minDepth = std::min(minDepth, depth);
+	}
+
+	if (minDepth <= 0.0f)
+	{
+		return true;
+	}
+
+	int firstColumn = std::max(0, (int)std::floor(minX));
+	int lastColumn = std::min(m_width - 1, (int)std::floor(maxX));
+	int firstRow = std::max(0, (int)std::floor(minY));
+	int lastRow = std::min(m_height - 1, (int)std::floor(maxY));
+
+	// entirely off screen, the GPU would clip all of it anyway
+	if ((firstColumn > lastColumn) || (firstRow > lastRow))
+	{
+		return false;
+	}
+
+	// occluders are sampled at pixel centers, so a pixel an
+	// occluder edge only partly covers can still hold its
+	// depth.  One more pixel on every side reaches past such
+	// an edge, so a box showing less than a pixel beyond it
+	// is still drawn.
+	firstColumn = std::max(0, firstColumn - 1);
+	lastColumn = std::min(m_width - 1, lastColumn + 1);
+	firstRow = std::max(0, firstRow - 1);
+	lastRow = std::min(m_height - 1, lastRow + 1);
+
+	float testDepth = minDepth - g_DepthBias;
+
+#ifdef OCCLUSION_USE_SSE
+	__m128 boxDepth = _mm_set1_ps(testDepth);
+	firstColumn &= ~3;
+#endif
+
+	for (int y = firstRow; y <= lastRow; y++)
+	{
+		const float* pRow = &m_depthBuffer[y * m_width];
+
+#ifdef OCCLUSION_USE_SSE
+		for (int x = firstColumn; x <= lastColumn; x += 4)
+		{
+			// any pixel where the occluders are at or behind the
+			// nearest point of the box lets the box show through
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(pRow + x), boxDepth)) != 0)
+			{
+				return true;
+			}
+		}
+#else
+		for (int x = firstColumn; x <= lastColumn; x++)
+		{
+			if (pRow[x] >= testDepth)
+			{
+				return true;
+			}
+		}
+#endif
+	}
+
+	return false;
+}
+
+/***********************************************************
+ *  DumpDepthBuffer()
+ *
+ *  This method is used to write the depth buffer to a binary
+ *  PGM image for debugging.  Empty pixels are black and the
+ *  occluders are stretched from grey (far) to white (near).
+ ***********************************************************/
+bool OcclusionCuller::DumpDepthBuffer(const char* filename) const
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "ERROR: could not write occlusion depth buffer to " << filename << std::endl;
+		return false;
+	}
+
+	float nearest = 1.0f;
+	float farthest = 0.0f;
+	for (int i = 0; i < (int)m_depthBuffer.size(); i++)
+	{
+		if (m_depthBuffer[i] < 1.0f)
+		{
+			nearest = std::min(nearest, m_depthBuffer[i]);
+			farthest = std::max(farthest, m_depthBuffer[i]);
+		}
+	}
+	float range = std::max(farthest - nearest, 1e-6f);
+
+	file << "P5\n" << m_width << " " << m_height << "\n255\n";
+
+	// images are stored top row first
+	std::vector<unsigned char> row(m_width);
+	for (int y = m_height - 1; y >= 0; y--)
+	{
+		for (int x = 0; x < m_width; x++)
+		{
+			float depth = m_depthBuffer[y * m_width + x];
+			if (depth >= 1.0f)
+			{
+				row[x] = 0;
+			}
+			else
+			{
+				row[x] = (unsigned char)(255.0f - 191.0f * ((depth - nearest) / range));
+			}
+		}
+		file.write((const char*)row.data(), m_width);
+	}
+
+	std::cout << "INFO: occlusion depth buffer written to " << filename << std::endl;
+
+	return true;
+}
@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.h
+// ============
+// software occlusion culling against a low resolution CPU depth buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ThreadPool.h"
+#include "FrameArena.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  OcclusionCuller
+ *
+ *  This class rasterizes a few large occluders into a small
+ *  depth buffer on the CPU, then tests the screen bounds of
+ *  other objects against it so hidden objects can be skipped
+ *  before any draw is issued.  Both steps are split across
+ *  the worker threads, and the inner loops work on four
+ *  pixels at a time with SSE when it is available.  Nothing
+ *  here touches the GPU.  The occluders and everything built
+ *  from them live in the frame arena until the next frame.
+ ***********************************************************/
+class OcclusionCuller
+{
+public:
+	// object space box transformed into the scene
+	struct OCCLUSION_BOX
+	{
+		glm::mat4 model;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	// counters for the most recent frame and since startup
+	struct OCCLUSION_STATS
+	{
+		int occluderCount;
+		int trianglesRasterized;
+		int testedCount;
+		int occludedCount;
+		int visibleCount;
+		double rasterizeMilliseconds;
+		double testMilliseconds;
+		// totals across all frames
+		uint64_t totalTested;
+		uint64_t totalOccluded;
+		uint64_t frameCount;
+	};
+
+	// constructor
+	OcclusionCuller(ThreadPool* pThreadPool, FrameArena* pFrameArena);
+
+	// set the size of the depth buffer, the width is rounded
+	// up to a multiple of four
+	void SetResolution(int width, int height);
+
+	// clear the depth buffer for a new frame and camera
+	void BeginFrame(const glm::mat4& viewProjection);
+	// add a solid box that hides whatever is behind it
+	void AddOccluder(const OCCLUSION_BOX& occluder);
+	// rasterize the occluders added this frame
+	void RasterizeOccluders();
+	// test each box against the depth buffer, writing 1 for
+	// visible and 0 for occluded into pVisible
+	void TestVisibility(const OCCLUSION_BOX* pBoxes, int boxCount, uint8_t* pVisible);
+
+	// write the depth buffer to a greyscale PGM image
+	bool DumpDepthBuffer(const char* filename) const;
+
+	// counters of the most recent frame and since startup
+	const OCCLUSION_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// occluder triangle after projection to the depth buffer
+	struct SCREEN_TRIANGLE
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+		int minX;
+		int maxX;
+		int minY;
+		int maxY;
+		bool bValid;
+	};
+
+	// workers used for setup, rasterization and testing
+	ThreadPool* m_pThreadPool;
+	// storage of the per-frame data
+	FrameArena* m_pFrameArena;
+
+	// depth buffer, row zero at the bottom of the screen, 1.0
+	// where nothing has been drawn
+	std::vector<float> m_depthBuffer;
+	int m_width;
+	int m_height;
+
+	// camera of the current frame
+	glm::mat4 m_viewProjection;
+	// occluders and their projected triangles
+	FrameVector<OCCLUSION_BOX> m_occluders;
+	SCREEN_TRIANGLE* m_pTriangles;
+	int m_triangleCount;
+
+	OCCLUSION_STATS m_stats;
+
+	// project the triangles of one occluder box
+	void SetupOccluderTriangles(int occluderIndex);
+	// rasterize every triangle into the rows [rowStart, rowEnd)
+	void RasterizeBand(int rowStart, int rowEnd);
+	// test a single box, returns true if any of it may be seen
+	bool IsBoxVisible(const OCCLUSION_BOX& box) const;
+};
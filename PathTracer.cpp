@@ -0,0 +1,458 @@
+///////////////////////////////////////////////////////////////////////////////
+// pathtracer.cpp
+// ============
+// offline CPU path traced reference images of the scene
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PathTracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+// declaration of global variables
+namespace
+{
+	// pixels along each side of a tile, a multiple of the 2 by
+	// 2 ray packets
+	const int g_TileSize = 16;
+	// rays leave a surface this far from it so they don't hit
+	// it again
+	const float g_RayOffset = 1e-3f;
+	// see-through surfaces a path may pass before it is ended
+	const int g_MaxPassThroughs = 8;
+	// bounces before paths may be ended at random
+	const int g_RouletteStart = 2;
+	const float g_Pi = 3.14159265f;
+
+	// ray counter of one thread, on its own cache line
+	struct THREAD_RAYS
+	{
+		uint64_t count;
+		char padding[56];
+	};
+
+	/***********************************************************
+	 *  NextRandom()
+	 *
+	 *  SplitMix64 step, the same numbers on every platform.
+	 ***********************************************************/
+	inline uint64_t NextRandom(uint64_t& state)
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return(z ^ (z >> 31));
+	}
+
+	/***********************************************************
+	 *  NextFloat()
+	 *
+	 *  Uniform random number in [0, 1).
+	 ***********************************************************/
+	inline float NextFloat(uint64_t& state)
+	{
+		return((float)(NextRandom(state) >> 40) / 16777216.0f);
+	}
+
+	/***********************************************************
+	 *  CosineDirection()
+	 *
+	 *  Random direction about a normal, more likely the closer
+	 *  it is to the normal, which matches diffuse reflection so
+	 *  no weight is needed.
+	 ***********************************************************/
+	glm::vec3 CosineDirection(const glm::vec3& normal, uint64_t& state)
+	{
+		float angle = 2.0f * g_Pi * NextFloat(state);
+		float radiusSquared = NextFloat(state);
+		float radius = std::sqrt(radiusSquared);
+
+		glm::vec3 tangent = (std::fabs(normal.x) > 0.9f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		tangent = glm::normalize(glm::cross(tangent, normal));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+
+		return(glm::normalize(tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) +
+			normal * std::sqrt(std::max(0.0f, 1.0f - radiusSquared))));
+	}
+}
+
+/***********************************************************
+ *  PathTracer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PathTracer::PathTracer(ThreadPool* pThreadPool)
+{
+	m_pThreadPool = pThreadPool;
+	m_pIndex = NULL;
+	m_width = 0;
+	m_height = 0;
+	m_stats.rayCount = 0;
+	m_stats.passCount = 0;
+	m_stats.seconds = 0.0;
+	m_stats.raysPerSecond = 0.0;
+}
+
+/***********************************************************
+ *  GetDefaultSettings()
+ *
+ *  This method is used to get settings for a reference image
+ *  of the given size.  The background is the clear color of
+ *  the rasterized frame.
+ ***********************************************************/
+PathTracer::TRACE_SETTINGS PathTracer::GetDefaultSettings(int width, int height)
+{
+	TRACE_SETTINGS settings;
+
+	settings.width = width;
+	settings.height = height;
+	settings.samplesPerPixel = 64;
+	settings.maxBounces = 4;
+	settings.saveInterval = 8;
+	settings.backgroundColor = glm::vec3(0.0f);
+
+	return(settings);
+}
+
+/***********************************************************
+ *  SetScene()
+ *
+ *  This method is used to set the objects and lights to
+ *  trace.  The index is kept, not copied, so it must outlive
+ *  the renders.
+ ***********************************************************/
+void PathTracer::SetScene(
+	const SpatialIndex* pIndex,
+	const std::vector<TRACE_SURFACE>& surfaces,
+	const std::vector<TRACE_LIGHT>& lights)
+{
+	m_pIndex = pIndex;
+	m_surfaces = surfaces;
+	m_lights = lights;
+}
+
+/***********************************************************
+ *  Render()
+ *
+ *  This method is used to render the scene as seen by a
+ *  camera.  Every pass adds one jittered sample to each
+ *  pixel, with the tiles of the image spread over the
+ *  threads, and the image written so far can be looked at
+ *  while the passes go on.
+ ***********************************************************/
+bool PathTracer::Render(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const TRACE_SETTINGS& settings,
+	const char* filename)
+{
+	if ((m_pIndex == NULL) || (m_pIndex->GetObjectCount() == 0) ||
+		(m_surfaces.size() != (size_t)m_pIndex->GetObjectCount()))
+	{
+		std::cout << "ERROR: path tracer has no scene to render" << std::endl;
+		return false;
+	}
+	if ((settings.width <= 0) || (settings.height <= 0) || (settings.samplesPerPixel <= 0))
+	{
+		std::cout << "ERROR: path tracer image of " << settings.width << "x" << settings.height << " with "
+			<< settings.samplesPerPixel << " samples can't be rendered" << std::endl;
+		return false;
+	}
+
+	m_width = settings.width;
+	m_height = settings.height;
+	m_accumulation.assign((size_t)m_width * m_height, glm::vec3(0.0f));
+
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	int tilesX = (m_width + g_TileSize - 1) / g_TileSize;
+	int tilesY = (m_height + g_TileSize - 1) / g_TileSize;
+	std::vector<THREAD_RAYS> threadRays(m_pThreadPool->GetThreadCount());
+	for (int i = 0; i < (int)threadRays.size(); i++)
+	{
+		threadRays[i].count = 0;
+	}
+
+	std::cout << "INFO: path tracing " << m_width << "x" << m_height << " at " << settings.samplesPerPixel
+		<< " samples per pixel with " << m_pThreadPool->GetThreadCount() << " threads" << std::endl;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < settings.samplesPerPixel; pass++)
+	{
+		m_pThreadPool->ParallelFor(tilesX * tilesY, [&](int tile, int threadIndex)
+			{
+				int tileX = (tile % tilesX) * g_TileSize;
+				int tileY = (tile / tilesX) * g_TileSize;
+				uint64_t rayCount = 0;
+
+				for (int y = tileY; (y < tileY + g_TileSize) && (y < m_height); y += 2)
+				{
+					for (int x = tileX; (x < tileX + g_TileSize) && (x < m_width); x += 2)
+					{
+						glm::vec3 origins[4];
+						glm::vec3 directions[4];
+						int pixels[4];
+						uint64_t randomStates[4];
+
+						for (int lane = 0; lane < 4; lane++)
+						{
+							// pixels past the edge trace a copy of the
+							// first ray and are dropped
+							int pixelX = x + (lane & 1);
+							int pixelY = y + (lane >> 1);
+							bool bInside = (pixelX < m_width) && (pixelY < m_height);
+							if (bInside == false)
+							{
+								pixelX = x;
+								pixelY = y;
+							}
+							int pixel = pixelY * m_width + pixelX;
+							pixels[lane] = bInside ? pixel : -1;
+							randomStates[lane] = ((uint64_t)pass << 40) ^ (uint64_t)pixel;
+							NextRandom(randomStates[lane]);
+
+							float screenX = ((float)pixelX + NextFloat(randomStates[lane])) / m_width * 2.0f - 1.0f;
+							float screenY = ((float)pixelY + NextFloat(randomStates[lane])) / m_height * 2.0f - 1.0f;
+							glm::vec4 nearPoint = inverseViewProjection * glm::vec4(screenX, screenY, -1.0f, 1.0f);
+							glm::vec4 farPoint = inverseViewProjection * glm::vec4(screenX, screenY, 1.0f, 1.0f);
+							origins[lane] = glm::vec3(nearPoint) / nearPoint.w;
+							directions[lane] = glm::normalize(glm::vec3(farPoint) / farPoint.w - origins[lane]);
+						}
+
+						SpatialIndex::RAY_HIT hits[4];
+						bool bHits[4];
+						m_pIndex->RaycastPacket(origins, directions, std::numeric_limits<float>::max(), hits, bHits);
+						rayCount += 4;
+
+						for (int lane = 0; lane < 4; lane++)
+						{
+							if (pixels[lane] < 0)
+							{
+								continue;
+							}
+							m_accumulation[pixels[lane]] += bHits[lane] ?
+								TracePath(directions[lane], hits[lane], settings, randomStates[lane], rayCount) :
+								settings.backgroundColor;
+						}
+					}
+				}
+
+				threadRays[threadIndex].count += rayCount;
+			});
+
+		int passCount = pass + 1;
+		bool bLastPass = (passCount == settings.samplesPerPixel);
+		if (bLastPass || ((settings.saveInterval > 0) && (passCount % settings.saveInterval == 0)))
+		{
+			m_stats.rayCount = 0;
+			for (int i = 0; i < (int)threadRays.size(); i++)
+			{
+				m_stats.rayCount += threadRays[i].count;
+			}
+			m_stats.passCount = passCount;
+			m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			m_stats.raysPerSecond = (m_stats.seconds > 0.0) ? (double)m_stats.rayCount / m_stats.seconds : 0.0;
+
+			std::cout << "Path tracing pass " << passCount << " of " << settings.samplesPerPixel << ": "
+				<< (m_stats.raysPerSecond / 1.0e6) << " Mrays/s, " << m_stats.seconds << " s" << std::endl;
+			if (WriteImage(filename, passCount) == false)
+			{
+				return false;
+			}
+		}
+	}
+
+	std::cout << "Path traced " << m_stats.rayCount << " rays in " << m_stats.seconds << " s, "
+		<< (m_stats.raysPerSecond / 1.0e6) << " Mrays/s, written to " << filename << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  TracePath()
+ *
+ *  This method is used to follow a path from the first hit
+ *  of a camera ray.  Each hit adds the direct light it gets,
+ *  scaled by the surfaces the path bounced off so far, and
+ *  continues diffusely.  See-through surfaces let rays pass
+ *  as often as they are transparent, and paths carrying
+ *  little light are ended at random, with the survivors
+ *  weighted up to keep the average right.
+ ***********************************************************/
+glm::vec3 PathTracer::TracePath(
+	const glm::vec3& direction,
+	const SpatialIndex::RAY_HIT& firstHit,
+	const TRACE_SETTINGS& settings,
+	uint64_t& randomState,
+	uint64_t& rayCount) const
+{
+	glm::vec3 color(0.0f);
+	glm::vec3 throughput(1.0f);
+	glm::vec3 rayDirection = direction;
+	SpatialIndex::RAY_HIT hit = firstHit;
+	int bounce = 0;
+	int passThroughs = 0;
+
+	while (true)
+	{
+		const TRACE_SURFACE& surface = m_surfaces[hit.objectIndex];
+		glm::vec3 normal = (glm::dot(hit.normal, rayDirection) > 0.0f) ? -hit.normal : hit.normal;
+		glm::vec3 rayOrigin;
+
+		if ((surface.opacity < 1.0f) && (NextFloat(randomState) >= surface.opacity))
+		{
+			if (++passThroughs > g_MaxPassThroughs)
+			{
+				break;
+			}
+			rayOrigin = hit.point + rayDirection * g_RayOffset;
+		}
+		else
+		{
+			rayOrigin = hit.point + normal * g_RayOffset;
+			color += throughput * surface.baseColor *
+				SampleLights(rayOrigin, normal, -rayDirection, surface, rayCount);
+
+			if (bounce >= settings.maxBounces)
+			{
+				break;
+			}
+			bounce++;
+			throughput *= surface.baseColor * surface.diffuseColor;
+
+			if (bounce > g_RouletteStart)
+			{
+				float survival = std::min(1.0f, std::max(throughput.x, std::max(throughput.y, throughput.z)));
+				if ((survival <= 0.0f) || (NextFloat(randomState) >= survival))
+				{
+					break;
+				}
+				throughput /= survival;
+			}
+			rayDirection = CosineDirection(normal, randomState);
+		}
+
+		rayCount++;
+		if (m_pIndex->Raycast(rayOrigin, rayDirection, std::numeric_limits<float>::max(), hit) == false)
+		{
+			// only rays still on their way from the camera see
+			// the background, the scene is lit by its lights alone
+			if (bounce == 0)
+			{
+				color += throughput * settings.backgroundColor;
+			}
+			break;
+		}
+	}
+
+	return(color);
+}
+
+/***********************************************************
+ *  SampleLights()
+ *
+ *  This method is used to add up the diffuse and specular
+ *  light each light gives a point, with the terms of the
+ *  scene shader.  A shadow ray checks that nothing is in the
+ *  way, and a see-through blocker dims the light by its
+ *  opacity.
+ ***********************************************************/
+glm::vec3 PathTracer::SampleLights(
+	const glm::vec3& point,
+	const glm::vec3& normal,
+	const glm::vec3& viewDirection,
+	const TRACE_SURFACE& surface,
+	uint64_t& rayCount) const
+{
+	glm::vec3 result(0.0f);
+
+	for (int i = 0; i < (int)m_lights.size(); i++)
+	{
+		const TRACE_LIGHT& light = m_lights[i];
+		glm::vec3 toLight;
+		float distance = std::numeric_limits<float>::max();
+		float attenuation = 1.0f;
+
+		if (light.bPointLight)
+		{
+			toLight = light.vector - point;
+			distance = glm::length(toLight);
+			if (distance <= 0.0f)
+			{
+				continue;
+			}
+			toLight /= distance;
+			attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+		}
+		else
+		{
+			toLight = glm::normalize(-light.vector);
+		}
+
+		float diffuse = glm::dot(normal, toLight);
+		if (diffuse <= 0.0f)
+		{
+			continue;
+		}
+
+		float visibility = 1.0f;
+		SpatialIndex::RAY_HIT blocker;
+		rayCount++;
+		if (m_pIndex->Raycast(point, toLight, distance, blocker))
+		{
+			visibility = 1.0f - m_surfaces[blocker.objectIndex].opacity;
+			if (visibility <= 0.0f)
+			{
+				continue;
+			}
+		}
+
+		glm::vec3 reflected = normal * (2.0f * diffuse) - toLight;
+		float specular = std::pow(std::max(glm::dot(viewDirection, reflected), 0.0f), surface.shininess);
+
+		result += (light.diffuse * surface.diffuseColor * diffuse + light.specular * surface.specularColor * specular) *
+			(attenuation * visibility);
+	}
+
+	return(result);
+}
+
+/***********************************************************
+ *  WriteImage()
+ *
+ *  This method is used to write the average of the passes so
+ *  far as a binary PPM image.  Values are clamped but not
+ *  gamma corrected, like the rasterized frame.
+ ***********************************************************/
+bool PathTracer::WriteImage(const char* filename, int passCount) const
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "ERROR: could not write path traced image to " << filename << std::endl;
+		return false;
+	}
+
+	file << "P6\n" << m_width << " " << m_height << "\n255\n";
+
+	// images are stored top row first
+	float scale = 1.0f / (float)passCount;
+	std::vector<unsigned char> row((size_t)m_width * 3);
+	for (int y = m_height - 1; y >= 0; y--)
+	{
+		for (int x = 0; x < m_width; x++)
+		{
+			glm::vec3 color = m_accumulation[(size_t)y * m_width + x] * scale;
+			for (int c = 0; c < 3; c++)
+			{
+				row[x * 3 + c] = (unsigned char)(std::min(std::max(color[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+		}
+		file.write((const char*)row.data(), row.size());
+	}
+
+	return(file.good());
+}
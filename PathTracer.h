@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+// pathtracer.h
+// ============
+// offline CPU path traced reference images of the scene
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SpatialIndex.h"
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  PathTracer
+ *
+ *  This class renders ground truth images of the scene on
+ *  the CPU.  Rays are traced through the SpatialIndex, with
+ *  the camera rays of each 2 by 2 block of pixels traced as
+ *  one packet.  At every hit the lights are sampled with
+ *  shadow rays using the Phong terms of the scene shader,
+ *  and the path continues in a cosine weighted direction to
+ *  gather the light bounced between objects, which the
+ *  rasterizer stands in for with its ambient term.
+ *
+ *  The image is split into tiles handed to every core, and
+ *  refined one sample per pixel per pass.  Each pixel and
+ *  pass has its own random sequence, so the image does not
+ *  depend on which thread traced a tile.
+ ***********************************************************/
+class PathTracer
+{
+public:
+	// shading values of one indexed object
+	struct TRACE_SURFACE
+	{
+		// texture or flat color of the object
+		glm::vec3 baseColor;
+		glm::vec3 diffuseColor;
+		glm::vec3 specularColor;
+		float shininess;
+		// chance a ray is stopped by the surface
+		float opacity;
+	};
+
+	// a light of the scene, as set up for the shaders
+	struct TRACE_LIGHT
+	{
+		bool bPointLight;
+		// direction of the directional light, position of a point
+		glm::vec3 vector;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		float constant;
+		float linear;
+		float quadratic;
+	};
+
+	// what to render
+	struct TRACE_SETTINGS
+	{
+		int width;
+		int height;
+		int samplesPerPixel;
+		// bounces after the camera ray
+		int maxBounces;
+		// write the image after this many passes, 0 for only at
+		// the end
+		int saveInterval;
+		// seen by camera rays that miss the scene
+		glm::vec3 backgroundColor;
+	};
+
+	// counters of the last render
+	struct TRACE_STATS
+	{
+		uint64_t rayCount;
+		int passCount;
+		double seconds;
+		double raysPerSecond;
+	};
+
+	// constructor
+	PathTracer(ThreadPool* pThreadPool);
+
+	// default settings for a reference image of a given size
+	static TRACE_SETTINGS GetDefaultSettings(int width, int height);
+
+	// scene to trace, with one surface per indexed object
+	void SetScene(
+		const SpatialIndex* pIndex,
+		const std::vector<TRACE_SURFACE>& surfaces,
+		const std::vector<TRACE_LIGHT>& lights);
+
+	// render the view of a camera into an image file,
+	// refining it pass by pass
+	bool Render(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const TRACE_SETTINGS& settings,
+		const char* filename);
+
+	const TRACE_STATS& GetStats() const { return(m_stats); }
+
+private:
+	ThreadPool* m_pThreadPool;
+	const SpatialIndex* m_pIndex;
+	std::vector<TRACE_SURFACE> m_surfaces;
+	std::vector<TRACE_LIGHT> m_lights;
+
+	// sum of the samples of each pixel, bottom row first
+	std::vector<glm::vec3> m_accumulation;
+	int m_width;
+	int m_height;
+	TRACE_STATS m_stats;
+
+	// light carried back along a path from its first hit
+	glm::vec3 TracePath(
+		const glm::vec3& direction,
+		const SpatialIndex::RAY_HIT& firstHit,
+		const TRACE_SETTINGS& settings,
+		uint64_t& randomState,
+		uint64_t& rayCount) const;
+	// direct light reaching a point from every light
+	glm::vec3 SampleLights(
+		const glm::vec3& point,
+		const glm::vec3& normal,
+		const glm::vec3& viewDirection,
+		const TRACE_SURFACE& surface,
+		uint64_t& rayCount) const;
+	// write the average of the passes so far
+	bool WriteImage(const char* filename, int passCount) const;
+};
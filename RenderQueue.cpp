@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.cpp
+// ============
+// collect the draws of a frame into render passes and sort them
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	/***********************************************************
+	 *  DepthSortKey()
+	 *
+	 *  Convert a view depth into an integer that sorts in the
+	 *  same order.  Positive IEEE floats compare like unsigned
+	 *  integers, and anything behind the camera clamps to zero.
+	 ***********************************************************/
+	uint32_t DepthSortKey(float depth)
+	{
+		uint32_t bits = 0;
+
+		if (depth < 0.0f)
+		{
+			depth = 0.0f;
+		}
+		std::memcpy(&bits, &depth, sizeof(bits));
+
+		return(bits);
+	}
+}
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue(FrameArena* pFrameArena)
+{
+	m_pFrameArena = pFrameArena;
+	for (int pass = 0; pass < PASS_COUNT; pass++)
+	{
+		m_lastItemCount[pass] = 0;
+	}
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used to empty every pass.  The storage
+ *  belongs to the frame that is ending, so it is let go of
+ *  rather than kept, and only the size is remembered.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+	for (int pass = 0; pass < PASS_COUNT; pass++)
+	{
+		m_lastItemCount[pass] = std::max(m_lastItemCount[pass], m_items[pass].size());
+		FrameVector<RENDER_ITEM>(FrameAllocator<RENDER_ITEM>(m_pFrameArena)).swap(m_items[pass]);
+		FrameVector<int>(FrameAllocator<int>(m_pFrameArena)).swap(m_sortedOrder[pass]);
+	}
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used to add a draw to the given pass.
+ ***********************************************************/
+void RenderQueue::Submit(RENDER_PASS pass, const RENDER_ITEM& item)
+{
+	// growing in the arena leaves the old storage unused until
+	// the frame ends, so the last frame's size is taken at once
+	if (m_items[pass].capacity() == 0)
+	{
+		m_items[pass].reserve(std::max(m_lastItemCount[pass], (size_t)64));
+	}
+	m_items[pass].push_back(item);
+	m_items[pass].back().bVisible = true;
+	m_items[pass].back().drawIndex = -1;
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method is used to build the draw order of each pass.
+ *  Opaque draws go nearest first so hidden fragments fail the
+ *  depth test early, and transparent draws go farthest first
+ *  so they blend over what is behind them.  Draws that have
+ *  been culled are left out of the order.
+ ***********************************************************/
+void RenderQueue::Sort(const glm::mat4& view)
+{
+	for (int pass = 0; pass < PASS_COUNT; pass++)
+	{
+		FrameVector<RENDER_ITEM>& items = m_items[pass];
+		FrameVector<int>& order = m_sortedOrder[pass];
+
+		order.clear();
+		order.reserve(items.size());
+		for (int i = 0; i < (int)items.size(); i++)
+		{
+			if (items[i].bVisible == false)
+			{
+				continue;
+			}
+
+			// the object origin is a good enough sort position for
+			// the small, separate shapes that make up the scene
+			glm::vec4 origin = items[i].drawData.model[3];
+			float depth = -(view * origin).z;
+			uint32_t depthKey = DepthSortKey(depth);
+
+			if (pass == PASS_TRANSPARENT)
+			{
+				depthKey = ~depthKey;
+			}
+
+			// the upper bits are left free for grouping by state
+			items[i].sortKey = (items[i].sortKey & 0xFFFFFFFF00000000ull) | depthKey;
+			order.push_back(i);
+		}
+
+		std::sort(order.begin(), order.end(),
+			[&items](int a, int b) { return(items[a].sortKey < items[b].sortKey); });
+	}
+}
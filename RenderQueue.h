@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.h
+// ============
+// collect the draws of a frame into render passes and sort them
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "DrawDataRingBuffer.h"
+#include "FrameArena.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class holds every draw submitted during a frame,
+ *  split into an opaque pass that is sorted front-to-back
+ *  and a transparent pass that is sorted back-to-front.  The
+ *  draws and their order live in the frame arena, so the
+ *  queue has to be cleared before the arena starts a frame.
+ ***********************************************************/
+class RenderQueue
+{
+public:
+	// the basic shapes that can be drawn
+	enum MESH_TYPE
+	{
+		MESH_PLANE,
+		MESH_BOX,
+		MESH_CYLINDER,
+		MESH_TAPERED_CYLINDER,
+		MESH_CONE,
+		MESH_TORUS,
+		MESH_PRISM,
+		MESH_TYPE_COUNT
+	};
+
+	// parts of a capped shape to draw
+	enum MESH_PART_FLAGS
+	{
+		MESH_PART_TOP = 1,
+		MESH_PART_BOTTOM = 2,
+		MESH_PART_SIDES = 4,
+		MESH_PART_ALL = 7
+	};
+
+	// how a draw is combined with the frame behind it
+	enum BLEND_MODE
+	{
+		BLEND_OPAQUE,
+		BLEND_ALPHA,
+		BLEND_ADDITIVE
+	};
+
+	// passes the draws are split into
+	enum RENDER_PASS
+	{
+		PASS_OPAQUE,
+		PASS_TRANSPARENT,
+		PASS_COUNT
+	};
+
+	// everything needed to issue one draw
+	struct RENDER_ITEM
+	{
+		MESH_TYPE meshType;
+		unsigned int meshParts;
+		// imported model drawn instead of the basic shape, -1 for
+		// none
+		int model;
+		BLEND_MODE blendMode;
+		DrawDataRingBuffer::DRAW_DATA drawData;
+		uint64_t sortKey;
+		// cleared by culling to leave the draw out of the pass
+		bool bVisible;
+		// ring buffer record written for the draw this frame,
+		// shared by every view drawing it, -1 until written
+		int drawIndex;
+	};
+
+	// constructor
+	RenderQueue(FrameArena* pFrameArena);
+
+	// remove the draws of the previous frame
+	void Clear();
+	// add a draw to a render pass
+	void Submit(RENDER_PASS pass, const RENDER_ITEM& item);
+	// order the visible draws of each pass by their distance
+	// from the camera
+	void Sort(const glm::mat4& view);
+
+	// number of draws submitted to a render pass
+	int GetSubmittedCount(RENDER_PASS pass) const { return((int)m_items[pass].size()); }
+	// draw in submission order, for culling before the sort
+	RENDER_ITEM& GetSubmittedItem(RENDER_PASS pass, int index) { return(m_items[pass][index]); }
+
+	// number of draws left in a render pass after sorting
+	int GetItemCount(RENDER_PASS pass) const { return((int)m_sortedOrder[pass].size()); }
+	// draw at the given position of the sorted pass
+	const RENDER_ITEM& GetSortedItem(RENDER_PASS pass, int index) const
+	{
+		return(m_items[pass][m_sortedOrder[pass][index]]);
+	}
+	RENDER_ITEM& GetSortedItem(RENDER_PASS pass, int index)
+	{
+		return(m_items[pass][m_sortedOrder[pass][index]]);
+	}
+
+private:
+	FrameArena* m_pFrameArena;
+	// submitted draws of each pass
+	FrameVector<RENDER_ITEM> m_items[PASS_COUNT];
+	// draw order of each pass after sorting
+	FrameVector<int> m_sortedOrder[PASS_COUNT];
+	// most draws submitted to each pass in one frame so far,
+	// the room reserved up front in the next one
+	size_t m_lastItemCount[PASS_COUNT];
+};
@@ -0,0 +1,293 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderstats.cpp
+// ============
+// count the work each frame hands to OpenGL and log it
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderStats.h"
+#include "GpuResources.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// how often the averages shown on screen are refreshed
+	const double g_AverageIntervalMilliseconds = 500.0;
+	// frames between GPU memory queries, which may be slow on
+	// some drivers
+	const int g_MemoryQueryInterval = 30;
+
+	const char* g_CounterNames[RenderStats::COUNTER_COUNT] =
+	{
+		"draw_calls",
+		"triangles",
+		"texture_binds",
+		"uniform_uploads",
+		"state_changes",
+		"upload_bytes"
+	};
+}
+
+uint64_t RenderStats::s_counters[RenderStats::COUNTER_COUNT] = {};
+
+/***********************************************************
+ *  RenderStats()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderStats::RenderStats()
+{
+	std::memset(&m_lastFrame, 0, sizeof(m_lastFrame));
+	std::memset(&m_sum, 0, sizeof(m_sum));
+	std::memset(&m_average, 0, sizeof(m_average));
+	m_lastFrame.gpuMemoryUsedMB = -1;
+	m_lastFrame.gpuMemoryFreeMB = -1;
+	m_average.gpuMemoryUsedMB = -1;
+	m_average.gpuMemoryFreeMB = -1;
+	m_sumFrameCount = 0;
+	m_averageVersion = 0;
+	m_frameIndex = 0;
+	m_lastFrameEnd = std::chrono::steady_clock::now();
+	m_lastAverageTime = m_lastFrameEnd;
+	m_gpuMemoryUsedMB = -1;
+	m_gpuMemoryFreeMB = -1;
+	m_viewCount = 1;
+	m_sharedMilliseconds = 0.0;
+	m_firstViewMilliseconds = 0.0;
+	m_extraViewMilliseconds = 0.0;
+	m_bJsonLog = false;
+}
+
+/***********************************************************
+ *  ~RenderStats()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderStats::~RenderStats()
+{
+	if (m_logFile.is_open())
+	{
+		if (m_bJsonLog)
+		{
+			m_logFile << "\n]\n";
+		}
+		m_logFile.close();
+	}
+}
+
+/***********************************************************
+ *  GetCounterName()
+ *
+ *  This method is used to get the name a counter is logged
+ *  under.
+ ***********************************************************/
+const char* RenderStats::GetCounterName(COUNTER counter)
+{
+	return(g_CounterNames[counter]);
+}
+
+/***********************************************************
+ *  OpenLog()
+ *
+ *  This method is used to start writing every frame to a
+ *  file.  A CSV file gets a header line, and a JSON file
+ *  holds an array with one object per line, closed when the
+ *  stats are deleted.
+ ***********************************************************/
+bool RenderStats::OpenLog(const char* filename)
+{
+	size_t length = std::strlen(filename);
+	m_bJsonLog = (length >= 5) && (std::strcmp(filename + length - 5, ".json") == 0);
+
+	m_logFile.open(filename, std::ios::trunc);
+	if (!m_logFile)
+	{
+		std::cout << "ERROR: could not create render stats log " << filename << std::endl;
+		return false;
+	}
+
+	if (m_bJsonLog)
+	{
+		m_logFile << "[";
+	}
+	else
+	{
+		m_logFile << "frame,frame_ms,submit_ms";
+		for (int i = 0; i < COUNTER_COUNT; i++)
+		{
+			m_logFile << "," << g_CounterNames[i];
+		}
+		m_logFile << ",gpu_memory_used_mb,gpu_memory_free_mb,tracked_gpu_bytes"
+			<< ",view_count,shared_ms,first_view_ms,extra_view_ms\n";
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  SetViewTimes()
+ *
+ *  This method is used to record how the submit time of the
+ *  frame divides between the work shared by its views and
+ *  the views themselves.  Frames that don't set it count as
+ *  a single view with no split.
+ ***********************************************************/
+void RenderStats::SetViewTimes(int viewCount, double sharedMilliseconds, double firstViewMilliseconds,
+	double extraViewMilliseconds)
+{
+	m_viewCount = viewCount;
+	m_sharedMilliseconds = sharedMilliseconds;
+	m_firstViewMilliseconds = firstViewMilliseconds;
+	m_extraViewMilliseconds = extraViewMilliseconds;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used to take the counts of the frame that
+ *  was just submitted and reset them for the next.  The
+ *  frame time runs from the end of the previous frame.
+ ***********************************************************/
+void RenderStats::EndFrame(double submitMilliseconds)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	if ((m_frameIndex % g_MemoryQueryInterval) == 0)
+	{
+		QueryGpuMemory();
+	}
+
+	m_lastFrame.frameIndex = m_frameIndex;
+	m_lastFrame.frameMilliseconds = std::chrono::duration<double, std::milli>(now - m_lastFrameEnd).count();
+	m_lastFrame.submitMilliseconds = submitMilliseconds;
+	for (int i = 0; i < COUNTER_COUNT; i++)
+	{
+		m_lastFrame.counters[i] = s_counters[i];
+		s_counters[i] = 0;
+	}
+	m_lastFrame.gpuMemoryUsedMB = m_gpuMemoryUsedMB;
+	m_lastFrame.gpuMemoryFreeMB = m_gpuMemoryFreeMB;
+	m_lastFrame.trackedGpuBytes = GpuResourceRegistry::GetCurrentBytes();
+	m_lastFrame.viewCount = m_viewCount;
+	m_lastFrame.sharedMilliseconds = m_sharedMilliseconds;
+	m_lastFrame.firstViewMilliseconds = m_firstViewMilliseconds;
+	m_lastFrame.extraViewMilliseconds = m_extraViewMilliseconds;
+	m_viewCount = 1;
+	m_sharedMilliseconds = 0.0;
+	m_firstViewMilliseconds = 0.0;
+	m_extraViewMilliseconds = 0.0;
+	m_lastFrameEnd = now;
+	m_frameIndex++;
+
+	if (m_logFile.is_open())
+	{
+		WriteLogLine(m_lastFrame);
+	}
+
+	m_sum.frameMilliseconds += m_lastFrame.frameMilliseconds;
+	m_sum.submitMilliseconds += m_lastFrame.submitMilliseconds;
+	m_sum.sharedMilliseconds += m_lastFrame.sharedMilliseconds;
+	m_sum.firstViewMilliseconds += m_lastFrame.firstViewMilliseconds;
+	m_sum.extraViewMilliseconds += m_lastFrame.extraViewMilliseconds;
+	for (int i = 0; i < COUNTER_COUNT; i++)
+	{
+		m_sum.counters[i] += m_lastFrame.counters[i];
+	}
+	m_sumFrameCount++;
+
+	if (std::chrono::duration<double, std::milli>(now - m_lastAverageTime).count() >= g_AverageIntervalMilliseconds)
+	{
+		m_average.frameIndex = m_lastFrame.frameIndex;
+		m_average.frameMilliseconds = m_sum.frameMilliseconds / m_sumFrameCount;
+		m_average.submitMilliseconds = m_sum.submitMilliseconds / m_sumFrameCount;
+		m_average.sharedMilliseconds = m_sum.sharedMilliseconds / m_sumFrameCount;
+		m_average.firstViewMilliseconds = m_sum.firstViewMilliseconds / m_sumFrameCount;
+		m_average.extraViewMilliseconds = m_sum.extraViewMilliseconds / m_sumFrameCount;
+		m_average.viewCount = m_lastFrame.viewCount;
+		for (int i = 0; i < COUNTER_COUNT; i++)
+		{
+			m_average.counters[i] = (m_sum.counters[i] + m_sumFrameCount / 2) / m_sumFrameCount;
+		}
+		m_average.gpuMemoryUsedMB = m_gpuMemoryUsedMB;
+		m_average.gpuMemoryFreeMB = m_gpuMemoryFreeMB;
+		m_average.trackedGpuBytes = m_lastFrame.trackedGpuBytes;
+		m_averageVersion++;
+
+		std::memset(&m_sum, 0, sizeof(m_sum));
+		m_sumFrameCount = 0;
+		m_lastAverageTime = now;
+	}
+}
+
+/***********************************************************
+ *  QueryGpuMemory()
+ *
+ *  This method is used to read how much video memory is in
+ *  use, through the NVIDIA or AMD extension.  AMD only
+ *  reports the free memory.
+ ***********************************************************/
+void RenderStats::QueryGpuMemory()
+{
+	if (GLEW_NVX_gpu_memory_info)
+	{
+		GLint totalKB = 0;
+		GLint availableKB = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &totalKB);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &availableKB);
+		m_gpuMemoryUsedMB = (totalKB - availableKB) / 1024;
+		m_gpuMemoryFreeMB = availableKB / 1024;
+	}
+	else if (GLEW_ATI_meminfo)
+	{
+		GLint textureFree[4] = { 0, 0, 0, 0 };
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, textureFree);
+		m_gpuMemoryUsedMB = -1;
+		m_gpuMemoryFreeMB = textureFree[0] / 1024;
+	}
+}
+
+/***********************************************************
+ *  WriteLogLine()
+ *
+ *  This method is used to append one frame to the log.  The
+ *  file is left to buffer the lines, so logging costs no
+ *  flush per frame.
+ ***********************************************************/
+void RenderStats::WriteLogLine(const FRAME_STATS& frame)
+{
+	char times[96];
+	char viewTimes[128];
+
+	if (m_bJsonLog)
+	{
+		snprintf(times, sizeof(times), "\"frame_ms\": %.3f, \"submit_ms\": %.3f",
+			frame.frameMilliseconds, frame.submitMilliseconds);
+		m_logFile << ((frame.frameIndex == 0) ? "\n" : ",\n") << "  { \"frame\": " << frame.frameIndex << ", " << times;
+		for (int i = 0; i < COUNTER_COUNT; i++)
+		{
+			m_logFile << ", \"" << g_CounterNames[i] << "\": " << frame.counters[i];
+		}
+		snprintf(viewTimes, sizeof(viewTimes),
+			"\"view_count\": %d, \"shared_ms\": %.3f, \"first_view_ms\": %.3f, \"extra_view_ms\": %.3f",
+			frame.viewCount, frame.sharedMilliseconds, frame.firstViewMilliseconds, frame.extraViewMilliseconds);
+		m_logFile << ", \"gpu_memory_used_mb\": " << frame.gpuMemoryUsedMB
+			<< ", \"gpu_memory_free_mb\": " << frame.gpuMemoryFreeMB
+			<< ", \"tracked_gpu_bytes\": " << frame.trackedGpuBytes << ", " << viewTimes << " }";
+	}
+	else
+	{
+		snprintf(times, sizeof(times), "%.3f,%.3f", frame.frameMilliseconds, frame.submitMilliseconds);
+		m_logFile << frame.frameIndex << "," << times;
+		for (int i = 0; i < COUNTER_COUNT; i++)
+		{
+			m_logFile << "," << frame.counters[i];
+		}
+		snprintf(viewTimes, sizeof(viewTimes), "%d,%.3f,%.3f,%.3f", frame.viewCount,
+			frame.sharedMilliseconds, frame.firstViewMilliseconds, frame.extraViewMilliseconds);
+		m_logFile << "," << frame.gpuMemoryUsedMB << "," << frame.gpuMemoryFreeMB << "," << frame.trackedGpuBytes
+			<< "," << viewTimes << "\n";
+	}
+}
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderstats.h
+// ============
+// count the work each frame hands to OpenGL and log it
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/***********************************************************
+ *  RenderStats
+ *
+ *  This class collects what every frame asks of OpenGL: draw
+ *  calls, triangles, texture binds, uniform uploads, state
+ *  changes and bytes uploaded, along with the frame and
+ *  submit times and the GPU memory in use.  The counters are
+ *  static, so the code issuing the GL calls adds to them
+ *  without holding a pointer, and each is a single add.
+ *  EndFrame() closes a frame, appends it to the log file if
+ *  one is open, and folds it into averages that are
+ *  refreshed a few times a second for display.  Only the
+ *  render thread counts.
+ ***********************************************************/
+class RenderStats
+{
+public:
+	// what is counted per frame
+	enum COUNTER
+	{
+		COUNTER_DRAW_CALLS,
+		COUNTER_TRIANGLES,
+		COUNTER_TEXTURE_BINDS,
+		COUNTER_UNIFORM_UPLOADS,
+		COUNTER_STATE_CHANGES,
+		COUNTER_UPLOAD_BYTES,
+		COUNTER_COUNT
+	};
+
+	// counts and times of one frame, or the average of several
+	struct FRAME_STATS
+	{
+		uint64_t frameIndex;
+		// time since the previous frame ended
+		double frameMilliseconds;
+		// CPU time spent submitting the frame
+		double submitMilliseconds;
+		uint64_t counters[COUNTER_COUNT];
+		// -1 when the driver doesn't report it
+		int gpuMemoryUsedMB;
+		int gpuMemoryFreeMB;
+		// memory of the GL objects in the resource registry
+		uint64_t trackedGpuBytes;
+		// views drawn, the CPU time of the work done once for
+		// all of them, of the first view, and of each further
+		// view on average, which is the price of adding one
+		int viewCount;
+		double sharedMilliseconds;
+		double firstViewMilliseconds;
+		double extraViewMilliseconds;
+	};
+
+	// constructor
+	RenderStats();
+	// destructor
+	~RenderStats();
+
+	// add to a counter of the current frame
+	static void Count(COUNTER counter, uint64_t amount = 1) { s_counters[counter] += amount; }
+	// count one draw call of the given number of triangles
+	static void CountDraw(uint64_t triangleCount)
+	{
+		s_counters[COUNTER_DRAW_CALLS]++;
+		s_counters[COUNTER_TRIANGLES] += triangleCount;
+	}
+	// name of a counter in the log
+	static const char* GetCounterName(COUNTER counter);
+
+	// write every frame to a file, as JSON if its name ends in
+	// .json and as CSV otherwise
+	bool OpenLog(const char* filename);
+	// split the submit time of the frame about to end between
+	// the shared work and its views
+	void SetViewTimes(int viewCount, double sharedMilliseconds, double firstViewMilliseconds,
+		double extraViewMilliseconds);
+	// close the counts of the frame that was just submitted and
+	// start the next one
+	void EndFrame(double submitMilliseconds);
+
+	const FRAME_STATS& GetLastFrame() const { return(m_lastFrame); }
+	// average over the last refresh interval, and a number that
+	// changes whenever it is refreshed
+	const FRAME_STATS& GetAverage() const { return(m_average); }
+	int GetAverageVersion() const { return(m_averageVersion); }
+
+private:
+	static uint64_t s_counters[COUNTER_COUNT];
+
+	FRAME_STATS m_lastFrame;
+	// frames summed since the averages were last refreshed
+	FRAME_STATS m_sum;
+	int m_sumFrameCount;
+	FRAME_STATS m_average;
+	int m_averageVersion;
+	uint64_t m_frameIndex;
+	std::chrono::steady_clock::time_point m_lastFrameEnd;
+	std::chrono::steady_clock::time_point m_lastAverageTime;
+	// latest GPU memory reading, repeated until the next query
+	int m_gpuMemoryUsedMB;
+	int m_gpuMemoryFreeMB;
+	// view times of the frame being submitted
+	int m_viewCount;
+	double m_sharedMilliseconds;
+	double m_firstViewMilliseconds;
+	double m_extraViewMilliseconds;
+
+	std::ofstream m_logFile;
+	bool m_bJsonLog;
+
+	// read the GPU memory counters of the driver
+	void QueryGpuMemory();
+	// append a frame to the log file
+	void WriteLogLine(const FRAME_STATS& frame);
+};
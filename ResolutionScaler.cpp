@@ -0,0 +1,528 @@
+///////////////////////////////////////////////////////////////////////////////
+// resolutionscaler.cpp
+// ============
+// render the 3D scene into an offscreen target whose resolution is adjusted
+// every frame to hold a target frame time, then upscale it to the window
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ResolutionScaler.h"
+#include "RenderStats.h"
+
+#include "GLFW/glfw3.h"
+
+#include <iostream>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// weight of the newest sample in the smoothed frame time
+	const float g_FrameTimeSmoothing = 0.1f;
+	// relative frame time error that is tolerated without rescaling
+	const float g_ControllerDeadband = 0.05f;
+	// largest change of the render scale allowed in one frame
+	const float g_MaxScaleStep = 0.05f;
+
+	// draws a single triangle that covers the whole viewport
+	const char* g_UpscaleVertexShader = R"(
+		#version 330 core
+		out vec2 texCoord;
+		void main()
+		{
+			vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+			texCoord = position;
+			gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+		}
+	)";
+
+	// bilinear upscale followed by a contrast adaptive sharpen
+	// that restores the edge detail lost to the lower resolution
+	const char* g_UpscaleFragmentShader = R"(
+		#version 330 core
+		in vec2 texCoord;
+		out vec4 fragmentColor;
+
+		uniform sampler2D sourceTexture;
+		uniform vec2 sourceScale;
+		uniform vec2 sourceTexel;
+		uniform float sharpness;
+
+		vec3 SampleSource(vec2 uv)
+		{
+			// never read outside the region the scene was drawn into
+			vec2 minUV = 0.5 * sourceTexel;
+			vec2 maxUV = sourceScale - 0.5 * sourceTexel;
+			return texture(sourceTexture, clamp(uv, minUV, maxUV)).rgb;
+		}
+
+		void main()
+		{
+			vec2 uv = texCoord * sourceScale;
+
+			vec3 center = SampleSource(uv);
+			vec3 north = SampleSource(uv + vec2(0.0, sourceTexel.y));
+			vec3 south = SampleSource(uv - vec2(0.0, sourceTexel.y));
+			vec3 east = SampleSource(uv + vec2(sourceTexel.x, 0.0));
+			vec3 west = SampleSource(uv - vec2(sourceTexel.x, 0.0));
+
+			vec3 minColor = min(center, min(min(north, south), min(east, west)));
+			vec3 maxColor = max(center, max(max(north, south), max(east, west)));
+
+			// sharpen less where the neighborhood is already high contrast
+			vec3 amount = sqrt(clamp(min(minColor, 1.0 - maxColor) / max(maxColor, 1e-4), 0.0, 1.0));
+			vec3 weight = amount * mix(-0.125, -0.2, sharpness);
+
+			vec3 color = (center + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);
+			fragmentColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+		}
+	)";
+
+	/***********************************************************
+	 *  CompileShaderStage()
+	 *
+	 *  Compile a single shader stage, printing the info log
+	 *  when compilation fails.
+	 ***********************************************************/
+	GLuint CompileShaderStage(GLenum stage, const char* source)
+	{
+		GLint success = 0;
+		GLuint shaderID = glCreateShader(stage);
+
+		glShaderSource(shaderID, 1, &source, NULL);
+		glCompileShader(shaderID);
+		glGetShaderiv(shaderID, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[1024];
+			glGetShaderInfoLog(shaderID, sizeof(infoLog), NULL, infoLog);
+			std::cout << "ERROR: upscale shader compilation failed\n" << infoLog << std::endl;
+			glDeleteShader(shaderID);
+			return 0;
+		}
+
+		return(shaderID);
+	}
+}
+
+/***********************************************************
+ *  ResolutionScaler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ResolutionScaler::ResolutionScaler()
+{
+	m_outputWidth = 1;
+	m_outputHeight = 1;
+	m_renderWidth = 1;
+	m_renderHeight = 1;
+	m_framebufferID = 0;
+	m_targetWidth = 0;
+	m_targetHeight = 0;
+	m_sourceTextureLocation = -1;
+	m_sourceScaleLocation = -1;
+	m_sourceTexelLocation = -1;
+	m_sharpnessLocation = -1;
+	for (int i = 0; i < TIMER_QUERY_COUNT; i++)
+	{
+		m_timerQueryIDs[i] = 0;
+		m_timerQueryPending[i] = false;
+	}
+	m_timerQueryIndex = 0;
+	m_lastPresentTime = 0.0;
+	m_bCreateFailed = false;
+
+	// aim for 60 frames per second by default
+	m_targetFrameTime = 1000.0f / 60.0f;
+	m_smoothedFrameTime = m_targetFrameTime;
+	m_renderScale = 1.0f;
+	m_minScale = 0.5f;
+	m_maxScale = 1.0f;
+	m_sharpness = 0.5f;
+}
+
+/***********************************************************
+ *  ~ResolutionScaler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ResolutionScaler::~ResolutionScaler()
+{
+	DestroyResources();
+}
+
+/***********************************************************
+ *  SetOutputSize()
+ *
+ *  This method is called whenever the window framebuffer is
+ *  resized so that the offscreen target follows it.
+ ***********************************************************/
+void ResolutionScaler::SetOutputSize(int width, int height)
+{
+	// a minimized window reports a zero sized framebuffer
+	if ((width <= 0) || (height <= 0))
+	{
+		return;
+	}
+
+	m_outputWidth = width;
+	m_outputHeight = height;
+
+	if (m_framebufferID != 0)
+	{
+		AllocateTarget();
+	}
+}
+
+/***********************************************************
+ *  SetTargetFrameTime()
+ *
+ *  This method is used to configure the frame time, in
+ *  milliseconds, that the controller aims for.
+ ***********************************************************/
+void ResolutionScaler::SetTargetFrameTime(float milliseconds)
+{
+	if (milliseconds > 0.0f)
+	{
+		m_targetFrameTime = milliseconds;
+	}
+}
+
+/***********************************************************
+ *  SetScaleRange()
+ *
+ *  This method is used to configure the smallest and largest
+ *  render scale the controller may choose.
+ ***********************************************************/
+void ResolutionScaler::SetScaleRange(float minScale, float maxScale)
+{
+	if ((minScale <= 0.0f) || (maxScale < minScale))
+	{
+		return;
+	}
+
+	bool bReallocate = (maxScale != m_maxScale);
+
+	m_minScale = minScale;
+	m_maxScale = maxScale;
+	m_renderScale = std::fmin(std::fmax(m_renderScale, m_minScale), m_maxScale);
+
+	if (bReallocate && (m_framebufferID != 0))
+	{
+		AllocateTarget();
+	}
+}
+
+/***********************************************************
+ *  SetSharpness()
+ *
+ *  This method is used to configure how strongly the
+ *  upscaled image is sharpened.
+ ***********************************************************/
+void ResolutionScaler::SetSharpness(float sharpness)
+{
+	m_sharpness = std::fmin(std::fmax(sharpness, 0.0f), 1.0f);
+}
+
+/***********************************************************
+ *  CreateResources()
+ *
+ *  This method is used to create the offscreen framebuffer,
+ *  the upscale program and the timer queries.
+ ***********************************************************/
+bool ResolutionScaler::CreateResources()
+{
+	GLint success = 0;
+	GLuint vertexShaderID = 0;
+	GLuint fragmentShaderID = 0;
+
+	vertexShaderID = CompileShaderStage(GL_VERTEX_SHADER, g_UpscaleVertexShader);
+	fragmentShaderID = CompileShaderStage(GL_FRAGMENT_SHADER, g_UpscaleFragmentShader);
+	if ((vertexShaderID == 0) || (fragmentShaderID == 0))
+	{
+		glDeleteShader(vertexShaderID);
+		glDeleteShader(fragmentShaderID);
+		return false;
+	}
+
+	GLuint programID = m_upscaleProgram.Create("resolution upscale");
+	glAttachShader(programID, vertexShaderID);
+	glAttachShader(programID, fragmentShaderID);
+	glLinkProgram(programID);
+	glDeleteShader(vertexShaderID);
+	glDeleteShader(fragmentShaderID);
+
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR: upscale program link failed\n" << infoLog << std::endl;
+		m_upscaleProgram.Reset();
+		return false;
+	}
+
+	m_upscaleProgram.SetBytes(GpuResourceRegistry::EstimateProgramBytes(programID));
+
+	m_sourceTextureLocation = glGetUniformLocation(programID, "sourceTexture");
+	m_sourceScaleLocation = glGetUniformLocation(programID, "sourceScale");
+	m_sourceTexelLocation = glGetUniformLocation(programID, "sourceTexel");
+	m_sharpnessLocation = glGetUniformLocation(programID, "sharpness");
+
+	// the fullscreen triangle is generated from gl_VertexID, but
+	// the core profile still requires a vertex array to be bound
+	m_emptyVertexArray.Create("resolution upscale");
+	glGenQueries(TIMER_QUERY_COUNT, m_timerQueryIDs);
+
+	glGenFramebuffers(1, &m_framebufferID);
+	m_colorTexture.Create("scaled scene color");
+	m_depthRenderbuffer.Create("scaled scene depth");
+	AllocateTarget();
+
+	m_lastPresentTime = glfwGetTime();
+
+	return true;
+}
+
+/***********************************************************
+ *  DestroyResources()
+ *
+ *  This method is used to free the GL objects owned by the
+ *  scaler.
+ ***********************************************************/
+void ResolutionScaler::DestroyResources()
+{
+	if (m_framebufferID != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebufferID);
+		glDeleteQueries(TIMER_QUERY_COUNT, m_timerQueryIDs);
+		m_framebufferID = 0;
+	}
+	m_colorTexture.Reset();
+	m_depthRenderbuffer.Reset();
+	m_emptyVertexArray.Reset();
+	m_upscaleProgram.Reset();
+}
+
+/***********************************************************
+ *  AllocateTarget()
+ *
+ *  This method is used to size the offscreen attachments for
+ *  the largest render scale, so that changing the scale from
+ *  frame to frame never reallocates GPU memory.
+ ***********************************************************/
+void ResolutionScaler::AllocateTarget()
+{
+	int width = (int)std::ceil(m_outputWidth * m_maxScale);
+	int height = (int)std::ceil(m_outputHeight * m_maxScale);
+
+	if ((width == m_targetWidth) && (height == m_targetHeight))
+	{
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, m_colorTexture.Get());
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	m_colorTexture.SetBytes(GpuResourceRegistry::EstimateTextureBytes(width, height, 4, 1));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer.Get());
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	m_depthRenderbuffer.SetBytes((size_t)width * height * 4);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTexture.Get(), 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer.Get());
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR: offscreen scene framebuffer is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_targetWidth = width;
+	m_targetHeight = height;
+}
+
+/***********************************************************
+ *  BeginSceneFrame()
+ *
+ *  This method is used to bind the offscreen target and set
+ *  the viewport to the region covered by the current render
+ *  scale.  The scene should be cleared and drawn afterwards.
+ ***********************************************************/
+void ResolutionScaler::BeginSceneFrame()
+{
+	// the GL objects can only be created once a context exists
+	if ((m_upscaleProgram.Get() == 0) && (m_bCreateFailed == false))
+	{
+		m_bCreateFailed = (CreateResources() == false);
+	}
+	if (m_upscaleProgram.Get() == 0)
+	{
+		// fall back to rendering straight into the window
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, m_outputWidth, m_outputHeight);
+		return;
+	}
+
+	m_renderWidth = (int)std::lround(m_outputWidth * m_renderScale);
+	m_renderHeight = (int)std::lround(m_outputHeight * m_renderScale);
+	m_renderWidth = (m_renderWidth < 1) ? 1 : ((m_renderWidth > m_targetWidth) ? m_targetWidth : m_renderWidth);
+	m_renderHeight = (m_renderHeight < 1) ? 1 : ((m_renderHeight > m_targetHeight) ? m_targetHeight : m_renderHeight);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glViewport(0, 0, m_renderWidth, m_renderHeight);
+
+	glBeginQuery(GL_TIME_ELAPSED, m_timerQueryIDs[m_timerQueryIndex]);
+	m_timerQueryPending[m_timerQueryIndex] = true;
+}
+
+/***********************************************************
+ *  PresentSceneFrame()
+ *
+ *  This method is used to upscale the rendered region of the
+ *  offscreen target into the window, and to update the
+ *  render scale for the next frame.
+ ***********************************************************/
+void ResolutionScaler::PresentSceneFrame()
+{
+	float frameTime = 0.0f;
+	double currentTime = glfwGetTime();
+	float cpuFrameTime = (float)((currentTime - m_lastPresentTime) * 1000.0);
+	m_lastPresentTime = currentTime;
+
+	if (m_upscaleProgram.Get() == 0)
+	{
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	m_timerQueryIndex = (m_timerQueryIndex + 1) % TIMER_QUERY_COUNT;
+
+	// the GPU cost of the scene is what the render scale affects;
+	// the CPU frame time is only used when the driver can't time it
+	if (CollectGpuFrameTime(frameTime) == false)
+	{
+		frameTime = cpuFrameTime;
+	}
+	UpdateController(frameTime);
+
+	GLboolean bDepthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean bBlend = glIsEnabled(GL_BLEND);
+	GLint previousProgram = 0;
+	GLint previousActiveTexture = 0;
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &previousActiveTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_outputWidth, m_outputHeight);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	glUseProgram(m_upscaleProgram.Get());
+	glBindTexture(GL_TEXTURE_2D, m_colorTexture.Get());
+	glUniform1i(m_sourceTextureLocation, 0);
+	glUniform2f(m_sourceScaleLocation,
+		(float)m_renderWidth / (float)m_targetWidth,
+		(float)m_renderHeight / (float)m_targetHeight);
+	glUniform2f(m_sourceTexelLocation,
+		1.0f / (float)m_targetWidth,
+		1.0f / (float)m_targetHeight);
+	// a native resolution frame only needs a light touch
+	glUniform1f(m_sharpnessLocation, m_sharpness * (m_renderScale < 1.0f ? 1.0f : 0.25f));
+
+	glBindVertexArray(m_emptyVertexArray.Get());
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	RenderStats::CountDraw(1);
+	RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS, 4);
+	// the framebuffer, program and vertex array switches and
+	// the texture bound there and back
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES, 3);
+	RenderStats::Count(RenderStats::COUNTER_TEXTURE_BINDS, 2);
+
+	// restore the state the scene rendering expects, including
+	// the scene texture that was bound to the first texture unit
+	glUseProgram(previousProgram);
+	glBindTexture(GL_TEXTURE_2D, previousTexture);
+	glActiveTexture(previousActiveTexture);
+	if (bDepthTest)
+	{
+		glEnable(GL_DEPTH_TEST);
+	}
+	if (bBlend)
+	{
+		glEnable(GL_BLEND);
+	}
+}
+
+/***********************************************************
+ *  CollectGpuFrameTime()
+ *
+ *  This method is used to read back the oldest timer query
+ *  if the GPU has finished with it.  It never waits.
+ ***********************************************************/
+bool ResolutionScaler::CollectGpuFrameTime(float& milliseconds)
+{
+	// the query about to be reused next frame is the oldest one
+	int index = m_timerQueryIndex;
+	GLint bAvailable = 0;
+	GLuint64 elapsedNanoseconds = 0;
+
+	if (m_timerQueryPending[index] == false)
+	{
+		return false;
+	}
+
+	glGetQueryObjectiv(m_timerQueryIDs[index], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+	if (!bAvailable)
+	{
+		return false;
+	}
+
+	glGetQueryObjectui64v(m_timerQueryIDs[index], GL_QUERY_RESULT, &elapsedNanoseconds);
+	m_timerQueryPending[index] = false;
+	milliseconds = (float)((double)elapsedNanoseconds / 1000000.0);
+
+	return true;
+}
+
+/***********************************************************
+ *  UpdateController()
+ *
+ *  This method is used to move the render scale towards the
+ *  value that meets the target frame time.  The cost of a
+ *  frame grows with the pixel count, so the scale on each
+ *  axis follows the square root of the time ratio.
+ ***********************************************************/
+void ResolutionScaler::UpdateController(float frameTimeMilliseconds)
+{
+	if (frameTimeMilliseconds <= 0.0f)
+	{
+		return;
+	}
+
+	m_smoothedFrameTime += (frameTimeMilliseconds - m_smoothedFrameTime) * g_FrameTimeSmoothing;
+
+	float ratio = m_targetFrameTime / m_smoothedFrameTime;
+
+	// leave the scale alone when close enough to the target so
+	// that the image does not shimmer between sizes
+	if (std::fabs(ratio - 1.0f) < g_ControllerDeadband)
+	{
+		return;
+	}
+
+	float desiredScale = m_renderScale * std::sqrt(ratio);
+	float step = desiredScale - m_renderScale;
+	step = std::fmin(std::fmax(step, -g_MaxScaleStep), g_MaxScaleStep);
+
+	m_renderScale = std::fmin(std::fmax(m_renderScale + step, m_minScale), m_maxScale);
+}
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+// resolutionscaler.h
+// ============
+// render the 3D scene into an offscreen target whose resolution is adjusted
+// every frame to hold a target frame time, then upscale it to the window
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GpuResources.h"
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  ResolutionScaler
+ *
+ *  This class owns the offscreen scene framebuffer and the
+ *  controller that picks the render scale for each frame.
+ *  The scene is drawn into the lower-left corner of the
+ *  offscreen target and then upscaled with a sharpening
+ *  filter into the default framebuffer.
+ ***********************************************************/
+class ResolutionScaler
+{
+public:
+	// constructor
+	ResolutionScaler();
+	// destructor
+	~ResolutionScaler();
+
+	// set the size of the window framebuffer being presented to
+	void SetOutputSize(int width, int height);
+
+	// bind the offscreen target at the current render scale
+	void BeginSceneFrame();
+	// upscale the offscreen target into the default framebuffer
+	// and feed the measured frame time into the controller
+	void PresentSceneFrame();
+
+	// configure the frame time the controller aims for
+	void SetTargetFrameTime(float milliseconds);
+	// configure the allowed render scale range
+	void SetScaleRange(float minScale, float maxScale);
+	// configure the strength of the sharpening filter (0 - 1)
+	void SetSharpness(float sharpness);
+
+	// current render scale applied to both axes
+	float GetRenderScale() const { return(m_renderScale); }
+	// most recent smoothed frame time in milliseconds
+	float GetMeasuredFrameTime() const { return(m_smoothedFrameTime); }
+	// size of the region of the offscreen target being rendered
+	int GetRenderWidth() const { return(m_renderWidth); }
+	int GetRenderHeight() const { return(m_renderHeight); }
+
+private:
+	// number of timer queries kept in flight so that reading
+	// back a result never stalls on the GPU
+	static const int TIMER_QUERY_COUNT = 4;
+
+	// size of the window framebuffer
+	int m_outputWidth;
+	int m_outputHeight;
+	// size of the scaled render region for the current frame
+	int m_renderWidth;
+	int m_renderHeight;
+
+	// offscreen scene framebuffer and its attachments
+	GLuint m_framebufferID;
+	GLTexture m_colorTexture;
+	GLRenderbuffer m_depthRenderbuffer;
+	// allocated size of the offscreen attachments
+	int m_targetWidth;
+	int m_targetHeight;
+
+	// upscale and sharpen program
+	GLProgram m_upscaleProgram;
+	GLVertexArray m_emptyVertexArray;
+	GLint m_sourceTextureLocation;
+	GLint m_sourceScaleLocation;
+	GLint m_sourceTexelLocation;
+	GLint m_sharpnessLocation;
+
+	// GPU timer queries used to measure the scene cost
+	GLuint m_timerQueryIDs[TIMER_QUERY_COUNT];
+	bool m_timerQueryPending[TIMER_QUERY_COUNT];
+	int m_timerQueryIndex;
+	// fallback CPU frame timing when no GPU timing is available
+	double m_lastPresentTime;
+	// set when the GL objects could not be created
+	bool m_bCreateFailed;
+
+	// controller state
+	float m_targetFrameTime;
+	float m_smoothedFrameTime;
+	float m_renderScale;
+	float m_minScale;
+	float m_maxScale;
+	float m_sharpness;
+
+	// create the GL objects used by the scaler
+	bool CreateResources();
+	// release the GL objects used by the scaler
+	void DestroyResources();
+	// (re)allocate the offscreen attachments for the output size
+	void AllocateTarget();
+	// read back any finished timer queries
+	bool CollectGpuFrameTime(float& milliseconds);
+	// adjust the render scale from the latest frame time
+	void UpdateController(float frameTimeMilliseconds);
+};
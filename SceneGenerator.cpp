@@ -0,0 +1,176 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegenerator.cpp
+// ============
+// lay out large, repeatable scenes from the desk compositions
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneGenerator.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// room taken by one desk, the desk plane is 32 by 18
+	const float g_DeskSpacingX = 36.0f;
+	const float g_DeskSpacingZ = 22.0f;
+	// how far the objects on a desk may move from their place
+	const float g_PositionJitter = 0.4f;
+	const float g_YawJitterDegrees = 20.0f;
+	// height of the bobbing of moving objects
+	const float g_BobHeight = 0.25f;
+
+	/***********************************************************
+	 *  SeedRandom
+	 *
+	 *  Small SplitMix64 generator.  The standard engines and
+	 *  distributions don't give the same numbers everywhere.
+	 ***********************************************************/
+	struct SeedRandom
+	{
+		uint64_t state;
+
+		explicit SeedRandom(uint64_t seed) : state(seed) {}
+
+		uint64_t Next()
+		{
+			uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return(z ^ (z >> 31));
+		}
+
+		// uniform in [0, 1)
+		float NextFloat()
+		{
+			return((float)(Next() >> 40) / 16777216.0f);
+		}
+
+		// uniform in [low, high)
+		float NextRange(float low, float high)
+		{
+			return(low + (high - low) * NextFloat());
+		}
+
+		// uniform in [0, count)
+		int NextInt(int count)
+		{
+			return((count > 1) ? (int)(Next() % (uint64_t)count) : 0);
+		}
+	};
+}
+
+/***********************************************************
+ *  GetDefaultSettings()
+ *
+ *  This method is used to get settings that reproduce the
+ *  original scene.
+ ***********************************************************/
+SceneGenerator::GENERATOR_SETTINGS SceneGenerator::GetDefaultSettings()
+{
+	GENERATOR_SETTINGS settings;
+
+	settings.seed = 1;
+	settings.deskCount = 1;
+	settings.materialVariety = 1;
+	settings.textureVariety = 1;
+	settings.animatedFraction = 0.0f;
+
+	return(settings);
+}
+
+/***********************************************************
+ *  Generate()
+ *
+ *  This method is used to lay out the desks on a square grid
+ *  growing away from the original desk, with every
+ *  composition of the scene on each of them.  The desk at the
+ *  origin is always the original one, so the default camera
+ *  still looks at an unchanged desk.
+ ***********************************************************/
+void SceneGenerator::Generate(const GENERATOR_SETTINGS& settings, std::vector<GENERATED_OBJECT>& objects)
+{
+	int deskCount = std::max(settings.deskCount, 0);
+	int columnCount = std::max(1, (int)std::ceil(std::sqrt((double)deskCount)));
+
+	objects.clear();
+	objects.reserve((size_t)deskCount * COMPOSITION_COUNT);
+
+	for (int desk = 0; desk < deskCount; desk++)
+	{
+		// each desk has its own stream of numbers
+		SeedRandom random(((uint64_t)settings.seed << 32) ^ (uint64_t)desk);
+		glm::vec3 deskPosition(
+			(float)(desk % columnCount) * g_DeskSpacingX,
+			0.0f,
+			-(float)(desk / columnCount) * g_DeskSpacingZ);
+
+		for (int composition = 0; composition < COMPOSITION_COUNT; composition++)
+		{
+			GENERATED_OBJECT object;
+
+			object.composition = (COMPOSITION)composition;
+			object.position = deskPosition;
+			object.yawDegrees = 0.0f;
+			object.materialVariant = 0;
+			object.textureVariant = 0;
+			object.bAnimated = false;
+			object.spinSpeed = 0.0f;
+			object.phase = 0.0f;
+
+			// the numbers are drawn even for the original desk so
+			// every later desk gets the same ones at any count
+			float jitterX = random.NextRange(-g_PositionJitter, g_PositionJitter);
+			float jitterZ = random.NextRange(-g_PositionJitter, g_PositionJitter);
+			float yaw = random.NextRange(-g_YawJitterDegrees, g_YawJitterDegrees);
+			int materialVariant = random.NextInt(settings.materialVariety);
+			int textureVariant = random.NextInt(settings.textureVariety);
+			bool bAnimated = random.NextFloat() < settings.animatedFraction;
+			float spinSpeed = random.NextRange(30.0f, 90.0f);
+			float phase = random.NextRange(0.0f, 6.2831853f);
+
+			// the desk itself stays square to the grid and still
+			if ((desk > 0) && (composition != COMPOSITION_DESK))
+			{
+				object.position += glm::vec3(jitterX, 0.0f, jitterZ);
+				object.yawDegrees = yaw;
+				object.bAnimated = bAnimated;
+				object.spinSpeed = spinSpeed;
+				object.phase = phase;
+			}
+			if (desk > 0)
+			{
+				object.materialVariant = materialVariant;
+				object.textureVariant = textureVariant;
+			}
+
+			objects.push_back(object);
+		}
+	}
+}
+
+/***********************************************************
+ *  GetTransform()
+ *
+ *  This method is used to place an object.  Moving objects
+ *  spin about the center of their composition and bob up and
+ *  down with their own speed and phase.
+ ***********************************************************/
+glm::mat4 SceneGenerator::GetTransform(const GENERATED_OBJECT& object, const glm::vec3& center, float seconds)
+{
+	float yawDegrees = object.yawDegrees;
+	glm::vec3 position = object.position;
+
+	if (object.bAnimated)
+	{
+		yawDegrees += object.spinSpeed * seconds;
+		position.y += g_BobHeight * (1.0f + std::sin(object.phase + seconds * 2.0f));
+	}
+
+	return(glm::translate(position + center) *
+		glm::rotate(glm::radians(yawDegrees), glm::vec3(0.0f, 1.0f, 0.0f)) *
+		glm::translate(-center));
+}
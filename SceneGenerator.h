@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegenerator.h
+// ============
+// lay out large, repeatable scenes from the desk compositions
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  SceneGenerator
+ *
+ *  This class fills a grid of desks with copies of the
+ *  objects of the original scene, for measuring how the
+ *  renderer scales.  Every desk is laid out from its own
+ *  seed derived from the scene seed and the desk index, so
+ *  a desk looks the same whatever the total count is, and
+ *  the same settings always give the same scene on every
+ *  platform.  Only the layout is generated here; the draws
+ *  of each composition come from the scene itself.
+ ***********************************************************/
+class SceneGenerator
+{
+public:
+	// groups of draws that are placed as one object
+	enum COMPOSITION
+	{
+		COMPOSITION_DESK,
+		COMPOSITION_CUP,
+		COMPOSITION_FRENCH_BOOK,
+		COMPOSITION_NOTEBOOK,
+		COMPOSITION_MECH_PENCIL,
+		COMPOSITION_ERASER,
+		COMPOSITION_COUNT
+	};
+
+	// what to generate
+	struct GENERATOR_SETTINGS
+	{
+		uint32_t seed;
+		int deskCount;
+		// number of material and texture choices per draw, 1
+		// keeps the ones of the original scene
+		int materialVariety;
+		int textureVariety;
+		// share of the objects on the desks that move, 0 - 1
+		float animatedFraction;
+	};
+
+	// one placed composition
+	struct GENERATED_OBJECT
+	{
+		COMPOSITION composition;
+		// offset of the whole composition from its place in the
+		// original scene
+		glm::vec3 position;
+		// turn about the composition's own center
+		float yawDegrees;
+		// added to the material index and texture slot of each
+		// draw, 0 for the original look
+		int materialVariant;
+		int textureVariant;
+		bool bAnimated;
+		// spin speed in degrees per second and start offset
+		float spinSpeed;
+		float phase;
+	};
+
+	// a single desk with the original look and nothing moving
+	static GENERATOR_SETTINGS GetDefaultSettings();
+
+	// lay out every object of the scene
+	static void Generate(const GENERATOR_SETTINGS& settings, std::vector<GENERATED_OBJECT>& objects);
+
+	// placement of an object at the given time, turning about
+	// the center of its composition
+	static glm::mat4 GetTransform(const GENERATED_OBJECT& object, const glm::vec3& center, float seconds);
+};
@@ -8,6 +8,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "CameraUniformBuffer.h"
+#include "MappedFile.h"
+#include "RenderStats.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -15,6 +18,14 @@
 #endif
 
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
 
 // declaration of global variables
 namespace
@@ -24,6 +35,131 @@ namespace
 	const char* g_TextureValueName = "objectTexture";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_DrawIndexName = "drawIndex";
+	const char* g_AtlasEntryName = "atlasEntry";
+	const char* g_AtlasRectsName = "atlasRects";
+
+	// initial number of draws each ring buffer region holds
+	const int g_MaxDrawsPerFrame = 1024;
+	// largest boxes rasterized as occluders each frame
+	const int g_MaxOccluders = 32;
+	// starting size of the frame arena of the render thread
+	// and of each worker, grown if a frame needs more
+	const size_t g_FrameArenaSize = 1024 * 1024;
+	const size_t g_WorkerFrameArenaSize = 64 * 1024;
+	// name of the mesh, material and light entries in the pack
+	const char* g_AssetPackSceneName = "scene";
+	// texture bytes uploaded per frame while streaming
+	const size_t g_TextureStreamBudget = 2 * 1024 * 1024;
+	// keyframed motion of the moving generated objects, one
+	// turn and two bobs per loop keyed at a fixed rate; each
+	// object plays it at its own speed
+	const float g_MovingClipSeconds = 6.0f;
+	const int g_MovingClipKeyCount = 49;
+	const float g_MovingSpinSpeed = 60.0f;
+	const float g_MovingBobHeight = 0.25f;
+	// how much darker the objects pulse halfway through a loop
+	const float g_MovingPulseDepth = 0.15f;
+	// moving objects and frames timed by TimeAnimation()
+	const int g_AnimationBenchmarkObjects = 100000;
+	const int g_AnimationBenchmarkFrames = 120;
+
+	// image file and tag of every scene texture, in slot order
+	struct SCENE_TEXTURE
+	{
+		const char* filename;
+		const char* tag;
+	};
+	const SCENE_TEXTURE g_SceneTextures[] =
+	{
+		{ "Photos/textures/black_top_vinyl.jpg", "desk" },	// desk
+		{ "Photos/textures/cup.jpg", "cup" },				// cup
+		{ "Photos/textures/rim.jpg", "cup_rim" },			// cup rim
+		{ "Photos/textures/french.jpg", "french" },			// french book
+		{ "Photos/textures/paper.jpg", "paper" },			// notebook
+		{ "Photos/textures/stainless.jpg", "metal" },		// notebook rings
+		{ "Photos/textures/mech_body.jpg", "body" },		// mech pencil body
+		{ "Photos/textures/point.jpg", "point" },			// mech pencil pointy tip
+		{ "Photos/textures/white_eraser.jpg", "eraser" },	// mech pencil eraser
+		{ "Photos/textures/clip.jpg", "clip" },				// mech pencil clip
+		{ "Photos/textures/eraser.jpg", "pink_eraser" }		// pink eraser
+	};
+	const int g_SceneTextureCount = sizeof(g_SceneTextures) / sizeof(g_SceneTextures[0]);
+
+	/***********************************************************
+	 *  FixedString()
+	 *
+	 *  Read a name stored in a fixed size field of the asset
+	 *  pack, which is only terminated if it is shorter.
+	 ***********************************************************/
+	std::string FixedString(const char* text, size_t maxLength)
+	{
+		return(std::string(text, std::find(text, text + maxLength, '\0')));
+	}
+
+	/***********************************************************
+	 *  BuildMovingClip()
+	 *
+	 *  Key the motion of the moving generated objects: a turn
+	 *  about the vertical axis, bobbing up and down, and a
+	 *  pulse of the object color.
+	 ***********************************************************/
+	AnimationSystem::ANIMATION_CLIP BuildMovingClip()
+	{
+		AnimationSystem::ANIMATION_CLIP clip;
+		AnimationSystem::ANIMATION_TRACK position;
+		AnimationSystem::ANIMATION_TRACK rotation;
+		AnimationSystem::ANIMATION_TRACK color;
+
+		position.target = AnimationSystem::TRACK_POSITION;
+		rotation.target = AnimationSystem::TRACK_ROTATION;
+		color.target = AnimationSystem::TRACK_COLOR;
+		for (int k = 0; k < g_MovingClipKeyCount; k++)
+		{
+			float fraction = (float)k / (float)(g_MovingClipKeyCount - 1);
+			float angle = fraction * glm::radians(360.0f);
+			float brightness = 1.0f - g_MovingPulseDepth * 0.5f * (1.0f - std::cos(angle));
+
+			position.times.push_back(fraction * g_MovingClipSeconds);
+			position.values.push_back(glm::vec4(0.0f, g_MovingBobHeight * (1.0f + std::sin(angle * 2.0f)), 0.0f, 0.0f));
+			rotation.times.push_back(fraction * g_MovingClipSeconds);
+			rotation.values.push_back(glm::vec4(0.0f, std::sin(angle * 0.5f), 0.0f, std::cos(angle * 0.5f)));
+			color.times.push_back(fraction * g_MovingClipSeconds);
+			color.values.push_back(glm::vec4(brightness, brightness, brightness, 1.0f));
+		}
+
+		clip.name = "moving object";
+		clip.duration = g_MovingClipSeconds;
+		clip.bLoop = true;
+		clip.tracks.push_back(position);
+		clip.tracks.push_back(rotation);
+		clip.tracks.push_back(color);
+
+		return(clip);
+	}
+
+	// object space bounds of each basic shape, kept generous
+	// since a box too large only makes culling less aggressive
+	const glm::vec3 g_MeshBoundsMin[RenderQueue::MESH_TYPE_COUNT] =
+	{
+		glm::vec3(-1.0f, -0.01f, -1.0f),	// plane
+		glm::vec3(-0.5f, -0.5f, -0.5f),		// box
+		glm::vec3(-1.0f, 0.0f, -1.0f),		// cylinder
+		glm::vec3(-1.0f, 0.0f, -1.0f),		// tapered cylinder
+		glm::vec3(-1.0f, 0.0f, -1.0f),		// cone
+		glm::vec3(-1.5f, -1.5f, -0.5f),		// torus
+		glm::vec3(-1.0f, -1.0f, -1.0f)		// prism
+	};
+	const glm::vec3 g_MeshBoundsMax[RenderQueue::MESH_TYPE_COUNT] =
+	{
+		glm::vec3(1.0f, 0.01f, 1.0f),
+		glm::vec3(0.5f, 0.5f, 0.5f),
+		glm::vec3(1.0f, 1.0f, 1.0f),
+		glm::vec3(1.0f, 1.0f, 1.0f),
+		glm::vec3(1.0f, 1.0f, 1.0f),
+		glm::vec3(1.5f, 1.5f, 0.5f),
+		glm::vec3(1.0f, 1.0f, 1.0f)
+	};
 }
 
 /***********************************************************
@@ -35,6 +171,62 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
 {
 	m_pShaderManager = pShaderManager;
 	m_basicMeshes = new ShapeMeshes();
+	m_loadedTextures = 0;
+	m_pDrawDataBuffer = new DrawDataRingBuffer();
+	m_bDepthPrePass = false;
+	m_depthModelLocation = -1;
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_viewPosition = glm::vec3(0.0f);
+	m_pThreadPool = new ThreadPool();
+	m_pFrameArena = new FrameArena(g_FrameArenaSize, g_WorkerFrameArenaSize, m_pThreadPool->GetThreadCount());
+	m_pRenderQueue = new RenderQueue(m_pFrameArena);
+	m_pOcclusionCuller = new OcclusionCuller(m_pThreadPool, m_pFrameArena);
+	m_bOcclusionCulling = true;
+	m_pMeshLibrary = new MeshLibrary();
+	m_bQuantizedMeshes = false;
+	m_pMeshStreamer = NULL;
+	m_bLazyMeshes = false;
+	m_bUsingAssetPack = false;
+	m_bColdStart = false;
+	m_pTextureStreamer = NULL;
+	m_pTextureAtlas = NULL;
+	m_bTextureAtlas = false;
+	m_pShaderPermutations = NULL;
+	m_generalProgramID = 0;
+	m_recordingComposition = -1;
+	m_sceneTime = 0.0f;
+	m_pAnimationSystem = new AnimationSystem(m_pThreadPool);
+	m_pGpuCuller = NULL;
+	m_pGpuProgramCache = NULL;
+	m_bGpuProgramPrepared = false;
+	m_bGpuSceneDirty = true;
+	m_pSpatialIndex = new SpatialIndex();
+	m_bSpatialIndexDirty = true;
+	m_spatialIndexAnimationChanges = 0;
+	for (int i = 0; i < RenderQueue::MESH_TYPE_COUNT; i++)
+	{
+		for (int j = 0; j <= RenderQueue::MESH_PART_ALL; j++)
+		{
+			m_spatialMeshes[i][j] = -1;
+			m_meshDrawCounts[i][j] = glm::ivec2(-1, 0);
+		}
+	}
+	for (int i = 0; i < SceneGenerator::COMPOSITION_COUNT; i++)
+	{
+		m_compositionCenters[i] = glm::vec3(0.0f);
+	}
+	for (int i = 0; i < RenderQueue::MESH_TYPE_COUNT; i++)
+	{
+		m_meshHandles[i] = -1;
+	}
+
+	// the same defaults the shader uniforms start out with
+	m_drawState.model = glm::mat4(1.0f);
+	m_drawState.normalMatrix = glm::mat4(1.0f);
+	m_drawState.objectColor = glm::vec4(1.0f);
+	m_drawState.uvScale = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+	m_drawState.params = glm::ivec4(-1, 0, 0, 0);
 }
 
 /***********************************************************
@@ -47,6 +239,68 @@ SceneManager::~SceneManager()
 	m_pShaderManager = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	delete m_pDrawDataBuffer;
+	m_pDrawDataBuffer = NULL;
+	delete m_pRenderQueue;
+	m_pRenderQueue = NULL;
+
+	const OcclusionCuller::OCCLUSION_STATS& stats = m_pOcclusionCuller->GetStats();
+	if (stats.totalTested > 0)
+	{
+		std::cout << "Occlusion culling: " << stats.totalOccluded << " of "
+			<< stats.totalTested << " draws hidden over " << stats.frameCount
+			<< " frames using " << m_pThreadPool->GetThreadCount() << " threads" << std::endl;
+	}
+	delete m_pOcclusionCuller;
+	m_pOcclusionCuller = NULL;
+
+	const AnimationSystem::ANIMATION_STATS& animationStats = m_pAnimationSystem->GetStats();
+	if (animationStats.updateCount > 0)
+	{
+		std::cout << "Animation: " << animationStats.instanceCount << " moving objects, peak of "
+			<< animationStats.peakMilliseconds << " ms per update, " << animationStats.overBudgetCount
+			<< " of " << animationStats.updateCount << " updates over budget" << std::endl;
+	}
+	delete m_pAnimationSystem;
+	m_pAnimationSystem = NULL;
+
+	const FrameArena::ARENA_STATS& arenaStats = m_pFrameArena->GetStats();
+	if (arenaStats.frameCount > 1)
+	{
+		std::cout << "Frame arena: peak of " << (arenaStats.peakBytes / 1024) << " KB in "
+			<< (arenaStats.capacityBytes / 1024) << " KB over " << (arenaStats.frameCount - 1) << " frames, "
+			<< arenaStats.fallbackCount << " heap fallbacks (" << (arenaStats.fallbackBytes / 1024)
+			<< " KB), grown " << arenaStats.growCount << " times" << std::endl;
+	}
+	delete m_pFrameArena;
+	m_pFrameArena = NULL;
+	delete m_pThreadPool;
+	m_pThreadPool = NULL;
+	delete m_pMeshLibrary;
+	m_pMeshLibrary = NULL;
+	delete m_pMeshStreamer;
+	m_pMeshStreamer = NULL;
+	delete m_pTextureStreamer;
+	m_pTextureStreamer = NULL;
+	delete m_pTextureAtlas;
+	m_pTextureAtlas = NULL;
+	delete m_pShaderPermutations;
+	m_pShaderPermutations = NULL;
+	delete m_pGpuCuller;
+	m_pGpuCuller = NULL;
+	delete m_pSpatialIndex;
+	m_pSpatialIndex = NULL;
+	for (int i = 0; i < (int)m_sceneModels.size(); i++)
+	{
+		delete m_sceneModels[i];
+	}
+	m_sceneModels.clear();
+
+	// the streamer is gone, so nothing uploads into the
+	// textures any more
+	DestroyGLTextures();
+	m_gpuProgram.Reset();
+	m_depthProgram.Reset();
 }
 
 /***********************************************************
@@ -64,6 +318,23 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 	int colorChannels = 0;
 	GLuint textureID = 0;
 
+	// the streamer only reads the image header here and decodes
+	// the rest in the background
+	if (m_pTextureStreamer != NULL)
+	{
+		textureID = m_pTextureStreamer->CreateFromFile(filename);
+		if (textureID == 0)
+		{
+			return false;
+		}
+
+		m_textureIDs[m_loadedTextures].texture.Adopt(textureID, tag, m_pTextureStreamer->GetTextureBytes(textureID));
+		m_textureIDs[m_loadedTextures].tag = tag;
+		m_loadedTextures++;
+
+		return true;
+	}
+
 	// indicate to always flip images vertically when loaded
 	stbi_set_flip_vertically_on_load(true);
 
@@ -80,7 +351,9 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 	{
 		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
 
-		glGenTextures(1, &textureID);
+		// the handle deletes the texture if it can't be filled
+		GLTexture texture;
+		textureID = texture.Create(tag);
 		glBindTexture(GL_TEXTURE_2D, textureID);
 
 		// set the texture wrapping parameters
@@ -99,18 +372,21 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 		else
 		{
 			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
+			stbi_image_free(image);
+			glBindTexture(GL_TEXTURE_2D, 0);
 			return false;
 		}
 
 		// generate the texture mipmaps for mapping textures to lower resolutions
 		glGenerateMipmap(GL_TEXTURE_2D);
+		texture.SetBytes(GpuResourceRegistry::EstimateTextureBytes(width, height, 4, 0));
 
 		// free the image data from local memory
 		stbi_image_free(image);
 		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
 
 		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
+		m_textureIDs[m_loadedTextures].texture = std::move(texture);
 		m_textureIDs[m_loadedTextures].tag = tag;
 		m_loadedTextures++;
 
@@ -123,6 +399,213 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 	return false;
 }
 
+/***********************************************************
+ *  CreateGLTextureFromMips()
+ *
+ *  This method is used for creating a texture from a mip
+ *  chain that is already decoded and reduced, such as one
+ *  mapped from the asset pack.  Each level is uploaded
+ *  straight from the passed in memory.
+ ***********************************************************/
+bool SceneManager::CreateGLTextureFromMips(
+	const unsigned char* pMipChain,
+	int width,
+	int height,
+	int channels,
+	int mipCount,
+	std::string tag)
+{
+	GLenum internalFormat = GL_RGB8;
+	GLenum format = GL_RGB;
+	GLuint textureID = 0;
+
+	// the chain is read again while the levels are streamed, so
+	// it has to outlive this call
+	if (m_pTextureStreamer != NULL)
+	{
+		textureID = m_pTextureStreamer->CreateFromMipChain(pMipChain, width, height, channels, mipCount);
+		if (textureID == 0)
+		{
+			return false;
+		}
+
+		m_textureIDs[m_loadedTextures].texture.Adopt(textureID, tag, m_pTextureStreamer->GetTextureBytes(textureID));
+		m_textureIDs[m_loadedTextures].tag = tag;
+		m_loadedTextures++;
+
+		return true;
+	}
+
+	if (channels == 4)
+	{
+		internalFormat = GL_RGBA8;
+		format = GL_RGBA;
+	}
+	else if (channels != 3)
+	{
+		std::cout << "Not implemented to handle image with " << channels << " channels" << std::endl;
+		return false;
+	}
+
+	GLTexture texture;
+	textureID = texture.Create(tag);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	texture.SetBytes(GpuResourceRegistry::EstimateTextureBytes(width, height, 4, mipCount));
+
+	// the same sampling as textures loaded from image files
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipCount - 1);
+
+	// levels are tightly packed, so RGB rows are not 4 byte
+	// aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int level = 0; level < mipCount; level++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pMipChain);
+		pMipChain += (size_t)width * height * channels;
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// register the loaded texture and associate it with the special tag string
+	m_textureIDs[m_loadedTextures].texture = std::move(texture);
+	m_textureIDs[m_loadedTextures].tag = tag;
+	m_loadedTextures++;
+
+	return true;
+}
+
+/***********************************************************
+ *  AddAtlasTexture()
+ *
+ *  This method is used for decoding a small image file and
+ *  keeping it to be packed into the texture atlas.  False is
+ *  returned when it couldn't be added, and the caller loads
+ *  it as a texture of its own instead.
+ ***********************************************************/
+bool SceneManager::AddAtlasTexture(const char* filename, std::string tag)
+{
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+
+	stbi_set_flip_vertically_on_load(true);
+	unsigned char* image = stbi_load(
+		filename,
+		&width,
+		&height,
+		&colorChannels,
+		0);
+	if (image == NULL)
+	{
+		return false;
+	}
+
+	int entry = m_pTextureAtlas->AddImage(tag, image, width, height, colorChannels);
+	stbi_image_free(image);
+	if (entry == 0)
+	{
+		return false;
+	}
+
+	std::cout << "Successfully packed image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  BuildTextureAtlas()
+ *
+ *  This method is used for packing the images added to the
+ *  texture atlas and registering each page as a loaded
+ *  texture, so it is bound like any other.  The atlas is
+ *  dropped if no image was small enough to be added.
+ ***********************************************************/
+void SceneManager::BuildTextureAtlas()
+{
+	if (m_pTextureAtlas->GetEntryCount() <= 1)
+	{
+		delete m_pTextureAtlas;
+		m_pTextureAtlas = NULL;
+		return;
+	}
+
+	m_pTextureAtlas->Build();
+	for (int page = 0; page < m_pTextureAtlas->GetPageCount(); page++)
+	{
+		m_textureIDs[m_loadedTextures].tag = "atlas_page_" + std::to_string(page);
+		m_textureIDs[m_loadedTextures].texture.Adopt(m_pTextureAtlas->CreatePageTexture(page),
+			m_textureIDs[m_loadedTextures].tag, m_pTextureAtlas->GetPageBytes(page));
+		m_pTextureAtlas->SetPageSlot(page, m_loadedTextures);
+		m_loadedTextures++;
+	}
+
+	std::cout << "INFO: packed " << (m_pTextureAtlas->GetEntryCount() - 1) << " small textures into "
+		<< m_pTextureAtlas->GetPageCount() << " atlas pages" << std::endl;
+}
+
+/***********************************************************
+ *  SetAtlasRects()
+ *
+ *  This method is used for setting the rectangle of every
+ *  atlas entry into the program in use.
+ ***********************************************************/
+void SceneManager::SetAtlasRects()
+{
+	if (m_pTextureAtlas == NULL)
+	{
+		return;
+	}
+
+	for (int i = 0; i < m_pTextureAtlas->GetEntryCount(); i++)
+	{
+		m_pShaderManager->setVec4Value(
+			std::string(g_AtlasRectsName) + "[" + std::to_string(i) + "]", m_pTextureAtlas->GetEntry(i).rect);
+	}
+}
+
+/***********************************************************
+ *  CollectTextureChoices()
+ *
+ *  This method is used for listing every texture a draw can
+ *  select, as its slot and atlas entry.  Atlas pages are not
+ *  textures of their own, their entries are listed instead.
+ ***********************************************************/
+void SceneManager::CollectTextureChoices()
+{
+	m_textureChoices.clear();
+
+	for (int i = 0; i < m_loadedTextures; i++)
+	{
+		bool bAtlasPage = false;
+		if (m_pTextureAtlas != NULL)
+		{
+			for (int entry = 1; (entry < m_pTextureAtlas->GetEntryCount()) && (bAtlasPage == false); entry++)
+			{
+				bAtlasPage = (m_pTextureAtlas->GetEntry(entry).slot == i);
+			}
+		}
+		if (bAtlasPage == false)
+		{
+			m_textureChoices.push_back(glm::ivec2(i, 0));
+		}
+	}
+
+	if (m_pTextureAtlas != NULL)
+	{
+		for (int entry = 1; entry < m_pTextureAtlas->GetEntryCount(); entry++)
+		{
+			m_textureChoices.push_back(glm::ivec2(m_pTextureAtlas->GetEntry(entry).slot, entry));
+		}
+	}
+}
+
 /***********************************************************
  *  BindGLTextures()
  *
@@ -135,22 +618,26 @@ void SceneManager::BindGLTextures()
 	{
 		// bind textures on corresponding texture units
 		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].texture.Get());
 	}
+	RenderStats::Count(RenderStats::COUNTER_TEXTURE_BINDS, m_loadedTextures);
 }
 
 /***********************************************************
  *  DestroyGLTextures()
  *
  *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  used texture memory slots, so the slots can be filled
+ *  again.
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
 	for (int i = 0; i < m_loadedTextures; i++)
 	{
-		glGenTextures(1, &m_textureIDs[i].ID);
+		m_textureIDs[i].texture.Reset();
+		m_textureIDs[i].tag.clear();
 	}
+	m_loadedTextures = 0;
 }
 
 /***********************************************************
@@ -165,201 +652,2566 @@ int SceneManager::FindTextureID(std::string tag)
 	int index = 0;
 	bool bFound = false;
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	while ((index < m_loadedTextures) && (bFound == false))
+	{
+		if (m_textureIDs[index].tag.compare(tag) == 0)
+		{
+			textureID = m_textureIDs[index].texture.Get();
+			bFound = true;
+		}
+		else
+			index++;
+	}
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting a slot index for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(std::string tag)
+{
+	int textureSlot = -1;
+	int index = 0;
+	bool bFound = false;
+
+	while ((index < m_loadedTextures) && (bFound == false))
+	{
+		if (m_textureIDs[index].tag.compare(tag) == 0)
+		{
+			textureSlot = index;
+			bFound = true;
+		}
+		else
+			index++;
+	}
+
+	return(textureSlot);
+}
+
+/***********************************************************
+ *  FindMaterial()
+ *
+ *  This method is used for getting a material from the previously
+ *  defined materials list that is associated with the passed in tag.
+ ***********************************************************/
+bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+{
+	if (m_objectMaterials.size() == 0)
+	{
+		return(false);
+	}
+
+	int index = 0;
+	bool bFound = false;
+	while ((index < (int)m_objectMaterials.size()) && (bFound == false))
+	{
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		{
+			bFound = true;
+			material.ambientColor = m_objectMaterials[index].ambientColor;
+			material.ambientStrength = m_objectMaterials[index].ambientStrength;
+			material.diffuseColor = m_objectMaterials[index].diffuseColor;
+			material.specularColor = m_objectMaterials[index].specularColor;
+			material.shininess = m_objectMaterials[index].shininess;
+		}
+		else
+		{
+			index++;
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  FindMaterialIndex()
+ *
+ *  This method is used for getting the index of a previously
+ *  defined material that is associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindMaterialIndex(std::string tag)
+{
+	int materialIndex = -1;
+	int index = 0;
+	bool bFound = false;
+
+	while ((index < (int)m_objectMaterials.size()) && (bFound == false))
+	{
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		{
+			materialIndex = index;
+			bFound = true;
+		}
+		else
+			index++;
+	}
+
+	return(materialIndex);
+}
+
+/***********************************************************
+ *  UploadMaterialTable()
+ *
+ *  This method is used for copying the defined materials into
+ *  the material table that the per-draw data indexes into.
+ ***********************************************************/
+void SceneManager::UploadMaterialTable()
+{
+	std::vector<DrawDataRingBuffer::MATERIAL_DATA> materialTable;
+
+	for (int i = 0; i < (int)m_objectMaterials.size(); i++)
+	{
+		DrawDataRingBuffer::MATERIAL_DATA entry;
+		entry.ambient = glm::vec4(m_objectMaterials[i].ambientColor, m_objectMaterials[i].ambientStrength);
+		entry.diffuse = glm::vec4(m_objectMaterials[i].diffuseColor, m_objectMaterials[i].opacity);
+		entry.specular = glm::vec4(m_objectMaterials[i].specularColor, m_objectMaterials[i].shininess);
+		materialTable.push_back(entry);
+	}
+
+	m_pDrawDataBuffer->UploadMaterials(materialTable.data(), (int)materialTable.size());
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	// variables for this method
+	glm::mat4 modelView;
+	glm::mat4 scale;
+	glm::mat4 rotationX;
+	glm::mat4 rotationY;
+	glm::mat4 rotationZ;
+	glm::mat4 translation;
+
+	// set the scale value in the transform buffer
+	scale = glm::scale(scaleXYZ);
+	// set the rotation values in the transform buffer
+	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+	// set the translation value in the transform buffer
+	translation = glm::translate(positionXYZ);
+
+	modelView = translation * rotationX * rotationY * rotationZ * scale;
+
+	// the transform is recorded with the next submitted mesh
+	m_drawState.model = modelView;
+}
+
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed in color
+ *  into the shader for the next draw command
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+	float redColorValue,
+	float greenColorValue,
+	float blueColorValue,
+	float alphaValue)
+{
+	// variables for this method
+	glm::vec4 currentColor;
+
+	currentColor.r = redColorValue;
+	currentColor.g = greenColorValue;
+	currentColor.b = blueColorValue;
+	currentColor.a = alphaValue;
+
+	m_drawState.objectColor = currentColor;
+	m_drawState.params.z = 0;
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in ID into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	std::string textureTag)
+{
+	// a packed texture is read from the slot of its page
+	int atlasEntry = (m_pTextureAtlas != NULL) ? m_pTextureAtlas->FindEntry(textureTag) : 0;
+	if (atlasEntry > 0)
+	{
+		m_drawState.params.y = m_pTextureAtlas->GetEntry(atlasEntry).slot;
+	}
+	else
+	{
+		m_drawState.params.y = FindTextureSlot(textureTag);
+	}
+	m_drawState.params.z = 1;
+	m_drawState.params.w = atlasEntry;
+}
+
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader.
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	m_drawState.uvScale = glm::vec4(u, v, 0.0f, 0.0f);
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for passing the material values
+ *  into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	std::string materialTag)
+{
+	m_drawState.params.x = FindMaterialIndex(materialTag);
+}
+
+/***********************************************************
+ *  SubmitMesh()
+ *
+ *  This method is used for recording a draw of the passed in
+ *  mesh with the transformation, color, texture and material
+ *  values set since the previous draw.
+ ***********************************************************/
+void SceneManager::SubmitMesh(
+	RenderQueue::MESH_TYPE meshType,
+	unsigned int meshParts)
+{
+	SubmitDraw(meshType, meshParts, -1);
+}
+
+/***********************************************************
+ *  SubmitDraw()
+ *
+ *  This method is used for recording a draw of a basic shape,
+ *  or of a loaded model when one is passed in, with the
+ *  values set since the previous draw.  Opaque and
+ *  transparent draws are sent to separate render passes.
+ ***********************************************************/
+void SceneManager::SubmitDraw(
+	RenderQueue::MESH_TYPE meshType,
+	unsigned int meshParts,
+	int model)
+{
+	RenderQueue::RENDER_ITEM item;
+	RenderQueue::RENDER_PASS pass = RenderQueue::PASS_OPAQUE;
+
+	item.meshType = meshType;
+	item.meshParts = meshParts;
+	item.model = model;
+
+	// the draws of a composition are recorded once and then
+	// submitted for every copy in a generated scene
+	if (m_recordingComposition >= 0)
+	{
+		item.blendMode = RenderQueue::BLEND_OPAQUE;
+		item.drawData = m_drawState;
+		item.sortKey = 0;
+		item.bVisible = true;
+		m_compositionItems[m_recordingComposition].push_back(item);
+		return;
+	}
+
+	item.blendMode = RenderQueue::BLEND_OPAQUE;
+	item.drawData = m_drawState;
+	item.sortKey = 0;
+
+	// the material decides how the object blends, and a flat
+	// color with alpha below one is blended as well
+	int materialIndex = m_drawState.params.x;
+	if ((materialIndex >= 0) && (materialIndex < (int)m_objectMaterials.size()))
+	{
+		item.blendMode = m_objectMaterials[materialIndex].blendMode;
+		if ((item.blendMode == RenderQueue::BLEND_OPAQUE) &&
+			(m_objectMaterials[materialIndex].opacity < 1.0f))
+		{
+			item.blendMode = RenderQueue::BLEND_ALPHA;
+		}
+	}
+	if ((item.blendMode == RenderQueue::BLEND_OPAQUE) &&
+		(m_drawState.params.z == 0) && (m_drawState.objectColor.a < 1.0f))
+	{
+		item.blendMode = RenderQueue::BLEND_ALPHA;
+	}
+
+	if (item.blendMode != RenderQueue::BLEND_OPAQUE)
+	{
+		pass = RenderQueue::PASS_TRANSPARENT;
+	}
+	// opaque draws are grouped by program ahead of depth, while
+	// transparent draws must stay strictly back to front
+	else if (m_pShaderPermutations != NULL)
+	{
+		item.sortKey = (uint64_t)GetDrawVariant(item) << 32;
+	}
+
+	m_pRenderQueue->Submit(pass, item);
+}
+
+/***********************************************************
+ *  SetViewParameters()
+ *
+ *  This method is used for passing in the camera matrices of
+ *  the current frame, which the draws are sorted against.
+ ***********************************************************/
+void SceneManager::SetViewParameters(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& viewPosition)
+{
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+	m_viewPosition = viewPosition;
+}
+
+/***********************************************************
+ *  RestoreShaderState()
+ *
+ *  This method is used for setting up a program that just
+ *  replaced the scene program.  Values that are only set in
+ *  PrepareScene() are applied again, while everything set per
+ *  frame or per draw is picked up on its own.
+ ***********************************************************/
+void SceneManager::RestoreShaderState()
+{
+	m_pShaderManager->use();
+
+	// the variants were built from the replaced sources
+	if (m_pShaderPermutations != NULL)
+	{
+		m_pShaderPermutations->Clear();
+	}
+
+	PrepareShaderProgram();
+
+	// and so was the program of the GPU culled draws
+	if (m_pGpuCuller != NULL)
+	{
+		m_gpuProgram.Reset();
+		if (CreateGpuProgram() == false)
+		{
+			std::cout << "WARNING: reloaded shaders can't be drawn by the GPU culling, drawing on the CPU" << std::endl;
+			delete m_pGpuCuller;
+			m_pGpuCuller = NULL;
+		}
+		m_pShaderManager->use();
+	}
+}
+
+/***********************************************************
+ *  PrepareShaderProgram()
+ *
+ *  This method is used for setting the values PrepareScene()
+ *  sets only once into the program in use, which was linked
+ *  after them.
+ ***********************************************************/
+void SceneManager::PrepareShaderProgram()
+{
+	GLuint programID = m_pShaderManager->m_programID;
+	GLuint blockIndex = glGetUniformBlockIndex(programID, "CameraBlock");
+	if (blockIndex != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(programID, blockIndex, CameraUniformBuffer::CAMERA_BLOCK_BINDING);
+	}
+
+	if (m_pDrawDataBuffer->IsActive())
+	{
+		if (m_pDrawDataBuffer->BindProgram(programID) == false)
+		{
+			std::cout << "WARNING: shader program has no draw data block, restart to use per-draw uniforms" << std::endl;
+		}
+		for (int i = 0; i < m_loadedTextures; i++)
+		{
+			m_pShaderManager->setSampler2DValue("objectTextures[" + std::to_string(i) + "]", i);
+		}
+	}
+	SetAtlasRects();
+
+	SetupSceneLights();
+}
+
+/***********************************************************
+ *  SetShaderPermutations()
+ *
+ *  This method is used for drawing each object with a program
+ *  built for just the features it uses.  Variants are built
+ *  from the sources the cache loaded, the first time a draw
+ *  needs one.
+ ***********************************************************/
+void SceneManager::SetShaderPermutations(ShaderProgramCache* pProgramCache)
+{
+	delete m_pShaderPermutations;
+	m_pShaderPermutations = NULL;
+
+	if (pProgramCache != NULL)
+	{
+		m_pShaderPermutations = new ShaderPermutations(pProgramCache);
+	}
+}
+
+/***********************************************************
+ *  SetGpuCulling()
+ *
+ *  This method is used for culling and drawing the static
+ *  opaque draws on the GPU.  The draws index the shared
+ *  buffers of the quantized shapes, which are switched on
+ *  for it, and read their values from the draw data block.
+ *  Moving and transparent draws still go through the render
+ *  queue.
+ ***********************************************************/
+void SceneManager::SetGpuCulling(ShaderProgramCache* pProgramCache)
+{
+	delete m_pGpuCuller;
+	m_pGpuCuller = NULL;
+	m_gpuProgram.Reset();
+	m_pGpuProgramCache = pProgramCache;
+	m_gpuCpuItems.clear();
+	m_bGpuSceneDirty = true;
+
+	if (pProgramCache == NULL)
+	{
+		return;
+	}
+
+	if (m_bQuantizedMeshes == false)
+	{
+		SetQuantizedMeshes(true);
+	}
+	if ((m_bQuantizedMeshes == false) || (m_pDrawDataBuffer->IsActive() == false))
+	{
+		std::cout << "INFO: GPU culling needs the quantized meshes and the draw data buffer, drawing on the CPU" << std::endl;
+		return;
+	}
+
+	m_pGpuCuller = new GpuCuller();
+	if ((m_pGpuCuller->Initialize() == false) || (CreateGpuProgram() == false))
+	{
+		std::cout << "INFO: GPU culling is not available, drawing on the CPU" << std::endl;
+		delete m_pGpuCuller;
+		m_pGpuCuller = NULL;
+	}
+	m_pShaderManager->use();
+}
+
+/***********************************************************
+ *  CreateGpuProgram()
+ *
+ *  This method is used for building the scene program the
+ *  GPU culled draws use, from the current sources of the
+ *  cache with the draw index taken from the commands.  It is
+ *  built at once since nothing else can draw those objects.
+ ***********************************************************/
+bool SceneManager::CreateGpuProgram()
+{
+	std::string vertexSource = m_pGpuProgramCache->GetVertexSource();
+	std::string fragmentSource = m_pGpuProgramCache->GetFragmentSource();
+
+	if (GpuCuller::AdaptSceneSources(vertexSource, fragmentSource) == false)
+	{
+		std::cout << "INFO: scene shaders don't read a draw index, GPU culling is not possible" << std::endl;
+		return false;
+	}
+
+	ShaderProgramCache::PROGRAM_BUILD build = m_pGpuProgramCache->BeginBuild(vertexSource, fragmentSource);
+	if (build.programID == 0)
+	{
+		return false;
+	}
+
+	GLuint programID = m_pGpuProgramCache->FinishBuild(build);
+	m_gpuProgram.Adopt(programID, "GPU culled scene", GpuResourceRegistry::EstimateProgramBytes(programID));
+	m_bGpuProgramPrepared = false;
+
+	return(m_gpuProgram.Get() != 0);
+}
+
+/***********************************************************
+ *  BuildGpuScene()
+ *
+ *  This method is used for uploading the static draws of the
+ *  scene.  They are recorded through the render queue as for
+ *  any frame, and every selected part of each opaque draw
+ *  becomes one command, bounded by the sphere around the
+ *  bounds of its shape.  Transparent draws are kept to be
+ *  submitted every frame, so they are still sorted.
+ ***********************************************************/
+void SceneManager::BuildGpuScene()
+{
+	std::vector<GpuCuller::GPU_OBJECT> objects;
+	std::vector<DrawDataRingBuffer::DRAW_DATA> drawData;
+
+	m_pRenderQueue->Clear();
+	if (m_generatedObjects.empty() == false)
+	{
+		SubmitGeneratedObjects(false);
+	}
+	else
+	{
+		DrawDesk();
+		DrawCup();
+		DrawFrenchBook();
+		DrawNoteBook();
+		DrawMechPencil();
+		DrawEraser();
+		DrawImportedModels();
+	}
+
+	// loaded models aren't in the shared buffers the commands
+	// index, so they are kept with the transparent draws
+	m_gpuCpuItems.clear();
+	int opaqueCount = m_pRenderQueue->GetSubmittedCount(RenderQueue::PASS_OPAQUE);
+	drawData.reserve(opaqueCount);
+	for (int i = 0; i < opaqueCount; i++)
+	{
+		const RenderQueue::RENDER_ITEM& item = m_pRenderQueue->GetSubmittedItem(RenderQueue::PASS_OPAQUE, i);
+		if (item.model >= 0)
+		{
+			m_gpuCpuItems.push_back(item);
+			continue;
+		}
+		const MeshLibrary::MESH_RANGE& range = m_pMeshLibrary->GetMeshRange(item.meshType);
+
+		DrawDataRingBuffer::DRAW_DATA data = item.drawData;
+		data.model = GetDrawModelMatrix(item);
+		data.normalMatrix = glm::transpose(glm::inverse(item.drawData.model));
+
+		const glm::mat4& model = item.drawData.model;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		GetDrawBounds(item, boundsMin, boundsMax);
+		float scale = std::max(glm::length(glm::vec3(model[0])),
+			std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+		GpuCuller::GPU_OBJECT object;
+		object.sphere = glm::vec4(glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f)),
+			glm::length((boundsMax - boundsMin) * 0.5f) * scale);
+		for (int p = 0; p < (int)range.parts.size(); p++)
+		{
+			const MeshBuilder::MESH_PART& part = range.parts[p];
+			if ((part.flags & item.meshParts) != 0)
+			{
+				object.command = glm::ivec4(part.indexCount, part.firstIndex, range.baseVertex, (int)drawData.size());
+				objects.push_back(object);
+			}
+		}
+		drawData.push_back(data);
+	}
+
+	int transparentCount = m_pRenderQueue->GetSubmittedCount(RenderQueue::PASS_TRANSPARENT);
+	for (int i = 0; i < transparentCount; i++)
+	{
+		m_gpuCpuItems.push_back(m_pRenderQueue->GetSubmittedItem(RenderQueue::PASS_TRANSPARENT, i));
+	}
+	m_pRenderQueue->Clear();
+
+	m_pGpuCuller->SetObjects(objects, drawData);
+	m_bGpuSceneDirty = false;
+
+	std::cout << "INFO: GPU culling " << objects.size() << " commands of " << drawData.size()
+		<< " static draws, " << m_gpuCpuItems.size() << " transparent and model draws on the CPU" << std::endl;
+}
+
+/***********************************************************
+ *  DrawGpuScene()
+ *
+ *  This method is used for culling and drawing the uploaded
+ *  static draws with their own program.  Like a variant, the
+ *  program doesn't get the camera uniforms the view manager
+ *  sets, so those are set here.
+ ***********************************************************/
+void SceneManager::DrawGpuScene()
+{
+	m_pGpuCuller->Cull(m_projectionMatrix * m_viewMatrix);
+
+	m_pShaderManager->m_programID = m_gpuProgram.Get();
+	m_pShaderManager->use();
+	if (m_bGpuProgramPrepared == false)
+	{
+		PrepareShaderProgram();
+		m_bGpuProgramPrepared = true;
+	}
+	m_pShaderManager->setMat4Value("view", m_viewMatrix);
+	m_pShaderManager->setMat4Value("projection", m_projectionMatrix);
+	m_pShaderManager->setVec3Value("viewPosition", m_viewPosition);
+	RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS, 3);
+
+	m_pGpuCuller->Draw(m_pMeshLibrary->GetVertexArray());
+
+	m_pShaderManager->m_programID = m_generalProgramID;
+	m_pShaderManager->use();
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES, 2);
+}
+
+/***********************************************************
+ *  GenerateScene()
+ *
+ *  This method is used for drawing a grid of desks instead of
+ *  the single one, for measuring how the renderer scales.
+ *  The desks are filled with copies of the objects drawn by
+ *  RenderScene(), so every rendering setting applies to them
+ *  as it does to the original desk.
+ ***********************************************************/
+void SceneManager::GenerateScene(const SceneGenerator::GENERATOR_SETTINGS& settings)
+{
+	if (m_compositionItems[SceneGenerator::COMPOSITION_DESK].empty())
+	{
+		RecordCompositions();
+	}
+
+	SceneGenerator::Generate(settings, m_generatedObjects);
+	CreateGeneratedAnimations();
+	m_bGpuSceneDirty = true;
+	m_bSpatialIndexDirty = true;
+
+	size_t drawCount = 0;
+	int animatedCount = 0;
+	for (int i = 0; i < (int)m_generatedObjects.size(); i++)
+	{
+		drawCount += m_compositionItems[m_generatedObjects[i].composition].size();
+		if (m_generatedObjects[i].bAnimated)
+		{
+			animatedCount++;
+		}
+	}
+
+	std::cout << "INFO: generated scene with seed " << settings.seed << ": " << settings.deskCount
+		<< " desks, " << m_generatedObjects.size() << " objects, " << animatedCount << " moving, "
+		<< drawCount << " draws per frame" << std::endl;
+}
+
+/***********************************************************
+ *  CreateGeneratedAnimations()
+ *
+ *  This method is used for giving every moving generated
+ *  object an instance of the moving clip.  The instance turns
+ *  about the center of the composition from the object's
+ *  still placement, at the object's spin speed, and starts
+ *  at its phase.
+ ***********************************************************/
+void SceneManager::CreateGeneratedAnimations()
+{
+	int clip = -1;
+
+	m_pAnimationSystem->Clear();
+	m_generatedAnimations.assign(m_generatedObjects.size(), -1);
+	for (int i = 0; i < (int)m_generatedObjects.size(); i++)
+	{
+		SceneGenerator::GENERATED_OBJECT placement = m_generatedObjects[i];
+		if (placement.bAnimated == false)
+		{
+			continue;
+		}
+		if (clip < 0)
+		{
+			clip = m_pAnimationSystem->AddClip(BuildMovingClip());
+		}
+
+		placement.bAnimated = false;
+		const glm::vec3& center = m_compositionCenters[placement.composition];
+		float speed = placement.spinSpeed / g_MovingSpinSpeed;
+		float startTime = -(placement.phase / glm::radians(360.0f)) * g_MovingClipSeconds / speed;
+		m_generatedAnimations[i] = m_pAnimationSystem->AddInstance(
+			clip, SceneGenerator::GetTransform(placement, center, 0.0f), center, startTime, speed);
+	}
+
+	m_pAnimationSystem->Update(m_sceneTime);
+}
+
+/***********************************************************
+ *  RecordCompositions()
+ *
+ *  This method is used for capturing the draws each of the
+ *  scene's Draw methods submits.  Each composition turns
+ *  about the average origin of its draws.
+ ***********************************************************/
+void SceneManager::RecordCompositions()
+{
+	for (int composition = 0; composition < SceneGenerator::COMPOSITION_COUNT; composition++)
+	{
+		m_compositionItems[composition].clear();
+		m_recordingComposition = composition;
+
+		switch (composition)
+		{
+		case SceneGenerator::COMPOSITION_DESK:
+			DrawDesk();
+			break;
+		case SceneGenerator::COMPOSITION_CUP:
+			DrawCup();
+			break;
+		case SceneGenerator::COMPOSITION_FRENCH_BOOK:
+			DrawFrenchBook();
+			break;
+		case SceneGenerator::COMPOSITION_NOTEBOOK:
+			DrawNoteBook();
+			break;
+		case SceneGenerator::COMPOSITION_MECH_PENCIL:
+			DrawMechPencil();
+			break;
+		case SceneGenerator::COMPOSITION_ERASER:
+			DrawEraser();
+			break;
+		}
+
+		glm::vec3 center(0.0f);
+		const std::vector<RenderQueue::RENDER_ITEM>& items = m_compositionItems[composition];
+		for (int i = 0; i < (int)items.size(); i++)
+		{
+			center += glm::vec3(items[i].drawData.model[3]);
+		}
+		if (items.empty() == false)
+		{
+			center /= (float)items.size();
+		}
+		m_compositionCenters[composition] = center;
+	}
+
+	m_recordingComposition = -1;
+}
+
+/***********************************************************
+ *  SubmitGeneratedScene()
+ *
+ *  This method is used for submitting the recorded draws of
+ *  every generated object, moved into place and with the
+ *  material and texture of its variant.  Variants step
+ *  through the defined materials and loaded textures from
+ *  the ones of the original draw.
+ ***********************************************************/
+void SceneManager::SubmitGeneratedScene()
+{
+	SubmitGeneratedObjects(false);
+	SubmitGeneratedObjects(true);
+}
+
+/***********************************************************
+ *  SubmitGeneratedObjects()
+ *
+ *  This method is used for submitting the recorded draws of
+ *  either the still or the moving generated objects.
+ ***********************************************************/
+void SceneManager::SubmitGeneratedObjects(bool bAnimated)
+{
+	int materialCount = (int)m_objectMaterials.size();
+
+	for (int i = 0; i < (int)m_generatedObjects.size(); i++)
+	{
+		const SceneGenerator::GENERATED_OBJECT& object = m_generatedObjects[i];
+		if (object.bAnimated != bAnimated)
+		{
+			continue;
+		}
+		const std::vector<RenderQueue::RENDER_ITEM>& items = m_compositionItems[object.composition];
+		// moving objects take the pose and material values their
+		// animation was sampled at
+		glm::mat4 transform;
+		glm::vec4 color(1.0f);
+		glm::vec4 uvScale(1.0f);
+		int animation = m_generatedAnimations[i];
+		if (animation >= 0)
+		{
+			transform = m_pAnimationSystem->GetTransform(animation);
+			color = m_pAnimationSystem->GetColor(animation);
+			uvScale = m_pAnimationSystem->GetUVScale(animation);
+		}
+		else
+		{
+			transform = SceneGenerator::GetTransform(object, m_compositionCenters[object.composition], m_sceneTime);
+		}
+
+		for (int j = 0; j < (int)items.size(); j++)
+		{
+			m_drawState = items[j].drawData;
+			m_drawState.model = transform * items[j].drawData.model;
+			m_drawState.objectColor *= color;
+			m_drawState.uvScale.x *= uvScale.x;
+			m_drawState.uvScale.y *= uvScale.y;
+			if ((object.textureVariant > 0) && (m_drawState.params.z != 0) && (m_textureChoices.empty() == false))
+			{
+				int choice = 0;
+				for (int c = 0; c < (int)m_textureChoices.size(); c++)
+				{
+					if ((m_textureChoices[c].x == m_drawState.params.y) && (m_textureChoices[c].y == m_drawState.params.w))
+					{
+						choice = c;
+					}
+				}
+				const glm::ivec2& variant = m_textureChoices[(choice + object.textureVariant) % m_textureChoices.size()];
+				m_drawState.params.y = variant.x;
+				m_drawState.params.w = variant.y;
+			}
+			if ((object.materialVariant > 0) && (m_drawState.params.x >= 0) && (materialCount > 0))
+			{
+				m_drawState.params.x = (m_drawState.params.x + object.materialVariant) % materialCount;
+			}
+			SubmitMesh(items[j].meshType, items[j].meshParts);
+		}
+	}
+}
+
+/***********************************************************
+ *  SetSceneTime()
+ *
+ *  This method is used for passing in the time the moving
+ *  objects of a generated scene are placed at.
+ ***********************************************************/
+void SceneManager::SetSceneTime(float seconds)
+{
+	m_sceneTime = seconds;
+	m_pAnimationSystem->Update(seconds);
+}
+
+/***********************************************************
+ *  TimeAnimation()
+ *
+ *  This method is used for timing the animation of as many
+ *  moving objects as its budget is set for, each playing the
+ *  moving clip at its own speed and start.  The frames are
+ *  timed here rather than by the suite, since the objects
+ *  have to be set up before the first one.
+ ***********************************************************/
+void SceneManager::TimeAnimation(BenchmarkSuite& suite)
+{
+	AnimationSystem animation(m_pThreadPool);
+	int clip = animation.AddClip(BuildMovingClip());
+	int rowLength = (int)std::sqrt((float)g_AnimationBenchmarkObjects);
+
+	for (int i = 0; i < g_AnimationBenchmarkObjects; i++)
+	{
+		glm::mat4 placement = glm::translate(glm::vec3((float)(i % rowLength), 0.0f, (float)(i / rowLength)));
+		animation.AddInstance(clip, placement, glm::vec3(0.0f), (float)(i % 100) * -0.06f, 0.5f + (float)(i % 11) * 0.1f);
+	}
+
+	std::vector<double> times;
+	for (int frame = 0; frame < g_AnimationBenchmarkFrames; frame++)
+	{
+		animation.Update((float)frame / 60.0f);
+		times.push_back(animation.GetStats().sampleMilliseconds * 1000000.0);
+	}
+	std::sort(times.begin(), times.end());
+
+	suite.AddResult("AnimationSystem::Update", g_AnimationBenchmarkFrames, times[times.size() / 2], times[0]);
+	std::cout << "INFO: median animation update of " << g_AnimationBenchmarkObjects << " moving objects "
+		<< times[times.size() / 2] / 1000000.0 << " ms using " << m_pThreadPool->GetThreadCount()
+		<< " threads" << std::endl;
+}
+
+/***********************************************************
+ *  AddBenchmarks()
+ *
+ *  This method is used for registering benchmarks of the
+ *  per-draw helpers and of recording and sorting a frame.
+ *  Lookups use the last tag, the slowest for the linear
+ *  search.  Only CPU work is timed, no draw calls are made.
+ ***********************************************************/
+void SceneManager::AddBenchmarks(BenchmarkSuite& suite)
+{
+	std::string textureTag = (m_loadedTextures > 0) ? m_textureIDs[m_loadedTextures - 1].tag : std::string();
+	std::string materialTag = m_objectMaterials.empty() ? std::string() : m_objectMaterials.back().tag;
+
+	suite.Add("SceneManager::SetTransformations", [this](int iterations)
+		{
+			for (int i = 0; i < iterations; i++)
+			{
+				SetTransformations(glm::vec3(1.0f, 2.0f, 1.0f), 10.0f, (float)(i & 255), 30.0f, glm::vec3(-2.5f, 0.0f, -1.0f));
+				BenchmarkSuite::DoNotOptimize(m_drawState.model);
+			}
+		});
+	suite.Add("SceneManager::FindTextureSlot", [this, textureTag](int iterations)
+		{
+			for (int i = 0; i < iterations; i++)
+			{
+				int slot = FindTextureSlot(textureTag);
+				BenchmarkSuite::DoNotOptimize(slot);
+			}
+		});
+	suite.Add("SceneManager::FindMaterial", [this, materialTag](int iterations)
+		{
+			OBJECT_MATERIAL material;
+			for (int i = 0; i < iterations; i++)
+			{
+				bool bFound = FindMaterial(materialTag, material);
+				BenchmarkSuite::DoNotOptimize(bFound);
+			}
+		});
+	suite.Add("SceneManager::SetShaderMaterial", [this, materialTag](int iterations)
+		{
+			for (int i = 0; i < iterations; i++)
+			{
+				SetShaderMaterial(materialTag);
+				BenchmarkSuite::DoNotOptimize(m_drawState.params);
+			}
+		});
+	suite.Add("SceneManager::SubmitScene", [this](int iterations)
+		{
+			for (int i = 0; i < iterations; i++)
+			{
+				SubmitScene();
+				m_pRenderQueue->Clear();
+				m_pFrameArena->BeginFrame();
+			}
+		});
+	suite.Add("RenderQueue::Sort", [this](int iterations)
+		{
+			SubmitScene();
+			for (int i = 0; i < iterations; i++)
+			{
+				m_pRenderQueue->Sort(m_viewMatrix);
+			}
+			m_pRenderQueue->Clear();
+		});
+
+	// rays from the camera through a grid of points around the
+	// view direction, the way the cursor picks
+	UpdateSpatialIndex();
+	suite.Add("SpatialIndex::Raycast", [this](int iterations)
+		{
+			glm::mat4 inverseView = glm::inverse(m_viewMatrix);
+			SpatialIndex::RAY_HIT hit;
+			for (int i = 0; i < iterations; i++)
+			{
+				glm::vec3 offset((float)(i % 16) / 16.0f - 0.5f, (float)((i / 16) % 16) / 16.0f - 0.5f, -1.0f);
+				glm::vec3 direction = glm::normalize(glm::vec3(inverseView * glm::vec4(offset, 0.0f)));
+				bool bHit = m_pSpatialIndex->Raycast(m_viewPosition, direction, 1.0e6f, hit);
+				BenchmarkSuite::DoNotOptimize(bHit);
+			}
+		});
+	suite.Add("SpatialIndex::QueryRadius", [this](int iterations)
+		{
+			std::vector<int> objects;
+			for (int i = 0; i < iterations; i++)
+			{
+				m_pSpatialIndex->QueryRadius(m_viewPosition, 10.0f, objects);
+				BenchmarkSuite::DoNotOptimize(objects.size());
+			}
+		});
+}
+
+/***********************************************************
+ *  SubmitScene()
+ *
+ *  This method is used for submitting the draws RenderScene()
+ *  records, without flushing them.
+ ***********************************************************/
+void SceneManager::SubmitScene()
+{
+	if (m_generatedObjects.empty() == false)
+	{
+		SubmitGeneratedScene();
+		return;
+	}
+
+	DrawDesk();
+	DrawCup();
+	DrawFrenchBook();
+	DrawNoteBook();
+	DrawMechPencil();
+	DrawEraser();
+	DrawImportedModels();
+}
+
+/***********************************************************
+ *  UpdateSpatialIndex()
+ *
+ *  This method is used for indexing the draws of the scene.
+ *  Each draw becomes one object, with the world bounds of its
+ *  shape and the triangles of the parts it draws, so a ray
+ *  has to hit the surface and not just the box.  The index
+ *  is built again after the scene changes, or when moving
+ *  objects have moved since.  Objects whose animation is
+ *  paused or finished don't count as moving.
+ ***********************************************************/
+void SceneManager::UpdateSpatialIndex()
+{
+	uint64_t animationChanges = m_pAnimationSystem->GetStats().changeCount;
+	if ((m_bSpatialIndexDirty == false) && (m_spatialIndexAnimationChanges == animationChanges))
+	{
+		return;
+	}
+
+	m_pRenderQueue->Clear();
+	SubmitScene();
+
+	m_spatialItems.clear();
+	for (int pass = 0; pass < RenderQueue::PASS_COUNT; pass++)
+	{
+		int itemCount = m_pRenderQueue->GetSubmittedCount((RenderQueue::RENDER_PASS)pass);
+		for (int i = 0; i < itemCount; i++)
+		{
+			m_spatialItems.push_back(m_pRenderQueue->GetSubmittedItem((RenderQueue::RENDER_PASS)pass, i));
+		}
+	}
+	m_pRenderQueue->Clear();
+
+	std::vector<SpatialIndex::SPATIAL_OBJECT> objects(m_spatialItems.size());
+	for (int i = 0; i < (int)m_spatialItems.size(); i++)
+	{
+		const RenderQueue::RENDER_ITEM& item = m_spatialItems[i];
+		const glm::mat4& model = item.drawData.model;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		GetDrawBounds(item, boundsMin, boundsMax);
+		glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		glm::vec3 halfSize = (boundsMax - boundsMin) * 0.5f;
+
+		// the box around the turned box, from the absolute
+		// values of the matrix
+		glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+		glm::vec3 worldHalfSize(0.0f);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			worldHalfSize += glm::abs(glm::vec3(model[axis])) * halfSize[axis];
+		}
+
+		objects[i].boundsMin = worldCenter - worldHalfSize;
+		objects[i].boundsMax = worldCenter + worldHalfSize;
+		objects[i].meshIndex = (item.model >= 0) ? m_sceneModels[item.model]->spatialMesh :
+			GetSpatialMesh(item.meshType, item.meshParts);
+		objects[i].transform = model;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	m_pSpatialIndex->Build(objects);
+	if (m_bSpatialIndexDirty)
+	{
+		std::cout << "INFO: spatial index of " << objects.size() << " draws built with "
+			<< m_pSpatialIndex->GetNodeCount() << " nodes in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+			<< " ms" << std::endl;
+	}
+
+	m_bSpatialIndexDirty = false;
+	m_spatialIndexAnimationChanges = animationChanges;
+}
+
+/***********************************************************
+ *  GetSpatialMesh()
+ *
+ *  This method is used for adding the triangles of the parts
+ *  of a shape to the spatial index, the first time a draw of
+ *  them is indexed.
+ ***********************************************************/
+int SceneManager::GetSpatialMesh(RenderQueue::MESH_TYPE meshType, unsigned int meshParts)
+{
+	meshParts &= RenderQueue::MESH_PART_ALL;
+	if (m_spatialMeshes[meshType][meshParts] >= 0)
+	{
+		return(m_spatialMeshes[meshType][meshParts]);
+	}
+
+	MeshBuilder::MESH_DATA mesh;
+	MeshBuilder::Build(meshType, mesh);
+
+	std::vector<glm::vec3> positions(mesh.GetVertexCount());
+	for (int i = 0; i < (int)positions.size(); i++)
+	{
+		const float* pVertex = &mesh.vertices[i * MeshBuilder::FLOATS_PER_VERTEX];
+		positions[i] = glm::vec3(pVertex[0], pVertex[1], pVertex[2]);
+	}
+
+	std::vector<uint32_t> indices;
+	for (int p = 0; p < (int)mesh.parts.size(); p++)
+	{
+		const MeshBuilder::MESH_PART& part = mesh.parts[p];
+		if ((part.flags & meshParts) != 0)
+		{
+			indices.insert(indices.end(), mesh.indices.begin() + part.firstIndex,
+				mesh.indices.begin() + part.firstIndex + part.indexCount);
+		}
+	}
+
+	m_spatialMeshes[meshType][meshParts] = m_pSpatialIndex->AddMesh(positions, indices);
+
+	return(m_spatialMeshes[meshType][meshParts]);
+}
+
+/***********************************************************
+ *  GetMeshDrawCounts()
+ *
+ *  This method is used for getting how many draw calls and
+ *  triangles drawing the parts of a shape takes, counted
+ *  from the built shape the first time it is drawn.  Each
+ *  part is assumed to be a draw call of its own, as it is
+ *  in the mesh library.
+ ***********************************************************/
+const glm::ivec2& SceneManager::GetMeshDrawCounts(RenderQueue::MESH_TYPE meshType, unsigned int meshParts)
+{
+	meshParts &= RenderQueue::MESH_PART_ALL;
+	glm::ivec2& counts = m_meshDrawCounts[meshType][meshParts];
+	if (counts.x >= 0)
+	{
+		return(counts);
+	}
+
+	MeshBuilder::MESH_DATA mesh;
+	MeshBuilder::Build(meshType, mesh);
+
+	counts = glm::ivec2(0, 0);
+	for (int p = 0; p < (int)mesh.parts.size(); p++)
+	{
+		if ((mesh.parts[p].flags & meshParts) != 0)
+		{
+			counts.x++;
+			counts.y += mesh.parts[p].indexCount / 3;
+		}
+	}
+
+	return(counts);
+}
+
+/***********************************************************
+ *  TrackShapeMeshMemory()
+ *
+ *  This method is used for recording the memory of the
+ *  shapes loaded into ShapeMeshes.  Its buffers aren't ours
+ *  to see, so they are sized from the same shapes built by
+ *  MeshBuilder, with float vertices and 32-bit indices.
+ ***********************************************************/
+void SceneManager::TrackShapeMeshMemory()
+{
+	for (int i = 0; i < RenderQueue::MESH_TYPE_COUNT; i++)
+	{
+		RenderQueue::MESH_TYPE meshType = (RenderQueue::MESH_TYPE)i;
+		MeshBuilder::MESH_DATA mesh;
+		MeshBuilder::Build(meshType, mesh);
+
+		m_shapeMeshMemory[i].Track(GpuResourceRegistry::CATEGORY_BUFFER,
+			std::string("ShapeMeshes ") + MeshLibrary::GetMeshName(meshType),
+			mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(uint32_t));
+	}
+}
+
+/***********************************************************
+ *  RenderReferenceImage()
+ *
+ *  This method is used for rendering a ground truth image of
+ *  the scene with the path tracer, from the camera passed to
+ *  SetViewParameters().  Every draw of the spatial index is
+ *  traced with its material, or its flat color, and the
+ *  active lights.  Textured draws use the average color of
+ *  their texture, since the tracer doesn't follow the
+ *  texture coordinates.
+ ***********************************************************/
+bool SceneManager::RenderReferenceImage(const char* filename, const PathTracer::TRACE_SETTINGS& settings)
+{
+	UpdateSpatialIndex();
+
+	std::vector<glm::vec3> textureColors(m_loadedTextures);
+	for (int i = 0; i < m_loadedTextures; i++)
+	{
+		textureColors[i] = GetTextureAverageColor(i);
+	}
+
+	std::vector<PathTracer::TRACE_SURFACE> surfaces(m_spatialItems.size());
+	for (int i = 0; i < (int)m_spatialItems.size(); i++)
+	{
+		const DrawDataRingBuffer::DRAW_DATA& drawData = m_spatialItems[i].drawData;
+		PathTracer::TRACE_SURFACE& surface = surfaces[i];
+
+		surface.baseColor = glm::vec3(drawData.objectColor);
+		surface.opacity = drawData.objectColor.a;
+		if ((drawData.params.z != 0) && (drawData.params.w > 0))
+		{
+			surface.baseColor = GetAtlasEntryColor(drawData.params.w);
+			surface.opacity = 1.0f;
+		}
+		else if ((drawData.params.z != 0) && (drawData.params.y >= 0) && (drawData.params.y < m_loadedTextures))
+		{
+			surface.baseColor = textureColors[drawData.params.y];
+			surface.opacity = 1.0f;
+		}
+
+		surface.diffuseColor = glm::vec3(1.0f);
+		surface.specularColor = glm::vec3(0.0f);
+		surface.shininess = 1.0f;
+		int materialIndex = drawData.params.x;
+		if ((materialIndex >= 0) && (materialIndex < (int)m_objectMaterials.size()))
+		{
+			const OBJECT_MATERIAL& material = m_objectMaterials[materialIndex];
+			surface.diffuseColor = material.diffuseColor;
+			surface.specularColor = material.specularColor;
+			surface.shininess = material.shininess;
+			surface.opacity *= material.opacity;
+		}
+	}
+
+	std::vector<PathTracer::TRACE_LIGHT> lights;
+	for (int i = 0; i < (int)m_sceneLights.size(); i++)
+	{
+		const SCENE_LIGHT& sceneLight = m_sceneLights[i];
+		if (sceneLight.bActive == false)
+		{
+			continue;
+		}
+
+		PathTracer::TRACE_LIGHT light;
+		light.bPointLight = sceneLight.bPointLight;
+		light.vector = sceneLight.vector;
+		light.diffuse = sceneLight.diffuse;
+		light.specular = sceneLight.specular;
+		light.constant = sceneLight.constant;
+		light.linear = sceneLight.linear;
+		light.quadratic = sceneLight.quadratic;
+		lights.push_back(light);
+	}
+
+	PathTracer tracer(m_pThreadPool);
+	tracer.SetScene(m_pSpatialIndex, surfaces, lights);
+
+	return(tracer.Render(m_viewMatrix, m_projectionMatrix, settings, filename));
+}
+
+/***********************************************************
+ *  GetTextureAverageColor()
+ *
+ *  This method is used for getting the average color of a
+ *  loaded texture by reading back its 1 by 1 mipmap level.
+ ***********************************************************/
+glm::vec3 SceneManager::GetTextureAverageColor(int textureSlot)
+{
+	glm::vec4 color(1.0f);
+	GLint width = 0;
+	GLint height = 0;
+	int level = 0;
+
+	glBindTexture(GL_TEXTURE_2D, m_textureIDs[textureSlot].texture.Get());
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	while ((width > 1) || (height > 1))
+	{
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+		level++;
+	}
+	glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_FLOAT, &color[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return(glm::vec3(color));
+}
+
+/***********************************************************
+ *  GetAtlasEntryColor()
+ *
+ *  This method is used for getting the average color of an
+ *  image in the texture atlas, which was measured when it
+ *  was packed since its page holds other images too.
+ ***********************************************************/
+glm::vec3 SceneManager::GetAtlasEntryColor(int atlasEntry) const
+{
+	if ((m_pTextureAtlas == NULL) || (atlasEntry <= 0) || (atlasEntry >= m_pTextureAtlas->GetEntryCount()))
+	{
+		return(glm::vec3(1.0f));
+	}
+
+	return(m_pTextureAtlas->GetEntry(atlasEntry).averageColor);
+}
+
+/***********************************************************
+ *  PickObject()
+ *
+ *  This method is used for finding the draw whose surface a
+ *  ray hits first, such as the one under the cursor.
+ ***********************************************************/
+int SceneManager::PickObject(const glm::vec3& origin, const glm::vec3& direction, float& distance)
+{
+	SpatialIndex::RAY_HIT hit;
+
+	UpdateSpatialIndex();
+	if (m_pSpatialIndex->Raycast(origin, direction, std::numeric_limits<float>::max(), hit) == false)
+	{
+		return(-1);
+	}
+
+	distance = hit.distance;
+
+	return(hit.objectIndex);
+}
+
+/***********************************************************
+ *  FindNearestObject()
+ *
+ *  This method is used for finding the draw closest to a
+ *  point, measured to its bounds.
+ ***********************************************************/
+int SceneManager::FindNearestObject(const glm::vec3& point, float maxDistance)
+{
+	float distance = 0.0f;
+
+	UpdateSpatialIndex();
+
+	return(m_pSpatialIndex->FindNearest(point, maxDistance, distance));
+}
+
+/***********************************************************
+ *  FindObjectsInRadius()
+ *
+ *  This method is used for finding every draw within a
+ *  distance of a point, measured to their bounds.
+ ***********************************************************/
+void SceneManager::FindObjectsInRadius(const glm::vec3& center, float radius, std::vector<int>& objects)
+{
+	UpdateSpatialIndex();
+	m_pSpatialIndex->QueryRadius(center, radius, objects);
+}
+
+/***********************************************************
+ *  DescribeObject()
+ *
+ *  This method is used for naming a draw found by the
+ *  spatial queries by its shape and material.
+ ***********************************************************/
+std::string SceneManager::DescribeObject(int objectIndex) const
+{
+	if ((objectIndex < 0) || (objectIndex >= (int)m_spatialItems.size()))
+	{
+		return("nothing");
+	}
+
+	const RenderQueue::RENDER_ITEM& item = m_spatialItems[objectIndex];
+	std::string description = (item.model >= 0) ? m_sceneModels[item.model]->tag :
+		std::string(MeshLibrary::GetMeshName(item.meshType));
+	int materialIndex = item.drawData.params.x;
+	if ((materialIndex >= 0) && (materialIndex < (int)m_objectMaterials.size()))
+	{
+		description += " (" + m_objectMaterials[materialIndex].tag + ")";
+	}
+
+	return(description);
+}
+
+/***********************************************************
+ *  SetDepthPrePass()
+ *
+ *  This method is used for enabling a depth-only pass over
+ *  the opaque draws, so the full fragment shader only runs
+ *  once for each visible pixel.
+ ***********************************************************/
+void SceneManager::SetDepthPrePass(bool bEnable)
+{
+	m_bDepthPrePass = bEnable;
+}
+
+/***********************************************************
+ *  SetOcclusionCulling()
+ *
+ *  This method is used for enabling the CPU occlusion test
+ *  that skips draws hidden behind large boxes.
+ ***********************************************************/
+void SceneManager::SetOcclusionCulling(bool bEnable)
+{
+	m_bOcclusionCulling = bEnable;
+}
+
+/***********************************************************
+ *  SetOcclusionDumpFile()
+ *
+ *  This method is used for writing the occlusion depth buffer
+ *  of the next culled frame to an image, for debugging.
+ ***********************************************************/
+void SceneManager::SetOcclusionDumpFile(const char* filename)
+{
+	m_occlusionDumpFile = filename;
+}
+
+/***********************************************************
+ *  SetAssetPackFile()
+ *
+ *  This method is used for loading the scene from an asset
+ *  pack instead of the source images and code.  If the pack
+ *  can't be used the source assets are loaded as before.
+ ***********************************************************/
+void SceneManager::SetAssetPackFile(const char* filename)
+{
+	m_assetPackFile = filename;
+}
+
+/***********************************************************
+ *  SetColdStart()
+ *
+ *  This method is used for evicting the scene files from the
+ *  page cache right before they are loaded, so the startup
+ *  time reflects reading them from disk.
+ ***********************************************************/
+void SceneManager::SetColdStart(bool bEnable)
+{
+	m_bColdStart = bEnable;
+}
+
+/***********************************************************
+ *  SetTextureStreaming()
+ *
+ *  This method is used for showing the scene before the
+ *  textures are fully loaded.  Each texture starts out with
+ *  its smallest levels and gains detail over the following
+ *  frames.
+ ***********************************************************/
+void SceneManager::SetTextureStreaming(bool bEnable)
+{
+	if (bEnable && (m_pTextureStreamer == NULL))
+	{
+		m_pTextureStreamer = new TextureStreamer();
+	}
+	else if ((bEnable == false) && (m_pTextureStreamer != NULL))
+	{
+		delete m_pTextureStreamer;
+		m_pTextureStreamer = NULL;
+	}
+}
+
+/***********************************************************
+ *  SetTextureAtlas()
+ *
+ *  This method is used for choosing whether the small scene
+ *  textures are packed into shared atlas pages when they are
+ *  loaded.  Packing is skipped while textures are streamed.
+ ***********************************************************/
+void SceneManager::SetTextureAtlas(bool bEnable)
+{
+	m_bTextureAtlas = bEnable;
+}
+
+/***********************************************************
+ *  SetLazyMeshes()
+ *
+ *  This method is used for choosing whether the basic shapes
+ *  are built on a worker thread the first time they are
+ *  drawn, with their bounds outlined until then, or loaded
+ *  by ShapeMeshes before the first frame.
+ ***********************************************************/
+void SceneManager::SetLazyMeshes(bool bEnable)
+{
+	m_bLazyMeshes = bEnable;
+}
+
+/***********************************************************
+ *  FinishMeshLoading()
+ *
+ *  This method is used for waiting until every basic shape
+ *  drawn so far is built and uploaded, so runs that measure
+ *  frames never draw a placeholder.
+ ***********************************************************/
+void SceneManager::FinishMeshLoading()
+{
+	if (m_pMeshStreamer != NULL)
+	{
+		m_pMeshStreamer->Finish();
+	}
+}
+
+/***********************************************************
+ *  LoadModel()
+ *
+ *  This method is used for importing an OBJ or glTF model
+ *  with the worker threads and uploading it into buffers of
+ *  its own, in the vertex layout of the basic shapes.  Its
+ *  triangles are added to the spatial index so it can be
+ *  picked like any other draw.
+ ***********************************************************/
+bool SceneManager::LoadModel(const char* filename, std::string tag)
+{
+	MeshBuilder::MESH_DATA mesh;
+	ModelImporter::IMPORT_STATS stats;
+
+	if (ModelImporter::Import(filename, m_pThreadPool, mesh, stats) == false)
+	{
+		return false;
+	}
+
+	SCENE_MODEL* pModel = new SCENE_MODEL();
+	pModel->tag = tag;
+	pModel->indexCount = (int)mesh.indices.size();
+
+	std::vector<glm::vec3> positions(mesh.GetVertexCount());
+	for (int i = 0; i < (int)positions.size(); i++)
+	{
+		const float* pVertex = &mesh.vertices[i * MeshBuilder::FLOATS_PER_VERTEX];
+		positions[i] = glm::vec3(pVertex[0], pVertex[1], pVertex[2]);
+	}
+	pModel->boundsMin = positions[0];
+	pModel->boundsMax = positions[0];
+	for (int i = 1; i < (int)positions.size(); i++)
+	{
+		pModel->boundsMin = glm::min(pModel->boundsMin, positions[i]);
+		pModel->boundsMax = glm::max(pModel->boundsMax, positions[i]);
+	}
+
+	size_t vertexBytes = mesh.vertices.size() * sizeof(float);
+	size_t indexBytes = mesh.indices.size() * sizeof(uint32_t);
+	const GLsizei stride = MeshBuilder::FLOATS_PER_VERTEX * sizeof(float);
+
+	glBindVertexArray(pModel->vertexArray.Create(tag));
+
+	glBindBuffer(GL_ARRAY_BUFFER, pModel->vertexBuffer.Create(tag + " vertices"));
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, mesh.vertices.data(), GL_STATIC_DRAW);
+	pModel->vertexBuffer.SetBytes(vertexBytes);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pModel->indexBuffer.Create(tag + " indices"));
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, mesh.indices.data(), GL_STATIC_DRAW);
+	pModel->indexBuffer.SetBytes(indexBytes);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	RenderStats::Count(RenderStats::COUNTER_UPLOAD_BYTES, vertexBytes + indexBytes);
+
+	pModel->spatialMesh = m_pSpatialIndex->AddMesh(positions, mesh.indices);
+	m_sceneModels.push_back(pModel);
+
+	// the model is a new draw of the scene
+	m_bSpatialIndexDirty = true;
+	m_bGpuSceneDirty = true;
+
+	return true;
+}
+
+/***********************************************************
+ *  LoadAssetPack()
+ *
+ *  This method is used for loading the scene from the asset
+ *  pack.  Meshes and texture levels are uploaded directly
+ *  from the mapped file, and the materials and lights are
+ *  copied out of it.  Nothing is loaded unless every entry
+ *  the scene needs is present.
+ ***********************************************************/
+bool SceneManager::LoadAssetPack()
+{
+	AssetPack& pack = m_assetPack;
+
+	if (m_bColdStart && (MappedFile::DropFromPageCache(m_assetPackFile.c_str()) == false))
+	{
+		std::cout << "WARNING: could not evict " << m_assetPackFile << " from the page cache" << std::endl;
+	}
+	if (pack.Open(m_assetPackFile.c_str()) == false)
+	{
+		return false;
+	}
+
+	const AssetPack::PACK_ENTRY* pVertices = pack.FindEntry(AssetPack::ENTRY_MESH_VERTICES, g_AssetPackSceneName);
+	const AssetPack::PACK_ENTRY* pIndices = pack.FindEntry(AssetPack::ENTRY_MESH_INDICES, g_AssetPackSceneName);
+	const AssetPack::PACK_ENTRY* pRanges = pack.FindEntry(AssetPack::ENTRY_MESH_RANGES, g_AssetPackSceneName);
+	const AssetPack::PACK_ENTRY* pMaterials = pack.FindEntry(AssetPack::ENTRY_MATERIALS, g_AssetPackSceneName);
+	const AssetPack::PACK_ENTRY* pLights = pack.FindEntry(AssetPack::ENTRY_LIGHTS, g_AssetPackSceneName);
+	if ((pVertices == NULL) || (pIndices == NULL) || (pRanges == NULL) || (pMaterials == NULL) || (pLights == NULL) ||
+		(pRanges->size != RenderQueue::MESH_TYPE_COUNT * sizeof(AssetPack::MESH_RECORD)))
+	{
+		std::cout << "ERROR: asset pack " << m_assetPackFile << " is missing scene entries" << std::endl;
+		return false;
+	}
+
+	// every part has to index vertices inside the entries, since
+	// the driver reads the buffers without checking them
+	const AssetPack::MESH_RECORD* pMeshRecords = (const AssetPack::MESH_RECORD*)pack.GetEntryData(*pRanges);
+	const uint16_t* pIndexData = (const uint16_t*)pack.GetEntryData(*pIndices);
+	int64_t vertexCount = (int64_t)(pVertices->size / sizeof(MeshOptimizer::QUANTIZED_VERTEX));
+	int64_t indexCount = (int64_t)(pIndices->size / sizeof(uint16_t));
+	for (int type = 0; type < RenderQueue::MESH_TYPE_COUNT; type++)
+	{
+		const AssetPack::MESH_RECORD& record = pMeshRecords[type];
+		bool bValid = (record.partCount >= 0) && (record.partCount <= 3) &&
+			(record.baseVertex >= 0) && (record.baseVertex < vertexCount);
+		for (int p = 0; bValid && (p < record.partCount); p++)
+		{
+			int64_t firstIndex = record.parts[p][1];
+			int64_t partIndexCount = record.parts[p][2];
+			bValid = (firstIndex >= 0) && (partIndexCount >= 0) && (firstIndex + partIndexCount <= indexCount);
+			for (int64_t i = firstIndex; bValid && (i < firstIndex + partIndexCount); i++)
+			{
+				bValid = (record.baseVertex + (int64_t)pIndexData[i] < vertexCount);
+			}
+		}
+		if (bValid == false)
+		{
+			std::cout << "ERROR: asset pack " << m_assetPackFile << " has a mesh range outside its buffers" << std::endl;
+			return false;
+		}
+	}
+
+	// the levels of each texture have to fill its entry exactly
+	for (int i = 0; i < pack.GetEntryCount(); i++)
+	{
+		const AssetPack::PACK_ENTRY& entry = pack.GetEntry(i);
+		if ((entry.type == AssetPack::ENTRY_TEXTURE) &&
+			(((entry.params[2] != 3) && (entry.params[2] != 4)) ||
+			 (AssetPack::GetMipChainSize((int)entry.params[0], (int)entry.params[1], (int)entry.params[2], (int)entry.params[3]) != entry.size)))
+		{
+			std::cout << "ERROR: asset pack " << m_assetPackFile << " texture " << FixedString(entry.name, sizeof(entry.name))
+				<< " does not match its mip chain" << std::endl;
+			return false;
+		}
+	}
+
+	// ---------------- TEXTURES ----------------
+	// the textures are created first, so a failure leaves the
+	// rest of the scene untouched for the fallback
+	for (int i = 0; i < pack.GetEntryCount(); i++)
+	{
+		const AssetPack::PACK_ENTRY& entry = pack.GetEntry(i);
+		if ((entry.type == AssetPack::ENTRY_TEXTURE) && (m_loadedTextures < 16))
+		{
+			bool bCreated = CreateGLTextureFromMips(
+				(const unsigned char*)pack.GetEntryData(entry),
+				(int)entry.params[0], (int)entry.params[1], (int)entry.params[2], (int)entry.params[3],
+				FixedString(entry.name, sizeof(entry.name)));
+			if (bCreated == false)
+			{
+				std::cout << "ERROR: could not create texture " << FixedString(entry.name, sizeof(entry.name))
+					<< " from asset pack " << m_assetPackFile << std::endl;
+				DestroyGLTextures();
+				pack.Close();
+				return false;
+			}
+		}
+	}
+
+	// ---------------- MESHES ----------------
+	for (int type = 0; type < RenderQueue::MESH_TYPE_COUNT; type++)
+	{
+		const AssetPack::MESH_RECORD& record = pMeshRecords[type];
+		MeshLibrary::MESH_RANGE range;
+
+		range.baseVertex = record.baseVertex;
+		range.dequantize = glm::make_mat4(record.dequantize);
+		for (int p = 0; p < record.partCount; p++)
+		{
+			MeshBuilder::MESH_PART part;
+			part.flags = (unsigned int)record.parts[p][0];
+			part.firstIndex = record.parts[p][1];
+			part.indexCount = record.parts[p][2];
+			range.parts.push_back(part);
+		}
+		m_pMeshLibrary->SetMeshRange((RenderQueue::MESH_TYPE)type, range);
+	}
+	m_pMeshLibrary->Upload(
+		pack.GetEntryData(*pVertices), (size_t)pVertices->size,
+		pack.GetEntryData(*pIndices), (size_t)pIndices->size);
+	m_bQuantizedMeshes = true;
+
+	// ---------------- MATERIALS ----------------
+	const AssetPack::MATERIAL_RECORD* pMaterialRecords = (const AssetPack::MATERIAL_RECORD*)pack.GetEntryData(*pMaterials);
+	int materialCount = (int)(pMaterials->size / sizeof(AssetPack::MATERIAL_RECORD));
+	m_objectMaterials.clear();
+	for (int i = 0; i < materialCount; i++)
+	{
+		const AssetPack::MATERIAL_RECORD& record = pMaterialRecords[i];
+		OBJECT_MATERIAL material;
+
+		material.ambientColor = glm::make_vec3(record.ambientColor);
+		material.ambientStrength = record.ambientStrength;
+		material.diffuseColor = glm::make_vec3(record.diffuseColor);
+		material.specularColor = glm::make_vec3(record.specularColor);
+		material.shininess = record.shininess;
+		material.opacity = record.opacity;
+		material.blendMode = (RenderQueue::BLEND_MODE)record.blendMode;
+		material.tag = FixedString(record.tag, sizeof(record.tag));
+		m_objectMaterials.push_back(material);
+	}
+
+	// ---------------- LIGHTS ----------------
+	const AssetPack::LIGHT_RECORD* pLightRecords = (const AssetPack::LIGHT_RECORD*)pack.GetEntryData(*pLights);
+	int lightCount = (int)(pLights->size / sizeof(AssetPack::LIGHT_RECORD));
+	m_sceneLights.clear();
+	for (int i = 0; i < lightCount; i++)
+	{
+		const AssetPack::LIGHT_RECORD& record = pLightRecords[i];
+		SCENE_LIGHT light;
+
+		light.bPointLight = (record.type == 1);
+		light.index = record.index;
+		light.vector = glm::make_vec3(record.vector);
+		light.ambient = glm::make_vec3(record.ambient);
+		light.diffuse = glm::make_vec3(record.diffuse);
+		light.specular = glm::make_vec3(record.specular);
+		light.constant = record.constant;
+		light.linear = record.linear;
+		light.quadratic = record.quadratic;
+		light.bActive = (record.bActive != 0);
+		m_sceneLights.push_back(light);
+	}
+
+	std::cout << "Loaded scene from asset pack " << m_assetPackFile << std::endl;
+
+	// the streamed texture levels are read from the mapping
+	if (m_pTextureStreamer == NULL)
+	{
+		pack.Close();
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  BuildAssetPack()
+ *
+ *  This method is used for writing everything PrepareScene()
+ *  builds into an asset pack: the optimized basic shapes,
+ *  every texture with its full mip chain, the materials and
+ *  the lights.  No OpenGL calls are made.
+ ***********************************************************/
+bool SceneManager::BuildAssetPack(const char* filename)
+{
+	AssetPackWriter writer;
+
+	// ---------------- MESHES ----------------
+	std::vector<MeshOptimizer::QUANTIZED_VERTEX> vertices;
+	std::vector<uint16_t> indices;
+	if (m_pMeshLibrary->BuildGeometry(vertices, indices) == false)
+	{
+		return false;
+	}
+
+	std::vector<AssetPack::MESH_RECORD> meshRecords(RenderQueue::MESH_TYPE_COUNT);
+	for (int type = 0; type < RenderQueue::MESH_TYPE_COUNT; type++)
+	{
+		const MeshLibrary::MESH_RANGE& range = m_pMeshLibrary->GetMeshRange((RenderQueue::MESH_TYPE)type);
+		AssetPack::MESH_RECORD& record = meshRecords[type];
+
+		std::memset(&record, 0, sizeof(record));
+		record.baseVertex = range.baseVertex;
+		record.partCount = std::min(3, (int)range.parts.size());
+		for (int p = 0; p < record.partCount; p++)
+		{
+			record.parts[p][0] = (int32_t)range.parts[p].flags;
+			record.parts[p][1] = range.parts[p].firstIndex;
+			record.parts[p][2] = range.parts[p].indexCount;
+		}
+		std::memcpy(record.dequantize, glm::value_ptr(range.dequantize), sizeof(record.dequantize));
+	}
+
+	writer.AddEntry(AssetPack::ENTRY_MESH_VERTICES, g_AssetPackSceneName, NULL,
+		vertices.data(), vertices.size() * sizeof(MeshOptimizer::QUANTIZED_VERTEX));
+	writer.AddEntry(AssetPack::ENTRY_MESH_INDICES, g_AssetPackSceneName, NULL,
+		indices.data(), indices.size() * sizeof(uint16_t));
+	writer.AddEntry(AssetPack::ENTRY_MESH_RANGES, g_AssetPackSceneName, NULL,
+		meshRecords.data(), meshRecords.size() * sizeof(AssetPack::MESH_RECORD));
+
+	// ---------------- MATERIALS ----------------
+	if (m_objectMaterials.empty())
+	{
+		DefineObjectMaterials();
+	}
+	std::vector<AssetPack::MATERIAL_RECORD> materialRecords(m_objectMaterials.size());
+	for (int i = 0; i < (int)m_objectMaterials.size(); i++)
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[i];
+		AssetPack::MATERIAL_RECORD& record = materialRecords[i];
+
+		std::memset(&record, 0, sizeof(record));
+		std::strncpy(record.tag, material.tag.c_str(), sizeof(record.tag) - 1);
+		std::memcpy(record.ambientColor, glm::value_ptr(material.ambientColor), sizeof(record.ambientColor));
+		record.ambientStrength = material.ambientStrength;
+		std::memcpy(record.diffuseColor, glm::value_ptr(material.diffuseColor), sizeof(record.diffuseColor));
+		record.opacity = material.opacity;
+		std::memcpy(record.specularColor, glm::value_ptr(material.specularColor), sizeof(record.specularColor));
+		record.shininess = material.shininess;
+		record.blendMode = (uint32_t)material.blendMode;
+	}
+	writer.AddEntry(AssetPack::ENTRY_MATERIALS, g_AssetPackSceneName, NULL,
+		materialRecords.data(), materialRecords.size() * sizeof(AssetPack::MATERIAL_RECORD));
+
+	// ---------------- LIGHTS ----------------
+	if (m_sceneLights.empty())
+	{
+		DefineSceneLights();
+	}
+	std::vector<AssetPack::LIGHT_RECORD> lightRecords(m_sceneLights.size());
+	for (int i = 0; i < (int)m_sceneLights.size(); i++)
+	{
+		const SCENE_LIGHT& light = m_sceneLights[i];
+		AssetPack::LIGHT_RECORD& record = lightRecords[i];
+
+		std::memset(&record, 0, sizeof(record));
+		record.type = light.bPointLight ? 1 : 0;
+		record.index = light.index;
+		std::memcpy(record.vector, glm::value_ptr(light.vector), sizeof(record.vector));
+		std::memcpy(record.ambient, glm::value_ptr(light.ambient), sizeof(record.ambient));
+		std::memcpy(record.diffuse, glm::value_ptr(light.diffuse), sizeof(record.diffuse));
+		std::memcpy(record.specular, glm::value_ptr(light.specular), sizeof(record.specular));
+		record.constant = light.constant;
+		record.linear = light.linear;
+		record.quadratic = light.quadratic;
+		record.bActive = light.bActive ? 1 : 0;
+	}
+	writer.AddEntry(AssetPack::ENTRY_LIGHTS, g_AssetPackSceneName, NULL,
+		lightRecords.data(), lightRecords.size() * sizeof(AssetPack::LIGHT_RECORD));
+
+	// ---------------- TEXTURES ----------------
+	// decoded exactly as CreateGLTexture() does, then reduced
+	// to the mip levels glGenerateMipmap() would have made
+	stbi_set_flip_vertically_on_load(true);
+	for (int i = 0; i < g_SceneTextureCount; i++)
+	{
+		int width = 0;
+		int height = 0;
+		int colorChannels = 0;
+		unsigned char* image = stbi_load(g_SceneTextures[i].filename, &width, &height, &colorChannels, 0);
+		if (image == NULL)
+		{
+			std::cout << "Could not load image:" << g_SceneTextures[i].filename << std::endl;
+			return false;
+		}
+		if ((colorChannels != 3) && (colorChannels != 4))
+		{
+			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
+			stbi_image_free(image);
+			return false;
+		}
+
+		std::vector<unsigned char> mipChain;
+		uint32_t params[7] = { 0 };
+		params[0] = (uint32_t)width;
+		params[1] = (uint32_t)height;
+		params[2] = (uint32_t)colorChannels;
+		params[3] = (uint32_t)AssetPack::BuildMipChain(image, width, height, colorChannels, mipChain);
+		stbi_image_free(image);
+
+		writer.AddEntry(AssetPack::ENTRY_TEXTURE, g_SceneTextures[i].tag, params, mipChain.data(), mipChain.size());
+	}
+
+	return(writer.Write(filename));
+}
+
+/***********************************************************
+ *  SetQuantizedMeshes()
+ *
+ *  This method is used for switching the basic shapes to the
+ *  cache optimized, 16 byte per vertex copies.  The copies
+ *  are built the first time they are enabled.
+ ***********************************************************/
+void SceneManager::SetQuantizedMeshes(bool bEnable)
+{
+	if (bEnable && (m_pMeshLibrary->IsActive() == false))
+	{
+		bEnable = m_pMeshLibrary->Initialize();
+	}
+	m_bQuantizedMeshes = bEnable;
+}
+
+/***********************************************************
+ *  CreateDepthProgram()
+ *
+ *  This method is used for building the minimal program used
+ *  by the depth pre-pass.  It reads the camera matrices from
+ *  the shared camera block and writes no color.
+ ***********************************************************/
+bool SceneManager::CreateDepthProgram()
+{
+	const char* vertexSource = R"(
+		#version 330 core
+		invariant gl_Position;
+		layout (location = 0) in vec3 inVertexPosition;
+		layout (std140) uniform CameraBlock
+		{
+			mat4 view;
+			mat4 projection;
+			mat4 viewProjection;
+			mat4 inverseView;
+			mat4 inverseProjection;
+			mat4 inverseViewProjection;
+			vec4 cameraPosition;
+			vec4 frameTime;
+		};
+		uniform mat4 model;
+		void main()
+		{
+			// same expression as the scene shader, and invariant in
+			// both, so the shading pass gets exactly the same depth
+			gl_Position = projection * view * model * vec4(inVertexPosition, 1.0);
+		}
+	)";
+	const char* fragmentSource = R"(
+		#version 330 core
+		void main()
+		{
+		}
+	)";
+
+	GLint success = 0;
+	GLuint vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderSource(vertexShaderID, 1, &vertexSource, NULL);
+	glCompileShader(vertexShaderID);
+	glShaderSource(fragmentShaderID, 1, &fragmentSource, NULL);
+	glCompileShader(fragmentShaderID);
+
+	GLuint programID = m_depthProgram.Create("depth pre-pass");
+	glAttachShader(programID, vertexShaderID);
+	glAttachShader(programID, fragmentShaderID);
+	glLinkProgram(programID);
+	glDeleteShader(vertexShaderID);
+	glDeleteShader(fragmentShaderID);
+
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR: depth pre-pass program link failed\n" << infoLog << std::endl;
+		m_depthProgram.Reset();
+		return false;
+	}
+	m_depthProgram.SetBytes(GpuResourceRegistry::EstimateProgramBytes(programID));
+
+	glUniformBlockBinding(programID,
+		glGetUniformBlockIndex(programID, "CameraBlock"),
+		CameraUniformBuffer::CAMERA_BLOCK_BINDING);
+	m_depthModelLocation = glGetUniformLocation(programID, "model");
+
+	return true;
+}
+
+/***********************************************************
+ *  DrawMeshGeometry()
+ *
+ *  This method is used for issuing the draw call of the
+ *  passed in basic shape.
+ ***********************************************************/
+void SceneManager::DrawMeshGeometry(
+	RenderQueue::MESH_TYPE meshType,
+	unsigned int meshParts)
+{
+	if (m_bQuantizedMeshes)
+	{
+		m_pMeshLibrary->Draw(meshType, meshParts);
+		return;
+	}
+
+	if (m_pMeshStreamer != NULL)
+	{
+		if (m_meshHandles[meshType] < 0)
+		{
+			m_meshHandles[meshType] = m_pMeshStreamer->Request(
+				MeshLibrary::GetMeshName(meshType),
+				[meshType](MeshBuilder::MESH_DATA& mesh)
+				{
+					MeshBuilder::Build(meshType, mesh);
+					return(true);
+				},
+				g_MeshBoundsMin[meshType],
+				g_MeshBoundsMax[meshType]);
+		}
+		m_pMeshStreamer->Draw(m_meshHandles[meshType], meshParts);
+		return;
+	}
+
+	bool bTop = (meshParts & RenderQueue::MESH_PART_TOP) != 0;
+	bool bBottom = (meshParts & RenderQueue::MESH_PART_BOTTOM) != 0;
+	bool bSides = (meshParts & RenderQueue::MESH_PART_SIDES) != 0;
+
+	switch (meshType)
+	{
+	case RenderQueue::MESH_PLANE:
+		m_basicMeshes->DrawPlaneMesh();
+		break;
+	case RenderQueue::MESH_BOX:
+		m_basicMeshes->DrawBoxMesh();
+		break;
+	case RenderQueue::MESH_CYLINDER:
+		m_basicMeshes->DrawCylinderMesh(bTop, bBottom, bSides);
+		break;
+	case RenderQueue::MESH_TAPERED_CYLINDER:
+		m_basicMeshes->DrawTaperedCylinderMesh(bTop, bBottom, bSides);
+		break;
+	case RenderQueue::MESH_CONE:
+		m_basicMeshes->DrawConeMesh(bBottom);
+		break;
+	case RenderQueue::MESH_TORUS:
+		m_basicMeshes->DrawTorusMesh();
+		break;
+	case RenderQueue::MESH_PRISM:
+		m_basicMeshes->DrawPrismMesh();
+		break;
+	default:
+		break;
+	}
+
+	const glm::ivec2& counts = GetMeshDrawCounts(meshType, meshParts);
+	RenderStats::Count(RenderStats::COUNTER_DRAW_CALLS, counts.x);
+	RenderStats::Count(RenderStats::COUNTER_TRIANGLES, counts.y);
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+}
+
+/***********************************************************
+ *  DrawModelGeometry()
+ *
+ *  This method is used for issuing the draw call of a loaded
+ *  model.
+ ***********************************************************/
+void SceneManager::DrawModelGeometry(int model)
+{
+	const SCENE_MODEL& sceneModel = *m_sceneModels[model];
+
+	glBindVertexArray(sceneModel.vertexArray.Get());
+	glDrawElements(GL_TRIANGLES, sceneModel.indexCount, GL_UNSIGNED_INT, (void*)0);
+	glBindVertexArray(0);
+
+	RenderStats::CountDraw(sceneModel.indexCount / 3);
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+}
+
+/***********************************************************
+ *  DrawItemGeometry()
+ *
+ *  This method is used for issuing the draw call of a
+ *  recorded draw, of its loaded model or its basic shape.
+ ***********************************************************/
+void SceneManager::DrawItemGeometry(const RenderQueue::RENDER_ITEM& item)
+{
+	if (item.model >= 0)
+	{
+		DrawModelGeometry(item.model);
+		return;
+	}
+
+	DrawMeshGeometry(item.meshType, item.meshParts);
+}
+
+/***********************************************************
+ *  GetDrawBounds()
+ *
+ *  This method is used for getting the bounds of the loaded
+ *  model or the basic shape of a recorded draw, before its
+ *  transformation.
+ ***********************************************************/
+void SceneManager::GetDrawBounds(
+	const RenderQueue::RENDER_ITEM& item,
+	glm::vec3& boundsMin,
+	glm::vec3& boundsMax) const
+{
+	if (item.model >= 0)
+	{
+		boundsMin = m_sceneModels[item.model]->boundsMin;
+		boundsMax = m_sceneModels[item.model]->boundsMax;
+		return;
+	}
+
+	boundsMin = g_MeshBoundsMin[item.meshType];
+	boundsMax = g_MeshBoundsMax[item.meshType];
+}
+
+/***********************************************************
+ *  GetDrawModelMatrix()
+ *
+ *  This method is used for getting the model matrix sent to
+ *  the shaders for a draw.  Quantized shapes store their
+ *  positions scaled into the snorm range, and the matrix
+ *  undoing that is folded in here.
+ ***********************************************************/
+glm::mat4 SceneManager::GetDrawModelMatrix(const RenderQueue::RENDER_ITEM& item) const
+{
+	if (m_bQuantizedMeshes && (item.model < 0))
+	{
+		return(item.drawData.model * m_pMeshLibrary->GetDequantizeMatrix(item.meshType));
+	}
+
+	return(item.drawData.model);
+}
+
+/***********************************************************
+ *  DrawRenderItem()
+ *
+ *  This method is used for passing the recorded values of a
+ *  draw into the shader and drawing its mesh.
+ ***********************************************************/
+void SceneManager::DrawRenderItem(RenderQueue::RENDER_ITEM& item)
+{
+	const DrawDataRingBuffer::DRAW_DATA& drawData = item.drawData;
+
+	if (m_pShaderPermutations != NULL)
+	{
+		UseDrawVariant(item);
+	}
+
+	// the ring buffer takes the whole record in one write, made
+	// by the first view drawing the item and reused by the rest
+	if (m_pDrawDataBuffer->IsActive())
+	{
+		if (item.drawIndex < 0)
+		{
+			DrawDataRingBuffer::DRAW_DATA* pDrawSlot = m_pDrawDataBuffer->Allocate(item.drawIndex);
+			if (pDrawSlot != NULL)
+			{
+				*pDrawSlot = drawData;
+				pDrawSlot->model = GetDrawModelMatrix(item);
+				pDrawSlot->normalMatrix = glm::transpose(glm::inverse(drawData.model));
+				RenderStats::Count(RenderStats::COUNTER_UPLOAD_BYTES, sizeof(DrawDataRingBuffer::DRAW_DATA));
+			}
+			else
+			{
+				item.drawIndex = -1;
+			}
+		}
+		if (item.drawIndex >= 0)
+		{
+			m_pShaderManager->setIntValue(g_DrawIndexName, item.drawIndex);
+			RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS);
+			DrawItemGeometry(item);
+			return;
+		}
+	}
+
+	// a shader written for the ring buffer reads the uniforms
+	// while its draw index is negative
+	if (m_pDrawDataBuffer->IsBlockDeclared())
+	{
+		m_pShaderManager->setIntValue(g_DrawIndexName, -1);
+		RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS);
+	}
+	m_pShaderManager->setMat4Value(g_ModelName, GetDrawModelMatrix(item));
+	m_pShaderManager->setVec2Value("UVscale", glm::vec2(drawData.uvScale.x, drawData.uvScale.y));
+
+	if (drawData.params.z != 0)
+	{
+		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		m_pShaderManager->setSampler2DValue(g_TextureValueName, drawData.params.y);
+		if (m_pTextureAtlas != NULL)
+		{
+			m_pShaderManager->setIntValue(g_AtlasEntryName, drawData.params.w);
+			RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS);
+		}
+	}
+	else
+	{
+		m_pShaderManager->setIntValue(g_UseTextureName, false);
+		m_pShaderManager->setVec4Value(g_ColorValueName, drawData.objectColor);
+	}
+	RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS, 4);
+
+	int materialIndex = drawData.params.x;
+	if ((materialIndex >= 0) && (materialIndex < (int)m_objectMaterials.size()))
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[materialIndex];
+
+		m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
+		m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
+		m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
+		m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
+		m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+		m_pShaderManager->setFloatValue("material.opacity", material.opacity);
+		RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS, 6);
+	}
+
+	DrawItemGeometry(item);
+}
+
+/***********************************************************
+ *  BeginSceneFrame()
+ *
+ *  This method is used for the work of a frame that doesn't
+ *  depend on the camera: the moving objects are placed, the
+ *  scene is walked and every draw is recorded with its
+ *  transform, once however many views the frame has.
+ ***********************************************************/
+void SceneManager::BeginSceneFrame()
+{
+	// the transient render data of the previous frame is done
+	// with, so the arena can hand out its memory again
+	m_pRenderQueue->Clear();
+	m_pFrameArena->BeginFrame();
+
+	if (m_pMeshStreamer != NULL)
+	{
+		m_pMeshStreamer->Update();
+	}
+
+	// the static draws are on the GPU, only the transparent and
+	// moving ones are submitted
+	if (m_pGpuCuller != NULL)
+	{
+		if (m_bGpuSceneDirty)
+		{
+			BuildGpuScene();
+		}
+		for (int i = 0; i < (int)m_gpuCpuItems.size(); i++)
+		{
+			const RenderQueue::RENDER_ITEM& item = m_gpuCpuItems[i];
+			m_pRenderQueue->Submit((item.blendMode == RenderQueue::BLEND_OPAQUE) ?
+				RenderQueue::PASS_OPAQUE : RenderQueue::PASS_TRANSPARENT, item);
+		}
+		if (m_generatedObjects.empty() == false)
+		{
+			SubmitGeneratedObjects(true);
+		}
+	}
+	else
+	{
+		SubmitScene();
+	}
+
+	// claim the ring buffer region for this frame's draw data,
+	// which every view writes into, sized for every draw
+	// recorded so nothing is moved once the views start
+	int drawCount = 0;
+	for (int pass = 0; pass < RenderQueue::PASS_COUNT; pass++)
+	{
+		drawCount += m_pRenderQueue->GetSubmittedCount((RenderQueue::RENDER_PASS)pass);
+	}
+	if (m_pDrawDataBuffer->BeginFrame(drawCount) == false)
+	{
+		std::cout << "WARNING: draw data ring buffer could not grow to " << drawCount
+			<< " draws, using per-draw uniforms" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  RenderSceneView()
+ *
+ *  This method is used for drawing the draws recorded for the
+ *  frame as seen by the current camera.  They are culled and
+ *  sorted for it, then opaque draws go first without
+ *  blending, nearest first, optionally after a depth-only
+ *  pre-pass.  Transparent draws follow with blending on,
+ *  farthest first, testing but not writing depth.
+ ***********************************************************/
+void SceneManager::RenderSceneView()
+{
+	m_generalProgramID = m_pShaderManager->m_programID;
+
+	if (m_bOcclusionCulling)
+	{
+		CullOccludedItems();
+	}
+
+	m_pRenderQueue->Sort(m_viewMatrix);
+
+	if (m_pTextureStreamer != NULL)
+	{
+		StreamVisibleTextures();
+	}
+
+	int opaqueCount = m_pRenderQueue->GetItemCount(RenderQueue::PASS_OPAQUE);
+	int transparentCount = m_pRenderQueue->GetItemCount(RenderQueue::PASS_TRANSPARENT);
+
+	glDisable(GL_BLEND);
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+
+	// ---------------- GPU CULLED PASS ----------------
+	// unsorted, but the rest of the frame depth tests against it
+	if (m_pGpuCuller != NULL)
+	{
+		DrawGpuScene();
+	}
+
+	// ---------------- DEPTH PRE-PASS ----------------
+	bool bDepthPrePass = m_bDepthPrePass;
+	if (bDepthPrePass && (m_depthProgram.Get() == 0) && (CreateDepthProgram() == false))
+	{
+		// keep running without the pre-pass if it can't be built
+		m_bDepthPrePass = false;
+		bDepthPrePass = false;
+	}
+	if (bDepthPrePass)
+	{
+		glUseProgram(m_depthProgram.Get());
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		for (int i = 0; i < opaqueCount; i++)
+		{
+			const RenderQueue::RENDER_ITEM& item = m_pRenderQueue->GetSortedItem(RenderQueue::PASS_OPAQUE, i);
+			glUniformMatrix4fv(m_depthModelLocation, 1, GL_FALSE, glm::value_ptr(GetDrawModelMatrix(item)));
+			DrawItemGeometry(item);
+		}
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		m_pShaderManager->use();
+
+		// the depth buffer is complete, so only the nearest
+		// fragment of each pixel passes the equal test
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(GL_FALSE);
+
+		RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS, opaqueCount);
+		RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES, 6);
+	}
+
+	// ---------------- OPAQUE PASS ----------------
+	for (int i = 0; i < opaqueCount; i++)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		DrawRenderItem(m_pRenderQueue->GetSortedItem(RenderQueue::PASS_OPAQUE, i));
+	}
+
+	if (bDepthPrePass)
+	{
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+		RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES, 2);
+	}
+
+	// ---------------- TRANSPARENT PASS ----------------
+	if (transparentCount > 0)
+	{
+		RenderQueue::BLEND_MODE currentBlendMode = RenderQueue::BLEND_OPAQUE;
+
+		glEnable(GL_BLEND);
+		glDepthMask(GL_FALSE);
+		for (int i = 0; i < transparentCount; i++)
 		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
+			RenderQueue::RENDER_ITEM& item = m_pRenderQueue->GetSortedItem(RenderQueue::PASS_TRANSPARENT, i);
+			if (item.blendMode != currentBlendMode)
+			{
+				if (item.blendMode == RenderQueue::BLEND_ADDITIVE)
+				{
+					glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+				}
+				else
+				{
+					glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				}
+				currentBlendMode = item.blendMode;
+				RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+			}
+			DrawRenderItem(item);
 		}
-		else
-			index++;
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+		RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES, 4);
 	}
 
-	return(textureID);
+	// the view and other managers keep setting their values
+	// into the general program
+	if (m_pShaderManager->m_programID != m_generalProgramID)
+	{
+		m_pShaderManager->m_programID = m_generalProgramID;
+		m_pShaderManager->use();
+		RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+	}
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  EndSceneFrame()
  *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for finishing the frame once every
+ *  view is drawn.  The textures are streamed for the largest
+ *  size any view showed them at, and the draw data written
+ *  by all views is fenced together.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+void SceneManager::EndSceneFrame()
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	if (m_pTextureStreamer != NULL)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
+		m_pTextureStreamer->Update(g_TextureStreamBudget);
 	}
 
-	return(textureSlot);
+	// fence the draw data written during this frame
+	m_pDrawDataBuffer->EndFrame();
+	m_pRenderQueue->Clear();
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  GetDrawVariant()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for finding the program variant a
+ *  recorded draw needs.  Lighting is on for the whole scene,
+ *  and the point light count is that of the active lights.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+uint32_t SceneManager::GetDrawVariant(const RenderQueue::RENDER_ITEM& item) const
 {
-	if (m_objectMaterials.size() == 0)
-	{
-		return(false);
-	}
+	int pointLightCount = 0;
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	for (int i = 0; i < (int)m_sceneLights.size(); i++)
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-		}
-		else
+		if (m_sceneLights[i].bPointLight && m_sceneLights[i].bActive)
 		{
-			index++;
+			pointLightCount++;
 		}
 	}
 
-	return(true);
+	return(ShaderPermutations::MakeVariantKey(item.drawData.params.z != 0, true, pointLightCount));
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  UseDrawVariant()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for switching to the program variant
+ *  of a recorded draw.  The general program stands in while a
+ *  variant is still compiling.  Variants don't get the camera
+ *  uniforms the view manager sets, so those are set here.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+void SceneManager::UseDrawVariant(const RenderQueue::RENDER_ITEM& item)
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
+	bool bFirstUse = false;
+	GLuint programID = 0;
 
-	modelView = translation * rotationX * rotationY * rotationZ * scale;
+	if (m_pShaderPermutations->IsSpecializable())
+	{
+		programID = m_pShaderPermutations->GetProgram(GetDrawVariant(item), bFirstUse);
+	}
+	if (programID == 0)
+	{
+		programID = m_generalProgramID;
+	}
+	if (programID == m_pShaderManager->m_programID)
+	{
+		return;
+	}
 
-	if (NULL != m_pShaderManager)
+	m_pShaderManager->m_programID = programID;
+	m_pShaderManager->use();
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+	if (bFirstUse)
+	{
+		PrepareShaderProgram();
+	}
+	if (programID != m_generalProgramID)
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		m_pShaderManager->setMat4Value("view", m_viewMatrix);
+		m_pShaderManager->setMat4Value("projection", m_projectionMatrix);
+		m_pShaderManager->setVec3Value("viewPosition", m_viewPosition);
+		RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS, 3);
 	}
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  CullOccludedItems()
  *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
+ *  This method is used for hiding the recorded draws that
+ *  can't be seen.  The largest opaque boxes of the frame are
+ *  rasterized into the CPU depth buffer, and every draw is
+ *  then tested with the bounds of its shape.  Only boxes are
+ *  used as occluders because they are the only shapes that
+ *  fill their bounds completely.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
+void SceneManager::CullOccludedItems()
 {
-	// variables for this method
-	glm::vec4 currentColor;
-
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+	m_pOcclusionCuller->BeginFrame(m_projectionMatrix * m_viewMatrix);
 
-	if (NULL != m_pShaderManager)
+	// pick the occluders, largest first when there are too many
+	FrameVector<std::pair<float, int> > occluders((FrameAllocator<std::pair<float, int> >(m_pFrameArena)));
+	int opaqueCount = m_pRenderQueue->GetSubmittedCount(RenderQueue::PASS_OPAQUE);
+	for (int i = 0; i < opaqueCount; i++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+		const RenderQueue::RENDER_ITEM& item = m_pRenderQueue->GetSubmittedItem(RenderQueue::PASS_OPAQUE, i);
+		if ((item.model < 0) && (item.meshType == RenderQueue::MESH_BOX) && (item.meshParts == RenderQueue::MESH_PART_ALL))
+		{
+			const glm::mat4& model = item.drawData.model;
+			float volume = glm::length(glm::vec3(model[0])) *
+				glm::length(glm::vec3(model[1])) * glm::length(glm::vec3(model[2]));
+			occluders.push_back(std::make_pair(volume, i));
+		}
 	}
-}
+	if ((int)occluders.size() > g_MaxOccluders)
+	{
+		std::partial_sort(occluders.begin(), occluders.begin() + g_MaxOccluders, occluders.end(),
+			[](const std::pair<float, int>& a, const std::pair<float, int>& b) { return(a.first > b.first); });
+		occluders.resize(g_MaxOccluders);
+	}
+	for (int i = 0; i < (int)occluders.size(); i++)
+	{
+		OcclusionCuller::OCCLUSION_BOX occluder;
+		occluder.model = m_pRenderQueue->GetSubmittedItem(RenderQueue::PASS_OPAQUE, occluders[i].second).drawData.model;
+		occluder.boundsMin = g_MeshBoundsMin[RenderQueue::MESH_BOX];
+		occluder.boundsMax = g_MeshBoundsMax[RenderQueue::MESH_BOX];
+		m_pOcclusionCuller->AddOccluder(occluder);
+	}
+	m_pOcclusionCuller->RasterizeOccluders();
 
-/***********************************************************
- *  SetShaderTexture()
- *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
- ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
-{
-	if (NULL != m_pShaderManager)
+	// test the bounds of every draw in both passes
+	for (int pass = 0; pass < RenderQueue::PASS_COUNT; pass++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		RenderQueue::RENDER_PASS renderPass = (RenderQueue::RENDER_PASS)pass;
+		int itemCount = m_pRenderQueue->GetSubmittedCount(renderPass);
+		if (itemCount == 0)
+		{
+			continue;
+		}
+
+		OcclusionCuller::OCCLUSION_BOX* pBoxes =
+			m_pFrameArena->AllocateArray<OcclusionCuller::OCCLUSION_BOX>(itemCount);
+		uint8_t* pVisible = m_pFrameArena->AllocateArray<uint8_t>(itemCount);
+		for (int i = 0; i < itemCount; i++)
+		{
+			const RenderQueue::RENDER_ITEM& item = m_pRenderQueue->GetSubmittedItem(renderPass, i);
+			pBoxes[i].model = item.drawData.model;
+			GetDrawBounds(item, pBoxes[i].boundsMin, pBoxes[i].boundsMax);
+		}
+
+		m_pOcclusionCuller->TestVisibility(pBoxes, itemCount, pVisible);
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		for (int i = 0; i < itemCount; i++)
+		{
+			m_pRenderQueue->GetSubmittedItem(renderPass, i).bVisible = (pVisible[i] != 0);
+		}
 	}
-}
 
-/***********************************************************
- *  SetTextureUVScale()
- *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
- ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
-{
-	if (NULL != m_pShaderManager)
+	if (m_occlusionDumpFile.empty() == false)
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		m_pOcclusionCuller->DumpDepthBuffer(m_occlusionDumpFile.c_str());
+		m_occlusionDumpFile.clear();
 	}
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  StreamVisibleTextures()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for ranking the streamed textures by
+ *  the current view.  The visible textured draws report how
+ *  many pixels tall their bounding sphere appears, times the
+ *  UV scale, so textures that are close up or tiled sharpen
+ *  first.  The streamer keeps the largest size of any view,
+ *  and EndSceneFrame() uploads the next levels.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+void SceneManager::StreamVisibleTextures()
 {
-	if (m_objectMaterials.size() > 0)
-	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
+	float pixelScale = m_projectionMatrix[1][1] * (float)viewport[3] * 0.5f;
+	// orthographic projections don't shrink with distance
+	bool bPerspective = (m_projectionMatrix[2][3] != 0.0f);
+
+	for (int pass = 0; pass < RenderQueue::PASS_COUNT; pass++)
+	{
+		RenderQueue::RENDER_PASS renderPass = (RenderQueue::RENDER_PASS)pass;
+		int itemCount = m_pRenderQueue->GetItemCount(renderPass);
+		for (int i = 0; i < itemCount; i++)
 		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			const RenderQueue::RENDER_ITEM& item = m_pRenderQueue->GetSortedItem(renderPass, i);
+			int slot = item.drawData.params.y;
+			if ((item.drawData.params.z == 0) || (slot < 0) || (slot >= m_loadedTextures))
+			{
+				continue;
+			}
+
+			const glm::mat4& model = item.drawData.model;
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			GetDrawBounds(item, boundsMin, boundsMax);
+			glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f * glm::vec3(
+				glm::length(glm::vec3(model[0])),
+				glm::length(glm::vec3(model[1])),
+				glm::length(glm::vec3(model[2])));
+			float radius = glm::length(halfExtent);
+
+			float pixels = radius * pixelScale;
+			if (bPerspective)
+			{
+				glm::vec4 center = m_viewMatrix * model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f);
+				float depth = -center.z;
+				// the camera inside the bounds sees it full screen
+				pixels = (depth > radius) ? (pixels / depth) : (float)viewport[3];
+			}
+			pixels *= std::max(item.drawData.uvScale.x, item.drawData.uvScale.y);
+
+			m_pTextureStreamer->SetScreenSize(m_textureIDs[slot].texture.Get(), pixels);
 		}
 	}
 }
@@ -386,6 +3238,8 @@ void SceneManager::DefineObjectMaterials() {
 	bookMaterial.diffuseColor = glm::vec3(0.6f, 0.3f, 0.1f);
 	bookMaterial.specularColor = glm::vec3(0.3f, 0.3f, 0.3f);
 	bookMaterial.shininess = 10.0f;
+	bookMaterial.opacity = 1.0f;
+	bookMaterial.blendMode = RenderQueue::BLEND_OPAQUE;
 	bookMaterial.tag = "book";
 	m_objectMaterials.push_back(bookMaterial);
 
@@ -397,6 +3251,8 @@ void SceneManager::DefineObjectMaterials() {
 	deskMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);         // allow texture to dominate
 	deskMaterial.specularColor = glm::vec3(0.9f, 0.9f, 0.9f);        // strong reflections
 	deskMaterial.shininess = 64.0f;                                 // sharper highlight
+	deskMaterial.opacity = 1.0f;
+	deskMaterial.blendMode = RenderQueue::BLEND_OPAQUE;
 	deskMaterial.tag = "desk";
 	m_objectMaterials.push_back(deskMaterial);
 
@@ -407,6 +3263,8 @@ void SceneManager::DefineObjectMaterials() {
 	cupMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.2f);
 	cupMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f); // reflective glass look
 	cupMaterial.shininess = 95.0f;
+	cupMaterial.opacity = 1.0f;
+	cupMaterial.blendMode = RenderQueue::BLEND_OPAQUE;
 	cupMaterial.tag = "cup";
 	m_objectMaterials.push_back(cupMaterial);
 
@@ -417,6 +3275,8 @@ void SceneManager::DefineObjectMaterials() {
 	notebookMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.7f); // bluish notebook
 	notebookMaterial.specularColor = glm::vec3(0.3f, 0.3f, 0.4f);
 	notebookMaterial.shininess = 18.0f;
+	notebookMaterial.opacity = 1.0f;
+	notebookMaterial.blendMode = RenderQueue::BLEND_OPAQUE;
 	notebookMaterial.tag = "notebook";
 	m_objectMaterials.push_back(notebookMaterial);
 
@@ -425,6 +3285,8 @@ void SceneManager::DefineObjectMaterials() {
 	metalMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.2f);
 	metalMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.7f);
 	metalMaterial.shininess = 42.0;
+	metalMaterial.opacity = 1.0f;
+	metalMaterial.blendMode = RenderQueue::BLEND_OPAQUE;
 	metalMaterial.tag = "metal";
 
 	m_objectMaterials.push_back(metalMaterial);
@@ -437,6 +3299,8 @@ void SceneManager::DefineObjectMaterials() {
 	mechPencilMaterial.diffuseColor = glm::vec3(0.1f, 0.1f, 0.8f);      // blue pencil body
 	mechPencilMaterial.specularColor = glm::vec3(0.4f, 0.4f, 0.4f);     // slight shine
 	mechPencilMaterial.shininess = 32.0f;                               // smooth highlight
+	mechPencilMaterial.opacity = 1.0f;
+	mechPencilMaterial.blendMode = RenderQueue::BLEND_OPAQUE;
 	mechPencilMaterial.tag = "mechpencil";
 	m_objectMaterials.push_back(mechPencilMaterial);
 
@@ -448,6 +3312,8 @@ void SceneManager::DefineObjectMaterials() {
 	eraserMaterial.diffuseColor = glm::vec3(1.0f, 0.6f, 0.6f);          // pink rubber
 	eraserMaterial.specularColor = glm::vec3(0.1f, 0.1f, 0.1f);         // almost no shine
 	eraserMaterial.shininess = 5.0f;                                    // very matte
+	eraserMaterial.opacity = 1.0f;
+	eraserMaterial.blendMode = RenderQueue::BLEND_OPAQUE;
 	eraserMaterial.tag = "eraser";
 	m_objectMaterials.push_back(eraserMaterial);
 
@@ -456,62 +3322,141 @@ void SceneManager::DefineObjectMaterials() {
 
 
  /***********************************************************
-  *  SetupSceneLights()
+  *  DefineSceneLights()
   *
-  *  This method is called to add and configure the light
-  *  sources for the 3D scene.
+  *  This method is called to define the light sources for
+  *  the 3D scene.  The lights are kept as data so they can be
+  *  stored in the asset pack.
   ***********************************************************/
-void SceneManager::SetupSceneLights()
+void SceneManager::DefineSceneLights()
 {
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
-
 	// ============================================================
 	// 1. DIRECTIONAL LIGHT  Slightly colored, soft, room-filling
 	// ============================================================
 	// Gives a gentle cool tint and fills shadows uniformly.
-	m_pShaderManager->setVec3Value("directionalLight.direction", -0.2f, -1.0f, -0.3f);
-	m_pShaderManager->setVec3Value("directionalLight.ambient", 0.25f, 0.22f, 0.30f);    // colored ambient
-	m_pShaderManager->setVec3Value("directionalLight.diffuse", 0.55f, 0.50f, 0.70f);    // soft bluish tint
-	m_pShaderManager->setVec3Value("directionalLight.specular", 0.25f, 0.25f, 0.35f);
-	m_pShaderManager->setBoolValue("directionalLight.bActive", true);
+	SCENE_LIGHT directionalLight;
+	directionalLight.bPointLight = false;
+	directionalLight.index = 0;
+	directionalLight.vector = glm::vec3(-0.2f, -1.0f, -0.3f);
+	directionalLight.ambient = glm::vec3(0.25f, 0.22f, 0.30f);    // colored ambient
+	directionalLight.diffuse = glm::vec3(0.55f, 0.50f, 0.70f);    // soft bluish tint
+	directionalLight.specular = glm::vec3(0.25f, 0.25f, 0.35f);
+	directionalLight.constant = 1.0f;
+	directionalLight.linear = 0.0f;
+	directionalLight.quadratic = 0.0f;
+	directionalLight.bActive = true;
+	m_sceneLights.push_back(directionalLight);
 
 	// ============================================================
 	// 2. POINT LIGHT  bright white overhead fill (primary light)
 	// ============================================================
 	// Illuminates everything from above and slightly forward.
-	m_pShaderManager->setVec3Value("pointLights[0].position", 0.0f, 7.0f, 3.0f);
+	SCENE_LIGHT overheadLight;
+	overheadLight.bPointLight = true;
+	overheadLight.index = 0;
+	overheadLight.vector = glm::vec3(0.0f, 7.0f, 3.0f);
 
-	m_pShaderManager->setVec3Value("pointLights[0].ambient", 0.20f, 0.20f, 0.20f);
-	m_pShaderManager->setVec3Value("pointLights[0].diffuse", 0.95f, 0.95f, 0.90f);
-	m_pShaderManager->setVec3Value("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
+	overheadLight.ambient = glm::vec3(0.20f, 0.20f, 0.20f);
+	overheadLight.diffuse = glm::vec3(0.95f, 0.95f, 0.90f);
+	overheadLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
 
-	m_pShaderManager->setFloatValue("pointLights[0].constant", 1.0f);
-	m_pShaderManager->setFloatValue("pointLights[0].linear", 0.045f);      // larger reach
-	m_pShaderManager->setFloatValue("pointLights[0].quadratic", 0.015f);   // smoother falloff
+	overheadLight.constant = 1.0f;
+	overheadLight.linear = 0.045f;      // larger reach
+	overheadLight.quadratic = 0.015f;   // smoother falloff
 
-	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
+	overheadLight.bActive = true;
+	m_sceneLights.push_back(overheadLight);
 
 	// ============================================================
 	// 3. Secondary Fill Light  soft warm point light (optional but helpful)
 	// ============================================================
 	// Eliminates dark sides when moving the camera around objects.
-	m_pShaderManager->setVec3Value("pointLights[1].position", -6.0f, 3.5f, 2.5f);
+	SCENE_LIGHT fillLight;
+	fillLight.bPointLight = true;
+	fillLight.index = 1;
+	fillLight.vector = glm::vec3(-6.0f, 3.5f, 2.5f);
 
-	m_pShaderManager->setVec3Value("pointLights[1].ambient", 0.10f, 0.07f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[1].diffuse", 0.55f, 0.40f, 0.25f); // warm tint
-	m_pShaderManager->setVec3Value("pointLights[1].specular", 0.25f, 0.20f, 0.15f);
+	fillLight.ambient = glm::vec3(0.10f, 0.07f, 0.05f);
+	fillLight.diffuse = glm::vec3(0.55f, 0.40f, 0.25f); // warm tint
+	fillLight.specular = glm::vec3(0.25f, 0.20f, 0.15f);
 
-	m_pShaderManager->setFloatValue("pointLights[1].constant", 1.0f);
-	m_pShaderManager->setFloatValue("pointLights[1].linear", 0.09f);
-	m_pShaderManager->setFloatValue("pointLights[1].quadratic", 0.032f);
+	fillLight.constant = 1.0f;
+	fillLight.linear = 0.09f;
+	fillLight.quadratic = 0.032f;
 
-	m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
+	fillLight.bActive = true;
+	m_sceneLights.push_back(fillLight);
 
 	// ============================================================
 	// Disable unused lights if your shader expects four
 	// ============================================================
-	m_pShaderManager->setBoolValue("pointLights[2].bActive", false);
-	m_pShaderManager->setBoolValue("pointLights[3].bActive", false);
+	for (int i = 2; i < 4; i++)
+	{
+		SCENE_LIGHT unusedLight;
+		unusedLight.bPointLight = true;
+		unusedLight.index = i;
+		unusedLight.vector = glm::vec3(0.0f);
+		unusedLight.ambient = glm::vec3(0.0f);
+		unusedLight.diffuse = glm::vec3(0.0f);
+		unusedLight.specular = glm::vec3(0.0f);
+		unusedLight.constant = 1.0f;
+		unusedLight.linear = 0.0f;
+		unusedLight.quadratic = 0.0f;
+		unusedLight.bActive = false;
+		m_sceneLights.push_back(unusedLight);
+	}
+}
+
+ /***********************************************************
+  *  SetupSceneLights()
+  *
+  *  This method is called to add and configure the light
+  *  sources for the 3D scene.
+  ***********************************************************/
+void SceneManager::SetupSceneLights()
+{
+	// the lights come from the asset pack when one was loaded
+	if (m_sceneLights.empty())
+	{
+		DefineSceneLights();
+	}
+
+	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+
+	for (int i = 0; i < (int)m_sceneLights.size(); i++)
+	{
+		const SCENE_LIGHT& light = m_sceneLights[i];
+		std::string name = "directionalLight";
+		if (light.bPointLight)
+		{
+			name = "pointLights[" + std::to_string(light.index) + "]";
+		}
+
+		m_pShaderManager->setBoolValue(name + ".bActive", light.bActive);
+		if (light.bActive == false)
+		{
+			continue;
+		}
+
+		if (light.bPointLight)
+		{
+			m_pShaderManager->setVec3Value(name + ".position", light.vector);
+		}
+		else
+		{
+			m_pShaderManager->setVec3Value(name + ".direction", light.vector);
+		}
+		m_pShaderManager->setVec3Value(name + ".ambient", light.ambient);
+		m_pShaderManager->setVec3Value(name + ".diffuse", light.diffuse);
+		m_pShaderManager->setVec3Value(name + ".specular", light.specular);
+
+		if (light.bPointLight)
+		{
+			m_pShaderManager->setFloatValue(name + ".constant", light.constant);
+			m_pShaderManager->setFloatValue(name + ".linear", light.linear);
+			m_pShaderManager->setFloatValue(name + ".quadratic", light.quadratic);
+		}
+	}
 }
 
 
@@ -526,37 +3471,39 @@ void SceneManager::SetupSceneLights()
  ***********************************************************/
 void SceneManager::LoadSceneTextures() {
 
-	bool bReturn = false;
-
-	//jpg image for the desk
-	bReturn = CreateGLTexture("Photos/textures/black_top_vinyl.jpg","desk");
-
-	//jpg image for the cup
-	bReturn = CreateGLTexture("Photos/textures/cup.jpg", "cup");
-	//jpg image for the cup rim
-	bReturn = CreateGLTexture("Photos/textures/rim.jpg", "cup_rim");
-	//jpg image for the french book
-	bReturn = CreateGLTexture("Photos/textures/french.jpg", "french");
-	//jpg image for the notebook
-	bReturn = CreateGLTexture("Photos/textures/paper.jpg", "paper");
-
-	//jpg image for the notebook rings
-	bReturn = CreateGLTexture("Photos/textures/stainless.jpg", "metal");
-
-	//jpg imagw for the mech pencil body.
-	bReturn = CreateGLTexture("Photos/textures/mech_body.jpg", "body");
-
-	//jpeg image for the mech pencil pointy tip.
-	CreateGLTexture("Photos/textures/point.jpg", "point");
+	// packing needs a scene program that reads through the
+	// atlas, and streamed textures each get their own levels
+	if (m_bTextureAtlas && (m_pTextureStreamer == NULL) &&
+		(glGetUniformLocation(m_pShaderManager->m_programID, g_AtlasRectsName) >= 0))
+	{
+		m_pTextureAtlas = new TextureAtlas();
+	}
 
-	//jpeg image for the mech pencil eraser.
-	CreateGLTexture("Photos/textures/white_eraser.jpg", "eraser");
+	for (int i = 0; i < g_SceneTextureCount; i++)
+	{
+		if (m_bColdStart && (MappedFile::DropFromPageCache(g_SceneTextures[i].filename) == false))
+		{
+			std::cout << "WARNING: could not evict " << g_SceneTextures[i].filename << " from the page cache" << std::endl;
+		}
 
-	//jpeg image for the mech pencil clip.
-	CreateGLTexture("Photos/textures/clip.jpg", "clip");
+		// only the header is read to decide
+		int width = 0;
+		int height = 0;
+		int colorChannels = 0;
+		if ((m_pTextureAtlas != NULL) &&
+			stbi_info(g_SceneTextures[i].filename, &width, &height, &colorChannels) &&
+			TextureAtlas::IsPackable(width, height) &&
+			AddAtlasTexture(g_SceneTextures[i].filename, g_SceneTextures[i].tag))
+		{
+			continue;
+		}
+		CreateGLTexture(g_SceneTextures[i].filename, g_SceneTextures[i].tag);
+	}
 
-	//jpeg image for the pink eraser.
-	CreateGLTexture("Photos/textures/eraser.jpg", "pink_eraser");
+	if (m_pTextureAtlas != NULL)
+	{
+		BuildTextureAtlas();
+	}
 
 	BindGLTextures();
 
@@ -572,17 +3519,71 @@ void SceneManager::LoadSceneTextures() {
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	// the asset pack replaces every step below that builds
+	// scene data from source files or code
+	m_bUsingAssetPack = false;
+	if (m_assetPackFile.empty() == false)
+	{
+		m_bUsingAssetPack = LoadAssetPack();
+		if (m_bUsingAssetPack == false)
+		{
+			std::cout << "Falling back to the source assets" << std::endl;
+		}
+	}
+
 	// only one instance of a particular mesh needs to be
 	// loaded in memory no matter how many times it is drawn
 	// in the rendered 3D scene
 
 	// define the materials that will be used for the objects
 	// in the 3D scene
-	DefineObjectMaterials();
+	if (m_bUsingAssetPack == false)
+	{
+		DefineObjectMaterials();
+	}
+
+	// per-draw data goes through the persistently mapped ring
+	// buffer when the driver and the shader both support it
+	if (m_pDrawDataBuffer->Initialize(m_pShaderManager->m_programID, g_MaxDrawsPerFrame))
+	{
+		UploadMaterialTable();
+	}
 	// add and defile the light sources for the 3D scene
 	SetupSceneLights();
 
-	LoadSceneTextures();
+	if (m_bUsingAssetPack)
+	{
+		BindGLTextures();
+	}
+	else
+	{
+		LoadSceneTextures();
+	}
+
+	// draws from the ring buffer select their texture by slot,
+	// so every slot gets a fixed entry in the sampler array
+	if (m_pDrawDataBuffer->IsActive())
+	{
+		for (int i = 0; i < m_loadedTextures; i++)
+		{
+			m_pShaderManager->setSampler2DValue("objectTextures[" + std::to_string(i) + "]", i);
+		}
+	}
+	SetAtlasRects();
+	CollectTextureChoices();
+
+	// the pack holds the shapes already built and optimized
+	if (m_bUsingAssetPack)
+	{
+		return;
+	}
+
+	// the shapes are built as the first frames draw them
+	if (m_bLazyMeshes)
+	{
+		m_pMeshStreamer = new MeshStreamer();
+		return;
+	}
 
 	m_basicMeshes->LoadPlaneMesh();
 	m_basicMeshes->LoadCylinderMesh();
@@ -592,6 +3593,7 @@ void SceneManager::PrepareScene()
 	m_basicMeshes->LoadTaperedCylinderMesh(); // Tapered cylinder for pencil tip
 	m_basicMeshes->LoadConeMesh();
 	//m_basicMeshes->DrawSphereMesh();
+	TrackShapeMeshMemory();
 	
 }
 
@@ -602,6 +3604,20 @@ void SceneManager::PrepareScene()
  *  transforming and drawing the basic 3D shapes
  ***********************************************************/
 void SceneManager::RenderScene()
+{
+	// record the desk and its objects, or the generated scene
+	// replacing it, then draw them for the single camera
+	BeginSceneFrame();
+	RenderSceneView();
+	EndSceneFrame();
+}
+
+// --------------------------------------------------------------
+// DrawDesk()
+// Builds the desk surface the other objects stand on:
+//   - Plane    : desk top
+// --------------------------------------------------------------
+void SceneManager::DrawDesk()
 {
 	// declare the variables for the transformations
 	glm::vec3 scaleXYZ;
@@ -652,25 +3668,7 @@ void SceneManager::RenderScene()
 	SetShaderMaterial("desk");
 
 	// Draw the plane that acts as the desk
-	m_basicMeshes->DrawPlaneMesh();
-	/****************************************************************/
-	
-	//creates the coffee cup
-	DrawCup();
-
-	//creates the french book.
-	DrawFrenchBook();
-
-	//creates the notebook.
-	DrawNoteBook();
-
-	//creates the mechanical pencil.
-	DrawMechPencil();
-
-	//creates the eraser.
-	DrawEraser();
-
-	
+	SubmitMesh(RenderQueue::MESH_PLANE);
 }
 
 // --------------------------------------------------------------
@@ -710,7 +3708,7 @@ void SceneManager::DrawCup()
 	SetShaderTexture("cup");
 	SetShaderMaterial("cup");
 
-	m_basicMeshes->DrawCylinderMesh(false,true,true);
+	SubmitMesh(RenderQueue::MESH_CYLINDER, RenderQueue::MESH_PART_BOTTOM | RenderQueue::MESH_PART_SIDES);
 
 
 	// ----------------------------------------------------------
@@ -734,7 +3732,7 @@ void SceneManager::DrawCup()
 	SetShaderTexture("cup");
 	SetShaderMaterial("cup");
 
-	m_basicMeshes->DrawTorusMesh();
+	SubmitMesh(RenderQueue::MESH_TORUS);
 
 
 	// ----------------------------------------------------------
@@ -766,7 +3764,7 @@ void SceneManager::DrawCup()
 	SetShaderTexture("cup_rim");
 	SetShaderMaterial("cup");
 
-	m_basicMeshes->DrawTorusMesh();
+	SubmitMesh(RenderQueue::MESH_TORUS);
 }
 
 // --------------------------------------------------------------
@@ -813,7 +3811,7 @@ void SceneManager::DrawFrenchBook() {
 
 	
 	// Draw the box
-	m_basicMeshes->DrawBoxMesh();
+	SubmitMesh(RenderQueue::MESH_BOX);
 	//*************************************************************************************************/
 
 }
@@ -840,7 +3838,7 @@ void SceneManager::DrawNoteBook() {
 	SetShaderTexture("paper");
 	SetShaderMaterial("notebook");
 
-	m_basicMeshes->DrawBoxMesh();
+	SubmitMesh(RenderQueue::MESH_BOX);
 
 
 	//*************************************************************************/
@@ -857,7 +3855,7 @@ void SceneManager::DrawNoteBook() {
 	SetShaderTexture("notebook");
 	SetShaderMaterial("notebook");
 
-	m_basicMeshes->DrawBoxMesh();
+	SubmitMesh(RenderQueue::MESH_BOX);
 
 //*************************************************************************/
 // Notebook (Torus) Rings
@@ -889,7 +3887,7 @@ void SceneManager::DrawNoteBook() {
 		SetShaderTexture("metal");
 		SetShaderMaterial("metal");
 
-		m_basicMeshes->DrawTorusMesh();
+		SubmitMesh(RenderQueue::MESH_TORUS);
 	}
 
 }
@@ -925,7 +3923,7 @@ void SceneManager::DrawMechPencil()
 	SetShaderTexture("body");
 	SetShaderMaterial("mechpencil");
 
-	m_basicMeshes->DrawCylinderMesh();       // Draw the pencil body using a cylinder mesh
+	SubmitMesh(RenderQueue::MESH_CYLINDER);       // Draw the pencil body using a cylinder mesh
 
 	//*************************************************************************/
 	// Pointy Tip (Tapered Cylinder with Cone)
@@ -945,7 +3943,7 @@ void SceneManager::DrawMechPencil()
 	SetShaderTexture("point");
 	SetShaderMaterial("mechpencil");
 
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	SubmitMesh(RenderQueue::MESH_TAPERED_CYLINDER);
 
 
 	//*****************************************************************************
@@ -965,7 +3963,7 @@ void SceneManager::DrawMechPencil()
 	SetShaderTexture("body");
 	SetShaderMaterial("mechpencil");
 
-	m_basicMeshes->DrawConeMesh();
+	SubmitMesh(RenderQueue::MESH_CONE);
 
 	//*************************************************************************/
 	// Eraser Tip (Cylinder)
@@ -984,7 +3982,7 @@ void SceneManager::DrawMechPencil()
 	SetShaderTexture("eraser");
 	SetShaderMaterial("eraser");
 
-	m_basicMeshes->DrawCylinderMesh();
+	SubmitMesh(RenderQueue::MESH_CYLINDER);
 
 
 
@@ -1006,7 +4004,7 @@ void SceneManager::DrawMechPencil()
 	SetShaderTexture("clip");
 	SetShaderMaterial("mechpencil");
 
-	m_basicMeshes->DrawBoxMesh();
+	SubmitMesh(RenderQueue::MESH_BOX);
 }
 
 
@@ -1037,7 +4035,7 @@ void SceneManager::DrawEraser() {
 	SetShaderTexture("pink_eraser");
 	SetShaderMaterial("eraser");
 
-	m_basicMeshes->DrawBoxMesh();
+	SubmitMesh(RenderQueue::MESH_BOX);
 
 	// ---------------------------------------------
 	// LEFT CHAMFER
@@ -1052,7 +4050,7 @@ void SceneManager::DrawEraser() {
 	SetShaderTexture("pink_eraser");
 	SetShaderMaterial("eraser");
 
-	m_basicMeshes->DrawPrismMesh();
+	SubmitMesh(RenderQueue::MESH_PRISM);
 
 	// ---------------------------------------------
 	// RIGHT CHAMFER
@@ -1068,7 +4066,42 @@ void SceneManager::DrawEraser() {
 	SetShaderTexture("pink_eraser");
 	SetShaderMaterial("eraser");
 
-	m_basicMeshes->DrawPrismMesh();
+	SubmitMesh(RenderQueue::MESH_PRISM);
+}
+
+/***********************************************************
+ *  DrawImportedModels()
+ *
+ *  This method is used for placing the models loaded with
+ *  LoadModel() in a row along the back of the desk.  Each is
+ *  scaled so its largest side is four units and stands on
+ *  the desk top, whatever units the file was written in.
+ ***********************************************************/
+void SceneManager::DrawImportedModels()
+{
+	const float modelSize = 4.0f;
+	const float modelSpacing = 5.0f;
+
+	for (int i = 0; i < (int)m_sceneModels.size(); i++)
+	{
+		const SCENE_MODEL& model = *m_sceneModels[i];
+		glm::vec3 extent = model.boundsMax - model.boundsMin;
+		float largestSide = std::max(extent.x, std::max(extent.y, extent.z));
+		float scale = (largestSide > 0.0f) ? (modelSize / largestSide) : 1.0f;
+
+		// the middle of the bottom of the bounds is the point
+		// set down on the desk
+		glm::vec3 base((model.boundsMin.x + model.boundsMax.x) * 0.5f, model.boundsMin.y,
+			(model.boundsMin.z + model.boundsMax.z) * 0.5f);
+		glm::vec3 positionXYZ(-11.0f + modelSpacing * i, 0.0f, -5.0f);
+
+		SetTransformations(glm::vec3(scale), 0.0f, 0.0f, 0.0f, positionXYZ);
+		m_drawState.model = m_drawState.model * glm::translate(-base);
+		SetShaderColor(0.75f, 0.75f, 0.78f, 1.0f);
+		SetShaderMaterial("cup");
+
+		SubmitDraw(RenderQueue::MESH_BOX, RenderQueue::MESH_PART_ALL, i);
+	}
 }
 
 
@@ -11,6 +11,25 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "GpuResources.h"
+#include "DrawDataRingBuffer.h"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+#include "FrameArena.h"
+#include "OcclusionCuller.h"
+#include "MeshLibrary.h"
+#include "MeshStreamer.h"
+#include "AssetPack.h"
+#include "TextureStreamer.h"
+#include "TextureAtlas.h"
+#include "ShaderPermutations.h"
+#include "GpuCuller.h"
+#include "SpatialIndex.h"
+#include "PathTracer.h"
+#include "SceneGenerator.h"
+#include "AnimationSystem.h"
+#include "ModelImporter.h"
+#include "BenchmarkSuite.h"
 
 #include <string>
 #include <vector>
@@ -32,7 +51,7 @@ public:
 	struct TEXTURE_INFO
 	{
 		std::string tag;
-		uint32_t ID;
+		GLTexture texture;
 	};
 
 	struct OBJECT_MATERIAL
@@ -42,9 +61,45 @@ public:
 		glm::vec3 diffuseColor;
 		glm::vec3 specularColor;
 		float shininess;
+		// 1.0 is fully opaque, anything lower is blended
+		float opacity;
+		// how the object is combined with the frame behind it
+		RenderQueue::BLEND_MODE blendMode;
 		std::string tag;
 	};
 
+	struct SCENE_LIGHT
+	{
+		// point light, or else the directional light
+		bool bPointLight;
+		// slot in the shader's point light array
+		int index;
+		// direction of the directional light, position of a point
+		glm::vec3 vector;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		// point light attenuation
+		float constant;
+		float linear;
+		float quadratic;
+		bool bActive;
+	};
+
+	// model read from a file, drawn from buffers of its own
+	struct SCENE_MODEL
+	{
+		std::string tag;
+		GLVertexArray vertexArray;
+		GLBuffer vertexBuffer;
+		GLBuffer indexBuffer;
+		int indexCount;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		// triangles of the model in the spatial index
+		int spatialMesh;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
@@ -54,20 +109,143 @@ private:
 	int m_loadedTextures;
 	// loaded textures info
 	TEXTURE_INFO m_textureIDs[16];
+	// memory of the shapes ShapeMeshes uploads, which it owns
+	GpuMemoryRecord m_shapeMeshMemory[RenderQueue::MESH_TYPE_COUNT];
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// defined scene lights
+	std::vector<SCENE_LIGHT> m_sceneLights;
+	// persistently mapped buffer receiving the per-draw data
+	DrawDataRingBuffer* m_pDrawDataBuffer;
+	// shader values for the draw being set up
+	DrawDataRingBuffer::DRAW_DATA m_drawState;
+	// draws recorded during the current frame
+	RenderQueue* m_pRenderQueue;
+	// camera values the draws are sorted against
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	glm::vec3 m_viewPosition;
+	// depth-only pass over the opaque draws
+	bool m_bDepthPrePass;
+	GLProgram m_depthProgram;
+	GLint m_depthModelLocation;
+	// worker threads shared by the CPU side frame work
+	ThreadPool* m_pThreadPool;
+	// storage of the render data that is rebuilt every frame
+	FrameArena* m_pFrameArena;
+	// CPU depth buffer used to skip hidden draws
+	OcclusionCuller* m_pOcclusionCuller;
+	bool m_bOcclusionCulling;
+	// file the occlusion depth buffer is written to once
+	std::string m_occlusionDumpFile;
+	// optimized and quantized copies of the basic shapes
+	MeshLibrary* m_pMeshLibrary;
+	bool m_bQuantizedMeshes;
+	// builds the basic shapes on first use, NULL when they are
+	// loaded by ShapeMeshes up front
+	MeshStreamer* m_pMeshStreamer;
+	bool m_bLazyMeshes;
+	// streamer handle of each basic shape, -1 until it is drawn
+	int m_meshHandles[RenderQueue::MESH_TYPE_COUNT];
+	// prebuilt scene data loaded instead of the source assets
+	std::string m_assetPackFile;
+	bool m_bUsingAssetPack;
+	// evict the scene files from the page cache before loading
+	bool m_bColdStart;
+	// uploads texture levels over several frames, NULL when the
+	// textures are loaded whole
+	TextureStreamer* m_pTextureStreamer;
+	// small textures packed into shared pages, NULL when every
+	// texture has a slot of its own
+	TextureAtlas* m_pTextureAtlas;
+	bool m_bTextureAtlas;
+	// slot and atlas entry of every loaded texture, which the
+	// texture variants of generated objects choose from
+	std::vector<glm::ivec2> m_textureChoices;
+	// kept mapped while its texture levels are being streamed
+	AssetPack m_assetPack;
+	// programs specialized for the features of each draw, NULL
+	// when every draw uses the general program
+	ShaderPermutations* m_pShaderPermutations;
+	// the shader manager's own program, while variants are drawn
+	GLuint m_generalProgramID;
+	// placed copies of the compositions, empty to draw the
+	// single desk
+	std::vector<SceneGenerator::GENERATED_OBJECT> m_generatedObjects;
+	// draws of each composition and the point it turns about
+	std::vector<RenderQueue::RENDER_ITEM> m_compositionItems[SceneGenerator::COMPOSITION_COUNT];
+	glm::vec3 m_compositionCenters[SceneGenerator::COMPOSITION_COUNT];
+	// composition SubmitMesh() records into, -1 to draw
+	int m_recordingComposition;
+	// seconds driving the moving generated objects
+	float m_sceneTime;
+	// samples the keyframed motion of the moving generated
+	// objects, and the instance of each object, -1 if still
+	AnimationSystem* m_pAnimationSystem;
+	std::vector<int> m_generatedAnimations;
+	// culls and draws the static opaque draws on the GPU, NULL
+	// when every draw goes through the render queue
+	GpuCuller* m_pGpuCuller;
+	// scene program reading its draw index from the commands
+	ShaderProgramCache* m_pGpuProgramCache;
+	GLProgram m_gpuProgram;
+	bool m_bGpuProgramPrepared;
+	// the static draws must be uploaded again
+	bool m_bGpuSceneDirty;
+	// static draws the GPU can't draw, submitted every frame
+	std::vector<RenderQueue::RENDER_ITEM> m_gpuCpuItems;
+	// hierarchy over the draws of the scene for picking and
+	// spatial lookups, built on the first query
+	SpatialIndex* m_pSpatialIndex;
+	std::vector<RenderQueue::RENDER_ITEM> m_spatialItems;
+	bool m_bSpatialIndexDirty;
+	// animation changes the moving objects were indexed at
+	uint64_t m_spatialIndexAnimationChanges;
+	// mesh of each shape and part selection, -1 until needed
+	int m_spatialMeshes[RenderQueue::MESH_TYPE_COUNT][RenderQueue::MESH_PART_ALL + 1];
+	// draw calls and triangles of each shape and part selection
+	// drawn through ShapeMeshes, for the render stats, x is -1
+	// until needed
+	glm::ivec2 m_meshDrawCounts[RenderQueue::MESH_TYPE_COUNT][RenderQueue::MESH_PART_ALL + 1];
+	// models loaded from files, placed along the desk
+	std::vector<SCENE_MODEL*> m_sceneModels;
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
+	// create a texture from an already built mip chain
+	bool CreateGLTextureFromMips(
+		const unsigned char* pMipChain,
+		int width,
+		int height,
+		int channels,
+		int mipCount,
+		std::string tag);
+	// decode a small image file into the texture atlas
+	bool AddAtlasTexture(const char* filename, std::string tag);
+	// pack the atlas images and give every page a slot
+	void BuildTextureAtlas();
+	// set the rectangles of the atlas entries into the program
+	// in use
+	void SetAtlasRects();
+	// list the textures the texture variants choose from
+	void CollectTextureChoices();
 	// bind loaded OpenGL textures to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
+	// record the memory of the shapes loaded into ShapeMeshes
+	void TrackShapeMeshMemory();
 	// find a loaded texture by tag
 	int FindTextureID(std::string tag);
 	int FindTextureSlot(std::string tag);
 	// find a defined material by tag
 	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	int FindMaterialIndex(std::string tag);
+	// upload the defined materials to the material table
+	void UploadMaterialTable();
+	// load the meshes, textures, materials and lights of the
+	// asset pack
+	bool LoadAssetPack();
 
 	// set the transformation values 
 	// into the transform buffer
@@ -97,8 +275,159 @@ private:
 	void SetShaderMaterial(
 		std::string materialTag);
 
+	// record a draw of a basic shape with the current values
+	void SubmitMesh(
+		RenderQueue::MESH_TYPE meshType,
+		unsigned int meshParts = RenderQueue::MESH_PART_ALL);
+	// record a draw of a basic shape or, if model isn't -1, of
+	// a loaded model with the current values
+	void SubmitDraw(
+		RenderQueue::MESH_TYPE meshType,
+		unsigned int meshParts,
+		int model);
+
+	// set the shader values of a recorded draw and draw it
+	void DrawRenderItem(RenderQueue::RENDER_ITEM& item);
+	// issue the draw call of a basic shape
+	void DrawMeshGeometry(
+		RenderQueue::MESH_TYPE meshType,
+		unsigned int meshParts);
+	// issue the draw call of a loaded model
+	void DrawModelGeometry(int model);
+	// issue the draw call of a recorded draw, its model or its
+	// basic shape
+	void DrawItemGeometry(const RenderQueue::RENDER_ITEM& item);
+	// local bounds of the model or shape of a recorded draw
+	void GetDrawBounds(const RenderQueue::RENDER_ITEM& item, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+	// model matrix the shaders receive for a recorded draw
+	glm::mat4 GetDrawModelMatrix(const RenderQueue::RENDER_ITEM& item) const;
+	// build the program used by the depth pre-pass
+	bool CreateDepthProgram();
+	// hide the recorded draws that are behind the occluders
+	void CullOccludedItems();
+	// rank the streamed textures by their size on screen in
+	// the current view, the levels are uploaded once per frame
+	void StreamVisibleTextures();
+	// variant key of the features a recorded draw uses
+	uint32_t GetDrawVariant(const RenderQueue::RENDER_ITEM& item) const;
+	// switch to the program variant of a recorded draw
+	void UseDrawVariant(const RenderQueue::RENDER_ITEM& item);
+	// set the values that are not set per frame or per draw
+	// into the program in use
+	void PrepareShaderProgram();
+	// record the draws of every composition of the scene
+	void RecordCompositions();
+	// submit every object of the generated scene
+	void SubmitGeneratedScene();
+	// submit either the still or the moving generated objects
+	void SubmitGeneratedObjects(bool bAnimated);
+	// play the keyframed motion on the moving generated objects
+	void CreateGeneratedAnimations();
+	// build the scene program used for the GPU culled draws
+	bool CreateGpuProgram();
+	// upload the static draws of the scene to the GPU culler
+	void BuildGpuScene();
+	// cull and draw the static draws on the GPU
+	void DrawGpuScene();
+	// submit every draw of the scene without flushing them
+	void SubmitScene();
+	// build the spatial index if the scene has changed since
+	void UpdateSpatialIndex();
+	// index of the triangles of a shape in the spatial index
+	int GetSpatialMesh(RenderQueue::MESH_TYPE meshType, unsigned int meshParts);
+	// average color of a loaded texture, from its last level
+	glm::vec3 GetTextureAverageColor(int textureSlot);
+	// average color of an image packed into the texture atlas,
+	// the entry being params.w of a draw
+	glm::vec3 GetAtlasEntryColor(int atlasEntry) const;
+	// draw calls and triangles of drawing a shape's parts
+	const glm::ivec2& GetMeshDrawCounts(RenderQueue::MESH_TYPE meshType, unsigned int meshParts);
+
 public:
 
+	// set the camera values of the current frame
+	void SetViewParameters(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& viewPosition);
+	// apply the startup shader values to a reloaded program,
+	// which must already be the shader manager's program
+	void RestoreShaderState();
+	// draw with program variants built from the sources of the
+	// cache, NULL to always use the general program
+	void SetShaderPermutations(ShaderProgramCache* pProgramCache);
+	// cull and draw the static opaque draws on the GPU with a
+	// program built from the sources of the cache, NULL to
+	// draw everything through the render queue
+	void SetGpuCulling(ShaderProgramCache* pProgramCache);
+	// replace the single desk with a generated grid of desks,
+	// must be called after PrepareScene()
+	void GenerateScene(const SceneGenerator::GENERATOR_SETTINGS& settings);
+	// set the time the moving generated objects are placed at,
+	// sampling their animation
+	void SetSceneTime(float seconds);
+	// draw hit first along a ray with a normalized direction,
+	// -1 if none.  Draws are numbered in submission order.
+	int PickObject(const glm::vec3& origin, const glm::vec3& direction, float& distance);
+	// draw with the bounds closest to a point, -1 if none is
+	// within the distance
+	int FindNearestObject(const glm::vec3& point, float maxDistance);
+	// every draw with bounds touching a sphere
+	void FindObjectsInRadius(const glm::vec3& center, float radius, std::vector<int>& objects);
+	// shape and material of a draw found by the queries
+	std::string DescribeObject(int objectIndex) const;
+	// path trace the scene from the current camera into an
+	// image file on the CPU
+	bool RenderReferenceImage(const char* filename, const PathTracer::TRACE_SETTINGS& settings);
+	// record the draws of the frame once for every view
+	void BeginSceneFrame();
+	// cull, sort and draw the recorded draws for the camera
+	// set by SetViewParameters(), once per view
+	void RenderSceneView();
+	// finish the frame after its last view
+	void EndSceneFrame();
+	// register the CPU side benchmarks of the scene, must be
+	// called after PrepareScene()
+	void AddBenchmarks(BenchmarkSuite& suite);
+	// time the animation of as many moving objects as its
+	// budget is set for and add the result to the suite
+	void TimeAnimation(BenchmarkSuite& suite);
+	// enable the depth-only pre-pass for heavy fragment shaders
+	void SetDepthPrePass(bool bEnable);
+	// enable the CPU occlusion culling of hidden draws
+	void SetOcclusionCulling(bool bEnable);
+	// write the occlusion depth buffer of the next frame to a
+	// PGM image
+	void SetOcclusionDumpFile(const char* filename);
+	// draw the optimized, quantized copies of the basic shapes
+	void SetQuantizedMeshes(bool bEnable);
+	// load the scene from an asset pack, must be set before
+	// PrepareScene() is called
+	void SetAssetPackFile(const char* filename);
+	// evict the scene files from the page cache before they are
+	// loaded, to measure a cold start
+	void SetColdStart(bool bEnable);
+	bool IsColdStart() const { return(m_bColdStart); }
+	// load the texture levels progressively over the first
+	// frames, must be set before PrepareScene() is called
+	void SetTextureStreaming(bool bEnable);
+	// pack the small textures into shared atlas pages, must be
+	// set before PrepareScene() is called
+	void SetTextureAtlas(bool bEnable);
+	// build the basic shapes in the background the first time
+	// they are drawn, must be set before PrepareScene() is called
+	void SetLazyMeshes(bool bEnable);
+	bool IsUsingLazyMeshes() const { return(m_pMeshStreamer != NULL); }
+	// block until every shape drawn so far is uploaded
+	void FinishMeshLoading();
+	// true if PrepareScene() loaded the scene from the pack
+	bool IsUsingAssetPack() const { return(m_bUsingAssetPack); }
+	// write the scene data into an asset pack
+	bool BuildAssetPack(const char* filename);
+	// import an OBJ or glTF model to be drawn on the desk,
+	// must be called after PrepareScene()
+	bool LoadModel(const char* filename, std::string tag);
+
 	// The following methods are for the students to 
 	// customize for their own 3D scene
 	void PrepareScene();
@@ -106,13 +435,16 @@ public:
 	void LoadSceneTextures();
 
 	void DefineObjectMaterials();
+	void DefineSceneLights();
 	void SetupSceneLights();
 
 	void RenderScene();
+	void DrawDesk();
 	void DrawCup();
 	void DrawFrenchBook();
 	void DrawNoteBook();
 	void DrawMechPencil();
 	void DrawEraser();
+	void DrawImportedModels();
 
 };
\ No newline at end of file
@@ -0,0 +1,252 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderpermutations.cpp
+// ============
+// specialized variants of the scene program for each set of features
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPermutations.h"
+
+#include <algorithm>
+#include <iostream>
+#include <regex>
+#include <sstream>
+
+// declaration of global variables
+namespace
+{
+	// uniforms replaced by constants, and the feature setting them
+	struct FOLDED_UNIFORM
+	{
+		const char* name;
+		uint32_t flag;
+	};
+	const FOLDED_UNIFORM g_FoldedUniforms[] =
+	{
+		{ "bUseTexture", ShaderPermutations::VARIANT_TEXTURED },
+		{ "bUseLighting", ShaderPermutations::VARIANT_LIT }
+	};
+	const int g_FoldedUniformCount = sizeof(g_FoldedUniforms) / sizeof(g_FoldedUniforms[0]);
+
+	/***********************************************************
+	 *  UniformPattern()
+	 *
+	 *  Pattern matching the declaration of a bool or int
+	 *  uniform.
+	 ***********************************************************/
+	std::regex UniformPattern(const char* name)
+	{
+		return(std::regex(std::string("uniform\\s+(bool|int)\\s+") + name + "\\s*;"));
+	}
+}
+
+/***********************************************************
+ *  ShaderPermutations()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderPermutations::ShaderPermutations(ShaderProgramCache* pProgramCache)
+{
+	m_pProgramCache = pProgramCache;
+	m_bSpecializable = false;
+
+	CheckSources();
+}
+
+/***********************************************************
+ *  ~ShaderPermutations()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderPermutations::~ShaderPermutations()
+{
+	DeletePrograms();
+}
+
+/***********************************************************
+ *  MakeVariantKey()
+ *
+ *  This method is used to pack the features of a draw into a
+ *  key.  Point lights beyond the largest count a variant can
+ *  be built for are left out of the count.
+ ***********************************************************/
+uint32_t ShaderPermutations::MakeVariantKey(bool bTextured, bool bLit, int pointLightCount)
+{
+	uint32_t variantKey = 0;
+
+	if (bTextured)
+	{
+		variantKey |= VARIANT_TEXTURED;
+	}
+	if (bLit)
+	{
+		variantKey |= VARIANT_LIT;
+		variantKey |= (uint32_t)std::min(std::max(pointLightCount, 0), (int)MAX_VARIANT_POINT_LIGHTS) <<
+			VARIANT_POINT_LIGHT_SHIFT;
+	}
+
+	return(variantKey);
+}
+
+/***********************************************************
+ *  CheckSources()
+ *
+ *  This method is used to find out whether the sources use
+ *  any of the feature macros or uniforms.
+ ***********************************************************/
+void ShaderPermutations::CheckSources()
+{
+	const std::string& vertexSource = m_pProgramCache->GetVertexSource();
+	const std::string& fragmentSource = m_pProgramCache->GetFragmentSource();
+	const char* macros[] = { "USE_TEXTURE", "USE_LIGHTING", "NUM_POINT_LIGHTS" };
+
+	m_bSpecializable = false;
+	for (int i = 0; (i < 3) && (m_bSpecializable == false); i++)
+	{
+		m_bSpecializable = (vertexSource.find(macros[i]) != std::string::npos) ||
+			(fragmentSource.find(macros[i]) != std::string::npos);
+	}
+	for (int i = 0; (i < g_FoldedUniformCount) && (m_bSpecializable == false); i++)
+	{
+		std::regex pattern = UniformPattern(g_FoldedUniforms[i].name);
+		m_bSpecializable = std::regex_search(vertexSource, pattern) ||
+			std::regex_search(fragmentSource, pattern);
+	}
+
+	if (m_bSpecializable == false)
+	{
+		std::cout << "INFO: scene shaders have no feature switches, drawing without permutations" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  SpecializeSource()
+ *
+ *  This method is used to fix the features of a variant in
+ *  one stage.  The defines go right after the #version line,
+ *  followed by a #line directive so compile errors still
+ *  point at the lines of the file.
+ ***********************************************************/
+std::string ShaderPermutations::SpecializeSource(const std::string& source, uint32_t variantKey) const
+{
+	std::string specialized = source;
+
+	for (int i = 0; i < g_FoldedUniformCount; i++)
+	{
+		bool bEnabled = (variantKey & g_FoldedUniforms[i].flag) != 0;
+		std::smatch match;
+		if (std::regex_search(specialized, match, UniformPattern(g_FoldedUniforms[i].name)))
+		{
+			std::string value = (match[1] == "bool") ? (bEnabled ? "true" : "false") : (bEnabled ? "1" : "0");
+			specialized = match.prefix().str() + "const " + match[1].str() + " " + g_FoldedUniforms[i].name +
+				" = " + value + ";" + match.suffix().str();
+		}
+	}
+
+	std::ostringstream defines;
+	defines << "#define SHADER_PERMUTATION 1\n"
+		<< "#define USE_TEXTURE " << (((variantKey & VARIANT_TEXTURED) != 0) ? 1 : 0) << "\n"
+		<< "#define USE_LIGHTING " << (((variantKey & VARIANT_LIT) != 0) ? 1 : 0) << "\n"
+		<< "#define NUM_POINT_LIGHTS " << (variantKey >> VARIANT_POINT_LIGHT_SHIFT) << "\n";
+
+	size_t insertAt = 0;
+	int nextLine = 1;
+	size_t versionStart = specialized.find("#version");
+	if (versionStart != std::string::npos)
+	{
+		insertAt = specialized.find('\n', versionStart);
+		insertAt = (insertAt == std::string::npos) ? specialized.size() : insertAt + 1;
+		nextLine = (int)std::count(specialized.begin(), specialized.begin() + insertAt, '\n') + 1;
+	}
+	defines << "#line " << nextLine << "\n";
+
+	specialized.insert(insertAt, defines.str());
+
+	return(specialized);
+}
+
+/***********************************************************
+ *  GetProgram()
+ *
+ *  This method is used to look up the program of a variant.
+ *  The first request starts the build, and later requests
+ *  check on it without waiting.
+ ***********************************************************/
+GLuint ShaderPermutations::GetProgram(uint32_t variantKey, bool& bFirstUse)
+{
+	bFirstUse = false;
+
+	std::map<uint32_t, VARIANT>::iterator found = m_variants.find(variantKey);
+	if (found == m_variants.end())
+	{
+		VARIANT variant;
+		variant.build = m_pProgramCache->BeginBuild(
+			SpecializeSource(m_pProgramCache->GetVertexSource(), variantKey),
+			SpecializeSource(m_pProgramCache->GetFragmentSource(), variantKey));
+		variant.programID = 0;
+		variant.bPending = true;
+		variant.bFailed = false;
+		variant.bUsed = false;
+		found = m_variants.insert(std::make_pair(variantKey, variant)).first;
+	}
+
+	VARIANT& variant = found->second;
+	if (variant.bPending)
+	{
+		if (m_pProgramCache->IsBuildComplete(variant.build) == false)
+		{
+			return(0);
+		}
+
+		variant.bPending = false;
+		variant.programID = m_pProgramCache->FinishBuild(variant.build);
+		if (variant.programID == 0)
+		{
+			std::cout << "ERROR: shader variant " << variantKey << " failed, using the general program" << std::endl;
+			variant.bFailed = true;
+		}
+	}
+
+	if (variant.bFailed)
+	{
+		return(0);
+	}
+
+	if (variant.bUsed == false)
+	{
+		variant.bUsed = true;
+		bFirstUse = true;
+	}
+
+	return(variant.programID);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used to delete every variant so new
+ *  requests build them from the current sources.
+ ***********************************************************/
+void ShaderPermutations::Clear()
+{
+	DeletePrograms();
+	CheckSources();
+}
+
+/***********************************************************
+ *  DeletePrograms()
+ *
+ *  This method is used to delete the program of every
+ *  variant, including the ones still compiling.
+ ***********************************************************/
+void ShaderPermutations::DeletePrograms()
+{
+	std::map<uint32_t, VARIANT>::iterator it;
+	for (it = m_variants.begin(); it != m_variants.end(); ++it)
+	{
+		if (it->second.bPending || (it->second.programID != 0))
+		{
+			glDeleteProgram(it->second.bPending ? it->second.build.programID : it->second.programID);
+		}
+	}
+	m_variants.clear();
+}
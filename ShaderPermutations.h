@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderpermutations.h
+// ============
+// specialized variants of the scene program for each set of features
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderProgramCache.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/***********************************************************
+ *  ShaderPermutations
+ *
+ *  This class builds variants of the scene program with the
+ *  features a draw uses fixed at compile time.  Each variant
+ *  gets USE_TEXTURE, USE_LIGHTING and NUM_POINT_LIGHTS defined
+ *  after the #version line, and the bUseTexture and
+ *  bUseLighting uniforms are turned into constants, so the
+ *  compiler removes the branches on them.  Variants are built
+ *  the first time a draw asks for one, through the program
+ *  cache, and until a variant has compiled the caller keeps
+ *  drawing with the general program.
+ ***********************************************************/
+class ShaderPermutations
+{
+public:
+	// features making up a variant key
+	enum VARIANT_FLAGS
+	{
+		VARIANT_TEXTURED = 1,
+		VARIANT_LIT = 2
+	};
+	// the point light count is kept above the flags
+	static const int VARIANT_POINT_LIGHT_SHIFT = 2;
+	static const int MAX_VARIANT_POINT_LIGHTS = 15;
+
+	// constructor
+	ShaderPermutations(ShaderProgramCache* pProgramCache);
+	// destructor
+	~ShaderPermutations();
+
+	// combine the features of a draw into a variant key
+	static uint32_t MakeVariantKey(bool bTextured, bool bLit, int pointLightCount);
+
+	// program of a variant, 0 while it is compiling or if it
+	// failed.  bFirstUse is set the first time a program is
+	// returned, when its startup values still have to be set.
+	GLuint GetProgram(uint32_t variantKey, bool& bFirstUse);
+
+	// delete every variant, after the sources have changed
+	void Clear();
+
+	// false when the sources have nothing to specialize, so
+	// every variant would be the general program again
+	bool IsSpecializable() const { return(m_bSpecializable); }
+
+	int GetVariantCount() const { return((int)m_variants.size()); }
+
+private:
+	// one variant and the state of its build
+	struct VARIANT
+	{
+		ShaderProgramCache::PROGRAM_BUILD build;
+		GLuint programID;
+		bool bPending;
+		bool bFailed;
+		bool bUsed;
+	};
+
+	ShaderProgramCache* m_pProgramCache;
+	std::map<uint32_t, VARIANT> m_variants;
+	bool m_bSpecializable;
+
+	// delete the programs of every variant
+	void DeletePrograms();
+	// check the current sources for anything to specialize
+	void CheckSources();
+	// sources with the features of a variant fixed
+	std::string SpecializeSource(const std::string& source, uint32_t variantKey) const;
+};
@@ -0,0 +1,605 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderprogramcache.cpp
+// ============
+// reuse compiled shader programs across runs and reload edited shaders
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderProgramCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	const char g_BinaryMagic[4] = { 'S', 'P', 'B', 'C' };
+	// how often the source files are checked for changes
+	const int g_PollIntervalMilliseconds = 500;
+
+	// start of every stored binary
+	struct BINARY_HEADER
+	{
+		char magic[4];
+		uint32_t format;
+		uint64_t key;
+		uint64_t length;
+	};
+
+	/***********************************************************
+	 *  ReadTextFile()
+	 *
+	 *  Read a whole file into a string.
+	 ***********************************************************/
+	bool ReadTextFile(const std::string& filename, std::string& text)
+	{
+		std::ifstream file(filename.c_str(), std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		std::stringstream stream;
+		stream << file.rdbuf();
+		text = stream.str();
+
+		return true;
+	}
+
+	/***********************************************************
+	 *  GetModifiedTime()
+	 *
+	 *  Last modification time of a file, 0 if it is missing.
+	 ***********************************************************/
+	time_t GetModifiedTime(const std::string& filename)
+	{
+		struct stat fileInfo;
+
+		if (stat(filename.c_str(), &fileInfo) != 0)
+		{
+			return(0);
+		}
+
+		return(fileInfo.st_mtime);
+	}
+
+	/***********************************************************
+	 *  DeclareInvariantPosition()
+	 *
+	 *  Declare gl_Position invariant in a vertex source, after
+	 *  the #version line and any #extension lines that follow
+	 *  it, with a #line directive so compile errors still point
+	 *  at the lines of the file.  A source that declares it
+	 *  already is left alone.
+	 ***********************************************************/
+	void DeclareInvariantPosition(std::string& source)
+	{
+		if (source.find("invariant gl_Position") != std::string::npos)
+		{
+			return;
+		}
+
+		size_t insertAt = 0;
+		size_t versionStart = source.find("#version");
+		if (versionStart != std::string::npos)
+		{
+			insertAt = source.find('\n', versionStart);
+			insertAt = (insertAt == std::string::npos) ? source.size() : insertAt + 1;
+			while (source.compare(insertAt, 10, "#extension") == 0)
+			{
+				insertAt = source.find('\n', insertAt);
+				insertAt = (insertAt == std::string::npos) ? source.size() : insertAt + 1;
+			}
+		}
+		int nextLine = (int)std::count(source.begin(), source.begin() + insertAt, '\n') + 1;
+
+		source.insert(insertAt, "invariant gl_Position;\n#line " + std::to_string(nextLine) + "\n");
+	}
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  Continue a 64 bit FNV-1a hash over a block of bytes.
+	 ***********************************************************/
+	uint64_t HashBytes(uint64_t hash, const void* pData, size_t size)
+	{
+		const unsigned char* pBytes = (const unsigned char*)pData;
+
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ULL;
+		}
+
+		return(hash);
+	}
+
+	/***********************************************************
+	 *  GetDriverString()
+	 *
+	 *  An OpenGL string, empty if the driver returns none.
+	 ***********************************************************/
+	std::string GetDriverString(GLenum name)
+	{
+		const GLubyte* pString = glGetString(name);
+
+		return((pString != NULL) ? std::string((const char*)pString) : std::string());
+	}
+}
+
+/***********************************************************
+ *  ShaderProgramCache()
+ *
+ *  The constructor for the class.  Needs a current context.
+ ***********************************************************/
+ShaderProgramCache::ShaderProgramCache(const char* cacheDirectory)
+{
+	m_cacheDirectory = cacheDirectory;
+	m_driverKey = GetDriverString(GL_VENDOR) + "\n" + GetDriverString(GL_RENDERER) + "\n" +
+		GetDriverString(GL_VERSION);
+	m_vertexTime = 0;
+	m_fragmentTime = 0;
+	m_sourceKey = 0;
+	m_bHotReload = true;
+	m_lastPollTime = std::chrono::steady_clock::now();
+	m_sourceFilter = NULL;
+	m_bSourcesFiltered = false;
+	m_pendingBuild.programID = 0;
+	m_pendingBuild.key = 0;
+	m_pendingBuild.bFromCache = false;
+	m_stats.cacheHits = 0;
+	m_stats.cacheMisses = 0;
+	m_stats.reloadCount = 0;
+	m_stats.failedReloadCount = 0;
+
+	// some drivers expose the entry points but no formats
+	GLint formatCount = 0;
+	if (GLEW_ARB_get_program_binary)
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	}
+	m_bBinarySupported = (formatCount > 0);
+	if (m_bBinarySupported == false)
+	{
+		std::cout << "INFO: driver can't save program binaries, shaders are compiled on every start" << std::endl;
+	}
+
+	// let the driver compile on its own threads
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
+#ifdef _WIN32
+	_mkdir(m_cacheDirectory.c_str());
+#else
+	mkdir(m_cacheDirectory.c_str(), 0755);
+#endif
+}
+
+/***********************************************************
+ *  ~ShaderProgramCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderProgramCache::~ShaderProgramCache()
+{
+	if (m_pendingBuild.programID != 0)
+	{
+		glDeleteProgram(m_pendingBuild.programID);
+		m_pendingBuild.programID = 0;
+	}
+}
+
+/***********************************************************
+ *  ComputeKey()
+ *
+ *  This method is used to hash both sources together with
+ *  the driver strings.  The separators keep text moving
+ *  between the sources from producing the same key.
+ ***********************************************************/
+uint64_t ShaderProgramCache::ComputeKey(const std::string& vertexSource, const std::string& fragmentSource) const
+{
+	const char separator = 0;
+	uint64_t key = 14695981039346656037ULL;
+
+	key = HashBytes(key, m_driverKey.data(), m_driverKey.size());
+	key = HashBytes(key, &separator, 1);
+	key = HashBytes(key, vertexSource.data(), vertexSource.size());
+	key = HashBytes(key, &separator, 1);
+	key = HashBytes(key, fragmentSource.data(), fragmentSource.size());
+
+	return(key);
+}
+
+/***********************************************************
+ *  GetCacheFilename()
+ *
+ *  This method is used to name the file of a key.
+ ***********************************************************/
+std::string ShaderProgramCache::GetCacheFilename(uint64_t key) const
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+
+	return(m_cacheDirectory + "/" + name);
+}
+
+/***********************************************************
+ *  LoadBinary()
+ *
+ *  This method is used to create a program from its stored
+ *  binary.  The driver may refuse a binary even for the same
+ *  strings, after which the caller compiles from source.
+ ***********************************************************/
+GLuint ShaderProgramCache::LoadBinary(uint64_t key)
+{
+	if (m_bBinarySupported == false)
+	{
+		return(0);
+	}
+
+	std::ifstream file(GetCacheFilename(key).c_str(), std::ios::binary);
+	if (!file)
+	{
+		return(0);
+	}
+
+	BINARY_HEADER header;
+	file.read((char*)&header, sizeof(header));
+	if (!file || (std::memcmp(header.magic, g_BinaryMagic, sizeof(g_BinaryMagic)) != 0) || (header.key != key))
+	{
+		return(0);
+	}
+
+	std::vector<char> binary((size_t)header.length);
+	file.read(binary.data(), (std::streamsize)binary.size());
+	if (!file)
+	{
+		return(0);
+	}
+
+	GLint success = 0;
+	GLuint programID = glCreateProgram();
+	glProgramBinary(programID, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		std::cout << "INFO: stored shader program was rejected by the driver, compiling" << std::endl;
+		glDeleteProgram(programID);
+		return(0);
+	}
+
+	return(programID);
+}
+
+/***********************************************************
+ *  StoreBinary()
+ *
+ *  This method is used to save the binary of a linked program
+ *  under its key.  It is written to a temporary file first so
+ *  a crash never leaves a truncated binary behind.
+ ***********************************************************/
+void ShaderProgramCache::StoreBinary(uint64_t key, GLuint programID)
+{
+	if (m_bBinarySupported == false)
+	{
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return;
+	}
+
+	GLenum format = 0;
+	std::vector<char> binary((size_t)length);
+	glGetProgramBinary(programID, length, &length, &format, binary.data());
+
+	BINARY_HEADER header;
+	std::memcpy(header.magic, g_BinaryMagic, sizeof(g_BinaryMagic));
+	header.format = format;
+	header.key = key;
+	header.length = (uint64_t)length;
+
+	std::string filename = GetCacheFilename(key);
+	std::string temporaryFilename = filename + ".tmp";
+	{
+		std::ofstream file(temporaryFilename.c_str(), std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), length);
+		if (!file)
+		{
+			std::cout << "WARNING: could not write shader cache file " << temporaryFilename << std::endl;
+			return;
+		}
+	}
+
+	// rename() won't replace an existing file on Windows
+	std::remove(filename.c_str());
+	std::rename(temporaryFilename.c_str(), filename.c_str());
+}
+
+/***********************************************************
+ *  BeginCompile()
+ *
+ *  This method is used to submit both stages and the link.
+ *  With parallel compilation the calls return at once, and
+ *  nothing waits for the driver until FinishCompile().
+ ***********************************************************/
+GLuint ShaderProgramCache::BeginCompile(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	const char* pVertexSource = vertexSource.c_str();
+	const char* pFragmentSource = fragmentSource.c_str();
+	GLuint vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderSource(vertexShaderID, 1, &pVertexSource, NULL);
+	glCompileShader(vertexShaderID);
+	glShaderSource(fragmentShaderID, 1, &pFragmentSource, NULL);
+	glCompileShader(fragmentShaderID);
+
+	GLuint programID = glCreateProgram();
+	if (m_bBinarySupported)
+	{
+		glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glAttachShader(programID, vertexShaderID);
+	glAttachShader(programID, fragmentShaderID);
+	glLinkProgram(programID);
+
+	// the stages are released with the program, and stay
+	// attached until then so their logs can be read
+	glDeleteShader(vertexShaderID);
+	glDeleteShader(fragmentShaderID);
+
+	return(programID);
+}
+
+/***********************************************************
+ *  FinishCompile()
+ *
+ *  This method is used to check the stages and the link of a
+ *  program, printing the log of whatever failed.
+ ***********************************************************/
+bool ShaderProgramCache::FinishCompile(GLuint programID)
+{
+	GLint success = 0;
+	GLuint shaderIDs[2] = { 0, 0 };
+	GLsizei shaderCount = 0;
+	char infoLog[1024];
+
+	glGetAttachedShaders(programID, 2, &shaderCount, shaderIDs);
+	for (int i = 0; i < shaderCount; i++)
+	{
+		GLint shaderType = 0;
+		glGetShaderiv(shaderIDs[i], GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderiv(shaderIDs[i], GL_SHADER_TYPE, &shaderType);
+			glGetShaderInfoLog(shaderIDs[i], sizeof(infoLog), NULL, infoLog);
+			std::cout << "ERROR: " << ((shaderType == GL_VERTEX_SHADER) ? m_vertexFilename : m_fragmentFilename)
+				<< " failed to compile\n" << infoLog << std::endl;
+		}
+	}
+
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR: shader program link failed\n" << infoLog << std::endl;
+		glDeleteProgram(programID);
+		return false;
+	}
+
+	for (int i = 0; i < shaderCount; i++)
+	{
+		glDetachShader(programID, shaderIDs[i]);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  BeginBuild()
+ *
+ *  This method is used to start building a program.  A stored
+ *  binary is ready at once, anything else is compiled.
+ ***********************************************************/
+ShaderProgramCache::PROGRAM_BUILD ShaderProgramCache::BeginBuild(
+	const std::string& vertexSource,
+	const std::string& fragmentSource)
+{
+	PROGRAM_BUILD build;
+
+	build.key = ComputeKey(vertexSource, fragmentSource);
+	build.programID = LoadBinary(build.key);
+	build.bFromCache = (build.programID != 0);
+	if (build.bFromCache)
+	{
+		m_stats.cacheHits++;
+	}
+	else
+	{
+		m_stats.cacheMisses++;
+		build.programID = BeginCompile(vertexSource, fragmentSource);
+	}
+
+	return(build);
+}
+
+/***********************************************************
+ *  IsBuildComplete()
+ *
+ *  This method is used to ask the driver whether a build is
+ *  done.  Without parallel compilation the answer is always
+ *  yes, and FinishBuild() waits instead.
+ ***********************************************************/
+bool ShaderProgramCache::IsBuildComplete(const PROGRAM_BUILD& build) const
+{
+	if (build.bFromCache || (GLEW_KHR_parallel_shader_compile == false))
+	{
+		return true;
+	}
+
+	GLint bComplete = GL_FALSE;
+	glGetProgramiv(build.programID, GL_COMPLETION_STATUS_KHR, &bComplete);
+
+	return(bComplete != GL_FALSE);
+}
+
+/***********************************************************
+ *  FinishBuild()
+ *
+ *  This method is used to check a build and store the binary
+ *  of a newly compiled program.
+ ***********************************************************/
+GLuint ShaderProgramCache::FinishBuild(const PROGRAM_BUILD& build)
+{
+	if (build.bFromCache)
+	{
+		return(build.programID);
+	}
+
+	if (FinishCompile(build.programID) == false)
+	{
+		return(0);
+	}
+	StoreBinary(build.key, build.programID);
+
+	return(build.programID);
+}
+
+/***********************************************************
+ *  LoadProgram()
+ *
+ *  This method is used to build the program at startup.  It
+ *  blocks until the program is ready, since nothing can be
+ *  drawn before it.
+ ***********************************************************/
+GLuint ShaderProgramCache::LoadProgram(const char* vertexFilename, const char* fragmentFilename)
+{
+	m_vertexFilename = vertexFilename;
+	m_fragmentFilename = fragmentFilename;
+	m_vertexTime = GetModifiedTime(m_vertexFilename);
+	m_fragmentTime = GetModifiedTime(m_fragmentFilename);
+
+	if ((ReadTextFile(m_vertexFilename, m_vertexSource) == false) ||
+		(ReadTextFile(m_fragmentFilename, m_fragmentSource) == false))
+	{
+		std::cout << "ERROR: could not read shader files " << vertexFilename << ", " << fragmentFilename << std::endl;
+		return(0);
+	}
+	DeclareInvariantPosition(m_vertexSource);
+	if (m_sourceFilter != NULL)
+	{
+		m_bSourcesFiltered = m_sourceFilter(m_vertexSource, m_fragmentSource);
+	}
+
+	PROGRAM_BUILD build = BeginBuild(m_vertexSource, m_fragmentSource);
+	m_sourceKey = build.key;
+	if (build.bFromCache)
+	{
+		std::cout << "INFO: shader program loaded from cache" << std::endl;
+	}
+
+	return(FinishBuild(build));
+}
+
+/***********************************************************
+ *  PollReload()
+ *
+ *  This method is used to pick up edited shader files.  A
+ *  pending build is checked without blocking, and the files
+ *  are only looked at a few times a second.  Saving a file
+ *  without changing it doesn't cost a compile, and reverting
+ *  to an earlier version loads it from the cache.
+ ***********************************************************/
+GLuint ShaderProgramCache::PollReload()
+{
+	if (m_pendingBuild.programID != 0)
+	{
+		if (IsBuildComplete(m_pendingBuild) == false)
+		{
+			return(0);
+		}
+
+		GLuint programID = FinishBuild(m_pendingBuild);
+		m_pendingBuild.programID = 0;
+		if (programID == 0)
+		{
+			std::cout << "INFO: keeping the previous shader program" << std::endl;
+			m_stats.failedReloadCount++;
+			return(0);
+		}
+
+		m_vertexSource.swap(m_pendingVertexSource);
+		m_fragmentSource.swap(m_pendingFragmentSource);
+		m_sourceKey = m_pendingBuild.key;
+		m_stats.reloadCount++;
+		std::cout << "INFO: shader program reloaded" << std::endl;
+
+		return(programID);
+	}
+
+	if ((m_bHotReload == false) || m_vertexFilename.empty())
+	{
+		return(0);
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - m_lastPollTime < std::chrono::milliseconds(g_PollIntervalMilliseconds))
+	{
+		return(0);
+	}
+	m_lastPollTime = now;
+
+	time_t vertexTime = GetModifiedTime(m_vertexFilename);
+	time_t fragmentTime = GetModifiedTime(m_fragmentFilename);
+	// a missing file is usually an editor in the middle of saving
+	if ((vertexTime == 0) || (fragmentTime == 0) ||
+		((vertexTime == m_vertexTime) && (fragmentTime == m_fragmentTime)))
+	{
+		return(0);
+	}
+	m_vertexTime = vertexTime;
+	m_fragmentTime = fragmentTime;
+
+	if ((ReadTextFile(m_vertexFilename, m_pendingVertexSource) == false) ||
+		(ReadTextFile(m_fragmentFilename, m_pendingFragmentSource) == false))
+	{
+		return(0);
+	}
+	DeclareInvariantPosition(m_pendingVertexSource);
+	// whatever was set up for the rewritten sources must keep
+	// working with the reloaded program
+	if ((m_sourceFilter != NULL) &&
+		(m_sourceFilter(m_pendingVertexSource, m_pendingFragmentSource) == false) && m_bSourcesFiltered)
+	{
+		std::cout << "WARNING: edited shaders can't be rewritten like the loaded ones, keeping the previous shader program" << std::endl;
+		m_stats.failedReloadCount++;
+		return(0);
+	}
+	if (ComputeKey(m_pendingVertexSource, m_pendingFragmentSource) == m_sourceKey)
+	{
+		return(0);
+	}
+
+	// picked up on the next poll, straight away if it came
+	// from the cache
+	m_pendingBuild = BeginBuild(m_pendingVertexSource, m_pendingFragmentSource);
+
+	return(PollReload());
+}
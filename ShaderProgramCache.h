@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderprogramcache.h
+// ============
+// reuse compiled shader programs across runs and reload edited shaders
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+/***********************************************************
+ *  ShaderProgramCache
+ *
+ *  This class builds the scene program from its GLSL files.
+ *  Linked programs are saved with glGetProgramBinary() under
+ *  a key hashed from both sources and the vendor, renderer
+ *  and version strings of the driver, so a warm start loads
+ *  the binary instead of compiling.  Any driver or source
+ *  change produces a new key, and a binary the driver rejects
+ *  is simply compiled again.
+ *
+ *  While running, the source files are polled for changes.
+ *  An edited program is compiled alongside the one in use,
+ *  in the background where KHR_parallel_shader_compile is
+ *  available, and only handed back once it has linked, so a
+ *  shader with errors never replaces a working one.
+ *
+ *  gl_Position is declared invariant in the vertex source as
+ *  it is read, so every program built from it places a vertex
+ *  exactly where the depth pre-pass put it.  A source filter
+ *  may then rewrite the sources, before they are compiled or
+ *  hashed, and everything built from GetVertexSource() and
+ *  GetFragmentSource() sees the rewritten sources.
+ ***********************************************************/
+class ShaderProgramCache
+{
+public:
+	// a program being built, from the cache or by compiling
+	struct PROGRAM_BUILD
+	{
+		GLuint programID;
+		uint64_t key;
+		// loaded from a stored binary and ready at once
+		bool bFromCache;
+	};
+
+	// rewrite a pair of sources in place, false if they can't
+	// be rewritten, which leaves them unchanged
+	typedef bool (*SOURCE_FILTER)(std::string& vertexSource, std::string& fragmentSource);
+
+	// counters since startup
+	struct CACHE_STATS
+	{
+		int cacheHits;
+		int cacheMisses;
+		int reloadCount;
+		int failedReloadCount;
+	};
+
+	// constructor
+	ShaderProgramCache(const char* cacheDirectory);
+	// destructor
+	~ShaderProgramCache();
+
+	// build the program from the two files, from the cache if
+	// possible, returns 0 if the sources don't compile
+	GLuint LoadProgram(const char* vertexFilename, const char* fragmentFilename);
+
+	// check the source files and advance a pending compile,
+	// called once per frame.  Returns a newly linked program
+	// that the caller switches to and then owns, or 0.
+	GLuint PollReload();
+
+	// watch the source files of the loaded program
+	void SetHotReload(bool bEnable) { m_bHotReload = bEnable; }
+	// rewrite the sources read from the files, must be set
+	// before LoadProgram()
+	void SetSourceFilter(SOURCE_FILTER filter) { m_sourceFilter = filter; }
+	// true if the filter rewrote the sources of the program
+	bool AreSourcesFiltered() const { return(m_bSourcesFiltered); }
+
+	// sources of the loaded program, updated by every reload
+	const std::string& GetVertexSource() const { return(m_vertexSource); }
+	const std::string& GetFragmentSource() const { return(m_fragmentSource); }
+
+	// start building a program from sources, without waiting
+	// for the driver, programID is 0 if nothing was started
+	PROGRAM_BUILD BeginBuild(const std::string& vertexSource, const std::string& fragmentSource);
+	// true once FinishBuild() won't block
+	bool IsBuildComplete(const PROGRAM_BUILD& build) const;
+	// check the result and store the binary, returns the
+	// program or 0 if the sources don't compile
+	GLuint FinishBuild(const PROGRAM_BUILD& build);
+
+	const CACHE_STATS& GetStats() const { return(m_stats); }
+
+private:
+	std::string m_cacheDirectory;
+	// driver strings folded into every key
+	std::string m_driverKey;
+	bool m_bBinarySupported;
+
+	// source files of the loaded program and when they were
+	// last seen changing
+	std::string m_vertexFilename;
+	std::string m_fragmentFilename;
+	std::string m_vertexSource;
+	std::string m_fragmentSource;
+	time_t m_vertexTime;
+	time_t m_fragmentTime;
+	uint64_t m_sourceKey;
+	bool m_bHotReload;
+	std::chrono::steady_clock::time_point m_lastPollTime;
+	// rewrites the sources read from the files, NULL for none
+	SOURCE_FILTER m_sourceFilter;
+	bool m_bSourcesFiltered;
+
+	// program being built for a reload, and its sources
+	PROGRAM_BUILD m_pendingBuild;
+	std::string m_pendingVertexSource;
+	std::string m_pendingFragmentSource;
+
+	CACHE_STATS m_stats;
+
+	// key of a pair of sources on this driver
+	uint64_t ComputeKey(const std::string& vertexSource, const std::string& fragmentSource) const;
+	// path of the binary stored under a key
+	std::string GetCacheFilename(uint64_t key) const;
+	// create a program from a stored binary, 0 if there is none
+	// or the driver no longer accepts it
+	GLuint LoadBinary(uint64_t key);
+	// save the binary of a linked program
+	void StoreBinary(uint64_t key, GLuint programID);
+	// compile and start linking, without waiting for the result
+	GLuint BeginCompile(const std::string& vertexSource, const std::string& fragmentSource);
+	// check the result of BeginCompile(), deleting the program
+	// on failure
+	bool FinishCompile(GLuint programID);
+};
@@ -0,0 +1,970 @@
+///////////////////////////////////////////////////////////////////////////////
+// spatialindex.cpp
+// ============
+// bounding volume hierarchy for picking and spatial lookups
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// SSE2 is part of every x64 target, so it only needs to be
+// detected for 32-bit builds
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SPATIAL_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// centroid bins tried along the split axis
+	const int g_BinCount = 16;
+	// nodes with this few objects are never split
+	const int g_MinLeafSize = 2;
+	// nodes with more objects are split even when the surface
+	// area heuristic finds no gain
+	const int g_MaxLeafSize = 8;
+	// cost of visiting a node relative to testing an object
+	const float g_TraversalCost = 1.0f;
+	// deepest traversal, far above any tree built here
+	const int g_MaxStackDepth = 128;
+	// smallest determinant of a ray and triangle that hit
+	const float g_TriangleEpsilon = 1e-12f;
+	// direction components are kept away from zero so their
+	// inverse stays finite
+	const float g_MinDirection = 1e-12f;
+
+	// a ray ready for repeated box tests
+	struct BOX_RAY
+	{
+		glm::vec3 origin;
+		glm::vec3 inverseDirection;
+#ifdef SPATIAL_USE_SSE
+		// the x value is repeated in the fourth lane
+		__m128 origin4;
+		__m128 inverseDirection4;
+#endif
+	};
+
+	// one bin of the surface area heuristic
+	struct SAH_BIN
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		int count;
+	};
+
+	// a node waiting on a traversal stack, with the distance at
+	// which the ray enters it
+	struct STACK_ENTRY
+	{
+		int nodeIndex;
+		float distance;
+	};
+
+	/***********************************************************
+	 *  HalfArea()
+	 *
+	 *  Half the surface area of a box, all the heuristic needs.
+	 ***********************************************************/
+	float HalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return(size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	/***********************************************************
+	 *  MakeBoxRay()
+	 *
+	 *  Prepare a ray for the box tests.
+	 ***********************************************************/
+	BOX_RAY MakeBoxRay(const glm::vec3& origin, const glm::vec3& direction)
+	{
+		BOX_RAY ray;
+
+		ray.origin = origin;
+		for (int i = 0; i < 3; i++)
+		{
+			float component = direction[i];
+			if (std::fabs(component) < g_MinDirection)
+			{
+				component = (component < 0.0f) ? -g_MinDirection : g_MinDirection;
+			}
+			ray.inverseDirection[i] = 1.0f / component;
+		}
+#ifdef SPATIAL_USE_SSE
+		ray.origin4 = _mm_setr_ps(origin.x, origin.y, origin.z, origin.x);
+		ray.inverseDirection4 = _mm_setr_ps(
+			ray.inverseDirection.x, ray.inverseDirection.y, ray.inverseDirection.z, ray.inverseDirection.x);
+#endif
+
+		return(ray);
+	}
+
+	/***********************************************************
+	 *  IntersectBox()
+	 *
+	 *  Slab test of a ray against a box, clipped to the ray
+	 *  from its origin up to a distance.  The distance at which
+	 *  the ray enters is 0 when it starts inside.
+	 ***********************************************************/
+	inline bool IntersectBox(
+		const glm::vec3& boundsMin,
+		const glm::vec3& boundsMax,
+		const BOX_RAY& ray,
+		float maxDistance,
+		float& enterDistance)
+	{
+#ifdef SPATIAL_USE_SSE
+		__m128 low = _mm_mul_ps(
+			_mm_sub_ps(_mm_setr_ps(boundsMin.x, boundsMin.y, boundsMin.z, boundsMin.x), ray.origin4),
+			ray.inverseDirection4);
+		__m128 high = _mm_mul_ps(
+			_mm_sub_ps(_mm_setr_ps(boundsMax.x, boundsMax.y, boundsMax.z, boundsMax.x), ray.origin4),
+			ray.inverseDirection4);
+		__m128 near4 = _mm_min_ps(low, high);
+		__m128 far4 = _mm_max_ps(low, high);
+
+		__m128 enter = _mm_max_ss(near4, _mm_shuffle_ps(near4, near4, _MM_SHUFFLE(1, 1, 1, 1)));
+		enter = _mm_max_ss(enter, _mm_shuffle_ps(near4, near4, _MM_SHUFFLE(2, 2, 2, 2)));
+		enter = _mm_max_ss(enter, _mm_setzero_ps());
+		__m128 exit = _mm_min_ss(far4, _mm_shuffle_ps(far4, far4, _MM_SHUFFLE(1, 1, 1, 1)));
+		exit = _mm_min_ss(exit, _mm_shuffle_ps(far4, far4, _MM_SHUFFLE(2, 2, 2, 2)));
+		exit = _mm_min_ss(exit, _mm_set_ss(maxDistance));
+
+		enterDistance = _mm_cvtss_f32(enter);
+		return(_mm_comile_ss(enter, exit) != 0);
+#else
+		glm::vec3 low = (boundsMin - ray.origin) * ray.inverseDirection;
+		glm::vec3 high = (boundsMax - ray.origin) * ray.inverseDirection;
+		glm::vec3 near3 = glm::min(low, high);
+		glm::vec3 far3 = glm::max(low, high);
+
+		float enter = std::max(std::max(near3.x, near3.y), std::max(near3.z, 0.0f));
+		float exit = std::min(std::min(far3.x, far3.y), std::min(far3.z, maxDistance));
+
+		enterDistance = enter;
+		return(enter <= exit);
+#endif
+	}
+
+	/***********************************************************
+	 *  BoxDistanceSquared()
+	 *
+	 *  Squared distance from a point to a box, 0 inside it.
+	 ***********************************************************/
+	inline float BoxDistanceSquared(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& point)
+	{
+		glm::vec3 outside = glm::max(glm::max(boundsMin - point, point - boundsMax), glm::vec3(0.0f));
+		return(glm::dot(outside, outside));
+	}
+}
+
+/***********************************************************
+ *  SpatialIndex()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SpatialIndex::SpatialIndex()
+{
+}
+
+/***********************************************************
+ *  AddMesh()
+ *
+ *  This method is used to store the triangles of a mesh in
+ *  packets of four.  The unused lanes of the last packet are
+ *  left zero, which no ray can hit.
+ ***********************************************************/
+int SpatialIndex::AddMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+{
+	MESH_RANGE range;
+	int triangleCount = (int)indices.size() / 3;
+
+	range.firstPacket = (int)m_packets.size();
+	range.packetCount = (triangleCount + 3) / 4;
+
+	TRIANGLE_PACKET emptyPacket = {};
+	m_packets.resize(m_packets.size() + range.packetCount, emptyPacket);
+
+	for (int i = 0; i < triangleCount; i++)
+	{
+		TRIANGLE_PACKET& packet = m_packets[range.firstPacket + i / 4];
+		int lane = i % 4;
+		const glm::vec3& v0 = positions[indices[i * 3 + 0]];
+		const glm::vec3& v1 = positions[indices[i * 3 + 1]];
+		const glm::vec3& v2 = positions[indices[i * 3 + 2]];
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			packet.v0[axis][lane] = v0[axis];
+			packet.edge1[axis][lane] = v1[axis] - v0[axis];
+			packet.edge2[axis][lane] = v2[axis] - v0[axis];
+		}
+	}
+
+	m_meshes.push_back(range);
+
+	return((int)m_meshes.size() - 1);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used to remove every object and mesh.
+ ***********************************************************/
+void SpatialIndex::Clear()
+{
+	m_nodes.clear();
+	m_boundsMin.clear();
+	m_boundsMax.clear();
+	m_objectIDs.clear();
+	m_meshIndices.clear();
+	m_inverseTransforms.clear();
+	m_packets.clear();
+	m_meshes.clear();
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used to build the hierarchy over a new set
+ *  of objects.  Nodes are split from the root down, and the
+ *  objects are then copied in the order of the leaves so each
+ *  leaf reads one contiguous range.
+ ***********************************************************/
+void SpatialIndex::Build(const std::vector<SPATIAL_OBJECT>& objects)
+{
+	int objectCount = (int)objects.size();
+	std::vector<int> order(objectCount);
+	std::vector<glm::vec3> centroids(objectCount);
+
+	m_nodes.clear();
+	m_boundsMin.resize(objectCount);
+	m_boundsMax.resize(objectCount);
+	m_objectIDs.resize(objectCount);
+	m_meshIndices.resize(objectCount);
+	m_inverseTransforms.resize(objectCount);
+	if (objectCount == 0)
+	{
+		return;
+	}
+
+	BVH_NODE root;
+	root.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	root.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+	root.leftFirst = 0;
+	root.count = objectCount;
+	for (int i = 0; i < objectCount; i++)
+	{
+		order[i] = i;
+		centroids[i] = (objects[i].boundsMin + objects[i].boundsMax) * 0.5f;
+		root.boundsMin = glm::min(root.boundsMin, objects[i].boundsMin);
+		root.boundsMax = glm::max(root.boundsMax, objects[i].boundsMax);
+	}
+
+	m_nodes.reserve((size_t)objectCount * 2);
+	m_nodes.push_back(root);
+
+	std::vector<int> pending;
+	pending.push_back(0);
+	while (pending.empty() == false)
+	{
+		int nodeIndex = pending.back();
+		pending.pop_back();
+		if (SplitNode(nodeIndex, order, centroids, objects))
+		{
+			pending.push_back(m_nodes[nodeIndex].leftFirst + 1);
+			pending.push_back(m_nodes[nodeIndex].leftFirst);
+		}
+	}
+
+	for (int i = 0; i < objectCount; i++)
+	{
+		const SPATIAL_OBJECT& object = objects[order[i]];
+
+		m_boundsMin[i] = object.boundsMin;
+		m_boundsMax[i] = object.boundsMax;
+		m_objectIDs[i] = order[i];
+		m_meshIndices[i] = object.meshIndex;
+		m_inverseTransforms[i] = (object.meshIndex >= 0) ? glm::inverse(object.transform) : glm::mat4(1.0f);
+	}
+}
+
+/***********************************************************
+ *  SplitNode()
+ *
+ *  This method is used to split the objects of a node in two
+ *  at the cheapest of the bin boundaries along its longest
+ *  centroid axis.  Small nodes stay leaves when splitting
+ *  would cost more than testing their objects, and objects
+ *  that can't be told apart by their centroids are halved.
+ ***********************************************************/
+bool SpatialIndex::SplitNode(
+	int nodeIndex,
+	std::vector<int>& order,
+	const std::vector<glm::vec3>& centroids,
+	const std::vector<SPATIAL_OBJECT>& objects)
+{
+	int first = m_nodes[nodeIndex].leftFirst;
+	int count = m_nodes[nodeIndex].count;
+	if (count <= g_MinLeafSize)
+	{
+		return false;
+	}
+
+	glm::vec3 centroidMin = centroids[order[first]];
+	glm::vec3 centroidMax = centroidMin;
+	for (int i = first + 1; i < first + count; i++)
+	{
+		centroidMin = glm::min(centroidMin, centroids[order[i]]);
+		centroidMax = glm::max(centroidMax, centroids[order[i]]);
+	}
+
+	glm::vec3 extent = centroidMax - centroidMin;
+	int axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+	int split = first + count / 2;
+
+	if (extent[axis] > 0.0f)
+	{
+		SAH_BIN bins[g_BinCount];
+		for (int b = 0; b < g_BinCount; b++)
+		{
+			bins[b].boundsMin = glm::vec3(std::numeric_limits<float>::max());
+			bins[b].boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+			bins[b].count = 0;
+		}
+
+		float scale = (float)g_BinCount / extent[axis];
+		for (int i = first; i < first + count; i++)
+		{
+			int object = order[i];
+			int bin = std::min(g_BinCount - 1, (int)((centroids[object][axis] - centroidMin[axis]) * scale));
+			bins[bin].boundsMin = glm::min(bins[bin].boundsMin, objects[object].boundsMin);
+			bins[bin].boundsMax = glm::max(bins[bin].boundsMax, objects[object].boundsMax);
+			bins[bin].count++;
+		}
+
+		// sweep from the right to get the cost of every right
+		// side, then from the left to find the cheapest plane
+		float rightCosts[g_BinCount];
+		glm::vec3 sweepMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 sweepMax = glm::vec3(-std::numeric_limits<float>::max());
+		int sweepCount = 0;
+		for (int b = g_BinCount - 1; b > 0; b--)
+		{
+			sweepMin = glm::min(sweepMin, bins[b].boundsMin);
+			sweepMax = glm::max(sweepMax, bins[b].boundsMax);
+			sweepCount += bins[b].count;
+			rightCosts[b] = (sweepCount > 0) ? HalfArea(sweepMin, sweepMax) * sweepCount : 0.0f;
+		}
+
+		float bestCost = std::numeric_limits<float>::max();
+		int bestPlane = -1;
+		sweepMin = glm::vec3(std::numeric_limits<float>::max());
+		sweepMax = glm::vec3(-std::numeric_limits<float>::max());
+		sweepCount = 0;
+		for (int b = 0; b < g_BinCount - 1; b++)
+		{
+			sweepMin = glm::min(sweepMin, bins[b].boundsMin);
+			sweepMax = glm::max(sweepMax, bins[b].boundsMax);
+			sweepCount += bins[b].count;
+			if ((sweepCount == 0) || (sweepCount == count))
+			{
+				continue;
+			}
+			float cost = HalfArea(sweepMin, sweepMax) * sweepCount + rightCosts[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestPlane = b + 1;
+			}
+		}
+
+		float nodeArea = HalfArea(m_nodes[nodeIndex].boundsMin, m_nodes[nodeIndex].boundsMax);
+		if ((count <= g_MaxLeafSize) &&
+			((bestPlane < 0) || (g_TraversalCost * nodeArea + bestCost >= nodeArea * count)))
+		{
+			return false;
+		}
+
+		if (bestPlane > 0)
+		{
+			float planeAxis = centroidMin[axis];
+			std::vector<int>::iterator middle = std::partition(
+				order.begin() + first, order.begin() + first + count,
+				[&](int object)
+				{
+					int bin = std::min(g_BinCount - 1, (int)((centroids[object][axis] - planeAxis) * scale));
+					return(bin < bestPlane);
+				});
+			split = (int)(middle - order.begin());
+		}
+	}
+	else if (count <= g_MaxLeafSize)
+	{
+		return false;
+	}
+
+	int leftIndex = (int)m_nodes.size();
+	for (int side = 0; side < 2; side++)
+	{
+		BVH_NODE child;
+		child.leftFirst = (side == 0) ? first : split;
+		child.count = (side == 0) ? (split - first) : (first + count - split);
+		child.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		child.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		for (int i = child.leftFirst; i < child.leftFirst + child.count; i++)
+		{
+			child.boundsMin = glm::min(child.boundsMin, objects[order[i]].boundsMin);
+			child.boundsMax = glm::max(child.boundsMax, objects[order[i]].boundsMax);
+		}
+		m_nodes.push_back(child);
+	}
+
+	m_nodes[nodeIndex].leftFirst = leftIndex;
+	m_nodes[nodeIndex].count = 0;
+
+	return true;
+}
+
+/***********************************************************
+ *  Raycast()
+ *
+ *  This method is used to find the closest object along a
+ *  ray.  The nearer child is visited first, and nodes the ray
+ *  enters beyond the closest hit so far are skipped.
+ ***********************************************************/
+bool SpatialIndex::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RAY_HIT& hit) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	BOX_RAY ray = MakeBoxRay(origin, direction);
+	float closest = maxDistance;
+	int closestObject = -1;
+	glm::vec3 closestNormal(0.0f);
+	float enter = 0.0f;
+
+	if (IntersectBox(m_nodes[0].boundsMin, m_nodes[0].boundsMax, ray, closest, enter) == false)
+	{
+		return false;
+	}
+
+	STACK_ENTRY stack[g_MaxStackDepth];
+	int stackSize = 0;
+	stack[stackSize].nodeIndex = 0;
+	stack[stackSize].distance = enter;
+	stackSize++;
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+		if (stack[stackSize].distance > closest)
+		{
+			continue;
+		}
+		const BVH_NODE& node = m_nodes[stack[stackSize].nodeIndex];
+
+		if (node.count > 0)
+		{
+			for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				if (IntersectBox(m_boundsMin[i], m_boundsMax[i], ray, closest, enter) &&
+					IntersectObject(i, origin, direction, enter, closest, closestNormal))
+				{
+					closestObject = i;
+				}
+			}
+			continue;
+		}
+
+		float leftEnter = 0.0f;
+		float rightEnter = 0.0f;
+		const BVH_NODE& left = m_nodes[node.leftFirst];
+		const BVH_NODE& right = m_nodes[node.leftFirst + 1];
+		bool bLeft = IntersectBox(left.boundsMin, left.boundsMax, ray, closest, leftEnter);
+		bool bRight = IntersectBox(right.boundsMin, right.boundsMax, ray, closest, rightEnter);
+
+		// push the farther child first so the nearer is popped
+		if (bLeft && bRight && (leftEnter < rightEnter))
+		{
+			stack[stackSize].nodeIndex = node.leftFirst + 1;
+			stack[stackSize].distance = rightEnter;
+			stackSize++;
+			bRight = false;
+		}
+		if (bLeft)
+		{
+			stack[stackSize].nodeIndex = node.leftFirst;
+			stack[stackSize].distance = leftEnter;
+			stackSize++;
+		}
+		if (bRight)
+		{
+			stack[stackSize].nodeIndex = node.leftFirst + 1;
+			stack[stackSize].distance = rightEnter;
+			stackSize++;
+		}
+	}
+
+	if (closestObject < 0)
+	{
+		return false;
+	}
+
+	hit.objectIndex = m_objectIDs[closestObject];
+	hit.distance = closest;
+	hit.point = origin + direction * closest;
+	hit.normal = closestNormal;
+
+	return true;
+}
+
+/***********************************************************
+ *  RaycastPacket()
+ *
+ *  This method is used to trace four rays at once.  Each
+ *  node is tested against all four with SSE, and visited if
+ *  any of them enters it before its closest hit.  Leaves then
+ *  test their objects with each ray on its own.  Packets work
+ *  best when the rays are coherent, as they take the nearer
+ *  child of their first ray.
+ ***********************************************************/
+void SpatialIndex::RaycastPacket(
+	const glm::vec3 origins[4],
+	const glm::vec3 directions[4],
+	float maxDistance,
+	RAY_HIT hits[4],
+	bool bHits[4]) const
+{
+#ifdef SPATIAL_USE_SSE
+	for (int lane = 0; lane < 4; lane++)
+	{
+		bHits[lane] = false;
+	}
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	BOX_RAY rays[4];
+	float closest[4];
+	int closestObjects[4];
+	glm::vec3 closestNormals[4];
+	float inverseDirections[3][4];
+	float originComponents[3][4];
+	for (int lane = 0; lane < 4; lane++)
+	{
+		rays[lane] = MakeBoxRay(origins[lane], directions[lane]);
+		closest[lane] = maxDistance;
+		closestObjects[lane] = -1;
+		closestNormals[lane] = glm::vec3(0.0f);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			inverseDirections[axis][lane] = rays[lane].inverseDirection[axis];
+			originComponents[axis][lane] = origins[lane][axis];
+		}
+	}
+
+	__m128 originX = _mm_loadu_ps(originComponents[0]);
+	__m128 originY = _mm_loadu_ps(originComponents[1]);
+	__m128 originZ = _mm_loadu_ps(originComponents[2]);
+	__m128 inverseX = _mm_loadu_ps(inverseDirections[0]);
+	__m128 inverseY = _mm_loadu_ps(inverseDirections[1]);
+	__m128 inverseZ = _mm_loadu_ps(inverseDirections[2]);
+	__m128 closest4 = _mm_loadu_ps(closest);
+
+	int stack[g_MaxStackDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const BVH_NODE& node = m_nodes[stack[--stackSize]];
+
+		// enter and exit distances of all four rays
+		__m128 lowX = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.x), originX), inverseX);
+		__m128 highX = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.x), originX), inverseX);
+		__m128 lowY = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.y), originY), inverseY);
+		__m128 highY = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.y), originY), inverseY);
+		__m128 lowZ = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.z), originZ), inverseZ);
+		__m128 highZ = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.z), originZ), inverseZ);
+		__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(lowX, highX), _mm_min_ps(lowY, highY)),
+			_mm_max_ps(_mm_min_ps(lowZ, highZ), _mm_setzero_ps()));
+		__m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(lowX, highX), _mm_max_ps(lowY, highY)),
+			_mm_min_ps(_mm_max_ps(lowZ, highZ), closest4));
+		int mask = _mm_movemask_ps(_mm_cmple_ps(enter, exit));
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (((mask >> lane) & 1) == 0)
+				{
+					continue;
+				}
+				float objectEnter = 0.0f;
+				for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+				{
+					if (IntersectBox(m_boundsMin[i], m_boundsMax[i], rays[lane], closest[lane], objectEnter) &&
+						IntersectObject(i, origins[lane], directions[lane], objectEnter, closest[lane], closestNormals[lane]))
+					{
+						closestObjects[lane] = i;
+					}
+				}
+			}
+			closest4 = _mm_loadu_ps(closest);
+			continue;
+		}
+
+		// the nearer child for the first ray along the axis the
+		// children are furthest apart on
+		const BVH_NODE& left = m_nodes[node.leftFirst];
+		const BVH_NODE& right = m_nodes[node.leftFirst + 1];
+		glm::vec3 separation = (right.boundsMin + right.boundsMax) - (left.boundsMin + left.boundsMax);
+		glm::vec3 spread = glm::abs(separation);
+		int axis = (spread.x > spread.y) ? ((spread.x > spread.z) ? 0 : 2) : ((spread.y > spread.z) ? 1 : 2);
+		bool bNearLeft = ((directions[0][axis] >= 0.0f) == (separation[axis] >= 0.0f));
+
+		stack[stackSize++] = bNearLeft ? (node.leftFirst + 1) : node.leftFirst;
+		stack[stackSize++] = bNearLeft ? node.leftFirst : (node.leftFirst + 1);
+	}
+
+	for (int lane = 0; lane < 4; lane++)
+	{
+		if (closestObjects[lane] >= 0)
+		{
+			hits[lane].objectIndex = m_objectIDs[closestObjects[lane]];
+			hits[lane].distance = closest[lane];
+			hits[lane].point = origins[lane] + directions[lane] * closest[lane];
+			hits[lane].normal = closestNormals[lane];
+			bHits[lane] = true;
+		}
+	}
+#else
+	for (int lane = 0; lane < 4; lane++)
+	{
+		bHits[lane] = Raycast(origins[lane], directions[lane], maxDistance, hits[lane]);
+	}
+#endif
+}
+
+/***********************************************************
+ *  IntersectObject()
+ *
+ *  This method is used to find where a ray that enters the
+ *  bounds of an object meets its surface.  Objects without a
+ *  mesh are hit where the ray enters their bounds, with the
+ *  normal of the face it passes through.  The distance is
+ *  only replaced by a closer hit.
+ ***********************************************************/
+bool SpatialIndex::IntersectObject(
+	int slot,
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float enterDistance,
+	float& distance,
+	glm::vec3& normal) const
+{
+	if (m_meshIndices[slot] < 0)
+	{
+		if (enterDistance > distance)
+		{
+			return false;
+		}
+
+		glm::vec3 point = origin + direction * enterDistance;
+		glm::vec3 center = (m_boundsMin[slot] + m_boundsMax[slot]) * 0.5f;
+		glm::vec3 offset = (point - center) / glm::max((m_boundsMax[slot] - m_boundsMin[slot]) * 0.5f, glm::vec3(1e-6f));
+		glm::vec3 absOffset = glm::abs(offset);
+		int axis = (absOffset.x > absOffset.y) ? ((absOffset.x > absOffset.z) ? 0 : 2) : ((absOffset.y > absOffset.z) ? 1 : 2);
+		normal = glm::vec3(0.0f);
+		normal[axis] = (offset[axis] < 0.0f) ? -1.0f : 1.0f;
+		distance = enterDistance;
+		return true;
+	}
+
+	const glm::mat4& inverse = m_inverseTransforms[slot];
+	glm::vec3 objectOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+	glm::vec3 objectDirection = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+	int triangle = -1;
+	if (IntersectMesh(m_meshIndices[slot], objectOrigin, objectDirection, distance, triangle) == false)
+	{
+		return false;
+	}
+
+	// normals go to the world by the transpose of the inverse
+	const TRIANGLE_PACKET& packet = m_packets[m_meshes[m_meshIndices[slot]].firstPacket + triangle / 4];
+	int lane = triangle % 4;
+	glm::vec3 edge1(packet.edge1[0][lane], packet.edge1[1][lane], packet.edge1[2][lane]);
+	glm::vec3 edge2(packet.edge2[0][lane], packet.edge2[1][lane], packet.edge2[2][lane]);
+	glm::vec3 objectNormal = glm::cross(edge1, edge2);
+	normal = glm::normalize(glm::vec3(
+		glm::dot(glm::vec3(inverse[0]), objectNormal),
+		glm::dot(glm::vec3(inverse[1]), objectNormal),
+		glm::dot(glm::vec3(inverse[2]), objectNormal)));
+
+	return true;
+}
+
+/***********************************************************
+ *  IntersectMesh()
+ *
+ *  This method is used to find the closest triangle of a mesh
+ *  a ray hits before the passed in distance, four triangles
+ *  at a time with the Moller-Trumbore test.  The direction
+ *  may be scaled by the object transform, which leaves the
+ *  distance along the world ray unchanged.
+ ***********************************************************/
+bool SpatialIndex::IntersectMesh(
+	int meshIndex,
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float& distance,
+	int& triangle) const
+{
+	const MESH_RANGE& range = m_meshes[meshIndex];
+	bool bHit = false;
+
+#ifdef SPATIAL_USE_SSE
+	__m128 originX = _mm_set1_ps(origin.x);
+	__m128 originY = _mm_set1_ps(origin.y);
+	__m128 originZ = _mm_set1_ps(origin.z);
+	__m128 directionX = _mm_set1_ps(direction.x);
+	__m128 directionY = _mm_set1_ps(direction.y);
+	__m128 directionZ = _mm_set1_ps(direction.z);
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 epsilon = _mm_set1_ps(g_TriangleEpsilon);
+	__m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (int p = range.firstPacket; p < range.firstPacket + range.packetCount; p++)
+	{
+		const TRIANGLE_PACKET& packet = m_packets[p];
+		__m128 edge1X = _mm_loadu_ps(packet.edge1[0]);
+		__m128 edge1Y = _mm_loadu_ps(packet.edge1[1]);
+		__m128 edge1Z = _mm_loadu_ps(packet.edge1[2]);
+		__m128 edge2X = _mm_loadu_ps(packet.edge2[0]);
+		__m128 edge2Y = _mm_loadu_ps(packet.edge2[1]);
+		__m128 edge2Z = _mm_loadu_ps(packet.edge2[2]);
+
+		// p = direction x edge2
+		__m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+		__m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+		__m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+		__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)),
+			_mm_mul_ps(edge1Z, pZ));
+		__m128 valid = _mm_cmpgt_ps(_mm_andnot_ps(signMask, determinant), epsilon);
+		if (_mm_movemask_ps(valid) == 0)
+		{
+			continue;
+		}
+		__m128 inverseDeterminant = _mm_div_ps(one, determinant);
+
+		// t = origin - v0
+		__m128 tX = _mm_sub_ps(originX, _mm_loadu_ps(packet.v0[0]));
+		__m128 tY = _mm_sub_ps(originY, _mm_loadu_ps(packet.v0[1]));
+		__m128 tZ = _mm_sub_ps(originZ, _mm_loadu_ps(packet.v0[2]));
+		__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tX, pX), _mm_mul_ps(tY, pY)), _mm_mul_ps(tZ, pZ)),
+			inverseDeterminant);
+
+		// q = t x edge1
+		__m128 qX = _mm_sub_ps(_mm_mul_ps(tY, edge1Z), _mm_mul_ps(tZ, edge1Y));
+		__m128 qY = _mm_sub_ps(_mm_mul_ps(tZ, edge1X), _mm_mul_ps(tX, edge1Z));
+		__m128 qZ = _mm_sub_ps(_mm_mul_ps(tX, edge1Y), _mm_mul_ps(tY, edge1X));
+		__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)),
+			_mm_mul_ps(directionZ, qZ)), inverseDeterminant);
+		__m128 hitDistance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)),
+			_mm_mul_ps(edge2Z, qZ)), inverseDeterminant);
+
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+		valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(hitDistance, zero));
+		valid = _mm_and_ps(valid, _mm_cmplt_ps(hitDistance, _mm_set1_ps(distance)));
+
+		int mask = _mm_movemask_ps(valid);
+		if (mask != 0)
+		{
+			float distances[4];
+			_mm_storeu_ps(distances, hitDistance);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (((mask >> lane) & 1) && (distances[lane] < distance))
+				{
+					distance = distances[lane];
+					triangle = (p - range.firstPacket) * 4 + lane;
+					bHit = true;
+				}
+			}
+		}
+	}
+#else
+	for (int p = range.firstPacket; p < range.firstPacket + range.packetCount; p++)
+	{
+		const TRIANGLE_PACKET& packet = m_packets[p];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			glm::vec3 v0(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+			glm::vec3 edge1(packet.edge1[0][lane], packet.edge1[1][lane], packet.edge1[2][lane]);
+			glm::vec3 edge2(packet.edge2[0][lane], packet.edge2[1][lane], packet.edge2[2][lane]);
+
+			glm::vec3 pVector = glm::cross(direction, edge2);
+			float determinant = glm::dot(edge1, pVector);
+			if (std::fabs(determinant) <= g_TriangleEpsilon)
+			{
+				continue;
+			}
+			float inverseDeterminant = 1.0f / determinant;
+
+			glm::vec3 tVector = origin - v0;
+			float u = glm::dot(tVector, pVector) * inverseDeterminant;
+			glm::vec3 qVector = glm::cross(tVector, edge1);
+			float v = glm::dot(direction, qVector) * inverseDeterminant;
+			float hitDistance = glm::dot(edge2, qVector) * inverseDeterminant;
+
+			if ((u >= 0.0f) && (v >= 0.0f) && (u + v <= 1.0f) && (hitDistance >= 0.0f) && (hitDistance < distance))
+			{
+				distance = hitDistance;
+				triangle = (p - range.firstPacket) * 4 + lane;
+				bHit = true;
+			}
+		}
+	}
+#endif
+
+	return(bHit);
+}
+
+/***********************************************************
+ *  FindNearest()
+ *
+ *  This method is used to find the object with the closest
+ *  bounds to a point.  Children are visited nearest first so
+ *  the search radius shrinks quickly.
+ ***********************************************************/
+int SpatialIndex::FindNearest(const glm::vec3& point, float maxDistance, float& distance) const
+{
+	if (m_nodes.empty())
+	{
+		return(-1);
+	}
+
+	float closest = maxDistance * maxDistance;
+	int closestObject = -1;
+
+	STACK_ENTRY stack[g_MaxStackDepth];
+	int stackSize = 0;
+	stack[stackSize].nodeIndex = 0;
+	stack[stackSize].distance = BoxDistanceSquared(m_nodes[0].boundsMin, m_nodes[0].boundsMax, point);
+	stackSize++;
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+		if (stack[stackSize].distance > closest)
+		{
+			continue;
+		}
+		const BVH_NODE& node = m_nodes[stack[stackSize].nodeIndex];
+
+		if (node.count > 0)
+		{
+			for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				float objectDistance = BoxDistanceSquared(m_boundsMin[i], m_boundsMax[i], point);
+				if (objectDistance <= closest)
+				{
+					closest = objectDistance;
+					closestObject = i;
+				}
+			}
+			continue;
+		}
+
+		int nearIndex = node.leftFirst;
+		int farIndex = node.leftFirst + 1;
+		float nearDistance = BoxDistanceSquared(m_nodes[nearIndex].boundsMin, m_nodes[nearIndex].boundsMax, point);
+		float farDistance = BoxDistanceSquared(m_nodes[farIndex].boundsMin, m_nodes[farIndex].boundsMax, point);
+		if (farDistance < nearDistance)
+		{
+			std::swap(nearIndex, farIndex);
+			std::swap(nearDistance, farDistance);
+		}
+		if (farDistance <= closest)
+		{
+			stack[stackSize].nodeIndex = farIndex;
+			stack[stackSize].distance = farDistance;
+			stackSize++;
+		}
+		if (nearDistance <= closest)
+		{
+			stack[stackSize].nodeIndex = nearIndex;
+			stack[stackSize].distance = nearDistance;
+			stackSize++;
+		}
+	}
+
+	if (closestObject < 0)
+	{
+		return(-1);
+	}
+
+	distance = std::sqrt(closest);
+
+	return(m_objectIDs[closestObject]);
+}
+
+/***********************************************************
+ *  QueryRadius()
+ *
+ *  This method is used to collect every object whose bounds
+ *  touch a sphere, in no particular order.
+ ***********************************************************/
+void SpatialIndex::QueryRadius(const glm::vec3& center, float radius, std::vector<int>& objects) const
+{
+	objects.clear();
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	float radiusSquared = radius * radius;
+	int stack[g_MaxStackDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const BVH_NODE& node = m_nodes[stack[--stackSize]];
+		if (BoxDistanceSquared(node.boundsMin, node.boundsMax, center) > radiusSquared)
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				if (BoxDistanceSquared(m_boundsMin[i], m_boundsMax[i], center) <= radiusSquared)
+				{
+					objects.push_back(m_objectIDs[i]);
+				}
+			}
+			continue;
+		}
+
+		stack[stackSize++] = node.leftFirst + 1;
+		stack[stackSize++] = node.leftFirst;
+	}
+}
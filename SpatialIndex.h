@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+// spatialindex.h
+// ============
+// bounding volume hierarchy for picking and spatial lookups
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  SpatialIndex
+ *
+ *  This class answers ray, nearest object and radius queries
+ *  over the world space bounds of many objects.  The bounds
+ *  are sorted into a binary hierarchy built with the surface
+ *  area heuristic over binned centroids, stored depth first
+ *  with the two children of a node next to each other.  Ray
+ *  tests against the boxes and against the triangles of a
+ *  mesh, four at a time, use SSE when it is available.
+ *
+ *  Objects can be given a mesh, in which case a ray has to
+ *  hit one of its triangles and not just its box.  Meshes are
+ *  shared between objects and kept in object space, and the
+ *  ray is moved into the space of each object it reaches.
+ ***********************************************************/
+class SpatialIndex
+{
+public:
+	// an object to index
+	struct SPATIAL_OBJECT
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		// mesh tested for exact hits, -1 to hit the bounds
+		int meshIndex;
+		// object to world transform of the mesh
+		glm::mat4 transform;
+	};
+
+	// closest object along a ray
+	struct RAY_HIT
+	{
+		// index of the object in the list given to Build()
+		int objectIndex;
+		float distance;
+		glm::vec3 point;
+		// unit surface normal, facing either way
+		glm::vec3 normal;
+	};
+
+	// constructor
+	SpatialIndex();
+
+	// add a triangle mesh objects can refer to, returns its
+	// index.  Meshes stay until Clear().
+	int AddMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+	// replace the indexed objects
+	void Build(const std::vector<SPATIAL_OBJECT>& objects);
+	// remove every object and mesh
+	void Clear();
+
+	// closest object hit by a ray within a distance, the
+	// direction must be normalized
+	bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RAY_HIT& hit) const;
+	// trace four rays together, such as those of neighboring
+	// pixels, visiting each node once for all of them.  Sets
+	// bHits for the rays that hit something.
+	void RaycastPacket(
+		const glm::vec3 origins[4],
+		const glm::vec3 directions[4],
+		float maxDistance,
+		RAY_HIT hits[4],
+		bool bHits[4]) const;
+	// object whose bounds are closest to a point, -1 if none
+	// is within the distance
+	int FindNearest(const glm::vec3& point, float maxDistance, float& distance) const;
+	// every object whose bounds touch a sphere
+	void QueryRadius(const glm::vec3& center, float radius, std::vector<int>& objects) const;
+
+	int GetObjectCount() const { return((int)m_objectIDs.size()); }
+	int GetNodeCount() const { return((int)m_nodes.size()); }
+
+private:
+	// node of the hierarchy, a leaf when count is not 0
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		// first child for inner nodes, first object for leaves
+		int leftFirst;
+		glm::vec3 boundsMax;
+		int count;
+	};
+
+	// four triangles stored by component, as the edges from
+	// their first corner
+	struct TRIANGLE_PACKET
+	{
+		float v0[3][4];
+		float edge1[3][4];
+		float edge2[3][4];
+	};
+
+	// range of packets of one mesh
+	struct MESH_RANGE
+	{
+		int firstPacket;
+		int packetCount;
+	};
+
+	std::vector<BVH_NODE> m_nodes;
+	// per object in leaf order
+	std::vector<glm::vec3> m_boundsMin;
+	std::vector<glm::vec3> m_boundsMax;
+	std::vector<int> m_objectIDs;
+	std::vector<int> m_meshIndices;
+	// world to object transforms, used by objects with a mesh
+	std::vector<glm::mat4> m_inverseTransforms;
+
+	std::vector<TRIANGLE_PACKET> m_packets;
+	std::vector<MESH_RANGE> m_meshes;
+
+	// split a node in place, returns false to keep it a leaf
+	bool SplitNode(int nodeIndex, std::vector<int>& order, const std::vector<glm::vec3>& centroids,
+		const std::vector<SPATIAL_OBJECT>& objects);
+	// closest hit of a ray with the triangles of a mesh
+	bool IntersectMesh(
+		int meshIndex,
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float& distance,
+		int& triangle) const;
+	// hit of a ray with an object whose bounds it enters at
+	// the given distance, closer than the passed in distance
+	bool IntersectObject(
+		int slot,
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float enterDistance,
+		float& distance,
+		glm::vec3& normal) const;
+};
@@ -0,0 +1,585 @@
+///////////////////////////////////////////////////////////////////////////////
+// statsoverlay.cpp
+// ============
+// draw the render stats over the top left corner of the window
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StatsOverlay.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// characters of the font, in the order of its glyphs;
+	// lowercase text is drawn in uppercase and any other
+	// character as a space
+	const char* g_FontCharacters = " 0123456789.:%/-()ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	const int g_GlyphCount = 45;
+	// glyphs are 5x7 pixels, each row a bit mask with the
+	// leftmost pixel in bit 4, listed from the top row down
+	const unsigned char g_FontGlyphs[g_GlyphCount][7] =
+	{
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// space
+		{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },	// 0
+		{ 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },	// 1
+		{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },	// 2
+		{ 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },	// 3
+		{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },	// 4
+		{ 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },	// 5
+		{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },	// 6
+		{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },	// 7
+		{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },	// 8
+		{ 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },	// 9
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },	// .
+		{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },	// :
+		{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },	// %
+		{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },	// /
+		{ 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },	// -
+		{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },	// (
+		{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },	// )
+		{ 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },	// A
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },	// B
+		{ 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },	// C
+		{ 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },	// D
+		{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },	// E
+		{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },	// F
+		{ 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },	// G
+		{ 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },	// H
+		{ 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },	// I
+		{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },	// J
+		{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },	// K
+		{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },	// L
+		{ 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },	// M
+		{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },	// N
+		{ 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// O
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },	// P
+		{ 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },	// Q
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },	// R
+		{ 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },	// S
+		{ 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// T
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// U
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },	// V
+		{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },	// W
+		{ 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },	// X
+		{ 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },	// Y
+		{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }	// Z
+	};
+	// every glyph sits in a cell with a column and a row of
+	// spacing, and one more cell of solid texels after the
+	// glyphs is used for the background
+	const int g_CellWidth = 6;
+	const int g_CellHeight = 8;
+	const int g_FontTextureWidth = (g_GlyphCount + 1) * g_CellWidth;
+	// screen pixels per font pixel
+	const float g_PixelScale = 2.0f;
+	// distance of the panel from the window corner, and of the
+	// text from the panel edge, in screen pixels
+	const float g_PanelMargin = 8.0f;
+	const float g_PanelPadding = 6.0f;
+	// floats per vertex: position, texture coordinate, color
+	const int g_VertexSize = 8;
+
+	// the overlay should never cost more than this per frame
+	const double g_BudgetMilliseconds = 0.1;
+	// weight of the newest sample in the smoothed overlay cost
+	const double g_CostSmoothing = 0.1;
+
+	const float g_BackgroundColor[4] = { 0.0f, 0.0f, 0.0f, 0.6f };
+	const float g_TextColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const float g_WarningColor[4] = { 1.0f, 0.4f, 0.3f, 1.0f };
+
+	// positions are in pixels from the top left corner of the
+	// window, which is where the panel is anchored
+	const char* g_OverlayVertexShader = R"(
+		#version 330 core
+		layout(location = 0) in vec2 position;
+		layout(location = 1) in vec2 texCoord;
+		layout(location = 2) in vec4 color;
+		out vec2 fragmentTexCoord;
+		out vec4 fragmentColor;
+
+		uniform vec2 viewportSize;
+
+		void main()
+		{
+			fragmentTexCoord = texCoord;
+			fragmentColor = color;
+			gl_Position = vec4(position.x / viewportSize.x * 2.0 - 1.0, 1.0 - position.y / viewportSize.y * 2.0, 0.0, 1.0);
+		}
+	)";
+
+	// the font texture only holds coverage, the color comes
+	// from the vertices
+	const char* g_OverlayFragmentShader = R"(
+		#version 330 core
+		in vec2 fragmentTexCoord;
+		in vec4 fragmentColor;
+		out vec4 outputColor;
+
+		uniform sampler2D fontTexture;
+
+		void main()
+		{
+			outputColor = vec4(fragmentColor.rgb, fragmentColor.a * texture(fontTexture, fragmentTexCoord).r);
+		}
+	)";
+
+	/***********************************************************
+	 *  CompileShaderStage()
+	 *
+	 *  Compile a single shader stage, printing the info log
+	 *  when compilation fails.
+	 ***********************************************************/
+	GLuint CompileShaderStage(GLenum stage, const char* source)
+	{
+		GLint success = 0;
+		GLuint shaderID = glCreateShader(stage);
+
+		glShaderSource(shaderID, 1, &source, NULL);
+		glCompileShader(shaderID);
+		glGetShaderiv(shaderID, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[1024];
+			glGetShaderInfoLog(shaderID, sizeof(infoLog), NULL, infoLog);
+			std::cout << "ERROR: stats overlay shader compilation failed\n" << infoLog << std::endl;
+			glDeleteShader(shaderID);
+			return 0;
+		}
+
+		return(shaderID);
+	}
+
+	/***********************************************************
+	 *  FindGlyph()
+	 *
+	 *  Find the glyph drawn for a character.
+	 ***********************************************************/
+	int FindGlyph(char c)
+	{
+		const char* pFound = std::strchr(g_FontCharacters, std::toupper((unsigned char)c));
+
+		if ((c == '\0') || (pFound == NULL))
+		{
+			return(0);
+		}
+
+		return((int)(pFound - g_FontCharacters));
+	}
+}
+
+/***********************************************************
+ *  StatsOverlay()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StatsOverlay::StatsOverlay()
+{
+	m_viewportSizeLocation = -1;
+	m_fontTextureLocation = -1;
+	m_vertexCount = 0;
+	m_builtVersion = -1;
+	for (int i = 0; i < TIMER_QUERY_COUNT; i++)
+	{
+		m_timerQueryIDs[i][0] = 0;
+		m_timerQueryIDs[i][1] = 0;
+		m_timerQueryPending[i] = false;
+	}
+	m_timerQueryIndex = 0;
+	m_cpuMilliseconds = 0.0;
+	m_gpuMilliseconds = -1.0;
+	m_bBudgetWarned = false;
+	m_bCreateFailed = false;
+}
+
+/***********************************************************
+ *  ~StatsOverlay()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StatsOverlay::~StatsOverlay()
+{
+	DestroyResources();
+}
+
+/***********************************************************
+ *  CreateResources()
+ *
+ *  This method is used to create the font texture, the
+ *  program and the vertex buffer of the panel.
+ ***********************************************************/
+bool StatsOverlay::CreateResources()
+{
+	GLint success = 0;
+	GLuint vertexShaderID = CompileShaderStage(GL_VERTEX_SHADER, g_OverlayVertexShader);
+	GLuint fragmentShaderID = CompileShaderStage(GL_FRAGMENT_SHADER, g_OverlayFragmentShader);
+
+	if ((vertexShaderID == 0) || (fragmentShaderID == 0))
+	{
+		glDeleteShader(vertexShaderID);
+		glDeleteShader(fragmentShaderID);
+		return false;
+	}
+
+	GLuint programID = m_program.Create("stats overlay");
+	glAttachShader(programID, vertexShaderID);
+	glAttachShader(programID, fragmentShaderID);
+	glLinkProgram(programID);
+	glDeleteShader(vertexShaderID);
+	glDeleteShader(fragmentShaderID);
+
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR: stats overlay program link failed\n" << infoLog << std::endl;
+		m_program.Reset();
+		return false;
+	}
+	m_program.SetBytes(GpuResourceRegistry::EstimateProgramBytes(programID));
+
+	m_viewportSizeLocation = glGetUniformLocation(programID, "viewportSize");
+	m_fontTextureLocation = glGetUniformLocation(programID, "fontTexture");
+
+	// texture rows run bottom up, so the top row of a glyph
+	// lands in the top row of its cell and the bottom row of
+	// every cell is left empty as line spacing
+	std::vector<unsigned char> texels(g_FontTextureWidth * g_CellHeight, 0);
+	for (int glyph = 0; glyph < g_GlyphCount; glyph++)
+	{
+		for (int row = 0; row < 7; row++)
+		{
+			for (int column = 0; column < 5; column++)
+			{
+				if (g_FontGlyphs[glyph][row] & (0x10 >> column))
+				{
+					texels[(g_CellHeight - 1 - row) * g_FontTextureWidth + glyph * g_CellWidth + column] = 255;
+				}
+			}
+		}
+	}
+	for (int row = 0; row < g_CellHeight; row++)
+	{
+		for (int column = 0; column < g_CellWidth; column++)
+		{
+			texels[row * g_FontTextureWidth + g_GlyphCount * g_CellWidth + column] = 255;
+		}
+	}
+
+	GLint previousAlignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glBindTexture(GL_TEXTURE_2D, m_fontTexture.Create("stats overlay font"));
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, g_FontTextureWidth, g_CellHeight, 0, GL_RED, GL_UNSIGNED_BYTE, &texels[0]);
+	m_fontTexture.SetBytes(GpuResourceRegistry::EstimateTextureBytes(g_FontTextureWidth, g_CellHeight, 1, 1));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+
+	glBindVertexArray(m_vertexArray.Create("stats overlay"));
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer.Create("stats overlay vertices"));
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, g_VertexSize * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, g_VertexSize * sizeof(float), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, g_VertexSize * sizeof(float), (void*)(4 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	for (int i = 0; i < TIMER_QUERY_COUNT; i++)
+	{
+		glGenQueries(2, m_timerQueryIDs[i]);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  DestroyResources()
+ *
+ *  This method is used to free the GL objects owned by the
+ *  overlay.
+ ***********************************************************/
+void StatsOverlay::DestroyResources()
+{
+	if (m_vertexArray.Get() != 0)
+	{
+		for (int i = 0; i < TIMER_QUERY_COUNT; i++)
+		{
+			glDeleteQueries(2, m_timerQueryIDs[i]);
+		}
+	}
+	m_vertexArray.Reset();
+	m_vertexBuffer.Reset();
+	m_fontTexture.Reset();
+	m_program.Reset();
+}
+
+/***********************************************************
+ *  AddQuad()
+ *
+ *  This method is used to add the two triangles of a
+ *  rectangle to the panel.
+ ***********************************************************/
+void StatsOverlay::AddQuad(
+	float x0, float y0, float x1, float y1,
+	float u0, float v0, float u1, float v1,
+	const float color[4])
+{
+	const float corners[6][4] =
+	{
+		{ x0, y0, u0, v0 }, { x0, y1, u0, v1 }, { x1, y1, u1, v1 },
+		{ x0, y0, u0, v0 }, { x1, y1, u1, v1 }, { x1, y0, u1, v0 }
+	};
+
+	for (int i = 0; i < 6; i++)
+	{
+		m_vertices.insert(m_vertices.end(), corners[i], corners[i] + 4);
+		m_vertices.insert(m_vertices.end(), color, color + 4);
+	}
+}
+
+/***********************************************************
+ *  AddText()
+ *
+ *  This method is used to add a line of text to the panel,
+ *  with its top left corner at the given pixel position.
+ *  Spaces take up room but add no triangles.
+ ***********************************************************/
+void StatsOverlay::AddText(const char* text, float x, float y, const float color[4])
+{
+	float cellWidth = g_CellWidth * g_PixelScale;
+	float cellHeight = g_CellHeight * g_PixelScale;
+
+	for (int i = 0; text[i] != '\0'; i++)
+	{
+		int glyph = FindGlyph(text[i]);
+		if (glyph != 0)
+		{
+			float u0 = (float)(glyph * g_CellWidth) / (float)g_FontTextureWidth;
+			float u1 = (float)((glyph + 1) * g_CellWidth) / (float)g_FontTextureWidth;
+			AddQuad(x, y, x + cellWidth, y + cellHeight, u0, 1.0f, u1, 0.0f, color);
+		}
+		x += cellWidth;
+	}
+}
+
+/***********************************************************
+ *  BuildVertices()
+ *
+ *  This method is used to lay out the panel for the latest
+ *  averages: a translucent background followed by one line
+ *  per group of counters.
+ ***********************************************************/
+void StatsOverlay::BuildVertices(const RenderStats& stats)
+{
+	const RenderStats::FRAME_STATS& average = stats.GetAverage();
+	const int lineCount = 8;
+	char lines[lineCount][80];
+
+	snprintf(lines[0], sizeof(lines[0]), "FRAME %.2f MS  SUBMIT %.2f MS",
+		average.frameMilliseconds, average.submitMilliseconds);
+	snprintf(lines[1], sizeof(lines[1]), "DRAWS %llu  TRIANGLES %llu",
+		(unsigned long long)average.counters[RenderStats::COUNTER_DRAW_CALLS],
+		(unsigned long long)average.counters[RenderStats::COUNTER_TRIANGLES]);
+	snprintf(lines[2], sizeof(lines[2]), "TEXTURE BINDS %llu  UNIFORMS %llu",
+		(unsigned long long)average.counters[RenderStats::COUNTER_TEXTURE_BINDS],
+		(unsigned long long)average.counters[RenderStats::COUNTER_UNIFORM_UPLOADS]);
+	snprintf(lines[3], sizeof(lines[3]), "STATE CHANGES %llu  UPLOADS %.1f KB",
+		(unsigned long long)average.counters[RenderStats::COUNTER_STATE_CHANGES],
+		(double)average.counters[RenderStats::COUNTER_UPLOAD_BYTES] / 1024.0);
+	if (average.gpuMemoryUsedMB >= 0)
+	{
+		snprintf(lines[4], sizeof(lines[4]), "GPU MEMORY %d MB USED  %d MB FREE",
+			average.gpuMemoryUsedMB, average.gpuMemoryFreeMB);
+	}
+	else if (average.gpuMemoryFreeMB >= 0)
+	{
+		snprintf(lines[4], sizeof(lines[4]), "GPU MEMORY %d MB FREE", average.gpuMemoryFreeMB);
+	}
+	else
+	{
+		snprintf(lines[4], sizeof(lines[4]), "GPU MEMORY N/A");
+	}
+	snprintf(lines[5], sizeof(lines[5]), "TRACKED %.1f MB  PEAK %.1f MB  OBJECTS %d",
+		(double)average.trackedGpuBytes / (1024.0 * 1024.0),
+		(double)GpuResourceRegistry::GetPeakBytes() / (1024.0 * 1024.0), GpuResourceRegistry::GetResourceCount());
+	snprintf(lines[6], sizeof(lines[6]), "VIEWS %d  SHARED %.2f MS  VIEW %.2f MS  EXTRA %.2f MS",
+		average.viewCount, average.sharedMilliseconds, average.firstViewMilliseconds, average.extraViewMilliseconds);
+	if (m_gpuMilliseconds >= 0.0)
+	{
+		snprintf(lines[7], sizeof(lines[7]), "OVERLAY CPU %.3f MS  GPU %.3f MS", m_cpuMilliseconds, m_gpuMilliseconds);
+	}
+	else
+	{
+		snprintf(lines[7], sizeof(lines[7]), "OVERLAY CPU %.3f MS  GPU -", m_cpuMilliseconds);
+	}
+
+	size_t longestLine = 0;
+	for (int i = 0; i < lineCount; i++)
+	{
+		longestLine = (std::strlen(lines[i]) > longestLine) ? std::strlen(lines[i]) : longestLine;
+	}
+
+	float cellWidth = g_CellWidth * g_PixelScale;
+	float cellHeight = g_CellHeight * g_PixelScale;
+	// the background samples the middle of the solid cell
+	float solidU = (g_GlyphCount * g_CellWidth + 0.5f * g_CellWidth) / (float)g_FontTextureWidth;
+
+	m_vertices.clear();
+	AddQuad(g_PanelMargin, g_PanelMargin,
+		g_PanelMargin + 2.0f * g_PanelPadding + longestLine * cellWidth,
+		g_PanelMargin + 2.0f * g_PanelPadding + lineCount * cellHeight,
+		solidU, 0.5f, solidU, 0.5f, g_BackgroundColor);
+
+	bool bOverBudget = (m_cpuMilliseconds > g_BudgetMilliseconds) || (m_gpuMilliseconds > g_BudgetMilliseconds);
+	for (int i = 0; i < lineCount; i++)
+	{
+		AddText(lines[i], g_PanelMargin + g_PanelPadding, g_PanelMargin + g_PanelPadding + i * cellHeight,
+			((i == lineCount - 1) && bOverBudget) ? g_WarningColor : g_TextColor);
+	}
+
+	m_vertexCount = (int)(m_vertices.size() / g_VertexSize);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer.Get());
+	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float), &m_vertices[0], GL_DYNAMIC_DRAW);
+	m_vertexBuffer.SetBytes(m_vertices.size() * sizeof(float));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_builtVersion = stats.GetAverageVersion();
+}
+
+/***********************************************************
+ *  CollectGpuTime()
+ *
+ *  This method is used to read back the timestamps of the
+ *  oldest overlay draw if the GPU has finished it.
+ ***********************************************************/
+void StatsOverlay::CollectGpuTime()
+{
+	// the queries about to be reused are the oldest ones
+	int index = m_timerQueryIndex;
+	GLint bAvailable = 0;
+	GLuint64 startNanoseconds = 0;
+	GLuint64 endNanoseconds = 0;
+
+	if (m_timerQueryPending[index] == false)
+	{
+		return;
+	}
+
+	glGetQueryObjectiv(m_timerQueryIDs[index][1], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+	if (!bAvailable)
+	{
+		return;
+	}
+
+	glGetQueryObjectui64v(m_timerQueryIDs[index][0], GL_QUERY_RESULT, &startNanoseconds);
+	glGetQueryObjectui64v(m_timerQueryIDs[index][1], GL_QUERY_RESULT, &endNanoseconds);
+	m_timerQueryPending[index] = false;
+
+	double milliseconds = (double)(endNanoseconds - startNanoseconds) / 1000000.0;
+	m_gpuMilliseconds = (m_gpuMilliseconds < 0.0) ? milliseconds :
+		m_gpuMilliseconds + (milliseconds - m_gpuMilliseconds) * g_CostSmoothing;
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used to draw the panel over the finished
+ *  frame.  Only the default framebuffer is touched, and the
+ *  program, texture and blend state the scene rendering
+ *  expects are put back afterwards.
+ ***********************************************************/
+void StatsOverlay::Draw(const RenderStats& stats, int width, int height)
+{
+	// the GL objects can only be created once a context exists
+	if ((m_program.Get() == 0) && (m_bCreateFailed == false))
+	{
+		m_bCreateFailed = (CreateResources() == false);
+	}
+	if ((m_program.Get() == 0) || (width <= 0) || (height <= 0))
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	CollectGpuTime();
+	glQueryCounter(m_timerQueryIDs[m_timerQueryIndex][0], GL_TIMESTAMP);
+
+	if (m_builtVersion != stats.GetAverageVersion())
+	{
+		BuildVertices(stats);
+	}
+
+	GLboolean bDepthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean bBlend = glIsEnabled(GL_BLEND);
+	GLint previousProgram = 0;
+	GLint previousActiveTexture = 0;
+	GLint previousTexture = 0;
+	GLint previousBlendSource = GL_ONE;
+	GLint previousBlendDestination = GL_ZERO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &previousActiveTexture);
+	glGetIntegerv(GL_BLEND_SRC_RGB, &previousBlendSource);
+	glGetIntegerv(GL_BLEND_DST_RGB, &previousBlendDestination);
+	glActiveTexture(GL_TEXTURE0);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glUseProgram(m_program.Get());
+	glBindTexture(GL_TEXTURE_2D, m_fontTexture.Get());
+	glUniform1i(m_fontTextureLocation, 0);
+	glUniform2f(m_viewportSizeLocation, (float)width, (float)height);
+
+	glBindVertexArray(m_vertexArray.Get());
+	glDrawArrays(GL_TRIANGLES, 0, m_vertexCount);
+	glBindVertexArray(0);
+
+	glUseProgram(previousProgram);
+	glBindTexture(GL_TEXTURE_2D, previousTexture);
+	glActiveTexture(previousActiveTexture);
+	glBlendFunc(previousBlendSource, previousBlendDestination);
+	if (bDepthTest)
+	{
+		glEnable(GL_DEPTH_TEST);
+	}
+	if (bBlend == GL_FALSE)
+	{
+		glDisable(GL_BLEND);
+	}
+
+	glQueryCounter(m_timerQueryIDs[m_timerQueryIndex][1], GL_TIMESTAMP);
+	m_timerQueryPending[m_timerQueryIndex] = true;
+	m_timerQueryIndex = (m_timerQueryIndex + 1) % TIMER_QUERY_COUNT;
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	m_cpuMilliseconds += (milliseconds - m_cpuMilliseconds) * g_CostSmoothing;
+
+	// the smoothed costs start from zero, so the budget is only
+	// checked once they have settled
+	if ((m_bBudgetWarned == false) && (stats.GetAverageVersion() > 2) &&
+		((m_cpuMilliseconds > g_BudgetMilliseconds) || (m_gpuMilliseconds > g_BudgetMilliseconds)))
+	{
+		std::cout << "WARNING: stats overlay costs " << m_cpuMilliseconds << " ms CPU and "
+			<< m_gpuMilliseconds << " ms GPU per frame, over its " << g_BudgetMilliseconds << " ms budget" << std::endl;
+		m_bBudgetWarned = true;
+	}
+}
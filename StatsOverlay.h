@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// statsoverlay.h
+// ============
+// draw the render stats over the top left corner of the window
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GpuResources.h"
+#include "RenderStats.h"
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  StatsOverlay
+ *
+ *  This class draws the averaged render stats as text over
+ *  the finished frame.  The glyphs come from a small bitmap
+ *  font built into the class, and the whole panel, its
+ *  background included, is one vertex buffer drawn with a
+ *  single call.  The vertices are only rebuilt when the
+ *  averages change, so most frames just replay the buffer.
+ *  The overlay times itself on the CPU and the GPU and shows
+ *  the result with the rest, and its own GL calls are left
+ *  out of the counters.  The GL objects are created on the
+ *  first Draw(), so a hidden overlay costs nothing.
+ ***********************************************************/
+class StatsOverlay
+{
+public:
+	// constructor
+	StatsOverlay();
+	// destructor
+	~StatsOverlay();
+
+	// draw the stats into the default framebuffer of the given
+	// size, leaving the GL state as it was
+	void Draw(const RenderStats& stats, int width, int height);
+
+private:
+	// number of timestamp query pairs kept in flight so that
+	// reading back a result never stalls on the GPU
+	static const int TIMER_QUERY_COUNT = 4;
+
+	// font texture and the program drawing the panel
+	GLTexture m_fontTexture;
+	GLProgram m_program;
+	GLint m_viewportSizeLocation;
+	GLint m_fontTextureLocation;
+	GLVertexArray m_vertexArray;
+	GLBuffer m_vertexBuffer;
+	// vertices of the panel, kept to refill the buffer
+	std::vector<float> m_vertices;
+	int m_vertexCount;
+	// averages the vertices were built from
+	int m_builtVersion;
+
+	// timestamps taken around the overlay draw
+	GLuint m_timerQueryIDs[TIMER_QUERY_COUNT][2];
+	bool m_timerQueryPending[TIMER_QUERY_COUNT];
+	int m_timerQueryIndex;
+	// smoothed cost of the overlay in milliseconds
+	double m_cpuMilliseconds;
+	double m_gpuMilliseconds;
+	bool m_bBudgetWarned;
+	// set when the GL objects could not be created
+	bool m_bCreateFailed;
+
+	// create the GL objects used by the overlay
+	bool CreateResources();
+	// release the GL objects used by the overlay
+	void DestroyResources();
+	// rebuild the panel from the averaged stats
+	void BuildVertices(const RenderStats& stats);
+	// add a line of text at a position in pixels
+	void AddText(const char* text, float x, float y, const float color[4]);
+	// add a rectangle in pixels with its texture coordinates
+	void AddQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, const float color[4]);
+	// read back any finished timestamp queries
+	void CollectGpuTime();
+};
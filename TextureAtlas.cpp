@@ -0,0 +1,586 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.cpp
+// ============
+// pack the small scene textures into shared pages
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureAtlas.h"
+#include "GpuResources.h"
+
+#include <algorithm>
+#include <cmath>
+#include <regex>
+
+// declaration of global variables
+namespace
+{
+	// the atlas function added to the scene fragment shader,
+	// after ATLAS_ENTRY is defined to the entry of the draw
+	const char* g_AtlasFunctionSource = R"(
+uniform vec4 atlasRects[ATLAS_MAX_ENTRIES];
+
+vec4 atlasTexture(sampler2D atlasSampler, vec2 uv)
+{
+	int entry = ATLAS_ENTRY;
+	if (entry <= 0)
+	{
+		return texture(atlasSampler, uv);
+	}
+
+	// the gradients come from the coordinates before they are
+	// wrapped, so the wrap doesn't pick a tiny mip level
+	vec4 rect = atlasRects[entry];
+	return textureGrad(atlasSampler, rect.xy + fract(uv) * rect.zw, dFdx(uv) * rect.zw, dFdy(uv) * rect.zw);
+}
+)";
+
+	/***********************************************************
+	 *  RoundUp()
+	 *
+	 *  Round a size up to a multiple of another.
+	 ***********************************************************/
+	int RoundUp(int value, int multiple)
+	{
+		return(((value + multiple - 1) / multiple) * multiple);
+	}
+
+	/***********************************************************
+	 *  ResampleImage()
+	 *
+	 *  Stretch an RGBA image to another size with bilinear
+	 *  filtering, wrapping at the edges like the shader does.
+	 ***********************************************************/
+	void ResampleImage(
+		const std::vector<unsigned char>& source,
+		int sourceWidth,
+		int sourceHeight,
+		std::vector<unsigned char>& target,
+		int targetWidth,
+		int targetHeight)
+	{
+		target.resize((size_t)targetWidth * targetHeight * 4);
+
+		for (int y = 0; y < targetHeight; y++)
+		{
+			float sy = ((float)y + 0.5f) * sourceHeight / targetHeight - 0.5f;
+			int y0 = (int)std::floor(sy);
+			float fy = sy - (float)y0;
+			int row0 = ((y0 % sourceHeight) + sourceHeight) % sourceHeight;
+			int row1 = (row0 + 1) % sourceHeight;
+
+			for (int x = 0; x < targetWidth; x++)
+			{
+				float sx = ((float)x + 0.5f) * sourceWidth / targetWidth - 0.5f;
+				int x0 = (int)std::floor(sx);
+				float fx = sx - (float)x0;
+				int column0 = ((x0 % sourceWidth) + sourceWidth) % sourceWidth;
+				int column1 = (column0 + 1) % sourceWidth;
+
+				for (int c = 0; c < 4; c++)
+				{
+					float top = source[((size_t)row0 * sourceWidth + column0) * 4 + c] * (1.0f - fx) +
+						source[((size_t)row0 * sourceWidth + column1) * 4 + c] * fx;
+					float bottom = source[((size_t)row1 * sourceWidth + column0) * 4 + c] * (1.0f - fx) +
+						source[((size_t)row1 * sourceWidth + column1) * 4 + c] * fx;
+					target[((size_t)y * targetWidth + x) * 4 + c] =
+						(unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  HalveImage()
+	 *
+	 *  Average 2 by 2 blocks of an RGBA image with even sides
+	 *  into the next mip level.
+	 ***********************************************************/
+	void HalveImage(
+		const std::vector<unsigned char>& source,
+		int sourceWidth,
+		int sourceHeight,
+		std::vector<unsigned char>& target)
+	{
+		int width = sourceWidth / 2;
+		int height = sourceHeight / 2;
+		target.resize((size_t)width * height * 4);
+
+		for (int y = 0; y < height; y++)
+		{
+			const unsigned char* pRow0 = &source[(size_t)(y * 2) * sourceWidth * 4];
+			const unsigned char* pRow1 = pRow0 + (size_t)sourceWidth * 4;
+			for (int x = 0; x < width; x++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = pRow0[x * 8 + c] + pRow0[x * 8 + 4 + c] + pRow1[x * 8 + c] + pRow1[x * 8 + 4 + c];
+					target[((size_t)y * width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  TextureAtlas()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureAtlas::TextureAtlas()
+{
+	// entry 0 is never packed and covers a whole texture
+	ATLAS_ENTRY unpacked;
+	unpacked.page = -1;
+	unpacked.slot = -1;
+	unpacked.rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	unpacked.averageColor = glm::vec3(1.0f);
+	m_entries.push_back(unpacked);
+}
+
+/***********************************************************
+ *  ~TextureAtlas()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureAtlas::~TextureAtlas()
+{
+}
+
+/***********************************************************
+ *  IsPackable()
+ *
+ *  This method is used to decide whether an image is small
+ *  enough to share a page.
+ ***********************************************************/
+bool TextureAtlas::IsPackable(int width, int height)
+{
+	return((width > 0) && (height > 0) && (width <= MAX_PACKED_SIZE) && (height <= MAX_PACKED_SIZE));
+}
+
+/***********************************************************
+ *  AddImage()
+ *
+ *  This method is used to keep an image until Build().  It
+ *  is converted to RGBA and, when its sides aren't whole
+ *  gutters, stretched to the next size that is.
+ ***********************************************************/
+int TextureAtlas::AddImage(
+	const std::string& tag,
+	const unsigned char* pPixels,
+	int width,
+	int height,
+	int channels)
+{
+	if ((GetEntryCount() >= MAX_ENTRIES) || (IsPackable(width, height) == false) ||
+		((channels != 3) && (channels != 4)))
+	{
+		return(0);
+	}
+
+	std::vector<unsigned char> pixels((size_t)width * height * 4);
+	double colorSum[3] = { 0.0, 0.0, 0.0 };
+	for (int i = 0; i < width * height; i++)
+	{
+		pixels[i * 4 + 0] = pPixels[i * channels + 0];
+		pixels[i * 4 + 1] = pPixels[i * channels + 1];
+		pixels[i * 4 + 2] = pPixels[i * channels + 2];
+		pixels[i * 4 + 3] = (channels == 4) ? pPixels[i * channels + 3] : 255;
+		colorSum[0] += pixels[i * 4 + 0];
+		colorSum[1] += pixels[i * 4 + 1];
+		colorSum[2] += pixels[i * 4 + 2];
+	}
+
+	ATLAS_ENTRY entry;
+	entry.tag = tag;
+	entry.page = -1;
+	entry.slot = -1;
+	entry.rect = glm::vec4(0.0f);
+	double texelCount = 255.0 * width * height;
+	entry.averageColor = glm::vec3(
+		(float)(colorSum[0] / texelCount),
+		(float)(colorSum[1] / texelCount),
+		(float)(colorSum[2] / texelCount));
+	m_entries.push_back(entry);
+
+	PENDING_IMAGE image;
+	image.entry = GetEntryCount() - 1;
+	image.width = RoundUp(width, GUTTER_SIZE);
+	image.height = RoundUp(height, GUTTER_SIZE);
+	image.cellX = 0;
+	image.cellY = 0;
+	if ((image.width != width) || (image.height != height))
+	{
+		ResampleImage(pixels, width, height, image.pixels, image.width, image.height);
+	}
+	else
+	{
+		image.pixels.swap(pixels);
+	}
+	m_pendingImages.push_back(image);
+
+	return(image.entry);
+}
+
+/***********************************************************
+ *  FindPosition()
+ *
+ *  This method is used to find the lowest spot on the
+ *  skyline of a page where a cell fits, the leftmost of
+ *  equally low ones.  A cell placed at a segment rests on
+ *  the highest of the segments below it.
+ ***********************************************************/
+bool TextureAtlas::FindPosition(
+	const ATLAS_PAGE& page,
+	int width,
+	int height,
+	int& x,
+	int& y,
+	int& segment) const
+{
+	int bestY = MAX_PAGE_SIZE + 1;
+
+	for (int i = 0; i < (int)page.skyline.size(); i++)
+	{
+		int left = page.skyline[i].x;
+		if (left + width > MAX_PAGE_SIZE)
+		{
+			break;
+		}
+
+		int top = 0;
+		int covered = 0;
+		for (int j = i; covered < width; j++)
+		{
+			top = std::max(top, page.skyline[j].y);
+			covered += page.skyline[j].width;
+		}
+
+		if ((top + height <= MAX_PAGE_SIZE) && (top < bestY))
+		{
+			bestY = top;
+			x = left;
+			y = top;
+			segment = i;
+		}
+	}
+
+	return(bestY <= MAX_PAGE_SIZE);
+}
+
+/***********************************************************
+ *  PlaceCell()
+ *
+ *  This method is used to raise the skyline over a cell.
+ *  The segments it covers are cut back or removed, and
+ *  neighbors left at the same height are merged.
+ ***********************************************************/
+void TextureAtlas::PlaceCell(ATLAS_PAGE& page, int segment, int x, int y, int width, int height)
+{
+	SKYLINE_SEGMENT top;
+	top.x = x;
+	top.y = y + height;
+	top.width = width;
+	page.skyline.insert(page.skyline.begin() + segment, top);
+
+	int right = x + width;
+	int i = segment + 1;
+	while ((i < (int)page.skyline.size()) && (page.skyline[i].x < right))
+	{
+		int overlap = right - page.skyline[i].x;
+		if (overlap >= page.skyline[i].width)
+		{
+			page.skyline.erase(page.skyline.begin() + i);
+		}
+		else
+		{
+			page.skyline[i].x += overlap;
+			page.skyline[i].width -= overlap;
+			break;
+		}
+	}
+
+	for (i = 0; i + 1 < (int)page.skyline.size(); )
+	{
+		if (page.skyline[i].y == page.skyline[i + 1].y)
+		{
+			page.skyline[i].width += page.skyline[i + 1].width;
+			page.skyline.erase(page.skyline.begin() + i + 1);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	page.width = std::max(page.width, right);
+	page.height = std::max(page.height, y + height);
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used to pack the added images, tallest
+ *  first, into as few pages as they fit.  Every cell is the
+ *  image with its gutter on each side, and since all sides
+ *  are whole gutters, every cell starts on a texel of the
+ *  smallest level.  Pages are cut down to the area in use.
+ ***********************************************************/
+void TextureAtlas::Build()
+{
+	std::vector<int> order(m_pendingImages.size());
+	for (int i = 0; i < (int)order.size(); i++)
+	{
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b)
+		{
+			if (m_pendingImages[a].height != m_pendingImages[b].height)
+			{
+				return(m_pendingImages[a].height > m_pendingImages[b].height);
+			}
+			return(m_pendingImages[a].width > m_pendingImages[b].width);
+		});
+
+	std::vector<int> imagePages(m_pendingImages.size(), -1);
+	for (int i = 0; i < (int)order.size(); i++)
+	{
+		PENDING_IMAGE& image = m_pendingImages[order[i]];
+		int cellWidth = image.width + GUTTER_SIZE * 2;
+		int cellHeight = image.height + GUTTER_SIZE * 2;
+		int x = 0;
+		int y = 0;
+		int segment = 0;
+		int page = 0;
+
+		while ((page < (int)m_pages.size()) &&
+			(FindPosition(m_pages[page], cellWidth, cellHeight, x, y, segment) == false))
+		{
+			page++;
+		}
+		if (page == (int)m_pages.size())
+		{
+			ATLAS_PAGE newPage;
+			SKYLINE_SEGMENT ground;
+			ground.x = 0;
+			ground.y = 0;
+			ground.width = MAX_PAGE_SIZE;
+			newPage.skyline.push_back(ground);
+			newPage.width = 0;
+			newPage.height = 0;
+			m_pages.push_back(newPage);
+			FindPosition(m_pages[page], cellWidth, cellHeight, x, y, segment);
+		}
+
+		PlaceCell(m_pages[page], segment, x, y, cellWidth, cellHeight);
+		image.cellX = x;
+		image.cellY = y;
+		imagePages[order[i]] = page;
+	}
+
+	for (int p = 0; p < (int)m_pages.size(); p++)
+	{
+		ATLAS_PAGE& page = m_pages[p];
+		page.skyline.clear();
+		page.levels.resize(PAGE_LEVEL_COUNT);
+		for (int level = 0; level < PAGE_LEVEL_COUNT; level++)
+		{
+			page.levels[level].assign((size_t)(page.width >> level) * (page.height >> level) * 4, 0);
+		}
+	}
+
+	for (int i = 0; i < (int)m_pendingImages.size(); i++)
+	{
+		const PENDING_IMAGE& image = m_pendingImages[i];
+		ATLAS_PAGE& page = m_pages[imagePages[i]];
+		ATLAS_ENTRY& entry = m_entries[image.entry];
+
+		entry.page = imagePages[i];
+		entry.rect = glm::vec4(
+			(float)(image.cellX + GUTTER_SIZE) / page.width,
+			(float)(image.cellY + GUTTER_SIZE) / page.height,
+			(float)image.width / page.width,
+			(float)image.height / page.height);
+		WriteImageLevels(page, image);
+	}
+
+	m_pendingImages.clear();
+}
+
+/***********************************************************
+ *  WriteImageLevels()
+ *
+ *  This method is used to write an image into every level of
+ *  its page.  Each level is halved from the one before, and
+ *  its gutter, halved as well, repeats the image wrapped
+ *  around so both bilinear and trilinear filtering find the
+ *  same texels they would in a texture of its own.
+ ***********************************************************/
+void TextureAtlas::WriteImageLevels(ATLAS_PAGE& page, const PENDING_IMAGE& image)
+{
+	std::vector<unsigned char> level = image.pixels;
+	std::vector<unsigned char> halved;
+
+	for (int l = 0; l < PAGE_LEVEL_COUNT; l++)
+	{
+		if (l > 0)
+		{
+			HalveImage(level, image.width >> (l - 1), image.height >> (l - 1), halved);
+			level.swap(halved);
+		}
+
+		int width = image.width >> l;
+		int height = image.height >> l;
+		int gutter = GUTTER_SIZE >> l;
+		int pageWidth = page.width >> l;
+		int cellX = image.cellX >> l;
+		int cellY = image.cellY >> l;
+		std::vector<unsigned char>& target = page.levels[l];
+
+		for (int y = -gutter; y < height + gutter; y++)
+		{
+			int row = ((y % height) + height) % height;
+			unsigned char* pTarget = &target[((size_t)(cellY + gutter + y) * pageWidth + cellX) * 4];
+			for (int x = -gutter; x < width + gutter; x++)
+			{
+				int column = ((x % width) + width) % width;
+				const unsigned char* pSource = &level[((size_t)row * width + column) * 4];
+				unsigned char* pTexel = pTarget + (size_t)(gutter + x) * 4;
+				pTexel[0] = pSource[0];
+				pTexel[1] = pSource[1];
+				pTexel[2] = pSource[2];
+				pTexel[3] = pSource[3];
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  CreatePageTexture()
+ *
+ *  This method is used to upload a built page with its
+ *  levels.  Unlike the scene textures, pages are sampled
+ *  with mipmaps, since their levels were built to keep the
+ *  packed images apart.
+ ***********************************************************/
+GLuint TextureAtlas::CreatePageTexture(int page)
+{
+	ATLAS_PAGE& atlasPage = m_pages[page];
+	GLuint textureID = 0;
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (int level = 0; level < PAGE_LEVEL_COUNT; level++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, atlasPage.width >> level, atlasPage.height >> level, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, atlasPage.levels[level].data());
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, PAGE_LEVEL_COUNT - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	std::vector<std::vector<unsigned char> >().swap(atlasPage.levels);
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  GetPageBytes()
+ *
+ *  This method is used to estimate the memory of the texture
+ *  of a page, which keeps its size after the pixels are
+ *  freed.
+ ***********************************************************/
+size_t TextureAtlas::GetPageBytes(int page) const
+{
+	return(GpuResourceRegistry::EstimateTextureBytes(m_pages[page].width, m_pages[page].height, 4, PAGE_LEVEL_COUNT));
+}
+
+/***********************************************************
+ *  SetPageSlot()
+ *
+ *  This method is used to record the texture slot of a page
+ *  in each of its entries.
+ ***********************************************************/
+void TextureAtlas::SetPageSlot(int page, int slot)
+{
+	for (int i = 1; i < GetEntryCount(); i++)
+	{
+		if (m_entries[i].page == page)
+		{
+			m_entries[i].slot = slot;
+		}
+	}
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method is used to look up a packed image by tag.
+ ***********************************************************/
+int TextureAtlas::FindEntry(const std::string& tag) const
+{
+	for (int i = 1; i < GetEntryCount(); i++)
+	{
+		if (m_entries[i].tag == tag)
+		{
+			return(i);
+		}
+	}
+
+	return(0);
+}
+
+/***********************************************************
+ *  AdaptSceneSources()
+ *
+ *  This method is used to send the reads of the scene
+ *  textures in the fragment shader through atlasTexture().
+ *  It is declared after the sampler and defined at the end,
+ *  where the draw data is in scope.  The entry of a draw
+ *  comes from params.w of its draw data, or from the
+ *  atlasEntry uniform for draws made with per-draw uniforms,
+ *  which in a shader with draw data have a negative draw
+ *  index.  The vertex stage is left as it is.
+ ***********************************************************/
+bool TextureAtlas::AdaptSceneSources(std::string& vertexSource, std::string& fragmentSource)
+{
+	std::regex samplerDeclaration("uniform\\s+sampler2D\\s+objectTextures?\\b[^;]*;");
+	std::regex textureRead("\\btexture\\s*\\(\\s*(objectTextures?\\b)");
+	std::regex drawDataBlock("buffer\\s+DrawDataBlock\\b");
+	std::smatch declaration;
+
+	(void)vertexSource;
+	if ((std::regex_search(fragmentSource, declaration, samplerDeclaration) == false) ||
+		(std::regex_search(fragmentSource, textureRead) == false))
+	{
+		return false;
+	}
+
+	std::string fragment = fragmentSource.substr(0, declaration.position(0) + declaration.length(0));
+	fragment += "\nvec4 atlasTexture(sampler2D atlasSampler, vec2 uv);\n";
+	fragment += declaration.suffix().str();
+	fragment = std::regex_replace(fragment, textureRead, "atlasTexture($1");
+
+	fragment += "\n#define ATLAS_MAX_ENTRIES " + std::to_string(MAX_ENTRIES) + "\n";
+	fragment += "uniform int atlasEntry;\n";
+	if (std::regex_search(fragment, drawDataBlock))
+	{
+		fragment += "#define ATLAS_ENTRY ((drawIndex >= 0) ? draws[drawIndex].params.w : atlasEntry)\n";
+	}
+	else
+	{
+		fragment += "#define ATLAS_ENTRY atlasEntry\n";
+	}
+	fragment += g_AtlasFunctionSource;
+
+	fragmentSource = fragment;
+
+	return true;
+}
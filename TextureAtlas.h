@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.h
+// ============
+// pack the small scene textures into shared pages
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureAtlas
+ *
+ *  This class packs small images into shared texture pages
+ *  when the scene is loaded, so they take one texture unit
+ *  between them instead of one each.  Images are placed with
+ *  a skyline packer, tallest first, and every image is
+ *  surrounded by a gutter holding its own texels wrapped
+ *  around, so filtering across its edges blends like
+ *  GL_REPEAT does.  The mip levels of a page are built here
+ *  image by image rather than by the driver, which keeps the
+ *  gutters at every level and stops small levels from mixing
+ *  neighboring images.  Images are stretched to a multiple
+ *  of the gutter size if needed, so each one lands on whole
+ *  texels down to the smallest level.
+ *
+ *  Each image becomes an entry whose rectangle in its page
+ *  the shader looks up.  AdaptSceneSources() routes the
+ *  texture reads of the scene program through a function
+ *  that wraps the scaled coordinates into that rectangle, so
+ *  SetTextureUVScale() still tiles packed images.  Entry 0
+ *  stands for a texture with a page of its own and is read
+ *  unchanged.
+ ***********************************************************/
+class TextureAtlas
+{
+public:
+	// entries the shader's rectangle table holds, including
+	// the unused entry 0
+	static const int MAX_ENTRIES = 32;
+	// images no larger than this on either side are packed
+	static const int MAX_PACKED_SIZE = 256;
+	// largest side of a page
+	static const int MAX_PAGE_SIZE = 1024;
+	// mip levels of a page, the gutter is a single texel wide
+	// at the smallest
+	static const int PAGE_LEVEL_COUNT = 5;
+	// gutter around every image at the largest level
+	static const int GUTTER_SIZE = 1 << (PAGE_LEVEL_COUNT - 1);
+
+	// a packed image
+	struct ATLAS_ENTRY
+	{
+		std::string tag;
+		// page holding the image, and the texture slot the page
+		// was given
+		int page;
+		int slot;
+		// xy = lower left corner, zw = size, in page coordinates
+		glm::vec4 rect;
+		// average color of the image, for the renderers that
+		// don't read textures
+		glm::vec3 averageColor;
+	};
+
+	// constructor
+	TextureAtlas();
+	// destructor
+	~TextureAtlas();
+
+	// true if an image of this size should be packed
+	static bool IsPackable(int width, int height);
+
+	// keep a decoded 3 or 4 channel image for packing, returns
+	// its entry or 0 if the table is full
+	int AddImage(const std::string& tag, const unsigned char* pPixels, int width, int height, int channels);
+	// pack every added image into pages and build their levels
+	void Build();
+	// create the texture of a built page and free its pixels,
+	// the caller owns the texture
+	GLuint CreatePageTexture(int page);
+	// memory of the texture of a page with its levels
+	size_t GetPageBytes(int page) const;
+	// record the texture slot a page is bound to
+	void SetPageSlot(int page, int slot);
+
+	int GetPageCount() const { return((int)m_pages.size()); }
+	// number of entries including entry 0
+	int GetEntryCount() const { return((int)m_entries.size()); }
+	const ATLAS_ENTRY& GetEntry(int entry) const { return(m_entries[entry]); }
+	// entry of a packed image, 0 if the tag wasn't packed
+	int FindEntry(const std::string& tag) const;
+
+	// route the texture reads of the scene fragment shader
+	// through the atlas rectangles, false if it doesn't read
+	// the scene textures in a way that can be redirected
+	static bool AdaptSceneSources(std::string& vertexSource, std::string& fragmentSource);
+
+private:
+	// a stretch of the top edge of the packed area of a page
+	struct SKYLINE_SEGMENT
+	{
+		int x;
+		int y;
+		int width;
+	};
+
+	// an image waiting to be packed, RGBA with its size
+	// already rounded to whole gutters
+	struct PENDING_IMAGE
+	{
+		int entry;
+		int width;
+		int height;
+		std::vector<unsigned char> pixels;
+		// lower left corner of its cell in the page
+		int cellX;
+		int cellY;
+	};
+
+	// a page and its levels, largest first
+	struct ATLAS_PAGE
+	{
+		std::vector<SKYLINE_SEGMENT> skyline;
+		int width;
+		int height;
+		std::vector<std::vector<unsigned char> > levels;
+	};
+
+	std::vector<ATLAS_ENTRY> m_entries;
+	std::vector<PENDING_IMAGE> m_pendingImages;
+	std::vector<ATLAS_PAGE> m_pages;
+
+	// lowest place on a page a cell fits, false if it doesn't
+	bool FindPosition(const ATLAS_PAGE& page, int width, int height, int& x, int& y, int& segment) const;
+	// raise the skyline of a page over a placed cell
+	void PlaceCell(ATLAS_PAGE& page, int segment, int x, int y, int width, int height);
+	// copy every level of an image and its gutters into its page
+	void WriteImageLevels(ATLAS_PAGE& page, const PENDING_IMAGE& image);
+};
@@ -0,0 +1,544 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.cpp
+// ============
+// make textures usable at once and load their detail over the next frames
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureStreamer.h"
+#include "AssetPack.h"
+#include "GpuResources.h"
+#include "RenderStats.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// texture unit used for uploads, above the units the scene
+	// textures are bound to so those bindings are never touched
+	const int g_UploadTextureUnit = 31;
+	// levels of in-memory chains at or below this size are
+	// uploaded as soon as the texture is created
+	const int g_ImmediateLevelSize = 64;
+
+	/***********************************************************
+	 *  LevelSize()
+	 *
+	 *  Width or height of a mip level.
+	 ***********************************************************/
+	int LevelSize(int size, int level)
+	{
+		return(std::max(1, size >> level));
+	}
+
+	/***********************************************************
+	 *  LevelBytes()
+	 *
+	 *  Bytes of one tightly packed mip level.
+	 ***********************************************************/
+	size_t LevelBytes(int width, int height, int channels, int level)
+	{
+		return((size_t)LevelSize(width, level) * LevelSize(height, level) * channels);
+	}
+}
+
+/***********************************************************
+ *  TextureStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureStreamer::TextureStreamer()
+{
+	m_stats.textureCount = 0;
+	m_stats.fullyResidentCount = 0;
+	m_stats.levelsUploaded = 0;
+	m_stats.bytesUploaded = 0;
+	m_stats.framesStreamed = 0;
+	m_bReported = false;
+	m_bShutdown = false;
+
+	// the scene expects every image flipped, and the setting is
+	// shared by all threads
+	stbi_set_flip_vertically_on_load(true);
+
+	m_worker = std::thread(&TextureStreamer::DecodeLoop, this);
+}
+
+/***********************************************************
+ *  ~TextureStreamer()
+ *
+ *  The destructor for the class.  The texture objects belong
+ *  to whoever created them and are not deleted here.
+ ***********************************************************/
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bShutdown = true;
+	}
+	m_workCondition.notify_all();
+	m_worker.join();
+
+	for (int i = 0; i < (int)m_textures.size(); i++)
+	{
+		delete m_textures[i];
+	}
+	m_textures.clear();
+}
+
+/***********************************************************
+ *  AllocateTexture()
+ *
+ *  This method is used to create a texture with storage for
+ *  every mip level.  Sampling is the same as for textures
+ *  loaded in one go, and only the smallest level is visible
+ *  until larger ones arrive.
+ ***********************************************************/
+GLuint TextureStreamer::AllocateTexture(int width, int height, int channels, int mipCount)
+{
+	GLenum internalFormat = (channels == 4) ? GL_RGBA8 : GL_RGB8;
+	GLenum format = (channels == 4) ? GL_RGBA : GL_RGB;
+	GLuint textureID = 0;
+	GLint activeTexture = 0;
+	GLint boundTexture = 0;
+
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+	glActiveTexture(GL_TEXTURE0 + g_UploadTextureUnit);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// immutable storage avoids the driver checking completeness
+	// each time a level is added
+	if (GLEW_ARB_texture_storage)
+	{
+		glTexStorage2D(GL_TEXTURE_2D, mipCount, internalFormat, width, height);
+	}
+	else
+	{
+		for (int level = 0; level < mipCount; level++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, internalFormat,
+				LevelSize(width, level), LevelSize(height, level), 0, format, GL_UNSIGNED_BYTE, NULL);
+		}
+	}
+
+	// the levels below the base are never sampled, so the base
+	// level alone decides how much detail is shown
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mipCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipCount - 1);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0.0f);
+
+	glBindTexture(GL_TEXTURE_2D, boundTexture);
+	glActiveTexture(activeTexture);
+
+	m_stats.textureCount++;
+	if (m_stats.textureCount == 1)
+	{
+		m_startTime = std::chrono::steady_clock::now();
+	}
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  CreateFromFile()
+ *
+ *  This method is used to create a texture for an image file
+ *  without decoding it.  Only the header is read to size the
+ *  storage, the smallest level is filled with neutral grey,
+ *  and the image is queued for the worker thread.
+ ***********************************************************/
+GLuint TextureStreamer::CreateFromFile(const char* filename)
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+
+	if (stbi_info(filename, &width, &height, &channels) == 0)
+	{
+		std::cout << "Could not load image:" << filename << std::endl;
+		return(0);
+	}
+	if ((channels != 3) && (channels != 4))
+	{
+		std::cout << "Not implemented to handle image with " << channels << " channels" << std::endl;
+		return(0);
+	}
+
+	int mipCount = 1;
+	while ((LevelSize(width, mipCount - 1) > 1) || (LevelSize(height, mipCount - 1) > 1))
+	{
+		mipCount++;
+	}
+
+	STREAMED_TEXTURE* pTexture = new STREAMED_TEXTURE();
+	pTexture->textureID = AllocateTexture(width, height, channels, mipCount);
+	pTexture->filename = filename;
+	pTexture->width = width;
+	pTexture->height = height;
+	pTexture->channels = channels;
+	pTexture->mipCount = mipCount;
+	pTexture->residentLevel = mipCount - 1;
+	pTexture->pMipChain = NULL;
+	pTexture->bDecoded = false;
+	pTexture->bFailed = false;
+	pTexture->bDecoding = false;
+	pTexture->screenSize = 0.0f;
+	pTexture->priority = 0.0f;
+
+	// something to sample until the real levels arrive
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	GLint activeTexture = 0;
+	GLint boundTexture = 0;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+	glActiveTexture(GL_TEXTURE0 + g_UploadTextureUnit);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+	glBindTexture(GL_TEXTURE_2D, pTexture->textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, mipCount - 1, 0, 0, 1, 1,
+		(channels == 4) ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, grey);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, boundTexture);
+	glActiveTexture(activeTexture);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_textures.push_back(pTexture);
+	}
+	m_workCondition.notify_one();
+
+	return(pTexture->textureID);
+}
+
+/***********************************************************
+ *  CreateFromMipChain()
+ *
+ *  This method is used to create a texture from levels that
+ *  are already decoded.  The small levels are uploaded right
+ *  away so the texture looks right at once, and the large
+ *  ones are left for Update().
+ ***********************************************************/
+GLuint TextureStreamer::CreateFromMipChain(
+	const unsigned char* pMipChain,
+	int width,
+	int height,
+	int channels,
+	int mipCount)
+{
+	if ((channels != 3) && (channels != 4))
+	{
+		std::cout << "Not implemented to handle image with " << channels << " channels" << std::endl;
+		return(0);
+	}
+
+	STREAMED_TEXTURE* pTexture = new STREAMED_TEXTURE();
+	pTexture->textureID = AllocateTexture(width, height, channels, mipCount);
+	pTexture->width = width;
+	pTexture->height = height;
+	pTexture->channels = channels;
+	pTexture->mipCount = mipCount;
+	pTexture->residentLevel = mipCount;
+	pTexture->pMipChain = pMipChain;
+	pTexture->bDecoded = true;
+	pTexture->bFailed = false;
+	pTexture->bDecoding = false;
+	pTexture->screenSize = 0.0f;
+	pTexture->priority = 0.0f;
+
+	GLint activeTexture = 0;
+	GLint boundTexture = 0;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+	glActiveTexture(GL_TEXTURE0 + g_UploadTextureUnit);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+
+	while ((pTexture->residentLevel > 0) &&
+		(LevelSize(width, pTexture->residentLevel - 1) <= g_ImmediateLevelSize) &&
+		(LevelSize(height, pTexture->residentLevel - 1) <= g_ImmediateLevelSize))
+	{
+		UploadLevel(*pTexture, pTexture->residentLevel - 1);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, boundTexture);
+	glActiveTexture(activeTexture);
+
+	if (pTexture->residentLevel == 0)
+	{
+		m_stats.fullyResidentCount++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_textures.push_back(pTexture);
+	}
+
+	return(pTexture->textureID);
+}
+
+/***********************************************************
+ *  UploadLevel()
+ *
+ *  This method is used to upload one level and lower the
+ *  base level to it.  The texture is bound on the upload
+ *  unit, which the caller must have made active.
+ ***********************************************************/
+size_t TextureStreamer::UploadLevel(STREAMED_TEXTURE& texture, int level)
+{
+	size_t offset = 0;
+	for (int i = 0; i < level; i++)
+	{
+		offset += LevelBytes(texture.width, texture.height, texture.channels, i);
+	}
+	size_t bytes = LevelBytes(texture.width, texture.height, texture.channels, level);
+
+	glBindTexture(GL_TEXTURE_2D, texture.textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0,
+		LevelSize(texture.width, level), LevelSize(texture.height, level),
+		(texture.channels == 4) ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, texture.pMipChain + offset);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+	texture.residentLevel = level;
+	m_stats.levelsUploaded++;
+	m_stats.bytesUploaded += bytes;
+	RenderStats::Count(RenderStats::COUNTER_TEXTURE_BINDS);
+	RenderStats::Count(RenderStats::COUNTER_UPLOAD_BYTES, bytes);
+
+	return(bytes);
+}
+
+/***********************************************************
+ *  FindTexture()
+ *
+ *  This method is used to look up a texture by object name.
+ ***********************************************************/
+TextureStreamer::STREAMED_TEXTURE* TextureStreamer::FindTexture(GLuint textureID)
+{
+	for (int i = 0; i < (int)m_textures.size(); i++)
+	{
+		if (m_textures[i]->textureID == textureID)
+		{
+			return(m_textures[i]);
+		}
+	}
+
+	return(NULL);
+}
+
+/***********************************************************
+ *  SetScreenSize()
+ *
+ *  This method is used to record how large a texture appears
+ *  in the frame being drawn.
+ ***********************************************************/
+void TextureStreamer::SetScreenSize(GLuint textureID, float pixels)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	STREAMED_TEXTURE* pTexture = FindTexture(textureID);
+
+	if ((pTexture != NULL) && (pixels > pTexture->screenSize))
+	{
+		pTexture->screenSize = pixels;
+	}
+}
+
+/***********************************************************
+ *  GetTextureBytes()
+ *
+ *  This method is used to estimate the memory of a texture.
+ *  All levels are allocated when it is created, so the size
+ *  doesn't change as they stream in.
+ ***********************************************************/
+size_t TextureStreamer::GetTextureBytes(GLuint textureID)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	STREAMED_TEXTURE* pTexture = FindTexture(textureID);
+
+	if (pTexture == NULL)
+	{
+		return(0);
+	}
+
+	return(GpuResourceRegistry::EstimateTextureBytes(pTexture->width, pTexture->height, 4, pTexture->mipCount));
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used to upload the next levels of the
+ *  decoded textures.  Every texture gains at most one level
+ *  per round, largest on screen first, and rounds continue
+ *  until the budget is spent, so all textures sharpen evenly
+ *  instead of one finishing before the next starts.  At least
+ *  one level is uploaded per frame so a single level larger
+ *  than the budget can't stall streaming.
+ ***********************************************************/
+void TextureStreamer::Update(size_t byteBudget)
+{
+	std::vector<STREAMED_TEXTURE*> ready;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (int i = 0; i < (int)m_textures.size(); i++)
+		{
+			STREAMED_TEXTURE* pTexture = m_textures[i];
+
+			pTexture->priority = pTexture->screenSize;
+			pTexture->screenSize = 0.0f;
+
+			if (pTexture->bFailed)
+			{
+				std::cout << "Could not load image:" << pTexture->filename << std::endl;
+				pTexture->bFailed = false;
+				pTexture->residentLevel = 0;
+				m_stats.fullyResidentCount++;
+			}
+			else if (pTexture->bDecoded && (pTexture->residentLevel > 0))
+			{
+				ready.push_back(pTexture);
+			}
+		}
+	}
+
+	if (ready.empty())
+	{
+		return;
+	}
+
+	std::stable_sort(ready.begin(), ready.end(),
+		[](const STREAMED_TEXTURE* a, const STREAMED_TEXTURE* b) { return(a->priority > b->priority); });
+
+	GLint activeTexture = 0;
+	GLint boundTexture = 0;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+	glActiveTexture(GL_TEXTURE0 + g_UploadTextureUnit);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+
+	size_t uploaded = 0;
+	bool bBudgetLeft = true;
+	bool bProgress = true;
+	while (bBudgetLeft && bProgress)
+	{
+		bProgress = false;
+		for (int i = 0; (i < (int)ready.size()) && bBudgetLeft; i++)
+		{
+			STREAMED_TEXTURE& texture = *ready[i];
+			if (texture.residentLevel == 0)
+			{
+				continue;
+			}
+
+			size_t bytes = LevelBytes(texture.width, texture.height, texture.channels, texture.residentLevel - 1);
+			if ((uploaded > 0) && (uploaded + bytes > byteBudget))
+			{
+				bBudgetLeft = false;
+				break;
+			}
+
+			uploaded += UploadLevel(texture, texture.residentLevel - 1);
+			bProgress = true;
+
+			if (texture.residentLevel == 0)
+			{
+				// the decoded copy is no longer needed
+				std::vector<unsigned char>().swap(texture.ownedMipChain);
+				m_stats.fullyResidentCount++;
+			}
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, boundTexture);
+	glActiveTexture(activeTexture);
+
+	m_stats.framesStreamed++;
+
+	if (IsComplete() && (m_bReported == false))
+	{
+		double milliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - m_startTime).count();
+		std::cout << "Texture streaming complete: " << m_stats.textureCount << " textures, "
+			<< m_stats.levelsUploaded << " levels, " << m_stats.bytesUploaded / (1024.0 * 1024.0)
+			<< " MB in " << m_stats.framesStreamed << " frames, " << milliseconds << " ms" << std::endl;
+		m_bReported = true;
+	}
+}
+
+/***********************************************************
+ *  DecodeLoop()
+ *
+ *  This method is the body of the decoding thread.  It takes
+ *  the waiting image that is largest on screen, decodes it
+ *  and builds its mip chain without holding the lock.
+ ***********************************************************/
+void TextureStreamer::DecodeLoop()
+{
+	while (true)
+	{
+		STREAMED_TEXTURE* pNext = NULL;
+		std::string filename;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_workCondition.wait(lock, [this, &pNext]()
+				{
+					pNext = NULL;
+					for (int i = 0; i < (int)m_textures.size(); i++)
+					{
+						STREAMED_TEXTURE* pTexture = m_textures[i];
+						if ((pTexture->filename.empty() == false) && (pTexture->bDecoded == false) &&
+							(pTexture->bDecoding == false) &&
+							((pNext == NULL) || (pTexture->priority > pNext->priority)))
+						{
+							pNext = pTexture;
+						}
+					}
+					return(m_bShutdown || (pNext != NULL));
+				});
+			if (m_bShutdown)
+			{
+				return;
+			}
+			pNext->bDecoding = true;
+			filename = pNext->filename;
+		}
+
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		std::vector<unsigned char> mipChain;
+		unsigned char* image = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+		bool bValid = (image != NULL) && (width == pNext->width) && (height == pNext->height) &&
+			(channels == pNext->channels);
+		if (bValid)
+		{
+			AssetPack::BuildMipChain(image, width, height, channels, mipChain);
+		}
+		if (image != NULL)
+		{
+			stbi_image_free(image);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (bValid)
+		{
+			pNext->ownedMipChain.swap(mipChain);
+			pNext->pMipChain = pNext->ownedMipChain.data();
+			pNext->bDecoded = true;
+		}
+		else
+		{
+			pNext->bFailed = true;
+			pNext->bDecoded = true;
+		}
+	}
+}
@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.h
+// ============
+// make textures usable at once and load their detail over the next frames
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureStreamer
+ *
+ *  This class hands out texture objects that can be drawn
+ *  with right away and fills in their mip levels over the
+ *  following frames, smallest first.  GL_TEXTURE_BASE_LEVEL
+ *  always points at the largest level that has arrived, so
+ *  the texture sharpens as levels are promoted.  Images from
+ *  files are decoded on a worker thread, while mip chains
+ *  already in memory (such as the asset pack) have their
+ *  small levels uploaded immediately.  Each frame, levels are
+ *  uploaded under a byte budget, in order of how large the
+ *  texture appears on screen.
+ ***********************************************************/
+class TextureStreamer
+{
+public:
+	// progress counters
+	struct STREAM_STATS
+	{
+		int textureCount;
+		int fullyResidentCount;
+		int levelsUploaded;
+		size_t bytesUploaded;
+		int framesStreamed;
+	};
+
+	// constructor
+	TextureStreamer();
+	// destructor
+	~TextureStreamer();
+
+	// create a texture for an image file, sized from its header
+	// and decoded in the background, returns 0 on failure
+	GLuint CreateFromFile(const char* filename);
+	// create a texture from a decoded mip chain, which must stay
+	// valid until the texture is fully resident
+	GLuint CreateFromMipChain(
+		const unsigned char* pMipChain,
+		int width,
+		int height,
+		int channels,
+		int mipCount);
+
+	// report the on-screen size in pixels of a draw using the
+	// texture, the largest report of a frame sets its priority
+	void SetScreenSize(GLuint textureID, float pixels);
+	// memory of a texture with every level allocated, 0 if it
+	// isn't streamed
+	size_t GetTextureBytes(GLuint textureID);
+	// upload the next levels within the byte budget, called
+	// once per frame
+	void Update(size_t byteBudget);
+
+	// true once every texture has all of its levels
+	bool IsComplete() const { return(m_stats.fullyResidentCount == m_stats.textureCount); }
+	const STREAM_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// one texture being streamed
+	struct STREAMED_TEXTURE
+	{
+		GLuint textureID;
+		std::string filename;
+		int width;
+		int height;
+		int channels;
+		int mipCount;
+		// smallest level index uploaded so far, the base level
+		int residentLevel;
+		// decoded levels, either owned or pointing elsewhere
+		std::vector<unsigned char> ownedMipChain;
+		const unsigned char* pMipChain;
+		// set by the worker once pMipChain can be read
+		bool bDecoded;
+		bool bFailed;
+		// taken by the worker
+		bool bDecoding;
+		// screen size of the current and the previous frame
+		float screenSize;
+		float priority;
+	};
+
+	std::vector<STREAMED_TEXTURE*> m_textures;
+	STREAM_STATS m_stats;
+	std::chrono::steady_clock::time_point m_startTime;
+	bool m_bReported;
+
+	// background decoding
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_workCondition;
+	bool m_bShutdown;
+
+	// allocate every level and set up the sampling state
+	GLuint AllocateTexture(int width, int height, int channels, int mipCount);
+	// upload one level and make it the base level
+	size_t UploadLevel(STREAMED_TEXTURE& texture, int level);
+	// find a texture by its object name
+	STREAMED_TEXTURE* FindTexture(GLuint textureID);
+	// body of the decoding thread
+	void DecodeLoop();
+};
@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+// threadpool.cpp
+// ============
+// persistent worker threads for splitting per-frame work across cores
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.h"
+
+/***********************************************************
+ *  ThreadPool()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ThreadPool::ThreadPool(int threadCount)
+{
+	m_pTask = NULL;
+	m_taskCount = 0;
+	m_nextIndex = 0;
+	m_activeWorkers = 0;
+	m_generation = 0;
+	m_bShutdown = false;
+
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency();
+	}
+
+	// the calling thread counts as one of the threads
+	for (int i = 1; i < threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+	}
+}
+
+/***********************************************************
+ *  ~ThreadPool()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bShutdown = true;
+	}
+	m_startCondition.notify_all();
+
+	for (int i = 0; i < (int)m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is used to run the task once for every index
+ *  in [0, count), spread across the worker threads and the
+ *  calling thread.  Indices are handed out one at a time, so
+ *  callers should make each index a reasonably sized chunk.
+ ***********************************************************/
+void ThreadPool::ParallelFor(int count, const PARALLEL_TASK& task)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// not worth waking anyone for a single index
+	if ((m_workers.size() == 0) || (count == 1))
+	{
+		for (int i = 0; i < count; i++)
+		{
+			task(i, 0);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pTask = &task;
+		m_taskCount = count;
+		m_nextIndex = 0;
+		m_activeWorkers = (int)m_workers.size();
+		m_generation++;
+	}
+	m_startCondition.notify_all();
+
+	RunTasks(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return(m_activeWorkers == 0); });
+	m_pTask = NULL;
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is the body of each worker thread.  It sleeps
+ *  until a new loop starts, helps run it, and reports back.
+ ***********************************************************/
+void ThreadPool::WorkerLoop(int threadIndex)
+{
+	unsigned int lastGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_startCondition.wait(lock, [this, lastGeneration]()
+				{ return(m_bShutdown || (m_generation != lastGeneration)); });
+			if (m_bShutdown)
+			{
+				return;
+			}
+			lastGeneration = m_generation;
+		}
+
+		RunTasks(threadIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeWorkers--;
+			if (m_activeWorkers == 0)
+			{
+				m_doneCondition.notify_one();
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  RunTasks()
+ *
+ *  This method is used to take indices of the current loop
+ *  until all of them have been claimed.
+ ***********************************************************/
+void ThreadPool::RunTasks(int threadIndex)
+{
+	int index = m_nextIndex.fetch_add(1);
+
+	while (index < m_taskCount)
+	{
+		(*m_pTask)(index, threadIndex);
+		index = m_nextIndex.fetch_add(1);
+	}
+}
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// threadpool.h
+// ============
+// persistent worker threads for splitting per-frame work across cores
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  ThreadPool
+ *
+ *  This class keeps a set of worker threads asleep until a
+ *  parallel loop is started.  The calling thread works on the
+ *  loop as well, and ParallelFor() returns once every index
+ *  has been processed.  Only one loop runs at a time, and a
+ *  task must not start another loop from inside itself.
+ ***********************************************************/
+class ThreadPool
+{
+public:
+	// task run for each index, threadIndex is 0 for the caller
+	typedef std::function<void(int index, int threadIndex)> PARALLEL_TASK;
+
+	// constructor, zero threads means one per hardware core
+	ThreadPool(int threadCount = 0);
+	// destructor
+	~ThreadPool();
+
+	// run the task for every index in [0, count)
+	void ParallelFor(int count, const PARALLEL_TASK& task);
+
+	// number of threads taking part in a loop, including the caller
+	int GetThreadCount() const { return((int)m_workers.size() + 1); }
+
+private:
+	// worker threads
+	std::vector<std::thread> m_workers;
+
+	// protects the loop hand-off between threads
+	std::mutex m_mutex;
+	// wakes the workers when a loop starts
+	std::condition_variable m_startCondition;
+	// wakes the caller when the last worker finishes
+	std::condition_variable m_doneCondition;
+
+	// loop being run
+	const PARALLEL_TASK* m_pTask;
+	int m_taskCount;
+	std::atomic<int> m_nextIndex;
+	// workers that have not yet finished the current loop
+	int m_activeWorkers;
+	// incremented for every loop so workers can tell it is new
+	unsigned int m_generation;
+	bool m_bShutdown;
+
+	// body of each worker thread
+	void WorkerLoop(int threadIndex);
+	// take indices from the current loop until none are left
+	void RunTasks(int threadIndex);
+};
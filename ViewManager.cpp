@@ -8,18 +8,27 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ViewManager.h"
+#include "ResolutionScaler.h"
+#include "CameraUniformBuffer.h"
+#include "CameraRecorder.h"
+#include "RenderStats.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <string>
+
 // declaration of the global variables and defines
 namespace
 {
-	// Variables for window width and height
+	// Variables for the initial window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
+	// current size of the window framebuffer, updated on resize
+	int g_WindowWidth = WINDOW_WIDTH;
+	int g_WindowHeight = WINDOW_HEIGHT;
 	const char* g_ViewName = "view";
 	const char* g_ProjectionName = "projection";
 
@@ -27,6 +36,10 @@ namespace
 	// the 3D scene
 	Camera* g_pCamera = nullptr;
 
+	// offscreen target that renders the 3D scene at a dynamic
+	// resolution driven by the frame time budget
+	ResolutionScaler* g_pResolutionScaler = nullptr;
+
 	// these variables are used for mouse movement processing
 	float gLastX = WINDOW_WIDTH / 2.0f;
 	float gLastY = WINDOW_HEIGHT / 2.0f;
@@ -39,6 +52,88 @@ namespace
 	// the following variable is false when orthographic projection
 	// is off and true when it is on
 	bool bOrthographicProjection = false;
+	// eye position of the orthographic front view
+	const glm::vec3 g_OrthographicEye = glm::vec3(0.0f, 0.0f, 10.0f);
+
+	// uniform buffer sharing the camera data with all programs
+	CameraUniformBuffer* g_pCameraBuffer = nullptr;
+	// last program connected to the camera block
+	GLuint g_RegisteredProgramID = 0;
+	bool g_bProgramUsesCameraBlock = false;
+
+	// cached projection and the inputs it was built from
+	glm::mat4 g_Projection;
+	bool g_bProjectionValid = false;
+	bool g_ProjectionOrthographic = false;
+	float g_ProjectionZoom = 0.0f;
+	float g_ProjectionAspect = 0.0f;
+
+	// what is done with the camera track of the session
+	enum CAMERA_TRACK_MODE
+	{
+		CAMERA_TRACK_NONE,
+		CAMERA_TRACK_RECORD,
+		CAMERA_TRACK_PLAYBACK
+	};
+	CameraRecorder* g_pCameraRecorder = nullptr;
+	CAMERA_TRACK_MODE g_CameraTrackMode = CAMERA_TRACK_NONE;
+	// file the recorded track is written to when closing
+	std::string g_CameraTrackFile;
+	// time of the first recorded frame
+	float g_RecordStartTime = 0.0f;
+	bool g_bRecordStarted = false;
+	// simulated time between played back frames
+	float g_PlaybackStep = 1.0f / 60.0f;
+	int g_PlaybackFrame = 0;
+	bool g_bPlaybackFinished = false;
+	// movement keys held during the current frame
+	uint32_t g_InputFlags = 0;
+
+	// cursor position of a click waiting to be picked
+	bool g_bPickPending = false;
+	double g_PickX = 0.0;
+	double g_PickY = 0.0;
+
+	// the render stats overlay, toggled on each press of F3
+	bool g_bStatsOverlayVisible = false;
+	bool g_bStatsKeyDown = false;
+
+	// fixed orthographic views shown beside the camera, all
+	// looking at the origin
+	struct ORTHOGRAPHIC_VIEW
+	{
+		const char* name;
+		glm::vec3 eye;
+		glm::vec3 up;
+	};
+	const ORTHOGRAPHIC_VIEW g_OrthographicViews[] =
+	{
+		{ "top", glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+		{ "front", g_OrthographicEye, glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ "side", glm::vec3(10.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) }
+	};
+	// half the height the orthographic projections show
+	const float g_OrthographicScale = 10.0f;
+
+	// the views of each layout, the camera first and then the
+	// orthographic views in order
+	const int g_MaxViews = 4;
+	const int g_LayoutViewCounts[ViewManager::VIEW_LAYOUT_COUNT] = { 1, 2, 4 };
+	const glm::vec4 g_LayoutRects[ViewManager::VIEW_LAYOUT_COUNT][g_MaxViews] =
+	{
+		{ glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) },
+		{ glm::vec4(0.0f, 0.0f, 0.5f, 1.0f), glm::vec4(0.5f, 0.0f, 0.5f, 1.0f) },
+		{
+			glm::vec4(0.0f, 0.5f, 0.5f, 0.5f), glm::vec4(0.5f, 0.5f, 0.5f, 0.5f),
+			glm::vec4(0.0f, 0.0f, 0.5f, 0.5f), glm::vec4(0.5f, 0.0f, 0.5f, 0.5f)
+		}
+	};
+	ViewManager::VIEW_LAYOUT g_ViewLayout = ViewManager::VIEW_LAYOUT_SINGLE;
+	bool g_bLayoutKeyDown = false;
+	// views of the current frame, and the one whose camera the
+	// shaders hold
+	ViewManager::SCENE_VIEW g_Views[g_MaxViews];
+	int g_AppliedView = -1;
 }
 
 /***********************************************************
@@ -58,6 +153,10 @@ ViewManager::ViewManager(
 	g_pCamera->Front = glm::vec3(0.0f, -0.5f, -2.0f);
 	g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
 	g_pCamera->Zoom = 80;
+
+	g_pResolutionScaler = new ResolutionScaler();
+	g_pCameraBuffer = new CameraUniformBuffer();
+	g_pCameraRecorder = new CameraRecorder();
 }
 
 /***********************************************************
@@ -75,6 +174,27 @@ ViewManager::~ViewManager()
 		delete g_pCamera;
 		g_pCamera = NULL;
 	}
+	if (NULL != g_pResolutionScaler)
+	{
+		delete g_pResolutionScaler;
+		g_pResolutionScaler = NULL;
+	}
+	if (NULL != g_pCameraBuffer)
+	{
+		delete g_pCameraBuffer;
+		g_pCameraBuffer = NULL;
+	}
+	if (NULL != g_pCameraRecorder)
+	{
+		// keep the recording of the session
+		if (g_CameraTrackMode == CAMERA_TRACK_RECORD)
+		{
+			g_pCameraRecorder->Save(g_CameraTrackFile.c_str());
+		}
+		delete g_pCameraRecorder;
+		g_pCameraRecorder = NULL;
+	}
+	g_CameraTrackMode = CAMERA_TRACK_NONE;
 }
 
 /***********************************************************
@@ -109,8 +229,18 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	// this callback is used to receive mouse wheel scrolling events
 	glfwSetScrollCallback(window, &ViewManager::Mouse_Scroll_Callback);
 
-	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
+	// this callback is used to receive mouse button clicks
+	glfwSetMouseButtonCallback(window, &ViewManager::Mouse_Button_Callback);
+
+	// this callback is used to receive window resizing events
+	glfwSetFramebufferSizeCallback(window, &ViewManager::Frame_Buffer_Size_Callback);
+
+	// the framebuffer can differ from the window size on high DPI displays
+	glfwGetFramebufferSize(window, &g_WindowWidth, &g_WindowHeight);
+	g_pResolutionScaler->SetOutputSize(g_WindowWidth, g_WindowHeight);
+
+	// blending for transparent rendering is only enabled by the
+	// scene manager during its transparent render pass
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_pWindow = window;
@@ -139,6 +269,12 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
 	gLastX = static_cast<float>(xMousePos);
 	gLastY = static_cast<float>(yMousePos);
 
+	// the played back track owns the camera
+	if (g_CameraTrackMode == CAMERA_TRACK_PLAYBACK)
+	{
+		return;
+	}
+
 	// Use Camera's built-in mouse movement processor
 	g_pCamera->ProcessMouseMovement(xOffset, yOffset);
 }
@@ -151,6 +287,11 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
  ***********************************************************/
 void ViewManager::Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset)
 {
+	if (g_CameraTrackMode == CAMERA_TRACK_PLAYBACK)
+	{
+		return;
+	}
+
 	if (g_pCamera)
 	{
 		// yOffset > 0: scroll up, increase speed
@@ -160,6 +301,46 @@ void ViewManager::Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, doub
 	std::cout << "SCROLL yOffset = " << yOffset << std::endl;
 }
 
+/***********************************************************
+ *  Mouse_Button_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  a mouse button is pressed or released in the active GLFW
+ *  display window.  A left click asks for the object under
+ *  the cursor.
+ ***********************************************************/
+void ViewManager::Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if ((button == GLFW_MOUSE_BUTTON_LEFT) && (action == GLFW_PRESS))
+	{
+		glfwGetCursorPos(window, &g_PickX, &g_PickY);
+		g_bPickPending = true;
+	}
+}
+
+/***********************************************************
+ *  Frame_Buffer_Size_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the framebuffer of the display window is resized.
+ ***********************************************************/
+void ViewManager::Frame_Buffer_Size_Callback(GLFWwindow* window, int width, int height)
+{
+	// ignore the zero size reported while the window is minimized
+	if ((width <= 0) || (height <= 0))
+	{
+		return;
+	}
+
+	g_WindowWidth = width;
+	g_WindowHeight = height;
+
+	if (g_pResolutionScaler)
+	{
+		g_pResolutionScaler->SetOutputSize(width, height);
+	}
+}
+
 
 
 
@@ -177,28 +358,56 @@ void ViewManager::ProcessKeyboardEvents()
 	{
 		glfwSetWindowShouldClose(m_pWindow, true);
 	}
+
+	// show or hide the render stats, once per press
+	bool bStatsKeyDown = (glfwGetKey(m_pWindow, GLFW_KEY_F3) == GLFW_PRESS);
+	if (bStatsKeyDown && (g_bStatsKeyDown == false))
+	{
+		g_bStatsOverlayVisible = !g_bStatsOverlayVisible;
+	}
+	g_bStatsKeyDown = bStatsKeyDown;
+
+	// cycle through the view layouts, once per press
+	bool bLayoutKeyDown = (glfwGetKey(m_pWindow, GLFW_KEY_F4) == GLFW_PRESS);
+	if (bLayoutKeyDown && (g_bLayoutKeyDown == false))
+	{
+		SetViewLayout((VIEW_LAYOUT)((g_ViewLayout + 1) % VIEW_LAYOUT_COUNT));
+	}
+	g_bLayoutKeyDown = bLayoutKeyDown;
+
+	// the played back track owns the camera
+	g_InputFlags = 0;
+	if (g_CameraTrackMode == CAMERA_TRACK_PLAYBACK)
+	{
+		return;
+	}
+
 	// move the camera forward.
 	if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS) {
 		// zoom into 3D scene
 		g_pCamera->ProcessKeyboard(FORWARD, gDeltaTime);
+		g_InputFlags |= CameraRecorder::INPUT_FORWARD;
 	}
 
 	//move the camera backward.
 	if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS) {
 		// zoom out of 3D scene
 		g_pCamera->ProcessKeyboard(BACKWARD, gDeltaTime);
+		g_InputFlags |= CameraRecorder::INPUT_BACKWARD;
 	}
 
 	//move the camera left.
 	if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS) {
 		// pan the camera out of the 3D Scene.
 		g_pCamera->ProcessKeyboard(LEFT, gDeltaTime);
+		g_InputFlags |= CameraRecorder::INPUT_LEFT;
 	}
 
 	// move the camera right,
 	if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS) {
 		// pan the camera out of the 3D scene.
 		g_pCamera->ProcessKeyboard(RIGHT, gDeltaTime);
+		g_InputFlags |= CameraRecorder::INPUT_RIGHT;
 	}
 
 
@@ -206,12 +415,14 @@ void ViewManager::ProcessKeyboardEvents()
 	if (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS) {
 		// pan the camera upward
 		g_pCamera->ProcessKeyboard(UP, gDeltaTime);
+		g_InputFlags |= CameraRecorder::INPUT_UP;
 	}
 
 	//move the camera down.
 	if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS) {
 		// pan the camera down.
 		g_pCamera->ProcessKeyboard(DOWN, gDeltaTime);
+		g_InputFlags |= CameraRecorder::INPUT_DOWN;
 	}
 
 	// Switch to perspective view
@@ -236,65 +447,503 @@ void ViewManager::ProcessKeyboardEvents()
 void ViewManager::PrepareSceneView()
 {
 	glm::mat4 view;
-	glm::mat4 projection;
+	glm::vec3 viewPosition;
 
 	// per-frame timing
-	float currentFrame = glfwGetTime();
+	float currentFrame = GetFrameTime();
 	gDeltaTime = currentFrame - gLastFrame;
 	gLastFrame = currentFrame;
 
 	// process any keyboard events that may be waiting in the event queue
 	ProcessKeyboardEvents();
 
-	// define the current projection matrix based on the current mode
+	// follow or extend the camera track
+	UpdateCameraTrack(currentFrame);
+
+	// render into the offscreen target at the current render scale
+	g_pResolutionScaler->BeginSceneFrame();
+
+	// the projection only depends on the mode, zoom and aspect
+	// ratio, so it is rebuilt only when one of those changes.
+	// The camera only gets its part of the window.
+	const glm::vec4& cameraRect = g_LayoutRects[g_ViewLayout][0];
+	float windowAspectRatio = (float)g_WindowWidth / (float)g_WindowHeight;
+	float aspectRatio = windowAspectRatio * cameraRect.z / cameraRect.w;
+	if ((g_bProjectionValid == false) ||
+		(g_ProjectionOrthographic != bOrthographicProjection) ||
+		(g_ProjectionZoom != g_pCamera->Zoom) ||
+		(g_ProjectionAspect != aspectRatio))
+	{
+		if (!bOrthographicProjection)
+		{
+			// Perspective projection (3D)
+			g_Projection = glm::perspective(
+				glm::radians(g_pCamera->Zoom),
+				aspectRatio,
+				0.1f,
+				100.0f
+			);
+		}
+		else
+		{
+			// Orthographic projection (front view 2D)
+			float scale = 10.0f; // adjust to fit your scene
+
+			g_Projection = glm::ortho(
+				-scale * aspectRatio, scale * aspectRatio, // left/right
+				-scale, scale,                             // bottom/top
+				0.1f, 100.0f                               // near/far
+			);
+		}
+
+		g_ProjectionOrthographic = bOrthographicProjection;
+		g_ProjectionZoom = g_pCamera->Zoom;
+		g_ProjectionAspect = aspectRatio;
+		g_bProjectionValid = true;
+	}
+
+	// define the current view matrix based on the current mode
 	if (!bOrthographicProjection)
 	{
 		// Perspective projection (3D)
 		view = g_pCamera->GetViewMatrix();
-
-		projection = glm::perspective(
-			glm::radians(g_pCamera->Zoom),
-			(GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT,
-			0.1f,
-			100.0f
-		);
+		viewPosition = g_pCamera->Position;
 	}
 	else
 	{
-		// Orthographic projection (front view 2D)
-		float scale = 10.0f; // adjust to fit your scene
-		float aspectRatio = (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT;
-
-		projection = glm::ortho(
-			-scale * aspectRatio, scale * aspectRatio, // left/right
-			-scale, scale,                             // bottom/top
-			0.1f, 100.0f                               // near/far
+		// the front view uses its own fixed eye so that the free
+		// camera keeps its place when switching back to perspective
+		view = glm::lookAt(
+			g_OrthographicEye,
+			g_OrthographicEye + glm::vec3(0.0f, 0.0f, -1.0f), // look at origin
+			glm::vec3(0.0f, 1.0f, 0.0f)                       // Y is up
 		);
+		viewPosition = g_OrthographicEye;
+	}
 
-		// Front-view camera setup
-		g_pCamera->Position = glm::vec3(0.0f, 0.0f, 10.0f);  // in front of origin
-		g_pCamera->Front = glm::vec3(0.0f, 0.0f, -1.0f); // look at origin
-		g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);  // Y is up
+	// the camera leads the views of the layout, followed by the
+	// fixed orthographic views
+	g_Views[0].name = "camera";
+	g_Views[0].rect = cameraRect;
+	g_Views[0].view = view;
+	g_Views[0].projection = g_Projection;
+	g_Views[0].position = viewPosition;
+	for (int i = 1; i < g_LayoutViewCounts[g_ViewLayout]; i++)
+	{
+		const ORTHOGRAPHIC_VIEW& orthographic = g_OrthographicViews[i - 1];
+		const glm::vec4& rect = g_LayoutRects[g_ViewLayout][i];
+		float viewAspectRatio = windowAspectRatio * rect.z / rect.w;
+
+		g_Views[i].name = orthographic.name;
+		g_Views[i].rect = rect;
+		g_Views[i].view = glm::lookAt(orthographic.eye, glm::vec3(0.0f), orthographic.up);
+		g_Views[i].projection = glm::ortho(
+			-g_OrthographicScale * viewAspectRatio, g_OrthographicScale * viewAspectRatio,
+			-g_OrthographicScale, g_OrthographicScale,
+			0.1f, 100.0f);
+		g_Views[i].position = orthographic.eye;
+	}
 
-		// Compute view matrix explicitly for orthographic front view
-		view = glm::lookAt(
-			g_pCamera->Position,
-			g_pCamera->Position + g_pCamera->Front,
-			g_pCamera->Up
-		);
+	// upload every camera value for this frame in one buffer update
+	g_pCameraBuffer->Update(view, g_Projection, viewPosition, gDeltaTime, currentFrame);
+
+	// connect newly loaded programs to the shared camera block
+	if ((m_pShaderManager != nullptr) && (g_RegisteredProgramID != m_pShaderManager->m_programID))
+	{
+		g_bProgramUsesCameraBlock = g_pCameraBuffer->RegisterProgram(m_pShaderManager->m_programID);
+		g_RegisteredProgramID = m_pShaderManager->m_programID;
+	}
+
+	// the first view is the camera just uploaded
+	SetViewState(0);
+	g_AppliedView = 0;
+}
+
+/***********************************************************
+ *  ApplyView()
+ *
+ *  This method is used for directing the draws that follow
+ *  into one of the views of the frame.  The first view is
+ *  applied by PrepareSceneView(), and the others upload
+ *  their camera over it without advancing the frame.
+ ***********************************************************/
+void ViewManager::ApplyView(int index)
+{
+	if (index == g_AppliedView)
+	{
+		return;
 	}
 
-	// if the shader manager object is valid
-	if (m_pShaderManager != nullptr)
+	const SCENE_VIEW& view = g_Views[index];
+	g_pCameraBuffer->SetView(view.view, view.projection, view.position);
+	SetViewState(index);
+	g_AppliedView = index;
+}
+
+/***********************************************************
+ *  SetViewState()
+ *
+ *  This method is used for pointing the viewport at a view's
+ *  part of the offscreen target, and for setting its camera
+ *  into programs that don't read the camera block.
+ ***********************************************************/
+void ViewManager::SetViewState(int index)
+{
+	const SCENE_VIEW& view = g_Views[index];
+
+	// split the target on whole pixels, so views that touch
+	// share an edge without a gap or an overlap
+	int width = g_pResolutionScaler->GetRenderWidth();
+	int height = g_pResolutionScaler->GetRenderHeight();
+	int left = (int)(view.rect.x * width + 0.5f);
+	int right = (int)((view.rect.x + view.rect.z) * width + 0.5f);
+	int bottom = (int)(view.rect.y * height + 0.5f);
+	int top = (int)((view.rect.y + view.rect.w) * height + 0.5f);
+	glViewport(left, bottom, right - left, top - bottom);
+	RenderStats::Count(RenderStats::COUNTER_STATE_CHANGES);
+
+	// programs without the camera block still read the
+	// individual uniforms
+	if ((m_pShaderManager != nullptr) && (g_bProgramUsesCameraBlock == false))
 	{
+		RenderStats::Count(RenderStats::COUNTER_UNIFORM_UPLOADS, 3);
+
 		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
+		m_pShaderManager->setMat4Value(g_ViewName, view.view);
 
 		// set the projection matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
+		m_pShaderManager->setMat4Value(g_ProjectionName, view.projection);
 
 		// set the camera position into the shader
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		m_pShaderManager->setVec3Value("viewPosition", view.position);
+	}
+}
+
+/***********************************************************
+ *  SetViewLayout()
+ *
+ *  This method is used for choosing how many views of the
+ *  scene are drawn and where.  The new layout takes effect
+ *  with the next frame.
+ ***********************************************************/
+void ViewManager::SetViewLayout(VIEW_LAYOUT layout)
+{
+	if (g_ViewLayout != layout)
+	{
+		g_ViewLayout = layout;
+		std::cout << "INFO: drawing " << g_LayoutViewCounts[layout] << " view"
+			<< ((g_LayoutViewCounts[layout] == 1) ? "" : "s") << std::endl;
 	}
 }
 
+/***********************************************************
+ *  GetViewLayout()
+ *
+ *  This method is used for getting the current view layout.
+ ***********************************************************/
+ViewManager::VIEW_LAYOUT ViewManager::GetViewLayout() const
+{
+	return(g_ViewLayout);
+}
+
+/***********************************************************
+ *  GetViewCount()
+ *
+ *  This method is used for getting the number of views in
+ *  the current frame.
+ ***********************************************************/
+int ViewManager::GetViewCount() const
+{
+	return(g_LayoutViewCounts[g_ViewLayout]);
+}
+
+/***********************************************************
+ *  GetView()
+ *
+ *  This method is used for getting a view that was prepared
+ *  for the current frame.
+ ***********************************************************/
+const ViewManager::SCENE_VIEW& ViewManager::GetView(int index) const
+{
+	return(g_Views[index]);
+}
+
+/***********************************************************
+ *  GetViewMatrix()
+ *
+ *  This method is used for getting the view matrix of the
+ *  camera that was prepared for the current frame.
+ ***********************************************************/
+glm::mat4 ViewManager::GetViewMatrix() const
+{
+	return(g_Views[0].view);
+}
+
+/***********************************************************
+ *  GetPickRay()
+ *
+ *  This method is used for turning the cursor position of
+ *  the last click into a world space ray, through the view
+ *  that was clicked.  The cursor is in window coordinates,
+ *  which can differ from the framebuffer size, and the ray
+ *  runs from the near to the far plane so both projections
+ *  are handled alike.
+ ***********************************************************/
+bool ViewManager::GetPickRay(glm::vec3& origin, glm::vec3& direction)
+{
+	if (g_bPickPending == false)
+	{
+		return false;
+	}
+	g_bPickPending = false;
+
+	int width = 0;
+	int height = 0;
+	glfwGetWindowSize(m_pWindow, &width, &height);
+	if ((width <= 0) || (height <= 0))
+	{
+		return false;
+	}
+
+	// the window y runs down, the view rectangles run up
+	float windowX = (float)(g_PickX / width);
+	float windowY = (float)(1.0 - g_PickY / height);
+	int viewIndex = 0;
+	for (int i = 0; i < GetViewCount(); i++)
+	{
+		const glm::vec4& rect = g_Views[i].rect;
+		if ((windowX >= rect.x) && (windowX < rect.x + rect.z) && (windowY >= rect.y) && (windowY < rect.y + rect.w))
+		{
+			viewIndex = i;
+			break;
+		}
+	}
+
+	const SCENE_VIEW& view = g_Views[viewIndex];
+	float x = 2.0f * (windowX - view.rect.x) / view.rect.z - 1.0f;
+	float y = 2.0f * (windowY - view.rect.y) / view.rect.w - 1.0f;
+	glm::mat4 inverseViewProjection = glm::inverse(view.projection * view.view);
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+
+	origin = glm::vec3(nearPoint) / nearPoint.w;
+	direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+	return true;
+}
+
+/***********************************************************
+ *  GetProjectionMatrix()
+ *
+ *  This method is used for getting the projection matrix
+ *  of the camera that was prepared for the current frame.
+ ***********************************************************/
+glm::mat4 ViewManager::GetProjectionMatrix() const
+{
+	return(g_Views[0].projection);
+}
+
+/***********************************************************
+ *  GetViewPosition()
+ *
+ *  This method is used for getting the eye position of the
+ *  camera that was prepared for the current frame.
+ ***********************************************************/
+glm::vec3 ViewManager::GetViewPosition() const
+{
+	return(g_Views[0].position);
+}
+
+/***********************************************************
+ *  RegisterShaderProgram()
+ *
+ *  This method is used to connect an additional shader
+ *  program to the shared per-frame camera block.
+ ***********************************************************/
+bool ViewManager::RegisterShaderProgram(GLuint programID)
+{
+	return(g_pCameraBuffer->RegisterProgram(programID));
+}
+
+/***********************************************************
+ *  PresentSceneView()
+ *
+ *  This method is used for upscaling the 3D scene that was
+ *  rendered into the offscreen target onto the display
+ *  window, once all of the scene drawing is finished
+ ***********************************************************/
+void ViewManager::PresentSceneView()
+{
+	g_pResolutionScaler->PresentSceneFrame();
+}
+
+/***********************************************************
+ *  StartCameraRecording()
+ *
+ *  This method is used to record the pose of the camera in
+ *  every frame.  The track is written to the file when the
+ *  view manager is destroyed.
+ ***********************************************************/
+bool ViewManager::StartCameraRecording(const char* filename)
+{
+	g_pCameraRecorder->Clear();
+	g_CameraTrackFile = filename;
+	g_bRecordStarted = false;
+	g_CameraTrackMode = CAMERA_TRACK_RECORD;
+
+	return true;
+}
+
+/***********************************************************
+ *  StartCameraPlayback()
+ *
+ *  This method is used to drive the camera from a recorded
+ *  track instead of the keyboard and mouse.  Frame n shows
+ *  the pose recorded n steps into the track, however long
+ *  the frames really take, so every playback of a track
+ *  renders the same frames.
+ ***********************************************************/
+bool ViewManager::StartCameraPlayback(const char* filename, float frameStep)
+{
+	if ((frameStep <= 0.0f) || (g_pCameraRecorder->Load(filename) == false))
+	{
+		return false;
+	}
+
+	g_PlaybackStep = frameStep;
+	g_PlaybackFrame = 0;
+	g_bPlaybackFinished = false;
+	gLastFrame = 0.0f;
+	g_CameraTrackMode = CAMERA_TRACK_PLAYBACK;
+
+	std::cout << "INFO: playing camera track " << filename << ", " << g_pCameraRecorder->GetSampleCount()
+		<< " recorded frames over " << g_pCameraRecorder->GetDuration() << " seconds" << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  GetFrameTime()
+ *
+ *  This method is used for getting the time of the frame
+ *  about to be prepared, simulated while a track plays.
+ ***********************************************************/
+float ViewManager::GetFrameTime() const
+{
+	if (g_CameraTrackMode == CAMERA_TRACK_PLAYBACK)
+	{
+		return((float)g_PlaybackFrame * g_PlaybackStep);
+	}
+
+	return((float)glfwGetTime());
+}
+
+/***********************************************************
+ *  UpdateCameraTrack()
+ *
+ *  This method is used to record the camera of the frame, or
+ *  to place it from the played back track.  The window is
+ *  closed once playback passes the end of the track.
+ ***********************************************************/
+void ViewManager::UpdateCameraTrack(float frameTime)
+{
+	CameraRecorder::CAMERA_SAMPLE sample;
+
+	if (g_CameraTrackMode == CAMERA_TRACK_RECORD)
+	{
+		if (g_bRecordStarted == false)
+		{
+			g_RecordStartTime = frameTime;
+			g_bRecordStarted = true;
+		}
+
+		sample.time = frameTime - g_RecordStartTime;
+		sample.position = g_pCamera->Position;
+		sample.front = g_pCamera->Front;
+		sample.up = g_pCamera->Up;
+		sample.zoom = g_pCamera->Zoom;
+		sample.inputFlags = g_InputFlags | (bOrthographicProjection ? CameraRecorder::INPUT_ORTHOGRAPHIC : 0);
+		g_pCameraRecorder->AddSample(sample);
+	}
+	else if (g_CameraTrackMode == CAMERA_TRACK_PLAYBACK)
+	{
+		bool bInside = g_pCameraRecorder->GetSample(frameTime, sample);
+		if (g_pCameraRecorder->GetSampleCount() > 0)
+		{
+			g_pCamera->Position = sample.position;
+			g_pCamera->Front = sample.front;
+			g_pCamera->Up = sample.up;
+			g_pCamera->Zoom = sample.zoom;
+			bOrthographicProjection = ((sample.inputFlags & CameraRecorder::INPUT_ORTHOGRAPHIC) != 0);
+		}
+
+		if ((bInside == false) && (g_bPlaybackFinished == false))
+		{
+			std::cout << "INFO: camera playback finished after " << g_PlaybackFrame << " frames" << std::endl;
+			glfwSetWindowShouldClose(m_pWindow, true);
+			g_bPlaybackFinished = true;
+		}
+		g_PlaybackFrame++;
+	}
+}
+
+/***********************************************************
+ *  SetFixedRenderScale()
+ *
+ *  This method is used to stop the dynamic resolution from
+ *  following the frame time, so frames of different runs
+ *  always shade the same number of pixels.
+ ***********************************************************/
+void ViewManager::SetFixedRenderScale(float scale)
+{
+	g_pResolutionScaler->SetScaleRange(scale, scale);
+}
+
+/***********************************************************
+ *  IsStatsOverlayVisible()
+ *
+ *  This method is used to check whether the render stats
+ *  should be drawn over the frame.
+ ***********************************************************/
+bool ViewManager::IsStatsOverlayVisible() const
+{
+	return(g_bStatsOverlayVisible);
+}
+
+/***********************************************************
+ *  SetStatsOverlayVisible()
+ *
+ *  This method is used to show or hide the render stats
+ *  without waiting for F3.
+ ***********************************************************/
+void ViewManager::SetStatsOverlayVisible(bool bVisible)
+{
+	g_bStatsOverlayVisible = bVisible;
+}
+
+/***********************************************************
+ *  AddBenchmarks()
+ *
+ *  This method is used for registering benchmarks of the
+ *  camera work done at the start of every frame.
+ ***********************************************************/
+void ViewManager::AddBenchmarks(BenchmarkSuite& suite)
+{
+	suite.Add("Camera::GetViewMatrix", [](int iterations)
+		{
+			for (int i = 0; i < iterations; i++)
+			{
+				glm::mat4 view = g_pCamera->GetViewMatrix();
+				BenchmarkSuite::DoNotOptimize(view);
+			}
+		});
+	suite.Add("CameraUniformBuffer::Update", [](int iterations)
+		{
+			glm::mat4 view = g_pCamera->GetViewMatrix();
+			for (int i = 0; i < iterations; i++)
+			{
+				g_pCameraBuffer->Update(view, g_Projection, g_pCamera->Position, 0.016f, (float)i);
+			}
+		});
+}
+
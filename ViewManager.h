@@ -10,6 +10,7 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "BenchmarkSuite.h"
 #include "camera.h"
 
 // GLFW library
@@ -18,6 +19,30 @@
 class ViewManager
 {
 public:
+	// how the window is split between views of the scene
+	enum VIEW_LAYOUT
+	{
+		// the camera fills the window
+		VIEW_LAYOUT_SINGLE,
+		// the camera beside an orthographic top view
+		VIEW_LAYOUT_DUAL,
+		// the camera with orthographic top, front and side views
+		VIEW_LAYOUT_QUAD,
+		VIEW_LAYOUT_COUNT
+	};
+
+	// one view of the frame, the camera always being the first
+	struct SCENE_VIEW
+	{
+		const char* name;
+		// part of the window, as x, y, width and height in
+		// fractions from the lower left corner
+		glm::vec4 rect;
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 position;
+	};
+
 	// constructor
 	ViewManager(
 		ShaderManager* pShaderManager);
@@ -30,6 +55,12 @@ public:
 	// Mouse scroll callback for zooming/movement speed
 	static void Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset);
 
+	// mouse button callback for picking objects under the cursor
+	static void Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods);
+
+	// framebuffer size callback for keeping the view in step with window resizing
+	static void Frame_Buffer_Size_Callback(GLFWwindow* window, int width, int height);
+
 
 private:
 	// pointer to shader manager object
@@ -39,6 +70,10 @@ private:
 
 	// process keyboard events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
+	// set the viewport and the individual camera uniforms of a view
+	void SetViewState(int index);
+	// record the camera, or place it from the played back track
+	void UpdateCameraTrack(float frameTime);
 
 public:
 	// create the initial OpenGL display window
@@ -46,4 +81,43 @@ public:
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// upscale the rendered 3D scene into the display window
+	void PresentSceneView();
+
+	// connect an additional shader program to the per-frame camera block
+	bool RegisterShaderProgram(GLuint programID);
+
+	// split the window between several views, also cycled
+	// with F4
+	void SetViewLayout(VIEW_LAYOUT layout);
+	VIEW_LAYOUT GetViewLayout() const;
+	// views prepared for the current frame
+	int GetViewCount() const;
+	const SCENE_VIEW& GetView(int index) const;
+	// make the draws that follow land in a view, with its camera
+	void ApplyView(int index);
+
+	// camera values prepared for the current frame
+	glm::mat4 GetViewMatrix() const;
+	glm::mat4 GetProjectionMatrix() const;
+	glm::vec3 GetViewPosition() const;
+	// world space ray under the cursor of the last click, once
+	// per click, false if there was none
+	bool GetPickRay(glm::vec3& origin, glm::vec3& direction);
+
+	// record the camera path to a track written when closing
+	bool StartCameraRecording(const char* filename);
+	// drive the camera from a recorded track at a fixed step
+	bool StartCameraPlayback(const char* filename, float frameStep);
+	// time of the next frame, simulated during playback
+	float GetFrameTime() const;
+
+	// keep the scene at one render scale, for repeatable timings
+	void SetFixedRenderScale(float scale);
+	// the render stats overlay, also toggled with F3
+	bool IsStatsOverlayVisible() const;
+	void SetStatsOverlayVisible(bool bVisible);
+	// register the benchmarks of the per-frame camera work
+	void AddBenchmarks(BenchmarkSuite& suite);
 };
\ No newline at end of file